@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    ElsBench.hpp
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <ctime>
+#include <stdint.h>
+
+namespace elsbench {
+
+typedef void (*BenchFunc)(void);
+
+struct BenchCase
+{
+    const char* suite;
+    const char* name;
+    BenchFunc func;
+};
+
+inline std::vector<BenchCase>& registry(void)
+{
+    static std::vector<BenchCase> cases;
+    return cases;
+}
+
+class Registrar
+{
+public:
+
+    Registrar(const char* suite, const char* name, BenchFunc func)
+    {
+        BenchCase bc = { suite, name, func };
+        registry().push_back(bc);
+    }
+};
+
+inline uint64_t nowNs(void)
+{
+    ::timespec ts;
+
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Iteration counts are scaled by ELSBENCH_SCALE (percent, default 100)
+ * so that the whole suite can be run quickly on slow targets.
+ */
+inline unsigned long scaled(unsigned long iterations)
+{
+    const char* env = ::getenv("ELSBENCH_SCALE");
+    unsigned long scale = env ? ::strtoul(env, 0, 10) : 100;
+    unsigned long ret = iterations * scale / 100;
+
+    return ret > 0 ? ret : 1;
+}
+
+inline void report(const char* label, unsigned long ops, uint64_t ns)
+{
+    double secs = static_cast<double>(ns) / 1e9;
+
+    ::printf("  %-48s %14.0f ops/s %10.1f ns/op\n", label,
+            secs > 0 ? ops / secs : 0.0,
+            ops > 0 ? static_cast<double>(ns) / ops : 0.0);
+    ::fflush(stdout);
+}
+
+inline int runElsBenchmarks(int argc, char** argv)
+{
+    std::vector<BenchCase>& cases = registry();
+    std::string fullName;
+
+    for (std::vector<BenchCase>::iterator it = cases.begin();
+            it != cases.end(); ++it)
+    {
+        fullName = std::string(it->suite) + "." + it->name;
+        if ((argc > 1) && (fullName.find(argv[1]) == std::string::npos))
+            continue;
+
+        ::printf("[ BENCH ] %s\n", fullName.c_str());
+        ::fflush(stdout);
+        it->func();
+    }
+
+    return 0;
+}
+
+} /* namespace elsbench */
+
+#define ELSBENCH_SIMPLE_CASE(SUITE, NAME)                                   \
+    static void elsbench_##SUITE##_##NAME(void);                            \
+    static elsbench::Registrar elsbench_reg_##SUITE##_##NAME(               \
+            #SUITE, #NAME, elsbench_##SUITE##_##NAME);                      \
+    static void elsbench_##SUITE##_##NAME(void)
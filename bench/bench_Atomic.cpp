@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    bench_Atomic.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/Atomic.hpp>
+#include <els/IThread.hpp>
+
+#include <vector>
+
+namespace {
+
+typedef els::thread::AtomicUint AtomicUint;
+
+enum LoadKind
+{
+    LOAD_LEGACY,
+    LOAD_GET,
+    LOAD_ACQUIRE,
+    LOAD_RELAXED,
+};
+
+const char* const loadNames[] = {
+    "__sync_fetch_and_or(0)",
+    "get() (seq_cst load)",
+    "load(acquire)",
+    "load(relaxed)",
+};
+
+struct Counter
+{
+    Counter(void) : value(1), raw(1) {}
+
+    AtomicUint value;
+    volatile unsigned raw;
+};
+
+unsigned readLoop(Counter& counter, LoadKind kind, unsigned long iterations)
+{
+    AtomicUint& value = counter.value;
+    unsigned sum = 0;
+
+    for (unsigned long i = 0; i < iterations; ++i)
+    {
+        switch (kind)
+        {
+        case LOAD_LEGACY:
+            /* What Atomic<T>::get() used to do. */
+            sum += ::__sync_fetch_and_or(&counter.raw, 0);
+            break;
+        case LOAD_GET:
+            sum += value.get();
+            break;
+        case LOAD_ACQUIRE:
+            sum += value.load(els::thread::MEMORY_ORDER_ACQUIRE);
+            break;
+        case LOAD_RELAXED:
+            sum += value.load(els::thread::MEMORY_ORDER_RELAXED);
+            break;
+        }
+    }
+
+    return sum;
+}
+
+class Reader : public els::thread::IThread
+{
+public:
+
+    Reader(Counter& counter, LoadKind kind, unsigned long iterations)
+        : els::thread::IThread(), sink(0), _M_counter(counter), _M_kind(kind),
+          _M_iterations(iterations) {}
+
+    volatile unsigned sink;
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        this->sink = readLoop(this->_M_counter, this->_M_kind,
+                this->_M_iterations);
+        return 0;
+    }
+
+private:
+
+    Counter& _M_counter;
+    LoadKind _M_kind;
+    unsigned long _M_iterations;
+};
+
+}
+
+ELSBENCH_SIMPLE_CASE(Atomic, loadPath)
+{
+    unsigned long iterations = elsbench::scaled(20000000);
+    Counter counter;
+    volatile unsigned sink = 0;
+    uint64_t start = 0;
+
+    for (int kind = LOAD_LEGACY; kind <= LOAD_RELAXED; ++kind)
+    {
+        start = elsbench::nowNs();
+        sink = readLoop(counter, static_cast<LoadKind>(kind), iterations);
+        elsbench::report(loadNames[kind], iterations,
+                elsbench::nowNs() - start);
+    }
+    (void)sink;
+}
+
+/*
+ * Readers sharing a counter, e.g. threads checking a reference count.
+ * Locked reads bounce the cache line between cores, plain loads share it.
+ */
+ELSBENCH_SIMPLE_CASE(Atomic, sharedReaders)
+{
+    const size_t numReaders = 4;
+    unsigned long iterations = elsbench::scaled(5000000);
+    Counter counter;
+    std::vector<Reader*> readers;
+    char label[64];
+    uint64_t start = 0;
+
+    for (int kind = LOAD_LEGACY; kind <= LOAD_RELAXED; ++kind)
+    {
+        for (size_t i = 0; i < numReaders; ++i)
+            readers.push_back(new Reader(counter, static_cast<LoadKind>(kind),
+                    iterations));
+
+        start = elsbench::nowNs();
+        for (size_t i = 0; i < numReaders; ++i)
+            readers[i]->start();
+        for (size_t i = 0; i < numReaders; ++i)
+            readers[i]->join();
+
+        ::snprintf(label, sizeof(label), "%s, %zu readers",
+                loadNames[kind], numReaders);
+        elsbench::report(label, iterations * numReaders,
+                elsbench::nowNs() - start);
+
+        for (size_t i = 0; i < numReaders; ++i)
+            delete readers[i];
+        readers.clear();
+    }
+}
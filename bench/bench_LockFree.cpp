@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    bench_LockFree.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/SpscQueue.hpp>
+#include <els/MpscQueue.hpp>
+#include <els/MpmcQueue.hpp>
+#include <els/TreiberStack.hpp>
+#include <els/Mutex.hpp>
+#include <els/AutoMutex.hpp>
+#include <els/IThread.hpp>
+
+#include <list>
+#include <vector>
+#include <sched.h>
+
+namespace {
+
+const size_t queueCapacity = 1024;
+
+/* What producer/consumer hand-offs used before the lock-free containers. */
+class LockedList
+{
+public:
+
+    bool push(unsigned long val)
+    {
+        els::thread::AutoMutex lock(this->_M_mutex);
+
+        this->_M_list.push_back(val);
+        return true;
+    }
+
+    bool pop(unsigned long& val)
+    {
+        els::thread::AutoMutex lock(this->_M_mutex);
+
+        if (this->_M_list.empty())
+            return false;
+
+        val = this->_M_list.front();
+        this->_M_list.pop_front();
+        return true;
+    }
+
+    bool popBack(unsigned long& val)
+    {
+        els::thread::AutoMutex lock(this->_M_mutex);
+
+        if (this->_M_list.empty())
+            return false;
+
+        val = this->_M_list.back();
+        this->_M_list.pop_back();
+        return true;
+    }
+
+private:
+
+    els::thread::Mutex _M_mutex;
+    std::list<unsigned long> _M_list;
+};
+
+struct Item : public els::thread::MpscNode
+{
+    unsigned long value;
+};
+
+/* Nodes are preallocated, the intrusive queue itself never allocates. */
+class IntrusiveQueue
+{
+public:
+
+    explicit IntrusiveQueue(unsigned long total) : _M_items(total) {}
+
+    bool push(unsigned long val)
+    {
+        this->_M_items[val].value = val;
+        this->_M_queue.push(&this->_M_items[val]);
+        return true;
+    }
+
+    bool pop(unsigned long& val)
+    {
+        Item* item = this->_M_queue.pop();
+
+        if (item == 0)
+            return false;
+
+        val = item->value;
+        return true;
+    }
+
+private:
+
+    std::vector<Item> _M_items;
+    els::thread::MpscQueue<Item> _M_queue;
+};
+
+template <typename Q> class Producer : public els::thread::IThread
+{
+public:
+
+    Producer(Q& queue, unsigned long first, unsigned long count)
+        : els::thread::IThread(), _M_queue(queue), _M_first(first),
+          _M_count(count) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        unsigned long end = this->_M_first + this->_M_count;
+
+        for (unsigned long i = this->_M_first; i < end; ++i)
+        {
+            while (!this->_M_queue.push(i))
+                ::sched_yield();
+        }
+
+        return 0;
+    }
+
+private:
+
+    Q& _M_queue;
+    unsigned long _M_first;
+    unsigned long _M_count;
+};
+
+template <typename Q> class Consumer : public els::thread::IThread
+{
+public:
+
+    Consumer(Q& queue, unsigned long count)
+        : els::thread::IThread(), sink(0), _M_queue(queue), _M_count(count) {}
+
+    volatile unsigned long sink;
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        unsigned long val = 0;
+
+        for (unsigned long i = 0; i < this->_M_count; )
+        {
+            if (this->_M_queue.pop(val))
+            {
+                this->sink += val;
+                ++i;
+            }
+            else
+            {
+                ::sched_yield();
+            }
+        }
+
+        return 0;
+    }
+
+private:
+
+    Q& _M_queue;
+    unsigned long _M_count;
+};
+
+template <typename Q>
+void runQueue(const char* label, Q& queue, size_t producers,
+        unsigned long total)
+{
+    std::vector<Producer<Q>*> threads;
+    Consumer<Q> consumer(queue, total);
+    unsigned long perProducer = total / producers;
+    uint64_t start = 0;
+
+    for (size_t i = 0; i < producers; ++i)
+        threads.push_back(new Producer<Q>(queue, i * perProducer,
+                perProducer));
+
+    start = elsbench::nowNs();
+    consumer.start();
+    for (size_t i = 0; i < producers; ++i)
+        threads[i]->start();
+    for (size_t i = 0; i < producers; ++i)
+        threads[i]->join();
+    consumer.join();
+    elsbench::report(label, total, elsbench::nowNs() - start);
+
+    for (size_t i = 0; i < producers; ++i)
+        delete threads[i];
+}
+
+class TreiberWorker : public els::thread::IThread
+{
+public:
+
+    TreiberWorker(els::thread::TreiberStack<unsigned long>& stack,
+            unsigned long count)
+        : els::thread::IThread(), _M_stack(stack), _M_count(count) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        unsigned long val = 0;
+
+        for (unsigned long i = 0; i < this->_M_count; ++i)
+        {
+            this->_M_stack.push(i);
+            this->_M_stack.pop(val);
+        }
+
+        return 0;
+    }
+
+private:
+
+    els::thread::TreiberStack<unsigned long>& _M_stack;
+    unsigned long _M_count;
+};
+
+class LockedStackWorker : public els::thread::IThread
+{
+public:
+
+    LockedStackWorker(LockedList& stack, unsigned long count)
+        : els::thread::IThread(), _M_stack(stack), _M_count(count) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        unsigned long val = 0;
+
+        for (unsigned long i = 0; i < this->_M_count; ++i)
+        {
+            this->_M_stack.push(i);
+            this->_M_stack.popBack(val);
+        }
+
+        return 0;
+    }
+
+private:
+
+    LockedList& _M_stack;
+    unsigned long _M_count;
+};
+
+template <typename W, typename S>
+void runStack(const char* label, S& stack, size_t numThreads,
+        unsigned long perThread)
+{
+    std::vector<W*> threads;
+    uint64_t start = 0;
+
+    for (size_t i = 0; i < numThreads; ++i)
+        threads.push_back(new W(stack, perThread));
+
+    start = elsbench::nowNs();
+    for (size_t i = 0; i < numThreads; ++i)
+        threads[i]->start();
+    for (size_t i = 0; i < numThreads; ++i)
+        threads[i]->join();
+    elsbench::report(label, numThreads * perThread * 2,
+            elsbench::nowNs() - start);
+
+    for (size_t i = 0; i < numThreads; ++i)
+        delete threads[i];
+}
+
+}
+
+ELSBENCH_SIMPLE_CASE(LockFree, spsc)
+{
+    unsigned long total = elsbench::scaled(2000000);
+    els::thread::SpscQueue<unsigned long> spsc(queueCapacity);
+    els::thread::MpmcQueue<unsigned long> mpmc(queueCapacity);
+    LockedList locked;
+
+    runQueue("SpscQueue", spsc, 1, total);
+    runQueue("MpmcQueue", mpmc, 1, total);
+    runQueue("Mutex + std::list", locked, 1, total);
+}
+
+ELSBENCH_SIMPLE_CASE(LockFree, mpsc)
+{
+    const size_t numProducers = 4;
+    unsigned long total = elsbench::scaled(2000000) / numProducers
+            * numProducers;
+    IntrusiveQueue mpsc(total);
+    els::thread::MpmcQueue<unsigned long> mpmc(queueCapacity);
+    LockedList locked;
+
+    runQueue("MpscQueue, 4 producers", mpsc, numProducers, total);
+    runQueue("MpmcQueue, 4 producers", mpmc, numProducers, total);
+    runQueue("Mutex + std::list, 4 producers", locked, numProducers, total);
+}
+
+ELSBENCH_SIMPLE_CASE(LockFree, stack)
+{
+    const size_t numThreads = 4;
+    unsigned long perThread = elsbench::scaled(1000000) / numThreads;
+    els::thread::TreiberStack<unsigned long> treiber;
+    LockedList locked;
+
+    runStack<TreiberWorker>("TreiberStack push+pop, 4 threads", treiber,
+            numThreads, perThread);
+    runStack<LockedStackWorker>("Mutex + std::list push+pop, 4 threads",
+            locked, numThreads, perThread);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    bench_Mutex.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/Mutex.hpp>
+#include <els/FastMutex.hpp>
+#include <els/TicketLock.hpp>
+#include <els/McsLock.hpp>
+#include <els/IThread.hpp>
+
+#include <vector>
+#include <pthread.h>
+
+namespace {
+
+const size_t threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+const size_t numThreadCounts = sizeof(threadCounts) / sizeof(threadCounts[0]);
+
+/* Iterations of busy work inside the critical section. */
+const unsigned sectionLengths[] = { 0, 200 };
+const size_t numSectionLengths =
+        sizeof(sectionLengths) / sizeof(sectionLengths[0]);
+
+/* Plain default pthread mutex, without Mutex's error checking. */
+class PthreadMutex
+{
+public:
+
+    PthreadMutex(void) { ::pthread_mutex_init(&this->_M_mutex, 0); }
+    ~PthreadMutex(void) { ::pthread_mutex_destroy(&this->_M_mutex); }
+
+    void lock(void) { ::pthread_mutex_lock(&this->_M_mutex); }
+    void unlock(void) { ::pthread_mutex_unlock(&this->_M_mutex); }
+
+private:
+
+    ::pthread_mutex_t _M_mutex;
+};
+
+class DebugFastMutex : public els::thread::FastMutex
+{
+public:
+
+    DebugFastMutex(void) : els::thread::FastMutex(true) {}
+};
+
+template <typename L> class Worker : public els::thread::IThread
+{
+public:
+
+    Worker(L& lock, volatile unsigned long& shared, unsigned long iterations,
+            unsigned sectionLength)
+        : els::thread::IThread(), _M_lock(lock), _M_shared(shared),
+          _M_iterations(iterations), _M_sectionLength(sectionLength) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        for (unsigned long i = 0; i < this->_M_iterations; ++i)
+        {
+            this->_M_lock.lock();
+            for (unsigned j = 0; j < this->_M_sectionLength; ++j)
+                this->_M_shared = this->_M_shared + j;
+            this->_M_shared = this->_M_shared + 1;
+            this->_M_lock.unlock();
+        }
+
+        return 0;
+    }
+
+private:
+
+    L& _M_lock;
+    volatile unsigned long& _M_shared;
+    unsigned long _M_iterations;
+    unsigned _M_sectionLength;
+};
+
+template <typename L>
+void runLock(const char* name, unsigned long total)
+{
+    std::vector<Worker<L>*> workers;
+    volatile unsigned long shared = 0;
+    L lock;
+    char label[80];
+    uint64_t start = 0;
+
+    for (size_t s = 0; s < numSectionLengths; ++s)
+    {
+        for (size_t t = 0; t < numThreadCounts; ++t)
+        {
+            for (size_t i = 0; i < threadCounts[t]; ++i)
+                workers.push_back(new Worker<L>(lock, shared,
+                        total / threadCounts[t], sectionLengths[s]));
+
+            start = elsbench::nowNs();
+            for (size_t i = 0; i < workers.size(); ++i)
+                workers[i]->start();
+            for (size_t i = 0; i < workers.size(); ++i)
+                workers[i]->join();
+            ::snprintf(label, sizeof(label), "%s, cs %u, %zu threads", name,
+                    sectionLengths[s], threadCounts[t]);
+            elsbench::report(label, total, elsbench::nowNs() - start);
+
+            for (size_t i = 0; i < workers.size(); ++i)
+                delete workers[i];
+            workers.clear();
+        }
+    }
+}
+
+template <typename L>
+void runUncontended(const char* label, unsigned long iterations)
+{
+    L lock;
+    uint64_t start = elsbench::nowNs();
+
+    for (unsigned long i = 0; i < iterations; ++i)
+    {
+        lock.lock();
+        lock.unlock();
+    }
+    elsbench::report(label, iterations, elsbench::nowNs() - start);
+}
+
+}
+
+ELSBENCH_SIMPLE_CASE(Mutex, uncontended)
+{
+    unsigned long iterations = elsbench::scaled(10000000);
+
+    runUncontended<PthreadMutex>("pthread default lock+unlock", iterations);
+    runUncontended<els::thread::Mutex>("Mutex lock+unlock", iterations);
+    runUncontended<els::thread::FastMutex>("FastMutex lock+unlock",
+            iterations);
+    runUncontended<els::thread::TicketLock>("TicketLock lock+unlock",
+            iterations);
+    runUncontended<els::thread::McsLock>("McsLock lock+unlock", iterations);
+}
+
+ELSBENCH_SIMPLE_CASE(Mutex, contended)
+{
+    unsigned long total = elsbench::scaled(1000000);
+
+    runLock<PthreadMutex>("pthread default", total);
+    runLock<els::thread::Mutex>("Mutex", total);
+    runLock<els::thread::FastMutex>("FastMutex", total);
+    runLock<DebugFastMutex>("FastMutex debug", total);
+    runLock<els::thread::TicketLock>("TicketLock", total);
+    runLock<els::thread::McsLock>("McsLock", total);
+}
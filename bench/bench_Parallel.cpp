@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    bench_Parallel.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/Parallel.hpp>
+#include <els/ThreadPool.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+namespace {
+
+typedef els::thread::ThreadPool ThreadPool;
+
+const size_t workerCounts[] = { 1, 2, 4, 8 };
+const size_t numWorkerCounts = sizeof(workerCounts) / sizeof(workerCounts[0]);
+
+class Filter
+{
+public:
+
+    Filter(const std::vector<float>& in, std::vector<float>& out)
+        : _M_in(in), _M_out(out) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+            this->_M_out[i] = std::sqrt(this->_M_in[i] * 0.5f + 1.0f);
+    }
+
+private:
+
+    const std::vector<float>& _M_in;
+    std::vector<float>& _M_out;
+};
+
+class SumSquares
+{
+public:
+
+    explicit SumSquares(const std::vector<float>& in) : _M_in(in) {}
+
+    double operator()(size_t begin, size_t end) const
+    {
+        double sum = 0.0;
+
+        for (size_t i = begin; i < end; ++i)
+            sum += this->_M_in[i] * this->_M_in[i];
+        return sum;
+    }
+
+private:
+
+    const std::vector<float>& _M_in;
+};
+
+void fillRandom(std::vector<float>& data)
+{
+    unsigned seed = 12345;
+
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = static_cast<float>(seed >> 8);
+    }
+}
+
+void reportSpeedup(const char* name, size_t workers, unsigned long ops,
+        uint64_t serialNs, uint64_t parallelNs)
+{
+    char label[64];
+
+    ::snprintf(label, sizeof(label), "%s, %zu workers (%.2fx)", name, workers,
+            parallelNs > 0 ? static_cast<double>(serialNs) / parallelNs : 0.0);
+    elsbench::report(label, ops, parallelNs);
+}
+
+}
+
+ELSBENCH_SIMPLE_CASE(Parallel, parallelForSpeedup)
+{
+    size_t count = elsbench::scaled(4000000);
+    std::vector<float> in(count);
+    std::vector<float> out(count);
+    uint64_t serialNs = 0;
+    uint64_t start = 0;
+
+    fillRandom(in);
+    start = elsbench::nowNs();
+    Filter(in, out)(0, count);
+    serialNs = elsbench::nowNs() - start;
+    elsbench::report("serial", count, serialNs);
+
+    for (size_t i = 0; i < numWorkerCounts; ++i)
+    {
+        ThreadPool pool;
+
+        pool.start(workerCounts[i]);
+        start = elsbench::nowNs();
+        els::thread::parallelFor(pool, 0, count, Filter(in, out));
+        reportSpeedup("parallelFor", workerCounts[i], count, serialNs,
+                elsbench::nowNs() - start);
+        pool.stop();
+    }
+}
+
+ELSBENCH_SIMPLE_CASE(Parallel, parallelReduceSpeedup)
+{
+    size_t count = elsbench::scaled(4000000);
+    std::vector<float> in(count);
+    volatile double sink = 0.0;
+    uint64_t serialNs = 0;
+    uint64_t start = 0;
+
+    fillRandom(in);
+    start = elsbench::nowNs();
+    sink = SumSquares(in)(0, count);
+    serialNs = elsbench::nowNs() - start;
+    elsbench::report("serial", count, serialNs);
+
+    for (size_t i = 0; i < numWorkerCounts; ++i)
+    {
+        ThreadPool pool;
+
+        pool.start(workerCounts[i]);
+        start = elsbench::nowNs();
+        sink = els::thread::parallelReduce(pool, 0, count, 0.0,
+                SumSquares(in), std::plus<double>());
+        reportSpeedup("parallelReduce", workerCounts[i], count, serialNs,
+                elsbench::nowNs() - start);
+        pool.stop();
+    }
+    (void)sink;
+}
+
+ELSBENCH_SIMPLE_CASE(Parallel, parallelSortSpeedup)
+{
+    size_t count = elsbench::scaled(2000000);
+    std::vector<float> data(count);
+    std::vector<float> work;
+    uint64_t serialNs = 0;
+    uint64_t start = 0;
+
+    fillRandom(data);
+    work = data;
+    start = elsbench::nowNs();
+    std::sort(work.begin(), work.end());
+    serialNs = elsbench::nowNs() - start;
+    elsbench::report("std::sort", count, serialNs);
+
+    for (size_t i = 0; i < numWorkerCounts; ++i)
+    {
+        ThreadPool pool;
+
+        work = data;
+        pool.start(workerCounts[i]);
+        start = elsbench::nowNs();
+        els::thread::parallelSort(pool, work.begin(), work.end());
+        reportSpeedup("parallelSort", workerCounts[i], count, serialNs,
+                elsbench::nowNs() - start);
+        pool.stop();
+    }
+}
+
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    bench_Rcu.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/Rcu.hpp>
+#include <els/ReadWriteLock.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+typedef std::map<unsigned, unsigned> RouteTable;
+
+enum LockKind
+{
+    LOCK_RCU,
+    LOCK_RWLOCK,
+};
+
+const char* const lockNames[] = {
+    "Rcu::readLock()",
+    "ReadWriteLock::rdlock()",
+};
+
+const size_t readerCounts[] = { 1, 4, 16, 64 };
+const size_t numReaderCounts = sizeof(readerCounts) / sizeof(readerCounts[0]);
+const unsigned numRoutes = 256;
+
+els::thread::AtomicInt stopWriter(0);
+
+RouteTable* makeTable(unsigned generation)
+{
+    RouteTable* table = new RouteTable;
+
+    for (unsigned i = 0; i < numRoutes; ++i)
+        (*table)[i] = i + generation;
+
+    return table;
+}
+
+struct Shared
+{
+    Shared(void)
+        : rcuTable(makeTable(0)), rwlock(), lockedTable(makeTable(0)) {}
+
+    ~Shared(void)
+    {
+        delete this->lockedTable;
+    }
+
+    els::thread::RcuPtr<RouteTable> rcuTable;
+    els::thread::ReadWriteLock rwlock;
+    RouteTable* lockedTable;
+};
+
+class Reader : public els::thread::IThread
+{
+public:
+
+    Reader(Shared& shared, LockKind kind, unsigned long iterations)
+        : els::thread::IThread(), sink(0), _M_shared(shared), _M_kind(kind),
+          _M_iterations(iterations) {}
+
+    volatile unsigned sink;
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        unsigned key = 0;
+
+        for (unsigned long i = 0; i < this->_M_iterations; ++i)
+        {
+            key = i % numRoutes;
+            if (this->_M_kind == LOCK_RCU)
+            {
+                els::thread::RcuReadGuard guard;
+
+                this->sink += this->_M_shared.rcuTable.get()->find(key)
+                        ->second;
+            }
+            else
+            {
+                this->_M_shared.rwlock.rdlock();
+                this->sink += this->_M_shared.lockedTable->find(key)->second;
+                this->_M_shared.rwlock.unlock();
+            }
+        }
+
+        return 0;
+    }
+
+private:
+
+    Shared& _M_shared;
+    LockKind _M_kind;
+    unsigned long _M_iterations;
+};
+
+/* Installs a new table about every millisecond. */
+class Writer : public els::thread::IThread
+{
+public:
+
+    Writer(Shared& shared, LockKind kind)
+        : els::thread::IThread(), _M_shared(shared), _M_kind(kind) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        RouteTable* table = 0;
+
+        for (unsigned gen = 1;
+                stopWriter.load(els::thread::MEMORY_ORDER_RELAXED) == 0;
+                ++gen)
+        {
+            table = makeTable(gen);
+            if (this->_M_kind == LOCK_RCU)
+            {
+                this->_M_shared.rcuTable.replace(table);
+            }
+            else
+            {
+                this->_M_shared.rwlock.wrlock();
+                std::swap(table, this->_M_shared.lockedTable);
+                this->_M_shared.rwlock.unlock();
+                delete table;
+            }
+            ::usleep(1000);
+        }
+
+        return 0;
+    }
+
+private:
+
+    Shared& _M_shared;
+    LockKind _M_kind;
+};
+
+void runReaders(bool withWriter)
+{
+    unsigned long total = elsbench::scaled(4000000);
+    std::vector<Reader*> readers;
+    Shared shared;
+    Writer* writer = 0;
+    char label[80];
+    uint64_t start = 0;
+
+    for (size_t c = 0; c < numReaderCounts; ++c)
+    {
+        for (int kind = LOCK_RCU; kind <= LOCK_RWLOCK; ++kind)
+        {
+            for (size_t i = 0; i < readerCounts[c]; ++i)
+                readers.push_back(new Reader(shared,
+                        static_cast<LockKind>(kind),
+                        total / readerCounts[c]));
+
+            if (withWriter)
+            {
+                stopWriter.set(0);
+                writer = new Writer(shared, static_cast<LockKind>(kind));
+                writer->start();
+            }
+
+            start = elsbench::nowNs();
+            for (size_t i = 0; i < readers.size(); ++i)
+                readers[i]->start();
+            for (size_t i = 0; i < readers.size(); ++i)
+                readers[i]->join();
+            ::snprintf(label, sizeof(label), "%s, %zu readers",
+                    lockNames[kind], readerCounts[c]);
+            elsbench::report(label, total, elsbench::nowNs() - start);
+
+            if (writer != 0)
+            {
+                stopWriter.set(1);
+                writer->join();
+                delete writer;
+                writer = 0;
+            }
+            for (size_t i = 0; i < readers.size(); ++i)
+                delete readers[i];
+            readers.clear();
+        }
+    }
+
+    els::thread::Rcu::barrier();
+}
+
+}
+
+ELSBENCH_SIMPLE_CASE(Rcu, lookup)
+{
+    runReaders(false);
+}
+
+ELSBENCH_SIMPLE_CASE(Rcu, lookupWithWriter)
+{
+    runReaders(true);
+}
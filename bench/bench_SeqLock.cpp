@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    bench_SeqLock.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/SeqLock.hpp>
+#include <els/ReadWriteLock.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+/* E.g. a sensor sample or a clock offset. */
+struct Snapshot
+{
+    long long timestamp;
+    double values[4];
+};
+
+struct Shared
+{
+    Shared(void) : seqlock(), rwlock(), data() {}
+
+    els::thread::SeqLock<Snapshot> seqlock;
+    els::thread::ReadWriteLock rwlock;
+    Snapshot data;
+};
+
+enum LockKind
+{
+    LOCK_SEQLOCK,
+    LOCK_RWLOCK,
+};
+
+const char* const lockNames[] = {
+    "SeqLock::load()",
+    "ReadWriteLock::rdlock()",
+};
+
+const size_t readerCounts[] = { 1, 4, 16, 64 };
+const size_t numReaderCounts = sizeof(readerCounts) / sizeof(readerCounts[0]);
+
+els::thread::AtomicInt stopWriter(0);
+
+class Reader : public els::thread::IThread
+{
+public:
+
+    Reader(Shared& shared, LockKind kind, unsigned long iterations)
+        : els::thread::IThread(), sink(0), _M_shared(shared), _M_kind(kind),
+          _M_iterations(iterations) {}
+
+    volatile long long sink;
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        Snapshot snap;
+
+        for (unsigned long i = 0; i < this->_M_iterations; ++i)
+        {
+            if (this->_M_kind == LOCK_SEQLOCK)
+            {
+                this->_M_shared.seqlock.load(snap);
+            }
+            else
+            {
+                this->_M_shared.rwlock.rdlock();
+                snap = this->_M_shared.data;
+                this->_M_shared.rwlock.unlock();
+            }
+            this->sink += snap.timestamp;
+        }
+
+        return 0;
+    }
+
+private:
+
+    Shared& _M_shared;
+    LockKind _M_kind;
+    unsigned long _M_iterations;
+};
+
+/* Publishes a new snapshot about every 100 microseconds. */
+class Writer : public els::thread::IThread
+{
+public:
+
+    Writer(Shared& shared, LockKind kind)
+        : els::thread::IThread(), _M_shared(shared), _M_kind(kind) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        Snapshot snap = Snapshot();
+
+        while (stopWriter.load(els::thread::MEMORY_ORDER_RELAXED) == 0)
+        {
+            ++snap.timestamp;
+            if (this->_M_kind == LOCK_SEQLOCK)
+            {
+                this->_M_shared.seqlock.store(snap);
+            }
+            else
+            {
+                this->_M_shared.rwlock.wrlock();
+                this->_M_shared.data = snap;
+                this->_M_shared.rwlock.unlock();
+            }
+            ::usleep(100);
+        }
+
+        return 0;
+    }
+
+private:
+
+    Shared& _M_shared;
+    LockKind _M_kind;
+};
+
+void runReaders(bool withWriter)
+{
+    unsigned long total = elsbench::scaled(4000000);
+    std::vector<Reader*> readers;
+    Shared shared;
+    Writer* writer = 0;
+    char label[80];
+    uint64_t start = 0;
+
+    for (size_t c = 0; c < numReaderCounts; ++c)
+    {
+        for (int kind = LOCK_SEQLOCK; kind <= LOCK_RWLOCK; ++kind)
+        {
+            for (size_t i = 0; i < readerCounts[c]; ++i)
+                readers.push_back(new Reader(shared,
+                        static_cast<LockKind>(kind),
+                        total / readerCounts[c]));
+
+            if (withWriter)
+            {
+                stopWriter.set(0);
+                writer = new Writer(shared, static_cast<LockKind>(kind));
+                writer->start();
+            }
+
+            start = elsbench::nowNs();
+            for (size_t i = 0; i < readers.size(); ++i)
+                readers[i]->start();
+            for (size_t i = 0; i < readers.size(); ++i)
+                readers[i]->join();
+            ::snprintf(label, sizeof(label), "%s, %zu readers",
+                    lockNames[kind], readerCounts[c]);
+            elsbench::report(label, total, elsbench::nowNs() - start);
+
+            if (writer != 0)
+            {
+                stopWriter.set(1);
+                writer->join();
+                delete writer;
+                writer = 0;
+            }
+            for (size_t i = 0; i < readers.size(); ++i)
+                delete readers[i];
+            readers.clear();
+        }
+    }
+}
+
+}
+
+ELSBENCH_SIMPLE_CASE(SeqLock, readOnly)
+{
+    runReaders(false);
+}
+
+ELSBENCH_SIMPLE_CASE(SeqLock, readWithWriter)
+{
+    runReaders(true);
+}
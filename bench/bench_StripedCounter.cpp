@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    bench_StripedCounter.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/Atomic.hpp>
+#include <els/StripedCounter.hpp>
+#include <els/IThread.hpp>
+
+#include <vector>
+
+namespace {
+
+using els::thread::StripedCounter;
+
+enum CounterKind
+{
+    COUNTER_ATOMIC,
+    COUNTER_BY_CPU,
+    COUNTER_BY_THREAD,
+    COUNTER_APPROXIMATE,
+};
+
+const char* const counterNames[] = {
+    "AtomicInt::inc()",
+    "StripedCounter by cpu",
+    "StripedCounter by thread",
+    "StripedCounter approximate",
+};
+
+struct Counters
+{
+    Counters(void)
+        : atomic(0),
+          byCpu(0, StripedCounter::STRIPE_BY_CPU),
+          byThread(64, StripedCounter::STRIPE_BY_THREAD),
+          approximate(64, StripedCounter::STRIPE_BY_THREAD, true) {}
+
+    els::thread::AtomicInt atomic;
+    StripedCounter byCpu;
+    StripedCounter byThread;
+    StripedCounter approximate;
+};
+
+class Incrementer : public els::thread::IThread
+{
+public:
+
+    Incrementer(Counters& counters, CounterKind kind,
+            unsigned long iterations)
+        : els::thread::IThread(), _M_counters(counters), _M_kind(kind),
+          _M_iterations(iterations) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        Counters& counters = this->_M_counters;
+
+        for (unsigned long i = 0; i < this->_M_iterations; ++i)
+        {
+            switch (this->_M_kind)
+            {
+            case COUNTER_ATOMIC:
+                counters.atomic.inc();
+                break;
+            case COUNTER_BY_CPU:
+                counters.byCpu.inc();
+                break;
+            case COUNTER_BY_THREAD:
+                counters.byThread.inc();
+                break;
+            case COUNTER_APPROXIMATE:
+                counters.approximate.inc();
+                break;
+            }
+        }
+
+        return 0;
+    }
+
+private:
+
+    Counters& _M_counters;
+    CounterKind _M_kind;
+    unsigned long _M_iterations;
+};
+
+}
+
+/*
+ * Threads bumping one statistic. The total number of increments is
+ * the same for every thread count, so the figures are comparable.
+ */
+ELSBENCH_SIMPLE_CASE(StripedCounter, contendedInc)
+{
+    static const size_t threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    unsigned long total = elsbench::scaled(6400000);
+    std::vector<Incrementer*> workers;
+    Counters counters;
+    char label[64];
+    uint64_t start = 0;
+
+    for (size_t t = 0; t < sizeof(threadCounts) / sizeof(size_t); ++t)
+    {
+        for (int kind = COUNTER_ATOMIC; kind <= COUNTER_APPROXIMATE; ++kind)
+        {
+            for (size_t i = 0; i < threadCounts[t]; ++i)
+                workers.push_back(new Incrementer(counters,
+                        static_cast<CounterKind>(kind),
+                        total / threadCounts[t]));
+
+            start = elsbench::nowNs();
+            for (size_t i = 0; i < workers.size(); ++i)
+                workers[i]->start();
+            for (size_t i = 0; i < workers.size(); ++i)
+                workers[i]->join();
+
+            ::snprintf(label, sizeof(label), "%s, %zu threads",
+                    counterNames[kind], threadCounts[t]);
+            elsbench::report(label, total, elsbench::nowNs() - start);
+
+            for (size_t i = 0; i < workers.size(); ++i)
+                delete workers[i];
+            workers.clear();
+        }
+    }
+}
+
+/* Reading sums every slot, unlike a single atomic load. */
+ELSBENCH_SIMPLE_CASE(StripedCounter, read)
+{
+    unsigned long iterations = elsbench::scaled(2000000);
+    Counters counters;
+    volatile els::ElsInt64 sink = 0;
+    uint64_t start = 0;
+
+    start = elsbench::nowNs();
+    for (unsigned long i = 0; i < iterations; ++i)
+        sink += counters.atomic.get();
+    elsbench::report("AtomicInt::get()", iterations,
+            elsbench::nowNs() - start);
+
+    start = elsbench::nowNs();
+    for (unsigned long i = 0; i < iterations; ++i)
+        sink += counters.byCpu.get();
+    elsbench::report("StripedCounter::get()", iterations,
+            elsbench::nowNs() - start);
+    (void)sink;
+}
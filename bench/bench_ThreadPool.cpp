@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    bench_ThreadPool.cpp
+ */
+
+#include "ElsBench.hpp"
+
+#include <els/ThreadPool.hpp>
+#include <els/IRunnable.hpp>
+#include <els/Atomic.hpp>
+#include <els/LatencyHistogram.hpp>
+#include <els/System.hpp>
+
+#include <vector>
+#include <unistd.h>
+#include <sched.h>
+
+namespace {
+
+typedef els::thread::ThreadPool ThreadPool;
+
+const size_t workerCounts[] = { 1, 2, 4, 8, 16 };
+const size_t numWorkerCounts = sizeof(workerCounts) / sizeof(workerCounts[0]);
+
+els::thread::AtomicInt done(0);
+
+void spin(unsigned iterations)
+{
+    volatile unsigned sink = 0;
+
+    for (unsigned i = 0; i < iterations; ++i)
+        sink += i;
+}
+
+void waitFor(int expected)
+{
+    while (done.get() < expected)
+        ::usleep(200);
+}
+
+class ShortTask : public els::thread::IRunnable
+{
+public:
+
+    ShortTask(void) : els::thread::IRunnable() {}
+
+    virtual void run(void) throw()
+    {
+        spin(50);
+        done.inc();
+    }
+};
+
+class FanOutTask : public els::thread::IRunnable
+{
+public:
+
+    FanOutTask(ThreadPool& pool, unsigned depth)
+        : els::thread::IRunnable(), _M_pool(pool), _M_depth(depth) {}
+
+    virtual void run(void) throw()
+    {
+        if (this->_M_depth > 0)
+        {
+            this->_M_pool.schedule(
+                    new FanOutTask(this->_M_pool, this->_M_depth - 1), true);
+            this->_M_pool.schedule(
+                    new FanOutTask(this->_M_pool, this->_M_depth - 1), true);
+        }
+        spin(50);
+        done.inc();
+    }
+
+private:
+
+    ThreadPool& _M_pool;
+    unsigned _M_depth;
+};
+
+const char* modeName(ThreadPool::SchedulingMode mode)
+{
+    return mode == ThreadPool::SCHEDULE_SHARED_QUEUE
+            ? "shared-queue" : "work-stealing";
+}
+
+void externalProducer(ThreadPool::SchedulingMode mode, size_t workers)
+{
+    unsigned long numTasks = elsbench::scaled(200000);
+    ThreadPool pool(mode);
+    ShortTask task;
+    uint64_t start = 0;
+    char label[64];
+
+    done.set(0);
+    pool.start(workers);
+    start = elsbench::nowNs();
+    for (unsigned long i = 0; i < numTasks; ++i)
+        pool.schedule(&task);
+    waitFor(numTasks);
+    ::snprintf(label, sizeof(label), "%s, %2zu workers", modeName(mode), workers);
+    elsbench::report(label, numTasks, elsbench::nowNs() - start);
+    pool.stop();
+}
+
+void batchedProducer(size_t workers, size_t batchSize)
+{
+    unsigned long numTasks = elsbench::scaled(200000);
+    ThreadPool pool;
+    ShortTask task;
+    std::vector<els::thread::IRunnable*> batch(batchSize, &task);
+    uint64_t start = 0;
+    char label[64];
+
+    done.set(0);
+    pool.start(workers);
+    start = elsbench::nowNs();
+    for (unsigned long i = 0; i < numTasks; i += batchSize)
+        pool.scheduleBatch(batch.begin(), batch.end());
+    waitFor(numTasks / batchSize * batchSize);
+    ::snprintf(label, sizeof(label), "batch of %4zu, %2zu workers",
+            batchSize, workers);
+    elsbench::report(label, numTasks / batchSize * batchSize,
+            elsbench::nowNs() - start);
+    pool.stop();
+}
+
+struct ShortFunctor
+{
+    void operator ()(void) const
+    {
+        spin(50);
+        done.inc();
+    }
+};
+
+/*
+ * Fire-and-forget tasks scheduled by a worker, so both the allocation
+ * and the release happen in the pool.
+ */
+class SpawnTask : public els::thread::IRunnable
+{
+public:
+
+    SpawnTask(ThreadPool& pool, unsigned long count, bool pooled)
+        : els::thread::IRunnable(), _M_pool(pool), _M_count(count),
+          _M_pooled(pooled) {}
+
+    virtual void run(void) throw()
+    {
+        for (unsigned long i = 0; i < this->_M_count; ++i)
+        {
+            if (this->_M_pooled)
+                this->_M_pool.execute(ShortFunctor());
+            else
+                this->_M_pool.schedule(new ShortTask, true);
+        }
+    }
+
+private:
+
+    ThreadPool& _M_pool;
+    unsigned long _M_count;
+    bool _M_pooled;
+};
+
+void fireAndForget(size_t workers, bool pooled)
+{
+    unsigned long numTasks = elsbench::scaled(200000);
+    ThreadPool pool(ThreadPool::SCHEDULE_WORK_STEALING);
+    SpawnTask spawner(pool, numTasks, pooled);
+    uint64_t start = 0;
+    char label[64];
+
+    done.set(0);
+    pool.start(workers);
+    start = elsbench::nowNs();
+    pool.schedule(&spawner);
+    waitFor(numTasks);
+    ::snprintf(label, sizeof(label), "%-10s %2zu workers",
+            pooled ? "execute" : "new/delete", workers);
+    elsbench::report(label, numTasks, elsbench::nowNs() - start);
+    pool.stop();
+}
+
+class StampedTask : public els::thread::IRunnable
+{
+public:
+
+    StampedTask(els::misc::LatencyHistogram& hist)
+        : els::thread::IRunnable(), _M_hist(hist), _M_scheduled(0) {}
+
+    void stamp(void)
+    {
+        this->_M_scheduled = els::sys::monotonicNs();
+    }
+
+    virtual void run(void) throw()
+    {
+        this->_M_hist.record(els::sys::monotonicNs() - this->_M_scheduled);
+        done.inc();
+    }
+
+private:
+
+    els::misc::LatencyHistogram& _M_hist;
+    uint64_t _M_scheduled;
+};
+
+const char* idleName(ThreadPool::IdleStrategy strategy)
+{
+    switch (strategy)
+    {
+    case ThreadPool::IDLE_BLOCK: return "block";
+    case ThreadPool::IDLE_SPIN_THEN_PARK: return "spin-then-park";
+    case ThreadPool::IDLE_ADAPTIVE: return "adaptive";
+    case ThreadPool::IDLE_BUSY_POLL: return "busy-poll";
+    }
+
+    return "unknown";
+}
+
+void wakeupLatency(ThreadPool::IdleStrategy strategy, unsigned gapUs)
+{
+    /* Sparse tasks, every one of them finds the worker idle. */
+    unsigned long numTasks = elsbench::scaled(2000);
+    els::misc::LatencyHistogram hist;
+    StampedTask task(hist);
+    ThreadPool pool;
+
+    done.set(0);
+    pool.setIdleStrategy(strategy, els::misc::Timeval(0, 500000));
+    pool.start(1);
+    for (unsigned long i = 0; i < numTasks; ++i)
+    {
+        ::usleep(gapUs);
+        task.stamp();
+        pool.schedule(&task);
+        while (done.get() <= static_cast<int>(i))
+            ::sched_yield();
+    }
+    ::printf("  %-16s %4u us gap: mean %8llu ns, p99 %8llu ns\n",
+            idleName(strategy), gapUs,
+            static_cast<unsigned long long>(hist.mean()),
+            static_cast<unsigned long long>(hist.percentile(99.0)));
+    pool.stop();
+}
+
+void fanOut(ThreadPool::SchedulingMode mode, size_t workers)
+{
+    /* Binary tree of tasks, each one schedules two children. */
+    unsigned depth = elsbench::scaled(100) < 100 ? 12 : 17;
+    int numTasks = (1 << (depth + 1)) - 1;
+    ThreadPool pool(mode);
+    uint64_t start = 0;
+    char label[64];
+
+    done.set(0);
+    pool.start(workers);
+    start = elsbench::nowNs();
+    pool.schedule(new FanOutTask(pool, depth), true);
+    waitFor(numTasks);
+    ::snprintf(label, sizeof(label), "%s, %2zu workers", modeName(mode), workers);
+    elsbench::report(label, numTasks, elsbench::nowNs() - start);
+    pool.stop();
+}
+
+}
+
+ELSBENCH_SIMPLE_CASE(ThreadPool, externalProducerScaling)
+{
+    for (size_t i = 0; i < numWorkerCounts; ++i)
+    {
+        externalProducer(ThreadPool::SCHEDULE_SHARED_QUEUE, workerCounts[i]);
+        externalProducer(ThreadPool::SCHEDULE_WORK_STEALING, workerCounts[i]);
+    }
+}
+
+ELSBENCH_SIMPLE_CASE(ThreadPool, batchedProducerScaling)
+{
+    const size_t batchSizes[] = { 1, 16, 256 };
+
+    for (size_t i = 0; i < numWorkerCounts; ++i)
+    {
+        for (size_t j = 0; j < sizeof(batchSizes) / sizeof(batchSizes[0]); ++j)
+            batchedProducer(workerCounts[i], batchSizes[j]);
+    }
+}
+
+ELSBENCH_SIMPLE_CASE(ThreadPool, fanOutScaling)
+{
+    for (size_t i = 0; i < numWorkerCounts; ++i)
+    {
+        fanOut(ThreadPool::SCHEDULE_SHARED_QUEUE, workerCounts[i]);
+        fanOut(ThreadPool::SCHEDULE_WORK_STEALING, workerCounts[i]);
+    }
+}
+
+ELSBENCH_SIMPLE_CASE(ThreadPool, idleWakeupLatency)
+{
+    const unsigned gaps[] = { 50, 200, 2000 };
+
+    for (size_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); ++i)
+    {
+        wakeupLatency(ThreadPool::IDLE_BLOCK, gaps[i]);
+        wakeupLatency(ThreadPool::IDLE_SPIN_THEN_PARK, gaps[i]);
+        wakeupLatency(ThreadPool::IDLE_ADAPTIVE, gaps[i]);
+        wakeupLatency(ThreadPool::IDLE_BUSY_POLL, gaps[i]);
+    }
+}
+
+ELSBENCH_SIMPLE_CASE(ThreadPool, fireAndForgetAllocation)
+{
+    for (size_t i = 0; i < numWorkerCounts; ++i)
+    {
+        fireAndForget(workerCounts[i], false);
+        fireAndForget(workerCounts[i], true);
+    }
+}
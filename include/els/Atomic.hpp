@@ -25,10 +25,32 @@
 #include "Macros.hpp"
 #include "Types.hpp"
 
+#include <cstddef>
+
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
+/**
+ * @brief   Memory ordering constraints of atomic operations, same as
+ *          those of C++11 std::memory_order.
+ */
+enum MemoryOrder
+{
+    MEMORY_ORDER_RELAXED = __ATOMIC_RELAXED,
+    MEMORY_ORDER_CONSUME = __ATOMIC_CONSUME,
+    MEMORY_ORDER_ACQUIRE = __ATOMIC_ACQUIRE,
+    MEMORY_ORDER_RELEASE = __ATOMIC_RELEASE,
+    MEMORY_ORDER_ACQ_REL = __ATOMIC_ACQ_REL,
+    MEMORY_ORDER_SEQ_CST = __ATOMIC_SEQ_CST,
+};
+
 /**
  * @brief   Allows atomic access and modification of integral variables.
+ *
+ * get(), set(), inc() and dec() are sequentially consistent. The other
+ * operations take an explicit memory order - loads default to acquire,
+ * stores to release and read-modify-write operations to sequentially
+ * consistent. Loads are plain loads on all common architectures, they
+ * never lock the bus.
  */
 template <class T> class ELS_EXPORT_SYMBOL Atomic
 {
@@ -38,7 +60,7 @@ public:
      * @brief   Constructor. Initializes the internal atomic variable.
      * @param   i       Initial value.
      */
-    explicit Atomic(T i) throw() : _M_i(i) {}
+    explicit Atomic(T i = T()) throw() : _M_i(i) {}
 
     /**
      * @brief   Destructor.
@@ -49,37 +71,191 @@ public:
      * @brief   Sets the internal atomic integer to a new value.
      * @param   i       New value.
      */
-    void set(T i) throw() { (void)::__sync_lock_test_and_set(&this->_M_i, i); }
+    void set(T i) throw() { this->store(i, MEMORY_ORDER_SEQ_CST); }
 
     /**
      * @brief   Returns current value of the atomic integer.
      * @return  Current value.
      */
-    T get(void) throw() { return ::__sync_fetch_and_or(&this->_M_i, 0); }
+    T get(void) const throw() { return this->load(MEMORY_ORDER_SEQ_CST); }
 
     /**
      * @brief   Increments the internal atomic integer by one and
      *          returns its value.
      * @return  Value of the atomic integer after incrementation.
      */
-    T inc(void) throw() { return ::__sync_add_and_fetch(&this->_M_i, 1); }
+    T inc(void) throw() { return this->fetchAdd(1) + 1; }
 
     /**
      * @brief   Decrements the internal atomic integer by one and
      *          returns its value.
      * @return  Value of the atomic integer after decrementation.
      */
-    T dec(void) throw() { return ::__sync_sub_and_fetch(&this->_M_i, 1); }
+    T dec(void) throw() { return this->fetchSub(1) - 1; }
+
+    /**
+     * @brief   Reads the value.
+     * @param   order   Relaxed, consume, acquire or seq_cst.
+     * @return  Current value.
+     */
+    T load(MemoryOrder order = MEMORY_ORDER_ACQUIRE) const throw()
+    {
+        return __atomic_load_n(&this->_M_i, order);
+    }
+
+    /**
+     * @brief   Writes a new value.
+     * @param   i       New value.
+     * @param   order   Relaxed, release or seq_cst.
+     */
+    void store(T i, MemoryOrder order = MEMORY_ORDER_RELEASE) throw()
+    {
+        __atomic_store_n(&this->_M_i, i, order);
+    }
+
+    /**
+     * @brief   Writes a new value and returns the previous one.
+     */
+    T exchange(T i, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_exchange_n(&this->_M_i, i, order);
+    }
+
+    /**
+     * @brief   Replaces the value with desired if it equals expected.
+     * @param   expected    Expected value, updated to the current one
+     *                      on failure.
+     * @param   desired     New value.
+     * @param   success     Memory order if the values were equal.
+     * @param   failure     Memory order otherwise, no stronger than
+     *                      success and neither release nor acq_rel.
+     * @return  True if the value has been replaced.
+     */
+    bool compareExchange(T& expected, T desired,
+            MemoryOrder success = MEMORY_ORDER_SEQ_CST,
+            MemoryOrder failure = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_compare_exchange_n(&this->_M_i, &expected, desired,
+                false, success, failure);
+    }
+
+    /**
+     * @brief   Like compareExchange(), but may fail spuriously. Cheaper
+     *          on LL/SC architectures when called in a loop anyway.
+     */
+    bool compareExchangeWeak(T& expected, T desired,
+            MemoryOrder success = MEMORY_ORDER_SEQ_CST,
+            MemoryOrder failure = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_compare_exchange_n(&this->_M_i, &expected, desired,
+                true, success, failure);
+    }
+
+    /** @brief  Adds i and returns the previous value. */
+    T fetchAdd(T i, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_fetch_add(&this->_M_i, i, order);
+    }
+
+    /** @brief  Subtracts i and returns the previous value. */
+    T fetchSub(T i, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_fetch_sub(&this->_M_i, i, order);
+    }
+
+    /** @brief  Bitwise ands with i and returns the previous value. */
+    T fetchAnd(T i, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_fetch_and(&this->_M_i, i, order);
+    }
+
+    /** @brief  Bitwise ors with i and returns the previous value. */
+    T fetchOr(T i, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_fetch_or(&this->_M_i, i, order);
+    }
+
+    /** @brief  Bitwise xors with i and returns the previous value. */
+    T fetchXor(T i, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_fetch_xor(&this->_M_i, i, order);
+    }
 
 private:
 
-    volatile T _M_i;
+    /* 64-bit integers are only 4-byte aligned on some 32-bit ABIs. */
+    volatile T _M_i __attribute__((aligned(sizeof(T))));
 
     ELS_CLASS_UNCOPYABLE(Atomic<T>);
 };
 
+/**
+ * @brief   Atomic pointer. Arithmetic is done in elements, like
+ *          on plain pointers.
+ */
+template <class T> class ELS_EXPORT_SYMBOL Atomic<T*>
+{
+public:
+
+    explicit Atomic(T* p = 0) throw() : _M_p(p) {}
+    ~Atomic(void) throw() {}
+
+    void set(T* p) throw() { this->store(p, MEMORY_ORDER_SEQ_CST); }
+    T* get(void) const throw() { return this->load(MEMORY_ORDER_SEQ_CST); }
+
+    T* load(MemoryOrder order = MEMORY_ORDER_ACQUIRE) const throw()
+    {
+        return __atomic_load_n(&this->_M_p, order);
+    }
+
+    void store(T* p, MemoryOrder order = MEMORY_ORDER_RELEASE) throw()
+    {
+        __atomic_store_n(&this->_M_p, p, order);
+    }
+
+    T* exchange(T* p, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_exchange_n(&this->_M_p, p, order);
+    }
+
+    bool compareExchange(T*& expected, T* desired,
+            MemoryOrder success = MEMORY_ORDER_SEQ_CST,
+            MemoryOrder failure = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_compare_exchange_n(&this->_M_p, &expected, desired,
+                false, success, failure);
+    }
+
+    bool compareExchangeWeak(T*& expected, T* desired,
+            MemoryOrder success = MEMORY_ORDER_SEQ_CST,
+            MemoryOrder failure = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_compare_exchange_n(&this->_M_p, &expected, desired,
+                true, success, failure);
+    }
+
+    /* The builtins operate on bytes, scale to elements. */
+    T* fetchAdd(ptrdiff_t n, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_fetch_add(&this->_M_p, n * sizeof(T), order);
+    }
+
+    T* fetchSub(ptrdiff_t n, MemoryOrder order = MEMORY_ORDER_SEQ_CST) throw()
+    {
+        return __atomic_fetch_sub(&this->_M_p, n * sizeof(T), order);
+    }
+
+private:
+
+    T* volatile _M_p;
+
+    ELS_CLASS_UNCOPYABLE(Atomic<T*>);
+};
+
 typedef Atomic<ElsInt32> AtomicInt;
 typedef Atomic<ElsUint32> AtomicUint;
+typedef Atomic<ElsInt64> AtomicInt64;
+typedef Atomic<ElsUint64> AtomicUint64;
 
 ELS_END_NAMESPACE_2
 
@@ -24,23 +24,26 @@
 
 #include "Macros.hpp"
 #include "Mutex.hpp"
+#include "FastMutex.hpp"
 
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
 /**
- * @brief   Automatically locks a mutex at construction and unlocks it
- *          at destruction.
+ * @brief   Automatically locks a Mutex or FastMutex at construction
+ *          and unlocks it at destruction.
  */
 class AutoMutex
 {
 public:
 
     ELS_EXPORT_SYMBOL explicit AutoMutex(Mutex& mutexRef);
+    ELS_EXPORT_SYMBOL explicit AutoMutex(FastMutex& mutexRef);
     ELS_EXPORT_SYMBOL ~AutoMutex(void) throw();
 
 private:
 
-    Mutex& _M_mutexRef;
+    Mutex* _M_mutex;
+    FastMutex* _M_fastMutex;
 
     ELS_CLASS_UNCOPYABLE(AutoMutex);
 };
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    CancelToken.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "StopToken.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+class ThreadPool;
+
+/**
+ * @brief   Shared flag telling tasks that their result is no longer needed.
+ *
+ * Tokens are cheap to copy - all copies share a single reference counted
+ * state, so cancelling any of them cancels all. Pass a token to a task
+ * with ThreadPool::TaskAttr::setCancelToken() and the pool drops the task
+ * without running it if the token is cancelled before it's dequeued.
+ * Long running tasks should poll cancelled() and bail out early.
+ *
+ * A cancel token is a StopToken as seen by the pool: cancel() requests
+ * a stop, so a task blocked on something it can't poll registers
+ * a StopCallback on stopToken() to be woken up. A token made from
+ * an existing StopToken, e.g. IThread::stopToken(), is cancelled when
+ * the stop is requested.
+ */
+class CancelToken
+{
+public:
+
+    ELS_EXPORT_SYMBOL CancelToken(void);
+    ELS_EXPORT_SYMBOL explicit CancelToken(const StopToken& token);
+
+    ELS_EXPORT_SYMBOL void cancel(void);
+    ELS_EXPORT_SYMBOL bool cancelled(void) const throw();
+    ELS_EXPORT_SYMBOL const StopToken& stopToken(void) const throw();
+
+private:
+
+    StopToken _M_token;
+
+    explicit CancelToken(StopToken::_T_State* state);
+
+    friend class ThreadPool;
+};
+
+ELS_END_NAMESPACE_2
@@ -24,6 +24,7 @@
 
 #include "Macros.hpp"
 #include "Exception.hpp"
+#include "Mutex.hpp"
 #include "Timeval.hpp"
 
 #include <pthread.h>
@@ -46,6 +47,9 @@ public:
     ELS_EXPORT_SYMBOL void block(void);
     ELS_EXPORT_SYMBOL void block(const misc::Timeval& tv,
             bool throwOnTimeout = false);
+    ELS_EXPORT_SYMBOL void block(Mutex& mutex);
+    ELS_EXPORT_SYMBOL void block(Mutex& mutex, const misc::Timeval& tv,
+            bool throwOnTimeout = false);
     ELS_EXPORT_SYMBOL void unblockOne(void);
     ELS_EXPORT_SYMBOL void unblockAll(void);
 
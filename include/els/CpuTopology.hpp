@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    CpuTopology.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+
+#include <string>
+#include <vector>
+
+ELS_BEGIN_NAMESPACE_2(els, sys)
+
+/**
+ * @brief   Layout of the CPUs available to the process.
+ *
+ * Read from /sys/devices/system/cpu and /sys/devices/system/node. Only
+ * CPUs which are online and in the affinity mask of the calling thread
+ * are listed. Missing sysfs entries are not an error - without them
+ * every CPU is its own core in package and node 0.
+ */
+class CpuTopology
+{
+public:
+
+    typedef std::vector<unsigned> CpuList;
+
+    /**
+     * @brief   Single logical CPU.
+     */
+    struct Cpu
+    {
+        /** Number used by the kernel, e.g. in sched_setaffinity(). */
+        unsigned id;
+        /** Core, unique only within the package. */
+        unsigned core;
+        /** Physical package (socket). */
+        unsigned package;
+        /** NUMA node. */
+        unsigned node;
+    };
+
+    /**
+     * @brief   Cache shared by one or more CPUs.
+     */
+    struct Cache
+    {
+        /** 1 for L1 and so on. */
+        unsigned level;
+        /** Data, Instruction or Unified. */
+        std::string type;
+        /** Size in bytes. */
+        size_t size;
+        /** Usable CPUs sharing this cache. */
+        CpuList cpus;
+    };
+
+    ELS_EXPORT_SYMBOL CpuTopology(void);
+    ELS_EXPORT_SYMBOL explicit CpuTopology(const std::string& sysfsRoot);
+    ELS_EXPORT_SYMBOL ~CpuTopology(void);
+
+    ELS_EXPORT_SYMBOL const std::vector<Cpu>& cpus(void) const;
+    ELS_EXPORT_SYMBOL const std::vector<Cache>& caches(void) const;
+    ELS_EXPORT_SYMBOL size_t numCpus(void) const;
+    ELS_EXPORT_SYMBOL size_t numCores(void) const;
+    ELS_EXPORT_SYMBOL size_t numPackages(void) const;
+    ELS_EXPORT_SYMBOL size_t numNodes(void) const;
+    ELS_EXPORT_SYMBOL CpuList siblings(unsigned cpu) const;
+    ELS_EXPORT_SYMBOL double cpuQuota(void) const;
+    ELS_EXPORT_SYMBOL size_t recommendedThreads(void) const;
+    ELS_EXPORT_SYMBOL CpuList compactOrder(void) const;
+    ELS_EXPORT_SYMBOL CpuList scatterOrder(void) const;
+
+    ELS_EXPORT_SYMBOL static CpuList parseCpuList(const std::string& list);
+
+private:
+
+    std::vector<Cpu> _M_cpus;
+    std::vector<Cache> _M_caches;
+    double _M_quota;
+
+    void _M_load(const std::string& root, const CpuList* allowed);
+    void _M_loadNodes(const std::string& root);
+    void _M_loadCaches(const std::string& root);
+    void _M_loadQuota(const std::string& root);
+    const Cpu* _M_find(unsigned id) const;
+};
+
+ELS_END_NAMESPACE_2
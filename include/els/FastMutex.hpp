@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    FastMutex.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Exception.hpp"
+
+#include <pthread.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Lightweight mutex implemented directly on a futex.
+ *
+ * Locking an unlocked mutex is a single compare-and-swap, unlocking one
+ * without waiters a single exchange; neither enters the kernel nor
+ * checks errors. A thread finding the mutex locked spins for a while
+ * before sleeping in the kernel. The spin budget adapts to how long
+ * the mutex was held recently and is zero on single CPU machines.
+ *
+ * In debug mode the mutex remembers its owner and, like Mutex, throws
+ * on relocking by the owner or unlocking by anyone else.
+ *
+ * Not recursive, can't be used with Condition.
+ */
+class FastMutex
+{
+public:
+
+    ELS_DECLARE_NESTED_EXCEPTION(FastMutexError, except::Exception);
+
+    ELS_EXPORT_SYMBOL explicit FastMutex(bool debug = false) throw();
+    ELS_EXPORT_SYMBOL ~FastMutex(void) throw();
+
+    /**
+     * @brief   Acquires the lock, blocking until it's free.
+     * @throw   FastMutexError  In debug mode if the caller already
+     *                          holds the lock.
+     */
+    void lock(void)
+    {
+        int unlocked = _S_unlocked;
+
+        if (ELS_LIKELY(!this->_M_debug)
+                && __atomic_compare_exchange_n(&this->_M_state, &unlocked,
+                        _S_locked, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return;
+
+        this->_M_lockSlow();
+    }
+
+    /**
+     * @brief   Acquires the lock if it's free, never blocks.
+     * @return  True if the lock has been acquired.
+     */
+    bool trylock(void) throw()
+    {
+        int unlocked = _S_unlocked;
+
+        if (!__atomic_compare_exchange_n(&this->_M_state, &unlocked,
+                _S_locked, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return false;
+
+        if (ELS_UNLIKELY(this->_M_debug))
+            this->_M_setOwner();
+
+        return true;
+    }
+
+    /**
+     * @brief   Releases the lock, waking up one waiter if there is any.
+     * @throw   FastMutexError  In debug mode if the caller doesn't hold
+     *                          the lock.
+     */
+    void unlock(void)
+    {
+        if (ELS_UNLIKELY(this->_M_debug))
+            this->_M_checkUnlock();
+
+        if (__atomic_exchange_n(&this->_M_state, _S_unlocked,
+                __ATOMIC_RELEASE) == _S_contended)
+            this->_M_wake();
+    }
+
+    ELS_EXPORT_SYMBOL bool debug(void) const throw();
+
+private:
+
+    /* Lock word states, see Drepper's "Futexes Are Tricky". */
+    static const int _S_unlocked = 0;
+    static const int _S_locked = 1;
+    static const int _S_contended = 2;
+
+    int _M_state;
+    /* Running average of spins needed to get the lock. */
+    int _M_spins;
+    bool _M_debug;
+    ::pthread_t _M_owner;
+
+    ELS_EXPORT_SYMBOL void _M_lockSlow(void);
+    ELS_EXPORT_SYMBOL void _M_wake(void) throw();
+    ELS_EXPORT_SYMBOL void _M_setOwner(void) throw();
+    ELS_EXPORT_SYMBOL void _M_checkUnlock(void);
+
+    ELS_CLASS_UNCOPYABLE(FastMutex);
+};
+
+ELS_END_NAMESPACE_2
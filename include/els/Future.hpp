@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    Future.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Atomic.hpp"
+#include "Mutex.hpp"
+#include "Condition.hpp"
+#include "Timeval.hpp"
+#include "IRunnable.hpp"
+#include "Exception.hpp"
+
+#include <string>
+#include <exception>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+class ThreadPool;
+template <typename T> class Future;
+template <typename T> class Promise;
+
+/**
+ * @brief   Thrown by Future::get() if the task producing the result
+ *          has thrown or has been discarded. Contains the message
+ *          of the original exception.
+ */
+ELS_DECLARE_EXCEPTION(TaskFailed, except::Exception);
+
+/**
+ * @brief   Task returning a value, see ThreadPool::submit().
+ */
+template <typename T> class ELS_EXPORT_SYMBOL ICallable
+{
+public:
+
+    ICallable(void) {}
+    virtual ~ICallable(void) {}
+
+    /**
+     * @brief   Computes the result. May throw - the exception will be
+     *          reported to the waiter as TaskFailed.
+     * @return  Value to store in the future.
+     */
+    virtual T call(void) = 0;
+};
+
+/**
+ * @brief   Task run once a future becomes ready, see Future::then().
+ */
+template <typename T, typename U> class ELS_EXPORT_SYMBOL IContinuation
+{
+public:
+
+    IContinuation(void) {}
+    virtual ~IContinuation(void) {}
+
+    /**
+     * @brief   Computes the result from the preceding stage.
+     * @param   previous    Ready future of the preceding stage, get()
+     *                      rethrows its error.
+     * @return  Value to store in the future returned by then().
+     */
+    virtual U call(const Future<T>& previous) = 0;
+};
+
+ELS_BEGIN_NAMESPACE_1(__future_detail)
+
+class FutureStateBase;
+
+class ContinuationBase : public IRunnable
+{
+public:
+
+    ELS_EXPORT_SYMBOL explicit ContinuationBase(ThreadPool& pool);
+    ELS_EXPORT_SYMBOL virtual ~ContinuationBase(void);
+
+private:
+
+    ThreadPool& _M_pool;
+    ContinuationBase* _M_next;
+
+    friend class FutureStateBase;
+
+    ELS_CLASS_UNCOPYABLE(ContinuationBase);
+};
+
+class FutureStateBase
+{
+public:
+
+    ELS_EXPORT_SYMBOL FutureStateBase(void);
+    ELS_EXPORT_SYMBOL virtual ~FutureStateBase(void);
+
+    ELS_EXPORT_SYMBOL void ref(void);
+    ELS_EXPORT_SYMBOL void unref(void);
+    ELS_EXPORT_SYMBOL bool ready(void) const;
+    ELS_EXPORT_SYMBOL void wait(void);
+    ELS_EXPORT_SYMBOL bool wait(const misc::Timeval& timeout);
+    ELS_EXPORT_SYMBOL void setError(const std::string& error);
+    ELS_EXPORT_SYMBOL void addContinuation(ContinuationBase* cont);
+
+protected:
+
+    ELS_EXPORT_SYMBOL void _M_checkNotReady(void) const;
+    ELS_EXPORT_SYMBOL void _M_checkError(void) const;
+    ELS_EXPORT_SYMBOL void _M_setReady(void);
+
+private:
+
+    AtomicInt _M_refs;
+    int _M_ready;
+    bool _M_failed;
+    std::string _M_error;
+    Mutex _M_mutex;
+    Condition _M_cond;
+    unsigned _M_waiters;
+    ContinuationBase* _M_contHead;
+    ContinuationBase* _M_contTail;
+
+    static void _S_scheduleContinuation(ContinuationBase* cont);
+
+    ELS_CLASS_UNCOPYABLE(FutureStateBase);
+};
+
+template <typename T> class ELS_EXPORT_SYMBOL FutureState
+    : public FutureStateBase
+{
+public:
+
+    FutureState(void) : FutureStateBase(), _M_value() {}
+
+    void setValue(const T& value)
+    {
+        this->_M_checkNotReady();
+        this->_M_value = value;
+        this->_M_setReady();
+    }
+
+    const T& value(void)
+    {
+        this->wait();
+        this->_M_checkError();
+        return this->_M_value;
+    }
+
+private:
+
+    T _M_value;
+};
+
+ELS_END_NAMESPACE_1
+
+/**
+ * @brief   Handle to a result computed asynchronously.
+ *
+ * Futures are cheap to copy - all copies share a single reference
+ * counted state. T must be default-constructible and assignable.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL Future
+{
+public:
+
+    /**
+     * @brief   Creates an empty future with no shared state.
+     */
+    Future(void) : _M_state(0) {}
+
+    Future(const Future<T>& other)
+        : _M_state(other._M_state)
+    {
+        if (this->_M_state != 0)
+            this->_M_state->ref();
+    }
+
+    Future<T>& operator =(const Future<T>& other)
+    {
+        if (other._M_state != 0)
+            other._M_state->ref();
+        if (this->_M_state != 0)
+            this->_M_state->unref();
+        this->_M_state = other._M_state;
+        return *this;
+    }
+
+    ~Future(void)
+    {
+        if (this->_M_state != 0)
+            this->_M_state->unref();
+    }
+
+    /**
+     * @brief   Checks whether this future refers to a shared state.
+     * @return  False for default-constructed futures.
+     */
+    bool valid(void) const
+    {
+        return (this->_M_state != 0);
+    }
+
+    /**
+     * @brief   Checks whether the result (or error) is available without
+     *          blocking.
+     * @return  True if get() won't block.
+     */
+    bool ready(void) const
+    {
+        return this->_M_checkedState()->ready();
+    }
+
+    /**
+     * @brief   Blocks until the result (or error) is available.
+     */
+    void wait(void) const
+    {
+        this->_M_checkedState()->wait();
+    }
+
+    /**
+     * @brief   Blocks until the result (or error) is available or
+     *          the timeout expires.
+     * @param   timeout     Maximum time to wait, relative to now.
+     * @return  True if the future is ready.
+     */
+    bool wait(const misc::Timeval& timeout) const
+    {
+        return this->_M_checkedState()->wait(timeout);
+    }
+
+    /**
+     * @brief   Waits for the result and returns it.
+     * @return  Reference to the result, valid as long as any copy
+     *          of this future exists.
+     * @throw   TaskFailed  If the task threw or has been discarded.
+     */
+    const T& get(void) const
+    {
+        return this->_M_checkedState()->value();
+    }
+
+    /**
+     * @brief   Schedules a continuation to be run on the pool once this
+     *          future becomes ready. No thread blocks waiting for it.
+     * @param   pool        Pool on which the continuation will run.
+     * @param   cont        Continuation receiving this future.
+     * @param   autoDelete  If true, cont is deleted after it has run.
+     * @return  Future holding the result of the continuation.
+     * @throw   LogicError  If this future has no shared state. If then()
+     *                      throws, cont is deleted if autoDelete is true.
+     */
+    template <typename U> Future<U> then(ThreadPool& pool,
+            IContinuation<T, U>* cont, bool autoDelete = false) const;
+
+private:
+
+    explicit Future(__future_detail::FutureState<T>* state)
+        : _M_state(state)
+    {
+        this->_M_state->ref();
+    }
+
+    __future_detail::FutureState<T>* _M_checkedState(void) const
+    {
+        if (this->_M_state == 0)
+            except::throwLogicError("Future has no shared state");
+        return this->_M_state;
+    }
+
+    __future_detail::FutureState<T>* _M_state;
+
+    template <typename> friend class Future;
+    friend class Promise<T>;
+    friend class ThreadPool;
+};
+
+ELS_BEGIN_NAMESPACE_1(__future_detail)
+
+/*
+ * Tasks remember whether they've run - if the pool discards one (e.g.
+ * when the queue overflows) the destructor fails the future instead of
+ * leaving its waiters blocked forever.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL CallTask : public IRunnable
+{
+public:
+
+    CallTask(ICallable<T>* callable, bool autoDelete)
+        : IRunnable(),
+          _M_callable(callable),
+          _M_autoDelete(autoDelete),
+          _M_state(new FutureState<T>),
+          _M_ran(false)
+    {
+
+    }
+
+    virtual ~CallTask(void)
+    {
+        if (!this->_M_ran)
+            this->_M_state->setError("Task discarded before running");
+        if (this->_M_autoDelete)
+            delete this->_M_callable;
+        this->_M_state->unref();
+    }
+
+    virtual void run(void) throw()
+    {
+        this->_M_ran = true;
+        try
+        {
+            this->_M_state->setValue(this->_M_callable->call());
+        }
+        catch (const std::exception& e)
+        {
+            this->_M_state->setError(e.what());
+        }
+        catch (...)
+        {
+            this->_M_state->setError("Unknown exception");
+        }
+    }
+
+    FutureState<T>* state(void) const
+    {
+        return this->_M_state;
+    }
+
+private:
+
+    ICallable<T>* _M_callable;
+    bool _M_autoDelete;
+    FutureState<T>* _M_state;
+    bool _M_ran;
+
+    ELS_CLASS_UNCOPYABLE(CallTask<T>);
+};
+
+template <typename T, typename U> class ELS_EXPORT_SYMBOL ThenTask
+    : public ContinuationBase
+{
+public:
+
+    ThenTask(ThreadPool& pool, const Future<T>& previous,
+            IContinuation<T, U>* cont, bool autoDelete)
+        : ContinuationBase(pool),
+          _M_previous(previous),
+          _M_cont(cont),
+          _M_autoDelete(autoDelete),
+          _M_state(new FutureState<U>),
+          _M_ran(false)
+    {
+
+    }
+
+    virtual ~ThenTask(void)
+    {
+        if (!this->_M_ran)
+            this->_M_state->setError("Task discarded before running");
+        if (this->_M_autoDelete)
+            delete this->_M_cont;
+        this->_M_state->unref();
+    }
+
+    virtual void run(void) throw()
+    {
+        this->_M_ran = true;
+        try
+        {
+            this->_M_state->setValue(this->_M_cont->call(this->_M_previous));
+        }
+        catch (const std::exception& e)
+        {
+            this->_M_state->setError(e.what());
+        }
+        catch (...)
+        {
+            this->_M_state->setError("Unknown exception");
+        }
+    }
+
+    FutureState<U>* state(void) const
+    {
+        return this->_M_state;
+    }
+
+private:
+
+    Future<T> _M_previous;
+    IContinuation<T, U>* _M_cont;
+    bool _M_autoDelete;
+    FutureState<U>* _M_state;
+    bool _M_ran;
+
+    ELS_CLASS_UNCOPYABLE(ThenTask);
+};
+
+ELS_END_NAMESPACE_1
+
+template <typename T> template <typename U>
+Future<U> Future<T>::then(ThreadPool& pool,
+        IContinuation<T, U>* cont, bool autoDelete) const
+{
+    __future_detail::FutureState<T>* state = 0;
+    __future_detail::ThenTask<T, U>* task = 0;
+
+    try
+    {
+        state = this->_M_checkedState();
+        task = new __future_detail::ThenTask<T, U>(
+                pool, *this, cont, autoDelete);
+    }
+    catch (...)
+    {
+        if (autoDelete)
+            delete cont;
+        throw;
+    }
+
+    Future<U> ret(task->state());
+
+    state->addContinuation(task);
+    return ret;
+}
+
+/**
+ * @brief   Producer side of a future, for results which are not computed
+ *          by a ThreadPool task.
+ *
+ * A promise destroyed without a value or error fails its future.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL Promise
+{
+public:
+
+    Promise(void)
+        : _M_state(new __future_detail::FutureState<T>)
+    {
+
+    }
+
+    ~Promise(void)
+    {
+        if (!this->_M_state->ready())
+            this->_M_state->setError("Broken promise");
+        this->_M_state->unref();
+    }
+
+    /**
+     * @brief   Returns a future sharing state with this promise.
+     * @return  Future object.
+     */
+    Future<T> future(void) const
+    {
+        return Future<T>(this->_M_state);
+    }
+
+    /**
+     * @brief   Stores the result and wakes up all waiters.
+     * @param   value   Result.
+     * @throw   LogicError  If a value or error has already been set.
+     */
+    void setValue(const T& value)
+    {
+        this->_M_state->setValue(value);
+    }
+
+    /**
+     * @brief   Fails the future - get() will throw TaskFailed.
+     * @param   error   Error message.
+     * @throw   LogicError  If a value or error has already been set.
+     */
+    void setError(const std::string& error)
+    {
+        this->_M_state->setError(error);
+    }
+
+private:
+
+    __future_detail::FutureState<T>* _M_state;
+
+    ELS_CLASS_UNCOPYABLE(Promise<T>);
+};
+
+ELS_END_NAMESPACE_2
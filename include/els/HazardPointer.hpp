@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    HazardPointer.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+class HazardPointer;
+
+/**
+ * @brief   Set of hazard pointers guarding the nodes of lock-free
+ *          containers.
+ *
+ * A thread reading a shared node publishes its address in a hazard
+ * pointer first. Removed nodes are retired instead of deleted and only
+ * freed once no hazard pointer of the domain points at them, so a node
+ * can neither disappear nor be recycled (ABA) under a reader.
+ *
+ * Records holding the hazard pointers are never freed before the
+ * domain, released ones are reused by later HazardPointer objects.
+ */
+class HazardDomain
+{
+public:
+
+    typedef void (*Deleter)(void*);
+
+    ELS_EXPORT_SYMBOL explicit HazardDomain(size_t retireThreshold = 64);
+    ELS_EXPORT_SYMBOL ~HazardDomain(void) throw();
+
+    ELS_EXPORT_SYMBOL size_t pending(void) const throw();
+
+private:
+
+    struct _T_Record
+    {
+        void* hazard;
+        int active;
+        _T_Record* next;
+        std::vector<std::pair<void*, Deleter> > retired;
+    };
+
+    _T_Record* _M_records;
+    size_t _M_threshold;
+    size_t _M_pending;
+
+    _T_Record* _M_acquire(void);
+    void _M_release(_T_Record* rec) throw();
+    void _M_retire(_T_Record* rec, void* ptr, Deleter deleter);
+    void _M_scan(_T_Record* rec);
+
+    friend class HazardPointer;
+
+    ELS_CLASS_UNCOPYABLE(HazardDomain);
+};
+
+/**
+ * @brief   Single hazard pointer owned by the calling thread for the
+ *          lifetime of the object.
+ */
+class HazardPointer
+{
+public:
+
+    ELS_EXPORT_SYMBOL explicit HazardPointer(HazardDomain& domain);
+    ELS_EXPORT_SYMBOL ~HazardPointer(void) throw();
+
+    /**
+     * @brief   Reads a shared pointer and protects the node it points to.
+     * @param   src     Location of the shared pointer.
+     * @return  Value of *src, safe to dereference until the hazard
+     *          pointer is reset or protects something else.
+     */
+    template <typename T> T* protect(T* const* src) throw()
+    {
+        T* ptr = __atomic_load_n(src, __ATOMIC_RELAXED);
+        T* check = 0;
+
+        for (;;)
+        {
+            __atomic_store_n(&this->_M_record->hazard,
+                    const_cast<void*>(static_cast<const void*>(ptr)),
+                    __ATOMIC_RELAXED);
+            /* Orders the store above before the re-read, see _M_scan(). */
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            check = __atomic_load_n(src, __ATOMIC_ACQUIRE);
+            if (check == ptr)
+                return ptr;
+            ptr = check;
+        }
+    }
+
+    /**
+     * @brief   Stops protecting the node.
+     */
+    void reset(void) throw()
+    {
+        __atomic_store_n(&this->_M_record->hazard, static_cast<void*>(0),
+                __ATOMIC_RELEASE);
+    }
+
+    ELS_EXPORT_SYMBOL void retire(void* ptr, HazardDomain::Deleter deleter);
+
+private:
+
+    HazardDomain& _M_domain;
+    HazardDomain::_T_Record* _M_record;
+
+    ELS_CLASS_UNCOPYABLE(HazardPointer);
+};
+
+ELS_END_NAMESPACE_2
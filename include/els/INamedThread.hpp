@@ -29,6 +29,12 @@
 
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
+/**
+ * @brief   Thread with a name, also visible to the kernel.
+ *
+ * The kernel limits thread names to 15 characters, longer names are
+ * truncated in /proc, ps and debuggers but name() returns the full one.
+ */
 class INamedThread : public IThread
 {
 public:
@@ -38,6 +44,10 @@ public:
 
     ELS_EXPORT_SYMBOL const std::string& name(void) const;
 
+protected:
+
+    ELS_EXPORT_SYMBOL virtual void _M_setup(void);
+
 private:
 
     std::string _M_name;
@@ -27,10 +27,12 @@
 #include "Condition.hpp"
 #include "Exception.hpp"
 #include "Atomic.hpp"
+#include "StopToken.hpp"
 
 #include <pthread.h>
 #include <sys/types.h>
 #include <memory>
+#include <vector>
 
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
@@ -50,6 +52,24 @@ public:
         THREAD_CANCELED,
     };
 
+    /**
+     * @brief   Scheduling policy of a thread.
+     *
+     * SCHED_POLICY_INHERIT keeps the policy and priority of the thread
+     * calling start(). SCHED_POLICY_FIFO and SCHED_POLICY_RR are
+     * real-time policies and usually require CAP_SYS_NICE or
+     * an RLIMIT_RTPRIO limit.
+     */
+    enum SchedPolicy
+    {
+        SCHED_POLICY_INHERIT = 0,
+        SCHED_POLICY_OTHER,
+        SCHED_POLICY_BATCH,
+        SCHED_POLICY_IDLE,
+        SCHED_POLICY_FIFO,
+        SCHED_POLICY_RR,
+    };
+
     class ThreadRetval
     {
     public:
@@ -89,12 +109,26 @@ public:
     ELS_EXPORT_SYMBOL void wake(void);
     ELS_EXPORT_SYMBOL ::pid_t tid(void) const;
     ELS_EXPORT_SYMBOL const ThreadRetval& retval(void) const;
+    ELS_EXPORT_SYMBOL StopToken stopToken(void) const;
+    ELS_EXPORT_SYMBOL void setAffinity(const std::vector<unsigned>& cpus);
+    ELS_EXPORT_SYMBOL std::vector<unsigned> affinity(void) const;
+    ELS_EXPORT_SYMBOL void setScheduling(SchedPolicy policy,
+            int priority = 0);
+    ELS_EXPORT_SYMBOL SchedPolicy schedPolicy(void) const;
+    ELS_EXPORT_SYMBOL int schedPriority(void) const;
+    ELS_EXPORT_SYMBOL void setStackSize(size_t size);
+    ELS_EXPORT_SYMBOL size_t stackSize(void) const;
+    ELS_EXPORT_SYMBOL void setGuardSize(size_t size);
+    ELS_EXPORT_SYMBOL size_t guardSize(void) const;
+    ELS_EXPORT_SYMBOL void setLockStack(bool lock);
+    ELS_EXPORT_SYMBOL bool lockStack(void) const;
 
     ELS_EXPORT_SYMBOL static unsigned threadCount(void);
 
 protected:
 
     virtual int _M_run(void) = 0;
+    ELS_EXPORT_SYMBOL virtual void _M_setup(void);
 
     ELS_EXPORT_SYMBOL void _M_sleep(void);
     ELS_EXPORT_SYMBOL bool _M_stopRequested(void) const;
@@ -106,12 +140,23 @@ private:
     ::pthread_t _M_id;
     ::pid_t _M_tid;
     mutable Mutex _M_mutex;
+    Mutex _M_sleepMutex;
     Condition _M_cond;
     ThreadState _M_state;
-    volatile bool _M_stopRequest;
+    StopToken _M_stop;
     _T_RetvalPtr _M_retval;
+    std::vector<unsigned> _M_affinity;
+    SchedPolicy _M_schedPolicy;
+    int _M_schedPriority;
+    size_t _M_stackSize;
+    size_t _M_guardSize;
+    bool _M_lockStack;
 
     void _M_setState(ThreadState state);
+    int _M_initAttr(::pthread_attr_t* attr) const;
+
+    static int _S_nativePolicy(SchedPolicy policy);
+    static int _S_lockStack(void** addr, size_t* size);
 
     static void* _S_initThread(void* threadPtr);
 
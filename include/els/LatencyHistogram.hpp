@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    LatencyHistogram.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, misc)
+
+/**
+ * @brief   Log-linear histogram of durations in nanoseconds.
+ *
+ * Every power of two range is split into four buckets, so values are
+ * recorded with an error of at most 25%. Recording is lock-free and may
+ * be done concurrently from many threads, reading while other threads
+ * record gives an approximate but consistent enough view.
+ */
+class LatencyHistogram
+{
+public:
+
+    ELS_EXPORT_SYMBOL LatencyHistogram(void) throw();
+    ELS_EXPORT_SYMBOL LatencyHistogram(const LatencyHistogram& other) throw();
+    ELS_EXPORT_SYMBOL LatencyHistogram& operator =(
+            const LatencyHistogram& other) throw();
+    ELS_EXPORT_SYMBOL ~LatencyHistogram(void) throw();
+
+    ELS_EXPORT_SYMBOL void record(ElsUint64 ns) throw();
+    ELS_EXPORT_SYMBOL void merge(const LatencyHistogram& other) throw();
+    ELS_EXPORT_SYMBOL void reset(void) throw();
+
+    ELS_EXPORT_SYMBOL ElsUint64 count(void) const throw();
+    ELS_EXPORT_SYMBOL ElsUint64 max(void) const throw();
+    ELS_EXPORT_SYMBOL ElsUint64 mean(void) const throw();
+    ELS_EXPORT_SYMBOL ElsUint64 percentile(double pct) const;
+
+private:
+
+    static const unsigned _S_NUM_BUCKETS = 252;
+
+    static unsigned _S_bucket(ElsUint64 ns) throw();
+    static ElsUint64 _S_upperBound(unsigned bucket) throw();
+
+    ElsUint64 _M_buckets[_S_NUM_BUCKETS];
+    ElsUint64 _M_count;
+    ElsUint64 _M_sum;
+    ElsUint64 _M_max;
+};
+
+ELS_END_NAMESPACE_2
+
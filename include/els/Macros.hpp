@@ -69,6 +69,24 @@
 #define ELS_INIT_THIRD __attribute__((init_priority(3000)))
 #define ELS_INIT_LAST __attribute__((init_priority(10000)))
 
+/**
+ * @brief   Size of a cache line assumed when padding data shared between
+ *          threads in order to avoid false sharing.
+ */
+#define ELS_CACHELINE_SIZE 64
+
+/**
+ * @brief   Hints the CPU that the calling thread is busy-waiting, which
+ *          saves power and frees resources for the sibling hyperthread.
+ */
+#if defined(__i386__) || defined(__x86_64__)
+#define ELS_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__) || (defined(__arm__) && (__ARM_ARCH >= 7))
+#define ELS_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define ELS_CPU_RELAX() __asm__ __volatile__("" ::: "memory")
+#endif
+
 #define ELS_LIKELY(EXPR) __builtin_expect((EXPR), 1)
 #define ELS_UNLIKELY(EXPR) __builtin_expect((EXPR), 0)
 
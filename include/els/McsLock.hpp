@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    McsLock.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   FIFO queue lock with local spinning (Mellor-Crummey/Scott).
+ *
+ * Waiters form a linked list, each spinning on a flag in its own queue
+ * node until the predecessor hands the lock over. An unlock() touches
+ * only the successor's node, so unlike with TicketLock the number of
+ * waiters doesn't multiply the cache traffic.
+ *
+ * Queue nodes come from a per-thread free list, which keeps the usual
+ * lock()/unlock() interface: a thread may hold any number of McsLocks
+ * at the same time and release them in any order. Waiters yield the
+ * CPU after spinning for a while. Not recursive, no error checking.
+ */
+class McsLock
+{
+public:
+
+    ELS_EXPORT_SYMBOL McsLock(void) throw();
+    ELS_EXPORT_SYMBOL ~McsLock(void) throw();
+
+    ELS_EXPORT_SYMBOL void lock(void);
+    ELS_EXPORT_SYMBOL bool trylock(void);
+    ELS_EXPORT_SYMBOL void unlock(void) throw();
+
+private:
+
+    struct _T_Node
+    {
+        _T_Node* next;
+        int locked;
+        /* All nodes allocated by the owning thread. */
+        _T_Node* chain;
+        char pad[ELS_CACHELINE_SIZE - 2 * sizeof(_T_Node*) - sizeof(int)];
+    };
+
+    /* Last node in the queue, 0 if the lock is free. */
+    _T_Node* _M_tail;
+    char _M_pad[ELS_CACHELINE_SIZE - sizeof(_T_Node*)];
+    /* Node of the current holder, only touched by the holder. */
+    _T_Node* _M_holder;
+
+    static _T_Node* _S_getNode(void);
+    static void _S_putNode(_T_Node* node) throw();
+    static void _S_createKey(void);
+    static void _S_freeNodes(void* chain);
+
+    static __thread _T_Node* _S_freeList;
+    static __thread _T_Node* _S_allNodes;
+
+    ELS_CLASS_UNCOPYABLE(McsLock);
+};
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    MpmcQueue.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+#include "Exception.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Bounded lock-free multi-producer multi-consumer queue.
+ *
+ * Fixed-size ring buffer in which every cell carries a sequence number
+ * telling producers and consumers whether it's free or filled for
+ * the current lap. Neither push() nor pop() ever allocates memory
+ * or blocks.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL MpmcQueue
+{
+public:
+
+    /**
+     * @brief   Constructor. Allocates the ring buffer.
+     * @param   capacity    Maximum number of elements, rounded up to
+     *                      the nearest power of two.
+     * @throw   InvalidArgument     If capacity is zero.
+     */
+    explicit MpmcQueue(size_t capacity)
+        : _M_buffer(0),
+          _M_mask(0),
+          _M_enqueuePos(0),
+          _M_dequeuePos(0)
+    {
+        size_t size = 2;
+
+        if (capacity == 0)
+            throw except::InvalidArgument("Queue capacity must not be 0");
+
+        while (size < capacity)
+            size <<= 1;
+
+        this->_M_buffer = new _T_Cell[size];
+        this->_M_mask = size - 1;
+        for (size_t i = 0; i < size; ++i)
+            this->_M_buffer[i].seq = i;
+    }
+
+    /**
+     * @brief   Destructor.
+     */
+    ~MpmcQueue(void)
+    {
+        delete[] this->_M_buffer;
+    }
+
+    /**
+     * @brief   Appends an element at the end of the queue.
+     * @param   val     Element to store.
+     * @return  True if the element has been stored, false if the queue
+     *          is full.
+     */
+    bool push(const T& val) throw()
+    {
+        _T_Cell* cell = 0;
+        size_t pos = __atomic_load_n(&this->_M_enqueuePos, __ATOMIC_RELAXED);
+        size_t seq = 0;
+        ssize_t diff = 0;
+
+        for (;;)
+        {
+            cell = &this->_M_buffer[pos & this->_M_mask];
+            seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+            diff = static_cast<ssize_t>(seq) - static_cast<ssize_t>(pos);
+            if (diff == 0)
+            {
+                if (__atomic_compare_exchange_n(&this->_M_enqueuePos,
+                        &pos, pos + 1, true,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = __atomic_load_n(&this->_M_enqueuePos,
+                        __ATOMIC_RELAXED);
+            }
+        }
+
+        cell->data = val;
+        __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @brief   Removes the element from the front of the queue.
+     * @param   val     Reference to which the element will be assigned.
+     * @return  True if an element has been retrieved, false if the queue
+     *          is empty.
+     */
+    bool pop(T& val) throw()
+    {
+        _T_Cell* cell = 0;
+        size_t pos = __atomic_load_n(&this->_M_dequeuePos, __ATOMIC_RELAXED);
+        size_t seq = 0;
+        ssize_t diff = 0;
+
+        for (;;)
+        {
+            cell = &this->_M_buffer[pos & this->_M_mask];
+            seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+            diff = static_cast<ssize_t>(seq) - static_cast<ssize_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (__atomic_compare_exchange_n(&this->_M_dequeuePos,
+                        &pos, pos + 1, true,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = __atomic_load_n(&this->_M_dequeuePos,
+                        __ATOMIC_RELAXED);
+            }
+        }
+
+        val = cell->data;
+        __atomic_store_n(&cell->seq, pos + this->_M_mask + 1,
+                __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @brief   Returns the maximum number of stored elements.
+     * @return  Queue capacity.
+     */
+    size_t capacity(void) const throw()
+    {
+        return this->_M_mask + 1;
+    }
+
+    /**
+     * @brief   Returns the number of stored elements. The value is only
+     *          a snapshot if other threads use the queue concurrently.
+     * @return  Approximate number of elements in the queue.
+     */
+    size_t size(void) const throw()
+    {
+        size_t deq = __atomic_load_n(&this->_M_dequeuePos, __ATOMIC_ACQUIRE);
+        size_t enq = __atomic_load_n(&this->_M_enqueuePos, __ATOMIC_ACQUIRE);
+
+        return enq > deq ? enq - deq : 0;
+    }
+
+private:
+
+    struct _T_Cell
+    {
+        size_t seq;
+        T data;
+    };
+
+    _T_Cell* _M_buffer;
+    size_t _M_mask;
+    char _M_pad0[ELS_CACHELINE_SIZE];
+    size_t _M_enqueuePos;
+    char _M_pad1[ELS_CACHELINE_SIZE];
+    size_t _M_dequeuePos;
+    char _M_pad2[ELS_CACHELINE_SIZE];
+
+    ELS_CLASS_UNCOPYABLE(MpmcQueue<T>);
+};
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    MpscQueue.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Link embedded in elements of an MpscQueue.
+ */
+struct MpscNode
+{
+    MpscNode(void) : next(0) {}
+
+    MpscNode* next;
+};
+
+/**
+ * @brief   Unbounded intrusive multi-producer single-consumer queue.
+ *
+ * Elements derive from MpscNode, the queue never allocates or frees
+ * memory. push() is a single atomic exchange and never fails, pop()
+ * must only be called from one thread at a time.
+ *
+ * The queue doesn't own the elements: a node may be freed or pushed
+ * again as soon as pop() returned it. The only write a producer makes
+ * to a node it didn't push is linking its own node behind the previous
+ * one, and pop() only returns a node once its next link is set - the
+ * last node stays queued until the stub is pushed behind it. After
+ * that no producer touches the node, so no reclamation scheme is
+ * needed.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL MpscQueue
+{
+public:
+
+    /**
+     * @brief   Constructor.
+     */
+    MpscQueue(void)
+        : _M_stub(),
+          _M_tail(&_M_stub),
+          _M_head(&_M_stub)
+    {
+
+    }
+
+    /**
+     * @brief   Appends an element. Safe to call from any thread.
+     * @param   node    Element to append, must not be in any queue.
+     */
+    void push(T* node) throw()
+    {
+        this->_M_push(static_cast<MpscNode*>(node));
+    }
+
+    /**
+     * @brief   Removes the element from the front. Consumer side only.
+     * @return  Element or 0 if the queue is empty.
+     *
+     * A producer preempted in the middle of push() hides the elements
+     * pushed after it until it completes, in that case pop() returns 0
+     * although the queue isn't empty.
+     */
+    T* pop(void) throw()
+    {
+        MpscNode* tail = this->_M_tail;
+        MpscNode* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+        MpscNode* head = 0;
+
+        if (tail == &this->_M_stub)
+        {
+            if (next == 0)
+                return 0;
+
+            this->_M_tail = next;
+            tail = next;
+            next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+        }
+
+        if (next != 0)
+        {
+            this->_M_tail = next;
+            return static_cast<T*>(tail);
+        }
+
+        head = __atomic_load_n(&this->_M_head, __ATOMIC_ACQUIRE);
+        if (tail != head)
+            return 0;
+
+        /* tail is the last node, requeue the stub behind it. */
+        this->_M_push(&this->_M_stub);
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+        if (next != 0)
+        {
+            this->_M_tail = next;
+            return static_cast<T*>(tail);
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief   Checks if there are no elements. Consumer side only.
+     * @return  True if the queue is empty.
+     */
+    bool empty(void) const throw()
+    {
+        return this->_M_tail == &this->_M_stub
+                && __atomic_load_n(&this->_M_stub.next,
+                        __ATOMIC_ACQUIRE) == 0;
+    }
+
+private:
+
+    void _M_push(MpscNode* node) throw()
+    {
+        MpscNode* prev = 0;
+
+        __atomic_store_n(&node->next, static_cast<MpscNode*>(0),
+                __ATOMIC_RELAXED);
+        prev = __atomic_exchange_n(&this->_M_head, node, __ATOMIC_ACQ_REL);
+        /* Until this store the consumer can't see the node. */
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    }
+
+    MpscNode _M_stub;
+    /* Consumer side. */
+    MpscNode* _M_tail;
+    char _M_pad0[ELS_CACHELINE_SIZE];
+    /* Producer side. */
+    MpscNode* _M_head;
+    char _M_pad1[ELS_CACHELINE_SIZE];
+
+    ELS_CLASS_UNCOPYABLE(MpscQueue<T>);
+};
+
+ELS_END_NAMESPACE_2
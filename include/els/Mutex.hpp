@@ -49,6 +49,8 @@ private:
 
     ::pthread_mutex_t _M_mutex;
 
+    friend class Condition;
+
     ELS_CLASS_UNCOPYABLE(Mutex);
 };
 
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    Parallel.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Atomic.hpp"
+#include "Mutex.hpp"
+#include "Condition.hpp"
+#include "IRunnable.hpp"
+#include "ThreadPool.hpp"
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+ELS_BEGIN_NAMESPACE_1(__parallel_detail)
+
+/*
+ * State shared by the caller and the helper tasks of a single parallel
+ * call. The range is split into chunks handed out through an atomic
+ * counter, so helpers which get to run late simply find no work left.
+ * The state is reference counted as helpers may outlive the call.
+ */
+class RangeTaskBase
+{
+public:
+
+    ELS_EXPORT_SYMBOL RangeTaskBase(ThreadPool& pool, size_t begin,
+            size_t end, size_t grain);
+    ELS_EXPORT_SYMBOL virtual ~RangeTaskBase(void);
+
+    ELS_EXPORT_SYMBOL size_t chunks(void) const;
+    ELS_EXPORT_SYMBOL void execute(bool callerRuns);
+    ELS_EXPORT_SYMBOL void work(void);
+    ELS_EXPORT_SYMBOL void helperDone(void);
+    ELS_EXPORT_SYMBOL void ref(void);
+    ELS_EXPORT_SYMBOL void unref(void);
+
+protected:
+
+    virtual void _M_runChunk(size_t chunk, size_t begin, size_t end) = 0;
+
+private:
+
+    ThreadPool& _M_pool;
+    size_t _M_begin;
+    size_t _M_end;
+    size_t _M_grain;
+    size_t _M_numChunks;
+    size_t _M_nextChunk;
+    size_t _M_doneChunks;
+    AtomicInt _M_refs;
+    Mutex _M_mutex;
+    Condition _M_cond;
+    bool _M_finished;
+    size_t _M_helpers;
+
+    ELS_CLASS_UNCOPYABLE(RangeTaskBase);
+};
+
+template <typename Body> class ForTask : public RangeTaskBase
+{
+public:
+
+    ForTask(ThreadPool& pool, size_t begin, size_t end, size_t grain,
+            const Body& body)
+        : RangeTaskBase(pool, begin, end, grain),
+          _M_body(body)
+    {
+
+    }
+
+protected:
+
+    virtual void _M_runChunk(size_t, size_t begin, size_t end)
+    {
+        this->_M_body(begin, end);
+    }
+
+private:
+
+    const Body& _M_body;
+};
+
+template <typename T, typename Body> class ReduceTask : public RangeTaskBase
+{
+public:
+
+    ReduceTask(ThreadPool& pool, size_t begin, size_t end, size_t grain,
+            const T& identity, const Body& body)
+        : RangeTaskBase(pool, begin, end, grain),
+          _M_body(body),
+          _M_partials(this->chunks(), identity)
+    {
+
+    }
+
+    const std::vector<T>& partials(void) const
+    {
+        return this->_M_partials;
+    }
+
+protected:
+
+    virtual void _M_runChunk(size_t chunk, size_t begin, size_t end)
+    {
+        this->_M_partials[chunk] = this->_M_body(begin, end);
+    }
+
+private:
+
+    const Body& _M_body;
+    std::vector<T> _M_partials;
+};
+
+template <typename InputIt, typename OutputIt, typename Op> class TransformBody
+{
+public:
+
+    TransformBody(InputIt first, OutputIt out, const Op& op)
+        : _M_first(first), _M_out(out), _M_op(op) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+            this->_M_out[i] = this->_M_op(this->_M_first[i]);
+    }
+
+private:
+
+    InputIt _M_first;
+    OutputIt _M_out;
+    const Op& _M_op;
+};
+
+template <typename RandomIt, typename Compare> class SortRunsBody
+{
+public:
+
+    SortRunsBody(RandomIt first, size_t count, size_t runLength,
+            const Compare& comp)
+        : _M_first(first), _M_count(count), _M_runLength(runLength),
+          _M_comp(comp) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+        size_t from = 0;
+        size_t to = 0;
+
+        for (size_t run = begin; run < end; ++run)
+        {
+            from = run * this->_M_runLength;
+            to = std::min(from + this->_M_runLength, this->_M_count);
+            std::sort(this->_M_first + from, this->_M_first + to,
+                    this->_M_comp);
+        }
+    }
+
+private:
+
+    RandomIt _M_first;
+    size_t _M_count;
+    size_t _M_runLength;
+    const Compare& _M_comp;
+};
+
+template <typename SrcIt, typename DstIt, typename Compare> class MergeBody
+{
+public:
+
+    MergeBody(SrcIt src, DstIt dst, size_t count, size_t width,
+            const Compare& comp)
+        : _M_src(src), _M_dst(dst), _M_count(count), _M_width(width),
+          _M_comp(comp) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+        size_t left = 0;
+        size_t mid = 0;
+        size_t right = 0;
+
+        for (size_t pair = begin; pair < end; ++pair)
+        {
+            left = pair * 2 * this->_M_width;
+            mid = std::min(left + this->_M_width, this->_M_count);
+            right = std::min(mid + this->_M_width, this->_M_count);
+            std::merge(this->_M_src + left, this->_M_src + mid,
+                    this->_M_src + mid, this->_M_src + right,
+                    this->_M_dst + left, this->_M_comp);
+        }
+    }
+
+private:
+
+    SrcIt _M_src;
+    DstIt _M_dst;
+    size_t _M_count;
+    size_t _M_width;
+    const Compare& _M_comp;
+};
+
+ELS_END_NAMESPACE_1
+
+/**
+ * @brief   Runs body over the range [begin, end) split into chunks
+ *          executed concurrently by the pool.
+ * @param   pool        Pool providing the helper threads.
+ * @param   begin       First index.
+ * @param   end         One past the last index.
+ * @param   body        Functor called as body(chunkBegin, chunkEnd),
+ *                      must be const-callable, thread-safe and must
+ *                      not throw.
+ * @param   grain       Number of indices per chunk, 0 picks one giving
+ *                      every worker several chunks to balance the load.
+ * @param   callerRuns  If true, the calling thread processes chunks
+ *                      right away instead of first waiting for the
+ *                      workers. Either way it takes the chunks of helper
+ *                      tasks the pool discarded. Must be true if called
+ *                      from a pool worker.
+ *
+ * Allocates the shared state and one helper task per worker, nothing
+ * per chunk or per index. Returns once the whole range is done.
+ */
+template <typename Body> void parallelFor(ThreadPool& pool, size_t begin,
+        size_t end, const Body& body, size_t grain = 0,
+        bool callerRuns = true)
+{
+    __parallel_detail::ForTask<Body>* task = 0;
+
+    if (begin >= end)
+        return;
+
+    task = new __parallel_detail::ForTask<Body>(pool, begin, end,
+            grain, body);
+    task->execute(callerRuns);
+    task->unref();
+}
+
+/**
+ * @brief   Computes a reduction of the range [begin, end) in parallel.
+ * @param   pool        Pool providing the helper threads.
+ * @param   begin       First index.
+ * @param   end         One past the last index.
+ * @param   identity    Result for an empty range, also the initial
+ *                      value of the reduction.
+ * @param   body        Functor called as body(chunkBegin, chunkEnd)
+ *                      returning the partial result of a chunk.
+ * @param   join        Functor called as join(a, b) combining two
+ *                      results. Partial results are joined in order
+ *                      in the calling thread, so join only has to be
+ *                      associative.
+ * @param   grain       See parallelFor().
+ * @param   callerRuns  See parallelFor().
+ * @return  Reduced value.
+ */
+template <typename T, typename Body, typename Join> T parallelReduce(
+        ThreadPool& pool, size_t begin, size_t end, const T& identity,
+        const Body& body, const Join& join, size_t grain = 0,
+        bool callerRuns = true)
+{
+    __parallel_detail::ReduceTask<T, Body>* task = 0;
+    T result = identity;
+
+    if (begin >= end)
+        return result;
+
+    task = new __parallel_detail::ReduceTask<T, Body>(pool, begin, end,
+            grain, identity, body);
+    task->execute(callerRuns);
+    for (size_t i = 0; i < task->partials().size(); ++i)
+        result = join(result, task->partials()[i]);
+    task->unref();
+
+    return result;
+}
+
+/**
+ * @brief   Stores op(*it) for every element of [first, last) in the range
+ *          starting at out, in parallel.
+ * @param   pool        Pool providing the helper threads.
+ * @param   first       Beginning of the input, random access iterator.
+ * @param   last        End of the input.
+ * @param   out         Beginning of the output, random access iterator.
+ *                      May be equal to first.
+ * @param   op          Unary functor, must be const-callable.
+ * @param   grain       See parallelFor().
+ * @param   callerRuns  See parallelFor().
+ */
+template <typename InputIt, typename OutputIt, typename Op>
+void parallelTransform(ThreadPool& pool, InputIt first, InputIt last,
+        OutputIt out, const Op& op, size_t grain = 0, bool callerRuns = true)
+{
+    __parallel_detail::TransformBody<InputIt, OutputIt, Op> body(
+            first, out, op);
+
+    parallelFor(pool, 0, last - first, body, grain, callerRuns);
+}
+
+/**
+ * @brief   Sorts the range [first, last) with a parallel merge sort.
+ * @param   pool        Pool providing the helper threads.
+ * @param   first       Beginning of the range, random access iterator.
+ * @param   last        End of the range.
+ * @param   comp        Strict weak ordering, must be const-callable.
+ * @param   grain       Length of the runs sorted sequentially before
+ *                      merging, 0 picks one giving every worker a run.
+ *
+ * Runs are sorted with std::sort and then merged pairwise in parallel,
+ * bouncing between the range and a temporary buffer of the same size.
+ * Element type must be default-constructible. Not stable.
+ */
+template <typename RandomIt, typename Compare> void parallelSort(
+        ThreadPool& pool, RandomIt first, RandomIt last, const Compare& comp,
+        size_t grain = 0)
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+
+    size_t count = last - first;
+    size_t runLength = grain;
+    size_t numRuns = 0;
+    bool inBuffer = false;
+    std::vector<T> buffer;
+    T* tmp = 0;
+
+    if (runLength == 0)
+        runLength = std::max(count / (pool.numWorkers() + 1),
+                static_cast<size_t>(1024));
+    if (count <= runLength)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    numRuns = (count + runLength - 1) / runLength;
+    parallelFor(pool, 0, numRuns,
+            __parallel_detail::SortRunsBody<RandomIt, Compare>(
+                first, count, runLength, comp), 1);
+
+    buffer.resize(count);
+    tmp = &buffer[0];
+    for (size_t width = runLength; width < count; width *= 2)
+    {
+        size_t numPairs = (count + 2 * width - 1) / (2 * width);
+
+        if (inBuffer)
+            parallelFor(pool, 0, numPairs,
+                    __parallel_detail::MergeBody<T*, RandomIt, Compare>(
+                        tmp, first, count, width, comp), 1);
+        else
+            parallelFor(pool, 0, numPairs,
+                    __parallel_detail::MergeBody<RandomIt, T*, Compare>(
+                        first, tmp, count, width, comp), 1);
+        inBuffer = !inBuffer;
+    }
+
+    if (inBuffer)
+        std::copy(buffer.begin(), buffer.end(), first);
+}
+
+/**
+ * @brief   Sorts the range [first, last) in ascending order with
+ *          a parallel merge sort, see the version taking a comparator.
+ */
+template <typename RandomIt> void parallelSort(ThreadPool& pool,
+        RandomIt first, RandomIt last)
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+
+    parallelSort(pool, first, last, std::less<T>());
+}
+
+ELS_END_NAMESPACE_2
+
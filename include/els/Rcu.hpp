@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    Rcu.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+
+#include <cstddef>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Process wide userspace read-copy-update.
+ *
+ * Readers bracket their accesses to RCU protected data with readLock()
+ * and readUnlock(). Both only write the calling thread's own epoch
+ * slot, readers never share a written cache line and scale with the
+ * number of cores. Writers publish a new version (see RcuPtr), then
+ * either wait for all readers which may still see the old one with
+ * synchronize() or hand it to call() to be freed later.
+ *
+ * Where the kernel supports membarrier(), readers get away without
+ * any memory fence and synchronize() pays for it with a system call
+ * interrupting the other running threads of the process. Otherwise
+ * readers issue a full fence when entering the outermost section.
+ *
+ * Read-side sections may nest and must not block for long - a writer
+ * in synchronize() waits for them.
+ */
+class Rcu
+{
+public:
+
+    typedef void (*Callback)(void*);
+
+    /**
+     * @brief   Enters a read-side section.
+     */
+    static void readLock(void) throw()
+    {
+        _T_Reader* reader = _S_reader;
+
+        if (ELS_UNLIKELY(reader == 0))
+            reader = _S_registerReader();
+
+        if (reader->nesting++ == 0)
+        {
+            __atomic_store_n(&reader->epoch,
+                    __atomic_load_n(&_S_epoch, __ATOMIC_RELAXED),
+                    __ATOMIC_RELAXED);
+            _S_readerFence();
+        }
+    }
+
+    /**
+     * @brief   Leaves a read-side section. Pointers obtained inside
+     *          the outermost section must not be used anymore.
+     */
+    static void readUnlock(void) throw()
+    {
+        _T_Reader* reader = _S_reader;
+
+        if (--reader->nesting == 0)
+            __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief   Checks if the calling thread is in a read-side section.
+     * @return  True between readLock() and the matching readUnlock().
+     */
+    static bool inReadSection(void) throw()
+    {
+        return _S_reader != 0 && _S_reader->nesting > 0;
+    }
+
+    ELS_EXPORT_SYMBOL static void synchronize(void);
+    ELS_EXPORT_SYMBOL static void call(Callback func, void* arg);
+    ELS_EXPORT_SYMBOL static void barrier(void);
+    ELS_EXPORT_SYMBOL static bool usesMembarrier(void) throw();
+
+private:
+
+    /* One per thread, each on its own cache line. */
+    struct _T_Reader
+    {
+        /* Epoch seen when entering the section, 0 outside of it. */
+        size_t epoch;
+        unsigned nesting;
+        int used;
+        _T_Reader* next;
+        char pad[ELS_CACHELINE_SIZE - 2 * sizeof(size_t)
+                - sizeof(unsigned) - sizeof(int)];
+    };
+
+    static void _S_readerFence(void) throw()
+    {
+        if (ELS_LIKELY(_S_membarrier))
+            __asm__ __volatile__("" ::: "memory");
+        else
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    ELS_EXPORT_SYMBOL static _T_Reader* _S_registerReader(void) throw();
+    static void _S_releaseReader(void* ptr);
+    static void _S_init(void);
+    static void _S_writerFence(void) throw();
+
+    ELS_EXPORT_SYMBOL static __thread _T_Reader* _S_reader;
+    static _T_Reader* _S_readers;
+    ELS_EXPORT_SYMBOL static size_t _S_epoch;
+    ELS_EXPORT_SYMBOL static bool _S_membarrier;
+
+    ELS_CLASS_NOT_INSTANTIABLE(Rcu);
+};
+
+/**
+ * @brief   Holds a read-side section for the lifetime of the object.
+ */
+class RcuReadGuard
+{
+public:
+
+    RcuReadGuard(void) throw() { Rcu::readLock(); }
+    ~RcuReadGuard(void) throw() { Rcu::readUnlock(); }
+
+private:
+
+    ELS_CLASS_UNCOPYABLE(RcuReadGuard);
+};
+
+/**
+ * @brief   Owning pointer to an RCU protected object.
+ *
+ * Readers call get() inside a read-side section and may use the object
+ * until they leave it. Writers build a new version and swap it in
+ * with replace(), the old one is deleted once no reader can see it.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL RcuPtr
+{
+public:
+
+    /**
+     * @brief   Constructor.
+     * @param   ptr     Initial object, the RcuPtr takes ownership.
+     */
+    explicit RcuPtr(T* ptr = 0) throw()
+        : _M_ptr(ptr)
+    {
+
+    }
+
+    /**
+     * @brief   Destructor. Deletes the current object, no reader may
+     *          still be using it.
+     */
+    ~RcuPtr(void)
+    {
+        delete this->_M_ptr;
+    }
+
+    /**
+     * @brief   Returns the current object. Only valid until the end of
+     *          the enclosing read-side section.
+     * @return  Current object.
+     */
+    T* get(void) const throw()
+    {
+        return __atomic_load_n(&this->_M_ptr, __ATOMIC_CONSUME);
+    }
+
+    /**
+     * @brief   Publishes a new object without reclaiming the old one.
+     * @param   ptr     New object, fully initialized.
+     * @return  Previous object, readers may still be using it.
+     */
+    T* exchange(T* ptr) throw()
+    {
+        return __atomic_exchange_n(&this->_M_ptr, ptr, __ATOMIC_ACQ_REL);
+    }
+
+    /**
+     * @brief   Publishes a new object and deletes the old one after
+     *          a grace period, without waiting for it.
+     * @param   ptr     New object, fully initialized.
+     */
+    void replace(T* ptr)
+    {
+        T* old = this->exchange(ptr);
+
+        if (old != 0)
+            Rcu::call(&_S_delete, old);
+    }
+
+    /**
+     * @brief   Publishes a new object, waits for readers of the old one
+     *          and deletes it.
+     * @param   ptr     New object, fully initialized.
+     */
+    void replaceSync(T* ptr)
+    {
+        T* old = this->exchange(ptr);
+
+        Rcu::synchronize();
+        delete old;
+    }
+
+private:
+
+    static void _S_delete(void* ptr)
+    {
+        delete static_cast<T*>(ptr);
+    }
+
+    T* _M_ptr;
+
+    ELS_CLASS_UNCOPYABLE(RcuPtr<T>);
+};
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    SeqLock.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <sched.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Sequence lock protecting a small value with many readers.
+ *
+ * Writers bump a sequence counter to an odd value, update the value
+ * and bump it again. Readers copy the value between two reads of the
+ * counter and retry if a write was in progress or happened meanwhile.
+ * Reading never writes shared memory, so readers don't bounce cache
+ * lines between each other no matter how many there are; the price is
+ * a retry when they race with a writer.
+ *
+ * Writers are serialized on the counter itself. T must be trivially
+ * copyable - readers may copy it while it's being modified and throw
+ * the torn copy away.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL SeqLock
+{
+public:
+
+    /**
+     * @brief   Constructor.
+     * @param   val     Initial value.
+     */
+    explicit SeqLock(const T& val = T())
+        : _M_seq(0),
+          _M_value(val)
+    {
+
+    }
+
+    /**
+     * @brief   Returns a consistent copy of the value.
+     * @return  Value stored by the last completed write.
+     */
+    T load(void) const throw()
+    {
+        T val;
+
+        this->load(val);
+        return val;
+    }
+
+    /**
+     * @brief   Copies the value, retrying until no write interferes.
+     * @param   val     Reference to which the value will be assigned.
+     */
+    void load(T& val) const throw()
+    {
+        size_t seq = 0;
+
+        do
+        {
+            seq = this->readBegin();
+            std::memcpy(&val, &this->_M_value, sizeof(T));
+        }
+        while (this->readRetry(seq));
+    }
+
+    /**
+     * @brief   Makes a single attempt at copying the value.
+     * @param   val     Reference to which the value will be assigned.
+     * @return  True if val is consistent, false if a write interfered.
+     */
+    bool tryLoad(T& val) const throw()
+    {
+        size_t seq = __atomic_load_n(&this->_M_seq, __ATOMIC_ACQUIRE);
+
+        if (seq & 1)
+            return false;
+
+        std::memcpy(&val, &this->_M_value, sizeof(T));
+        return !this->readRetry(seq);
+    }
+
+    /**
+     * @brief   Replaces the value.
+     * @param   val     New value.
+     */
+    void store(const T& val) throw()
+    {
+        this->writeLock();
+        std::memcpy(&this->_M_value, &val, sizeof(T));
+        this->writeUnlock();
+    }
+
+    /**
+     * @brief   Starts a read section, waiting for a running write to end.
+     * @return  Sequence number to pass to readRetry().
+     *
+     * For reading only some fields of a bigger value through get():
+     *
+     *     do {
+     *         seq = lock.readBegin();
+     *         offset = lock.get().offset;
+     *     } while (lock.readRetry(seq));
+     */
+    size_t readBegin(void) const throw()
+    {
+        size_t seq = 0;
+        unsigned spins = 0;
+
+        while ((seq = __atomic_load_n(&this->_M_seq, __ATOMIC_ACQUIRE)) & 1)
+        {
+            /* The writer may have been preempted, let it run. */
+            if (++spins < _S_maxSpins)
+                ELS_CPU_RELAX();
+            else
+                ::sched_yield();
+        }
+
+        return seq;
+    }
+
+    /**
+     * @brief   Ends a read section.
+     * @param   seq     Value returned by readBegin().
+     * @return  True if the data read may be torn and must be read again.
+     */
+    bool readRetry(size_t seq) const throw()
+    {
+        /* Keeps the data reads above from sinking below the check. */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&this->_M_seq, __ATOMIC_RELAXED) != seq;
+    }
+
+    /**
+     * @brief   Starts a write section, waiting for other writers.
+     *
+     * Between writeLock() and writeUnlock() the value can be modified
+     * in place through get().
+     */
+    void writeLock(void) throw()
+    {
+        size_t seq = __atomic_load_n(&this->_M_seq, __ATOMIC_RELAXED);
+        unsigned spins = 0;
+
+        for (;;)
+        {
+            if (!(seq & 1) && __atomic_compare_exchange_n(&this->_M_seq,
+                    &seq, seq + 1, true,
+                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                break;
+
+            if (++spins < _S_maxSpins)
+                ELS_CPU_RELAX();
+            else
+                ::sched_yield();
+            seq = __atomic_load_n(&this->_M_seq, __ATOMIC_RELAXED);
+        }
+
+        /* Readers seeing any of the new data see the odd counter. */
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief   Ends a write section and publishes the new value.
+     */
+    void writeUnlock(void) throw()
+    {
+        __atomic_add_fetch(&this->_M_seq, 1, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief   Gives access to the protected value. Only valid inside
+     *          a read or write section.
+     * @return  Reference to the value.
+     */
+    T& get(void) throw() { return this->_M_value; }
+    const T& get(void) const throw() { return this->_M_value; }
+
+    /**
+     * @brief   Returns the sequence number, which grows by two with
+     *          every completed write.
+     * @return  Current sequence number.
+     */
+    size_t sequence(void) const throw()
+    {
+        return __atomic_load_n(&this->_M_seq, __ATOMIC_ACQUIRE);
+    }
+
+private:
+
+    static const unsigned _S_maxSpins = 64;
+
+    size_t _M_seq;
+    T _M_value;
+
+    ELS_CLASS_UNCOPYABLE(SeqLock<T>);
+};
+
+ELS_END_NAMESPACE_2
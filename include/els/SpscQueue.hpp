@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    SpscQueue.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+#include "Exception.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Bounded wait-free single-producer single-consumer queue.
+ *
+ * Ring buffer indexed by two free-running counters, each written by
+ * only one side. Both sides keep a private copy of the other side's
+ * counter and only re-read the shared one when the queue looks full
+ * (or empty), so in steady state a push or pop touches no cache line
+ * written by the other thread except the element itself.
+ *
+ * Exactly one thread may push and exactly one thread may pop.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL SpscQueue
+{
+public:
+
+    /**
+     * @brief   Constructor. Allocates the ring buffer.
+     * @param   capacity    Maximum number of elements, rounded up to
+     *                      the nearest power of two.
+     * @throw   InvalidArgument     If capacity is zero.
+     */
+    explicit SpscQueue(size_t capacity)
+        : _M_buffer(0),
+          _M_mask(0),
+          _M_tail(0),
+          _M_headCache(0),
+          _M_head(0),
+          _M_tailCache(0)
+    {
+        size_t size = 1;
+
+        if (capacity == 0)
+            throw except::InvalidArgument("Queue capacity must not be 0");
+
+        while (size < capacity)
+            size <<= 1;
+
+        this->_M_buffer = new T[size];
+        this->_M_mask = size - 1;
+    }
+
+    /**
+     * @brief   Destructor.
+     */
+    ~SpscQueue(void)
+    {
+        delete[] this->_M_buffer;
+    }
+
+    /**
+     * @brief   Appends an element. Producer side only.
+     * @param   val     Element to store.
+     * @return  True if the element has been stored, false if the queue
+     *          is full.
+     */
+    bool push(const T& val)
+    {
+        size_t tail = __atomic_load_n(&this->_M_tail, __ATOMIC_RELAXED);
+
+        if (tail - this->_M_headCache > this->_M_mask)
+        {
+            this->_M_headCache = __atomic_load_n(&this->_M_head,
+                    __ATOMIC_ACQUIRE);
+            if (tail - this->_M_headCache > this->_M_mask)
+                return false;
+        }
+
+        this->_M_buffer[tail & this->_M_mask] = val;
+        __atomic_store_n(&this->_M_tail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @brief   Removes the element from the front. Consumer side only.
+     * @param   val     Reference to which the element will be assigned.
+     * @return  True if an element has been retrieved, false if the queue
+     *          is empty.
+     */
+    bool pop(T& val)
+    {
+        size_t head = __atomic_load_n(&this->_M_head, __ATOMIC_RELAXED);
+
+        if (head == this->_M_tailCache)
+        {
+            this->_M_tailCache = __atomic_load_n(&this->_M_tail,
+                    __ATOMIC_ACQUIRE);
+            if (head == this->_M_tailCache)
+                return false;
+        }
+
+        val = this->_M_buffer[head & this->_M_mask];
+        __atomic_store_n(&this->_M_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @brief   Returns the maximum number of stored elements.
+     * @return  Queue capacity.
+     */
+    size_t capacity(void) const throw()
+    {
+        return this->_M_mask + 1;
+    }
+
+    /**
+     * @brief   Returns the number of stored elements. The value is only
+     *          a snapshot if the queue is used concurrently.
+     * @return  Approximate number of elements in the queue.
+     */
+    size_t size(void) const throw()
+    {
+        size_t head = __atomic_load_n(&this->_M_head, __ATOMIC_ACQUIRE);
+        size_t tail = __atomic_load_n(&this->_M_tail, __ATOMIC_ACQUIRE);
+
+        return tail - head;
+    }
+
+private:
+
+    T* _M_buffer;
+    size_t _M_mask;
+    char _M_pad0[ELS_CACHELINE_SIZE];
+    /* Producer side. */
+    size_t _M_tail;
+    size_t _M_headCache;
+    char _M_pad1[ELS_CACHELINE_SIZE];
+    /* Consumer side. */
+    size_t _M_head;
+    size_t _M_tailCache;
+    char _M_pad2[ELS_CACHELINE_SIZE];
+
+    ELS_CLASS_UNCOPYABLE(SpscQueue<T>);
+};
+
+ELS_END_NAMESPACE_2
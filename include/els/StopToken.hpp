@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    StopToken.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "IRunnable.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Shared flag asking a thread to stop, with callbacks run
+ *          when the stop is requested.
+ *
+ * All copies of a token share the same state. Checking the flag is
+ * a single atomic load, so it's cheap enough for tight loops. Code
+ * blocked on something the flag can't interrupt - a condition variable,
+ * a socket, a queue - registers a callback which unblocks it instead
+ * of waking up periodically to poll.
+ *
+ * Callbacks run in the thread calling requestStop(), in the order they
+ * were added, and must not throw. A callback added after the stop was
+ * requested runs immediately in the thread adding it.
+ *
+ * ThreadPool's CancelToken is built on the same state, so a task can
+ * be cancelled by a stop request and wake up through a callback.
+ */
+class StopToken
+{
+public:
+
+    ELS_EXPORT_SYMBOL StopToken(void);
+    ELS_EXPORT_SYMBOL StopToken(const StopToken& other);
+    ELS_EXPORT_SYMBOL StopToken& operator =(const StopToken& other);
+    ELS_EXPORT_SYMBOL ~StopToken(void);
+
+    ELS_EXPORT_SYMBOL bool requestStop(void);
+    ELS_EXPORT_SYMBOL bool stopRequested(void) const throw();
+    ELS_EXPORT_SYMBOL void addCallback(IRunnable* callback);
+    ELS_EXPORT_SYMBOL void removeCallback(IRunnable* callback);
+
+private:
+
+    struct _T_State;
+
+    _T_State* _M_state;
+
+    explicit StopToken(_T_State* state);
+
+    static _T_State* _S_ref(_T_State* state) throw();
+    static void _S_unref(_T_State* state) throw();
+    static bool _S_stopped(const _T_State* state) throw();
+
+    friend class CancelToken;
+    friend class ThreadPool;
+};
+
+/**
+ * @brief   Registers a stop callback for the lifetime of the object.
+ *
+ * The destructor waits for the callback to return if it's running
+ * in another thread, so whatever the callback uses may be destroyed
+ * right after.
+ */
+class StopCallback
+{
+public:
+
+    ELS_EXPORT_SYMBOL StopCallback(const StopToken& token,
+            IRunnable& callback);
+    ELS_EXPORT_SYMBOL ~StopCallback(void);
+
+private:
+
+    StopToken _M_token;
+    IRunnable& _M_callback;
+
+    ELS_CLASS_UNCOPYABLE(StopCallback);
+};
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    Strand.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+#include "IRunnable.hpp"
+#include "Mutex.hpp"
+#include "Condition.hpp"
+
+#include <vector>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+class ThreadPool;
+
+/**
+ * @brief   Serial executor multiplexed over a ThreadPool.
+ *
+ * Tasks posted to a strand run one at a time in FIFO order, but not
+ * necessarily always in the same thread. A strand occupies at most one
+ * worker and only while it has pending tasks, so any number of strands
+ * can share a small pool. Each run processes a bounded batch of tasks
+ * and then yields the worker back to the pool to keep other strands
+ * from starving.
+ *
+ * Unless a strand has been drained, it must not be destroyed before
+ * the pool's workers have run all its pending tasks.
+ */
+class Strand
+{
+public:
+
+    ELS_EXPORT_SYMBOL static const size_t DEF_BATCH_SIZE;
+
+    ELS_EXPORT_SYMBOL explicit Strand(ThreadPool& pool,
+            size_t batchSize = DEF_BATCH_SIZE);
+    ELS_EXPORT_SYMBOL virtual ~Strand(void);
+
+    ELS_EXPORT_SYMBOL void post(IRunnable* task, bool autoDelete = false);
+    ELS_EXPORT_SYMBOL void drain(void);
+    ELS_EXPORT_SYMBOL size_t pending(void) const;
+    ELS_EXPORT_SYMBOL bool runningInThisThread(void) const;
+
+private:
+
+    struct _T_Task
+    {
+        IRunnable* runnable;
+        bool autoDelete;
+        _T_Task* next;
+    };
+
+    class _T_Runner;
+
+    ThreadPool& _M_pool;
+    const size_t _M_batchSize;
+    _T_Task* _M_head;
+    _T_Task* _M_tail;
+    size_t _M_pending;
+    bool _M_scheduled;
+    mutable Mutex _M_mutex;
+    Condition _M_idleCond;
+
+    static __thread const Strand* _S_current;
+
+    void _M_run(void) throw();
+    void _M_schedule(void);
+    bool _M_trySchedule(void);
+
+    ELS_CLASS_UNCOPYABLE(Strand);
+};
+
+/**
+ * @brief   Fixed set of strands indexed by a key.
+ *
+ * Tasks posted with the same key always end up in the same strand, so
+ * they're serialized with respect to each other. Tasks with different
+ * keys may share a strand too - use enough strands to keep such false
+ * serialization rare.
+ */
+class KeyedStrands
+{
+public:
+
+    ELS_EXPORT_SYMBOL KeyedStrands(ThreadPool& pool, size_t numStrands,
+            size_t batchSize = Strand::DEF_BATCH_SIZE);
+    ELS_EXPORT_SYMBOL virtual ~KeyedStrands(void);
+
+    ELS_EXPORT_SYMBOL void post(size_t key, IRunnable* task,
+            bool autoDelete = false);
+    ELS_EXPORT_SYMBOL Strand& strand(size_t key);
+    ELS_EXPORT_SYMBOL size_t size(void) const;
+    ELS_EXPORT_SYMBOL void drain(void);
+
+private:
+
+    typedef std::vector<Strand*> _T_StrandList;
+
+    _T_StrandList _M_strands;
+
+    ELS_CLASS_UNCOPYABLE(KeyedStrands);
+};
+
+ELS_END_NAMESPACE_2
+
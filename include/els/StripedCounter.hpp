@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    StripedCounter.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+
+#include <cstddef>
+#include <sched.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Counter updated by many threads without contending on
+ *          a single cache line.
+ *
+ * The value is split over slots a cache line apart. Every update goes
+ * to the slot of the current CPU (STRIPE_BY_CPU) or thread
+ * (STRIPE_BY_THREAD), reading the counter sums all slots. Updates are
+ * relaxed, get() doesn't synchronize with anything and may miss
+ * updates which are in flight.
+ *
+ * In approximate mode updates are a plain load and store instead of
+ * a locked add. A thread preempted between the two overwrites every
+ * update other threads made to its slot in the meantime, so the loss
+ * is unbounded whenever a slot is shared. CPU slots always are, so
+ * approximate mode requires STRIPE_BY_THREAD, and with more threads than
+ * slots it still loses updates. With a slot per thread, approximate
+ * updates are exact but get() may still miss those in flight.
+ */
+class StripedCounter
+{
+public:
+
+    enum StripePolicy
+    {
+        STRIPE_BY_CPU = 0,
+        STRIPE_BY_THREAD,
+    };
+
+    ELS_EXPORT_SYMBOL explicit StripedCounter(size_t slots = 0,
+            StripePolicy policy = STRIPE_BY_CPU, bool approximate = false);
+    ELS_EXPORT_SYMBOL ~StripedCounter(void);
+
+    /**
+     * @brief   Adds delta to the slot of the calling CPU or thread.
+     * @param   delta   Value to add, may be negative.
+     */
+    void add(ElsInt64 delta) throw()
+    {
+        ElsInt64* value = &this->_M_slots[this->_M_index()].value;
+
+        if (this->_M_approximate)
+            __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED)
+                    + delta, __ATOMIC_RELAXED);
+        else
+            __atomic_fetch_add(value, delta, __ATOMIC_RELAXED);
+    }
+
+    void inc(void) throw() { this->add(1); }
+    void dec(void) throw() { this->add(-1); }
+
+    ELS_EXPORT_SYMBOL ElsInt64 get(void) const throw();
+    ELS_EXPORT_SYMBOL void reset(void) throw();
+    ELS_EXPORT_SYMBOL size_t slots(void) const throw();
+    ELS_EXPORT_SYMBOL StripePolicy policy(void) const throw();
+    ELS_EXPORT_SYMBOL bool approximate(void) const throw();
+
+private:
+
+    struct _T_Slot
+    {
+        ElsInt64 value;
+        char pad[ELS_CACHELINE_SIZE - sizeof(ElsInt64)];
+    };
+
+    _T_Slot* _M_slots;
+    size_t _M_mask;
+    StripePolicy _M_policy;
+    bool _M_approximate;
+
+    size_t _M_index(void) const throw()
+    {
+        int cpu = 0;
+
+        if ((this->_M_policy == STRIPE_BY_CPU)
+                && ((cpu = ::sched_getcpu()) >= 0))
+            return cpu & this->_M_mask;
+
+        if (_S_threadSlot == 0)
+            _S_threadSlot = _S_nextThreadSlot();
+        return _S_threadSlot & this->_M_mask;
+    }
+
+    ELS_EXPORT_SYMBOL static __thread size_t _S_threadSlot;
+    ELS_EXPORT_SYMBOL static size_t _S_nextThreadSlot(void) throw();
+
+    ELS_CLASS_UNCOPYABLE(StripedCounter);
+};
+
+ELS_END_NAMESPACE_2
@@ -38,6 +38,7 @@ ELS_EXPORT_SYMBOL char** getEnvp(void) throw();
 ELS_EXPORT_SYMBOL void makeDir(const std::string& path, ElsMode mode);
 ELS_EXPORT_SYMBOL void* libcMalloc(ElsSize size);
 ELS_EXPORT_SYMBOL void libcFree(void* ptr);
+ELS_EXPORT_SYMBOL ElsUint64 monotonicNs(void) throw();
 
 ELS_END_NAMESPACE_2
 
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    TaskGraph.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+#include "IRunnable.hpp"
+#include "Mutex.hpp"
+#include "Condition.hpp"
+
+#include <string>
+#include <vector>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+class ThreadPool;
+
+/**
+ * @brief   Runs a directed acyclic graph of tasks on a ThreadPool.
+ *
+ * A node is scheduled as soon as all its predecessors have finished.
+ * The graph is validated and laid out once, after which it can be run
+ * any number of times (e.g. once per frame) without allocating memory.
+ * Every run measures the duration of each node, which gives the critical
+ * path - the chain of dependent nodes bounding the run time no matter
+ * how many workers there are.
+ */
+class TaskGraph
+{
+public:
+
+    typedef size_t NodeId;
+
+    ELS_EXPORT_SYMBOL explicit TaskGraph(ThreadPool& pool);
+    ELS_EXPORT_SYMBOL virtual ~TaskGraph(void);
+
+    ELS_EXPORT_SYMBOL NodeId addNode(IRunnable* task,
+            const std::string& name = std::string(), bool autoDelete = false);
+    ELS_EXPORT_SYMBOL void addEdge(NodeId from, NodeId to);
+    ELS_EXPORT_SYMBOL size_t size(void) const;
+    ELS_EXPORT_SYMBOL const std::string& name(NodeId node) const;
+
+    ELS_EXPORT_SYMBOL void run(void);
+
+    ELS_EXPORT_SYMBOL ElsUint64 lastRunTime(void) const;
+    ELS_EXPORT_SYMBOL ElsUint64 nodeTime(NodeId node) const;
+    ELS_EXPORT_SYMBOL ElsUint64 criticalPathTime(void) const;
+    ELS_EXPORT_SYMBOL std::vector<NodeId> criticalPath(void) const;
+
+private:
+
+    class _T_Node : public IRunnable
+    {
+    public:
+        _T_Node(TaskGraph* graph, NodeId id, IRunnable* task,
+                const std::string& name, bool autoDelete);
+        virtual ~_T_Node(void);
+        virtual void run(void) throw();
+    private:
+        TaskGraph* _M_graph;
+        NodeId _M_id;
+        IRunnable* _M_task;
+        std::string _M_name;
+        bool _M_autoDelete;
+        std::vector<_T_Node*> _M_successors;
+        size_t _M_numPredecessors;
+        size_t _M_pending;
+        ElsUint64 _M_duration;
+        ElsUint64 _M_pathTime;
+        _T_Node* _M_pathPrev;
+        friend class TaskGraph;
+        ELS_CLASS_UNCOPYABLE(_T_Node);
+    };
+
+    typedef std::vector<_T_Node*> _T_NodeList;
+
+    ThreadPool& _M_pool;
+    _T_NodeList _M_nodes;
+    _T_NodeList _M_order;
+    _T_NodeList _M_roots;
+    bool _M_prepared;
+    bool _M_running;
+    size_t _M_remaining;
+    bool _M_finished;
+    Mutex _M_mutex;
+    Condition _M_cond;
+    ElsUint64 _M_lastRunTime;
+    _T_Node* _M_criticalEnd;
+
+    _T_Node* _M_node(NodeId node) const;
+    void _M_prepare(void);
+    void _M_runSerial(void);
+    void _M_schedule(_T_Node* node);
+    void _M_finishNode(void);
+    void _M_computeCriticalPath(void);
+
+    ELS_CLASS_UNCOPYABLE(TaskGraph);
+};
+
+ELS_END_NAMESPACE_2
+
@@ -23,52 +23,660 @@
 #pragma once
 
 #include "Macros.hpp"
+#include "Types.hpp"
 #include "IRunnable.hpp"
 #include "IThread.hpp"
+#include "Mutex.hpp"
+#include "Condition.hpp"
+#include "Atomic.hpp"
+#include "MpmcQueue.hpp"
+#include "Future.hpp"
+#include "CancelToken.hpp"
+#include "Timeval.hpp"
+#include "LatencyHistogram.hpp"
 
-#include <list>
+#include <string>
 #include <vector>
-#include <utility>
+#include <new>
 
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
+ELS_BEGIN_NAMESPACE_1(__pool_detail)
+
+template <typename Function> class ELS_EXPORT_SYMBOL FunctionTask
+    : public IRunnable
+{
+public:
+
+    explicit FunctionTask(const Function& fn) : IRunnable(), _M_fn(fn) {}
+
+    virtual void run(void) throw()
+    {
+        this->_M_fn();
+    }
+
+private:
+
+    Function _M_fn;
+};
+
+ELS_END_NAMESPACE_1
+
 class ThreadPool
 {
 public:
 
+    /**
+     * @brief   Decides how scheduled tasks are distributed among workers.
+     *
+     * SCHEDULE_SHARED_QUEUE - all tasks go to a single FIFO queue.
+     *
+     * SCHEDULE_WORK_STEALING - every worker owns a local deque. Tasks
+     * scheduled from a worker thread are pushed to its deque and popped
+     * in LIFO order, idle workers steal from the other end (FIFO) of
+     * their peers' deques. Tasks scheduled from outside the pool
+     * go to the shared queue.
+     */
+    enum SchedulingMode
+    {
+        SCHEDULE_SHARED_QUEUE = 0,
+        SCHEDULE_WORK_STEALING,
+    };
+
+    /**
+     * @brief   Decides what schedule() does when a bounded queue is full.
+     *
+     * OVERFLOW_BLOCK - wait until a worker frees a slot.
+     *
+     * OVERFLOW_FAIL - reject the task, schedule() returns false.
+     *
+     * OVERFLOW_DROP_OLDEST - discard the task at the front of the queue
+     * to make room for the new one.
+     *
+     * OVERFLOW_CALLER_RUNS - run the task in the calling thread.
+     */
+    enum OverflowPolicy
+    {
+        OVERFLOW_BLOCK = 0,
+        OVERFLOW_FAIL,
+        OVERFLOW_DROP_OLDEST,
+        OVERFLOW_CALLER_RUNS,
+    };
+
+    /**
+     * @brief   Decides what a worker does when it runs out of tasks.
+     *
+     * IDLE_BLOCK - sleep on a condition variable right away. Cheapest
+     * in CPU time, but every wakeup costs a round trip through the kernel.
+     *
+     * IDLE_SPIN_THEN_PARK - poll the queues for up to the maximum spin
+     * time first, yielding the CPU during the second half, then sleep.
+     *
+     * IDLE_ADAPTIVE - like IDLE_SPIN_THEN_PARK, but every worker spins for
+     * about twice the recent average time between running out of work
+     * and getting a new task. If tasks arrive less often than the maximum
+     * spin time, workers go to sleep immediately.
+     *
+     * IDLE_BUSY_POLL - never sleep. Only meant for pools with dedicated
+     * CPUs, workers of an elastic pool never retire in this mode.
+     */
+    enum IdleStrategy
+    {
+        IDLE_BLOCK = 0,
+        IDLE_SPIN_THEN_PARK,
+        IDLE_ADAPTIVE,
+        IDLE_BUSY_POLL,
+    };
+
+    /**
+     * @brief   How workers are pinned to CPUs.
+     *
+     * AFFINITY_NONE - workers inherit the affinity of the thread calling
+     * start() and the kernel is free to migrate them.
+     *
+     * AFFINITY_COMPACT - every worker gets a single CPU, SMT siblings
+     * and cores of the same package are filled first. Suits workers
+     * sharing data.
+     *
+     * AFFINITY_SCATTER - every worker gets a single CPU, spreading
+     * workers over NUMA nodes and physical cores before using SMT
+     * siblings. Suits independent, memory-bound tasks.
+     *
+     * AFFINITY_EXPLICIT - workers are pinned in turn to the CPUs passed
+     * to setAffinity().
+     *
+     * With more workers than CPUs the order wraps around.
+     */
+    enum AffinityPolicy
+    {
+        AFFINITY_NONE = 0,
+        AFFINITY_COMPACT,
+        AFFINITY_SCATTER,
+        AFFINITY_EXPLICIT,
+    };
+
+    /**
+     * @brief   Scheduling attributes of a single task.
+     *
+     * Priority 0 is the most urgent one. Priorities above the number
+     * of configured levels are clamped to the least urgent level, which
+     * is also the default. Group is an identifier returned
+     * by addTaskGroup(), 0 being the default group.
+     *
+     * A task whose deadline has passed or whose cancellation token has
+     * been cancelled by the time a worker dequeues it is discarded
+     * without being run.
+     */
+    class TaskAttr
+    {
+    public:
+        ELS_EXPORT_SYMBOL static const unsigned PRIORITY_LOWEST;
+
+        ELS_EXPORT_SYMBOL TaskAttr(void);
+        ELS_EXPORT_SYMBOL TaskAttr& setPriority(unsigned priority);
+        ELS_EXPORT_SYMBOL TaskAttr& setGroup(unsigned group);
+        ELS_EXPORT_SYMBOL TaskAttr& setDeadline(ElsUint64 deadline);
+        ELS_EXPORT_SYMBOL TaskAttr& setTimeout(const misc::Timeval& timeout);
+        ELS_EXPORT_SYMBOL TaskAttr& setCancelToken(const CancelToken& token);
+        ELS_EXPORT_SYMBOL unsigned priority(void) const;
+        ELS_EXPORT_SYMBOL unsigned group(void) const;
+        ELS_EXPORT_SYMBOL ElsUint64 deadline(void) const;
+        ELS_EXPORT_SYMBOL const CancelToken& cancelToken(void) const;
+
+    private:
+        unsigned _M_priority;
+        unsigned _M_group;
+        ElsUint64 _M_deadline;
+        CancelToken _M_token;
+    };
+
+    /**
+     * @brief   Change in the number of workers of an elastic pool.
+     */
+    struct ResizeEvent
+    {
+        /** Time of the change as returned by sys::monotonicNs(). */
+        ElsUint64 timestamp;
+        /** Number of workers after the change. */
+        size_t workers;
+        /** True if a worker was spawned, false if one retired. */
+        bool grown;
+        /** Queue wait in nanoseconds which caused the pool to grow. */
+        ElsUint64 queueWait;
+    };
+
+    /**
+     * @brief   Counters of a single worker, see stats().
+     */
+    struct WorkerStats
+    {
+        /** Number of tasks run, not including discarded ones. */
+        ElsUint64 tasksRun;
+        /** Number of tasks taken from other workers' deques. */
+        ElsUint64 steals;
+        /** Time spent running tasks in nanoseconds. */
+        ElsUint64 busyNs;
+        /** Time spent waiting for new tasks in nanoseconds. */
+        ElsUint64 idleNs;
+        /** Largest number of tasks seen in the worker's deque. */
+        size_t localHighWater;
+        /** Time from scheduling a task to its start. */
+        misc::LatencyHistogram waitLatency;
+        /** Execution time of tasks. */
+        misc::LatencyHistogram runTime;
+
+        ELS_EXPORT_SYMBOL WorkerStats(void);
+        ELS_EXPORT_SYMBOL double busyRatio(void) const;
+    };
+
+    /**
+     * @brief   Snapshot of the pool's instrumentation, see stats().
+     */
+    struct Stats
+    {
+        /** Number of pending tasks, see queueDepth(). */
+        size_t queueDepth;
+        /** Largest number of tasks seen in the shared queue. */
+        size_t queueHighWater;
+        /** Counters of all workers added together. */
+        WorkerStats total;
+        /** Counters of every worker that has ever been started. */
+        std::vector<WorkerStats> workers;
+    };
+
     ELS_EXPORT_SYMBOL static const size_t DEF_NUM_THREADS;
+    ELS_EXPORT_SYMBOL static const size_t AUTO_NUM_THREADS;
+    ELS_EXPORT_SYMBOL static const size_t MAX_RESIZE_EVENTS;
 
-    ELS_EXPORT_SYMBOL ThreadPool(void);
+    ELS_EXPORT_SYMBOL explicit ThreadPool(
+            SchedulingMode mode = SCHEDULE_SHARED_QUEUE);
     ELS_EXPORT_SYMBOL virtual ~ThreadPool(void);
 
-    ELS_EXPORT_SYMBOL void schedule(IRunnable* task, bool autoDelete = false);
-    ELS_EXPORT_SYMBOL void start(size_t numJobs = DEF_NUM_THREADS);
+    ELS_EXPORT_SYMBOL SchedulingMode schedulingMode(void) const;
+
+    ELS_EXPORT_SYMBOL void setQueueLimit(size_t capacity,
+            OverflowPolicy policy = OVERFLOW_BLOCK);
+    ELS_EXPORT_SYMBOL size_t queueLimit(void) const;
+    ELS_EXPORT_SYMBOL OverflowPolicy overflowPolicy(void) const;
+    ELS_EXPORT_SYMBOL size_t queueDepth(void) const;
+    ELS_EXPORT_SYMBOL size_t droppedTasks(void) const;
+    ELS_EXPORT_SYMBOL size_t cancelledTasks(void) const;
+    ELS_EXPORT_SYMBOL size_t expiredTasks(void) const;
+    ELS_EXPORT_SYMBOL static bool cancellationRequested(void);
+
+    ELS_EXPORT_SYMBOL void setPriorityLevels(unsigned levels);
+    ELS_EXPORT_SYMBOL unsigned priorityLevels(void) const;
+    ELS_EXPORT_SYMBOL void setAgingThreshold(const misc::Timeval& threshold);
+    ELS_EXPORT_SYMBOL misc::Timeval agingThreshold(void) const;
+    ELS_EXPORT_SYMBOL unsigned addTaskGroup(const std::string& name,
+            unsigned weight);
+    ELS_EXPORT_SYMBOL unsigned taskGroup(const std::string& name) const;
+    ELS_EXPORT_SYMBOL misc::LatencyHistogram waitLatency(
+            unsigned priority) const;
+    ELS_EXPORT_SYMBOL Stats stats(void) const;
+    ELS_EXPORT_SYMBOL void resetStats(void);
+
+    ELS_EXPORT_SYMBOL bool schedule(IRunnable* task, bool autoDelete = false);
+    ELS_EXPORT_SYMBOL bool schedule(IRunnable* task, const TaskAttr& attr,
+            bool autoDelete = false);
+    ELS_EXPORT_SYMBOL size_t scheduleBatch(IRunnable* const* tasks,
+            size_t count, bool autoDelete = false);
+
+    /**
+     * @brief   Queues all tasks from a range of IRunnable pointers.
+     * @param   first       Beginning of the range.
+     * @param   last        End of the range.
+     * @param   autoDelete  If true, the tasks are deleted after they have
+     *                      run or have been discarded.
+     * @return  Number of tasks queued, see the array version.
+     */
+    template <typename Iterator> size_t scheduleBatch(Iterator first,
+            Iterator last, bool autoDelete = false)
+    {
+        IRunnable* chunk[_S_BATCH_CHUNK];
+        size_t count = 0;
+        size_t done = 0;
+        size_t queued = 0;
+
+        while (first != last)
+        {
+            chunk[count++] = *first++;
+            if ((count == _S_BATCH_CHUNK) || (first == last))
+            {
+                done = this->scheduleBatch(chunk, count, autoDelete);
+                queued += done;
+                if (done < count)
+                    break;
+                count = 0;
+            }
+        }
+
+        return queued;
+    }
+
+    /**
+     * @brief   Queues a copy of a function object for execution.
+     * @param   fn          Function or function object callable with
+     *                      no arguments. Must not throw.
+     * @return  See schedule().
+     *
+     * Function objects which fit in _S_INLINE_SIZE bytes are stored
+     * in the pool's own task node, so once the pool has warmed up this
+     * doesn't allocate any memory. Larger ones are copied to the heap.
+     */
+    template <typename Function> bool execute(Function fn)
+    {
+        return this->_M_execute(fn, 0);
+    }
+
+    /**
+     * @brief   Queues a copy of a function object with given attributes.
+     * @param   fn          Function or function object callable with
+     *                      no arguments. Must not throw.
+     * @param   attr        Scheduling attributes.
+     * @return  See schedule().
+     * @throw   InvalidArgument     If the task group doesn't exist.
+     */
+    template <typename Function> bool execute(Function fn,
+            const TaskAttr& attr)
+    {
+        return this->_M_execute(fn, &attr);
+    }
+
+    /**
+     * @brief   Queues a task producing a result.
+     * @param   callable    Task to run.
+     * @param   autoDelete  If true, callable is deleted after it has run
+     *                      or has been discarded.
+     * @return  Future which becomes ready once the task has run. If the
+     *          task is rejected or discarded because the queue is full,
+     *          the future fails with TaskFailed.
+     */
+    template <typename T> Future<T> submit(ICallable<T>* callable,
+            bool autoDelete = false)
+    {
+        __future_detail::CallTask<T>* task
+                = new __future_detail::CallTask<T>(callable, autoDelete);
+        Future<T> future(task->state());
+
+        if (!this->schedule(task, true))
+            delete task;
+
+        return future;
+    }
+
+    /**
+     * @brief   Queues a task producing a result with given attributes.
+     * @param   callable    Task to run.
+     * @param   attr        Priority and group of the task.
+     * @param   autoDelete  If true, callable is deleted after it has run
+     *                      or has been discarded.
+     * @return  Future which becomes ready once the task has run.
+     * @throw   InvalidArgument     If the task group doesn't exist, in
+     *                              which case callable is deleted if
+     *                              autoDelete is true.
+     */
+    template <typename T> Future<T> submit(ICallable<T>* callable,
+            const TaskAttr& attr, bool autoDelete = false)
+    {
+        __future_detail::CallTask<T>* task
+                = new __future_detail::CallTask<T>(callable, autoDelete);
+        Future<T> future(task->state());
+
+        try
+        {
+            if (!this->schedule(task, attr, true))
+                delete task;
+        }
+        catch (...)
+        {
+            delete task;
+            throw;
+        }
+
+        return future;
+    }
+
+    ELS_EXPORT_SYMBOL void start(size_t numJobs = AUTO_NUM_THREADS);
+    ELS_EXPORT_SYMBOL void start(size_t minJobs, size_t maxJobs);
     ELS_EXPORT_SYMBOL void stop(void);
 
+    ELS_EXPORT_SYMBOL void setIdleStrategy(IdleStrategy strategy,
+            const misc::Timeval& maxSpin = misc::Timeval(0, 50000));
+    ELS_EXPORT_SYMBOL IdleStrategy idleStrategy(void) const;
+
+    ELS_EXPORT_SYMBOL void setAffinity(AffinityPolicy policy,
+            const std::vector<unsigned>& cpus = std::vector<unsigned>());
+    ELS_EXPORT_SYMBOL AffinityPolicy affinityPolicy(void) const;
+
+    ELS_EXPORT_SYMBOL void setGrowThreshold(const misc::Timeval& wait);
+    ELS_EXPORT_SYMBOL void setIdleTimeout(const misc::Timeval& timeout);
+    ELS_EXPORT_SYMBOL size_t numWorkers(void) const;
+    ELS_EXPORT_SYMBOL std::vector<ResizeEvent> resizeEvents(void) const;
+
 private:
 
+    static const size_t _S_INLINE_SIZE = 64;
+
+    union _T_Storage
+    {
+        char bytes[_S_INLINE_SIZE];
+        ElsUint64 align;
+        void* ptr;
+        double dbl;
+    };
+
+    /*
+     * Nodes are recycled through free lists and never copied - runnable
+     * may point into storage.
+     */
+    struct _T_Task
+    {
+        IRunnable* runnable;
+        bool autoDelete;
+        bool inlined;
+        unsigned priority;
+        unsigned group;
+        ElsUint64 enqueued;
+        ElsUint64 deadline;
+        StopToken::_T_State* token;
+        _T_Task* next;
+        _T_Storage storage;
+    };
+
+    class _T_TaskQueue
+    {
+    public:
+        _T_TaskQueue(void);
+        void push(_T_Task* task);
+        _T_Task* front(void) const;
+        _T_Task* pop(void);
+        size_t size(void) const;
+        bool empty(void) const;
+    private:
+        _T_Task* _M_head;
+        _T_Task* _M_tail;
+        size_t _M_size;
+        ELS_CLASS_UNCOPYABLE(_T_TaskQueue);
+    };
+
+    /*
+     * FIFO queues for every combination of priority level and task group.
+     * Levels are served in strict order, groups within a level
+     * get a share proportional to their weight (stride scheduling).
+     * Must be protected by the task mutex except for size() and empty().
+     */
+    class _T_PriorityQueue
+    {
+    public:
+        _T_PriorityQueue(void);
+        ~_T_PriorityQueue(void);
+        void setLevels(unsigned levels);
+        unsigned levels(void) const;
+        void addGroup(unsigned weight);
+        unsigned groups(void) const;
+        void push(_T_Task* task);
+        _T_Task* pop(ElsUint64 agingNs);
+        ElsUint64 oldest(void) const;
+        size_t size(void) const;
+        bool empty(void) const;
+    private:
+        struct _T_Lane
+        {
+            _T_TaskQueue tasks;
+            ElsUint64 pass;
+        };
+        typedef std::vector<_T_Lane*> _T_LaneList;
+        struct _T_Level
+        {
+            _T_LaneList lanes;
+            ElsUint64 vtime;
+            size_t size;
+        };
+        typedef std::vector<_T_Level> _T_LevelList;
+        static const ElsUint64 _S_STRIDE_ONE;
+        _T_LevelList _M_levels;
+        std::vector<ElsUint64> _M_strides;
+        size_t _M_size;
+        _T_Task* _M_take(unsigned level, unsigned group);
+        void _M_clear(void);
+        ELS_CLASS_UNCOPYABLE(_T_PriorityQueue);
+    };
+
+    class _T_LocalQueue;
+
+    typedef std::vector<misc::LatencyHistogram> _T_HistogramList;
+
+    /*
+     * Written only by the owning worker. Padded, so that workers don't
+     * share cache lines with each other or with whatever the allocator
+     * put next to them.
+     */
+    struct _T_WorkerCounters
+    {
+        char pad0[ELS_CACHELINE_SIZE];
+        ElsUint64 tasksRun;
+        ElsUint64 steals;
+        ElsUint64 busyNs;
+        ElsUint64 idleNs;
+        size_t localHighWater;
+        misc::LatencyHistogram waitLatency;
+        misc::LatencyHistogram runTime;
+        _T_HistogramList priorityWait;
+        char pad1[ELS_CACHELINE_SIZE];
+
+        explicit _T_WorkerCounters(unsigned levels);
+        void reset(void);
+        void snapshot(WorkerStats& stats) const;
+    };
+
     class _T_Job : public IThread
     {
     public:
-        explicit _T_Job(ThreadPool* owner);
+        _T_Job(ThreadPool* owner, size_t index);
         virtual ~_T_Job(void);
     protected:
         virtual int _M_run(void);
     private:
         ThreadPool* _M_owner;
+        _T_LocalQueue* _M_localQueue;
+        _T_WorkerCounters* _M_counters;
+        ElsUint32 _M_seed;
+        ElsUint64 _M_avgIdleGap;
+        _T_Task* _M_freeTasks;
+        size_t _M_numFree;
+        ElsUint32 _M_random(void);
+        friend class ThreadPool;
         ELS_CLASS_UNCOPYABLE(_T_Job);
     };
 
-    typedef std::list<std::pair<IRunnable*, bool /* delete */ > > _T_TaskList;
     typedef std::vector<_T_Job*> _T_JobList;
+    typedef MpmcQueue<_T_Task*> _T_RingQueue;
+    typedef std::vector<_T_Task*> _T_SlabList;
+    typedef std::vector<_T_WorkerCounters*> _T_CounterList;
+    typedef std::vector<ResizeEvent> _T_EventList;
+
+    static const size_t _S_BATCH_CHUNK = 64;
+    static const size_t _S_LOCAL_QUEUE_SIZE;
+    static const size_t _S_DEQUEUE_CHUNK = 8;
+    static const size_t _S_SLAB_SIZE;
+    static const size_t _S_TASK_CACHE_SIZE;
+    static const ElsUint64 _S_DEF_AGING_NS;
+    static const ElsUint64 _S_DEF_GROW_THRESHOLD_NS;
+    static const ElsUint64 _S_DEF_IDLE_TIMEOUT_NS;
+    static __thread _T_Job* _S_currentJob;
+    static __thread const _T_Task* _S_currentTask;
 
-    _T_TaskList _M_tasks;
+    const SchedulingMode _M_mode;
+    _T_PriorityQueue _M_tasks;
+    std::vector<std::string> _M_groupNames;
+    ElsUint64 _M_agingNs;
+    _T_RingQueue* _M_ring;
+    OverflowPolicy _M_overflowPolicy;
+    mutable AtomicUint _M_dropped;
+    mutable AtomicUint _M_cancelled;
+    mutable AtomicUint _M_expired;
+    size_t _M_highWater;
+    _T_CounterList _M_counters;
     mutable Mutex _M_taskMutex;
     _T_JobList _M_jobs;
     mutable Mutex _M_jobMutex;
+    mutable Mutex _M_listMutex;
     Condition _M_cond;
+    AtomicUint _M_sleepers;
+    ElsUint32 _M_wakeEpoch;
+    Condition _M_spaceCond;
+    AtomicUint _M_blockedProducers;
+    ElsUint32 _M_spaceEpoch;
+    bool _M_stopping;
+    size_t _M_minJobs;
+    size_t _M_activeJobs;
+    ElsUint64 _M_growThresholdNs;
+    ElsUint64 _M_idleTimeoutNs;
+    IdleStrategy _M_idleStrategy;
+    ElsUint64 _M_maxSpinNs;
+    AffinityPolicy _M_affinityPolicy;
+    std::vector<unsigned> _M_affinityCpus;
+    ElsUint64 _M_lastGrowth;
+    _T_EventList _M_events;
+    size_t _M_eventCount;
+    mutable Mutex _M_eventMutex;
+    _T_Task* _M_freeTasks;
+    _T_SlabList _M_slabs;
+    Mutex _M_freeMutex;
 
+    template <typename Function> bool _M_execute(const Function& fn,
+            const TaskAttr* attr)
+    {
+        typedef __pool_detail::FunctionTask<Function> Task;
+        _T_Task* task = this->_M_newTask(0, false, attr, 0);
+
+        try
+        {
+            if ((sizeof(Task) <= sizeof(_T_Storage))
+                    && (__alignof__(Task) <= __alignof__(_T_Storage)))
+            {
+                task->runnable = new (task->storage.bytes) Task(fn);
+                task->inlined = true;
+            }
+            else
+            {
+                task->runnable = new Task(fn);
+                task->autoDelete = true;
+            }
+        }
+        catch (...)
+        {
+            this->_M_rejectTask(task);
+            throw;
+        }
+
+        if (!this->_M_submit(task, attr == 0))
+        {
+            this->_M_releaseTask(task);
+            return false;
+        }
+
+        return true;
+    }
+
+    ELS_EXPORT_SYMBOL _T_Task* _M_newTask(IRunnable* runnable,
+            bool autoDelete, const TaskAttr* attr, ElsUint64 now);
+    _T_Task* _M_allocTask(void);
+    void _M_freeTask(_T_Task* task);
+    void _M_refillCache(_T_Job* job);
+    void _M_spillCache(_T_Job* job, size_t keep);
+    void _M_addSlab(void);
+    void _M_checkIdle(void) const;
+    size_t _M_queueDepth(void) const;
+    ELS_EXPORT_SYMBOL bool _M_submit(_T_Task* task, bool local);
+    bool _M_pushShared(_T_Task* task);
+    bool _M_pushRing(_T_Task* task);
+    void _M_waitForSpace(void);
+    void _M_notifySpace(void);
+    bool _M_nextTask(_T_Job* job, _T_Task*& task);
+    bool _M_popShared(_T_Job* job, _T_Task*& task);
+    bool _M_steal(_T_Job* job, _T_Task*& task);
+    bool _M_hasWork(void) const;
+    ElsUint64 _M_recordWait(_T_Job* job, const _T_Task& task, ElsUint64 now);
+    void _M_noteDepth(size_t depth);
+    void _M_noteLocalDepth(_T_Job* job);
+    bool _M_elastic(void) const;
+    void _M_checkLoad(ElsUint64 now);
+    void _M_grow(ElsUint64 queueWait);
+    bool _M_retire(void);
+    void _M_addEvent(bool grown, size_t workers, ElsUint64 queueWait);
+    bool _M_runTask(_T_Task* task);
+    ELS_EXPORT_SYMBOL void _M_releaseTask(_T_Task* task);
+    ELS_EXPORT_SYMBOL void _M_rejectTask(_T_Task* task);
+    bool _M_dropStale(_T_Task* task);
+    bool _M_idle(_T_Job* job);
+    bool _M_spin(_T_Job* job, ElsUint64 budget);
+    bool _M_park(void);
+    void _M_notify(size_t count = 1);
+    void _M_flushLocal(_T_Job* job);
     void _M_clearJobs(void);
+    void _M_clearTasks(void);
 
     friend class _T_Job;
 
@@ -76,4 +684,3 @@ private:
 };
 
 ELS_END_NAMESPACE_2
-
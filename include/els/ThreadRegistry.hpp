@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    ThreadRegistry.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+#include "IThread.hpp"
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Process wide list of running IThread threads with their
+ *          CPU usage.
+ *
+ * Threads add themselves when they start running and remove themselves
+ * when _M_run() returns, throws or the thread is cancelled. Statistics
+ * come from /proc/self/task/<tid>, so they're what top and ps would
+ * show, at a cost of a few file reads per thread. Taking a snapshot
+ * doesn't block the registered threads.
+ */
+class ThreadRegistry
+{
+public:
+
+    /**
+     * @brief   State and CPU usage of a single thread.
+     */
+    struct ThreadInfo
+    {
+        ELS_EXPORT_SYMBOL ThreadInfo(void);
+
+        ::pid_t tid;
+        /** Kernel name, set by INamedThread. */
+        std::string name;
+        IThread::ThreadState state;
+        /** Time spent in user mode, clock tick resolution. */
+        ElsUint64 userNs;
+        /** Time spent in the kernel, clock tick resolution. */
+        ElsUint64 systemNs;
+        /**
+         * Total time on CPU, with nanosecond resolution where
+         * the kernel provides schedstat, otherwise userNs + systemNs.
+         */
+        ElsUint64 cpuNs;
+        ElsUint64 voluntarySwitches;
+        ElsUint64 involuntarySwitches;
+    };
+
+    ELS_EXPORT_SYMBOL static std::vector<ThreadInfo> snapshot(void);
+    ELS_EXPORT_SYMBOL static size_t size(void);
+    ELS_EXPORT_SYMBOL static ElsUint64 currentCpuNs(void);
+
+private:
+
+    static void _S_add(IThread* thread);
+    static void _S_remove(IThread* thread);
+    static bool _S_readStats(ThreadInfo& info);
+
+    friend class IThread;
+
+    ELS_CLASS_NOT_INSTANTIABLE(ThreadRegistry);
+};
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    TicketLock.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   FIFO spinlock handing out tickets.
+ *
+ * lock() draws the next ticket and waits until it's being served,
+ * unlock() serves the next one. Threads get the lock in the order they
+ * asked for it, nobody starves. All waiters still watch the same cache
+ * line, which every unlock() invalidates - see McsLock for a lock with
+ * local spinning.
+ *
+ * Waiters spin for a time proportional to their place in the queue and
+ * yield the CPU when their turn doesn't come, so a preempted holder
+ * doesn't stall everyone for a whole time slice. Meant for short
+ * critical sections. Not recursive, no error checking.
+ */
+class TicketLock
+{
+public:
+
+    ELS_EXPORT_SYMBOL TicketLock(void) throw();
+    ELS_EXPORT_SYMBOL ~TicketLock(void) throw();
+
+    /**
+     * @brief   Acquires the lock, waiting for the threads queued before.
+     */
+    void lock(void) throw()
+    {
+        unsigned ticket = __atomic_fetch_add(&this->_M_next, 1,
+                __ATOMIC_RELAXED);
+
+        if (__atomic_load_n(&this->_M_serving, __ATOMIC_ACQUIRE) != ticket)
+            this->_M_wait(ticket);
+    }
+
+    /**
+     * @brief   Acquires the lock if nobody holds or waits for it.
+     * @return  True if the lock has been acquired.
+     */
+    bool trylock(void) throw()
+    {
+        unsigned serving = __atomic_load_n(&this->_M_serving,
+                __ATOMIC_ACQUIRE);
+        unsigned expected = serving;
+
+        return __atomic_compare_exchange_n(&this->_M_next, &expected,
+                serving + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * @brief   Releases the lock to the next thread in line.
+     */
+    void unlock(void) throw()
+    {
+        /* Only the holder writes _M_serving. */
+        __atomic_store_n(&this->_M_serving,
+                __atomic_load_n(&this->_M_serving, __ATOMIC_RELAXED) + 1,
+                __ATOMIC_RELEASE);
+    }
+
+private:
+
+    unsigned _M_next;
+    unsigned _M_serving;
+
+    ELS_EXPORT_SYMBOL void _M_wait(unsigned ticket) throw();
+
+    ELS_CLASS_UNCOPYABLE(TicketLock);
+};
+
+ELS_END_NAMESPACE_2
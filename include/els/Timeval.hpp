@@ -52,6 +52,11 @@ public:
     ELS_EXPORT_SYMBOL void toTimeval(::timeval& tv) const throw();
     ELS_EXPORT_SYMBOL void toTimespec(::timespec& ts) const throw();
 
+    ELS_EXPORT_SYMBOL Timeval& operator +=(const Timeval& other) throw();
+    ELS_EXPORT_SYMBOL bool operator <(const Timeval& other) const throw();
+
+    ELS_EXPORT_SYMBOL static Timeval now(void) throw();
+
 private:
 
     static ElsInt32& _S_checkNsec(ElsInt32& nsec);
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    TreiberStack.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "HazardPointer.hpp"
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Unbounded lock-free LIFO stack.
+ *
+ * Classic Treiber stack - push() and pop() swing the top pointer with
+ * a compare-and-swap. Popped nodes are reclaimed through hazard
+ * pointers, which also protects pop() from the ABA problem.
+ */
+template <typename T> class ELS_EXPORT_SYMBOL TreiberStack
+{
+public:
+
+    /**
+     * @brief   Constructor.
+     */
+    TreiberStack(void)
+        : _M_top(0),
+          _M_domain()
+    {
+
+    }
+
+    /**
+     * @brief   Destructor. Must not run concurrently with other calls.
+     */
+    ~TreiberStack(void)
+    {
+        _T_Node* node = this->_M_top;
+        _T_Node* next = 0;
+
+        while (node != 0)
+        {
+            next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    /**
+     * @brief   Puts an element on top of the stack.
+     * @param   val     Element to store.
+     */
+    void push(const T& val)
+    {
+        _T_Node* node = new _T_Node(val);
+
+        node->next = __atomic_load_n(&this->_M_top, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&this->_M_top, &node->next,
+                node, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    /**
+     * @brief   Removes the element from the top of the stack.
+     * @param   val     Reference to which the element will be assigned.
+     * @return  True if an element has been retrieved, false if the stack
+     *          is empty.
+     */
+    bool pop(T& val)
+    {
+        HazardPointer hazard(this->_M_domain);
+        _T_Node* top = 0;
+
+        for (;;)
+        {
+            top = hazard.protect(&this->_M_top);
+            if (top == 0)
+                return false;
+
+            /* top->next can't change while top is still the top. */
+            if (__atomic_compare_exchange_n(&this->_M_top, &top, top->next,
+                    true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                break;
+        }
+
+        val = top->data;
+        hazard.reset();
+        hazard.retire(top, &_S_deleteNode);
+        return true;
+    }
+
+    /**
+     * @brief   Checks if the stack is empty. Only a snapshot if other
+     *          threads use the stack concurrently.
+     * @return  True if there are no elements on the stack.
+     */
+    bool empty(void) const throw()
+    {
+        return __atomic_load_n(&this->_M_top, __ATOMIC_RELAXED) == 0;
+    }
+
+    /**
+     * @brief   Returns the number of popped nodes not freed yet.
+     * @return  Number of nodes waiting for reclamation.
+     */
+    size_t pendingReclaim(void) const throw()
+    {
+        return this->_M_domain.pending();
+    }
+
+private:
+
+    struct _T_Node
+    {
+        explicit _T_Node(const T& val) : data(val), next(0) {}
+
+        T data;
+        _T_Node* next;
+    };
+
+    static void _S_deleteNode(void* node)
+    {
+        delete static_cast<_T_Node*>(node);
+    }
+
+    _T_Node* _M_top;
+    HazardDomain _M_domain;
+
+    ELS_CLASS_UNCOPYABLE(TreiberStack<T>);
+};
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    Watchdog.hpp
+ */
+
+#pragma once
+
+#include "Macros.hpp"
+#include "Types.hpp"
+#include "INamedThread.hpp"
+#include "Mutex.hpp"
+#include "Condition.hpp"
+#include "Timeval.hpp"
+#include "Logger.hpp"
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Detects threads which stopped making progress.
+ *
+ * Every monitored thread gets a heartbeat slot and calls beat() at
+ * least once per its period. The watchdog thread wakes up every check
+ * interval and in a single pass over the slots looks for the ones
+ * which haven't been touched for longer than their period. Every stall
+ * is reported once, a thread which beats again is considered healthy
+ * and can stall again.
+ *
+ * Stalls are detected with the accuracy of the check interval, which
+ * should be a fraction of the shortest period.
+ */
+class Watchdog : public INamedThread
+{
+private:
+
+    /*
+     * Slots are a cache line apart, so that monitored threads never
+     * write to the same line. Only alive is written by the monitored
+     * thread, the rest belongs to the watchdog and is accessed under
+     * its mutex.
+     */
+    struct _T_Slot
+    {
+        ElsUint64 periodNs;
+        ElsUint64 lastSeen;
+        int alive;
+        int used;
+        int stalled;
+        ::pid_t tid;
+        char pad[ELS_CACHELINE_SIZE - 2 * sizeof(ElsUint64)
+                - 3 * sizeof(int) - sizeof(::pid_t)];
+    };
+
+public:
+
+    /**
+     * @brief   What happens when a stall is detected, can be combined.
+     *
+     * ACTION_DUMP_STACK makes the stalled thread print its backtrace
+     * to stderr from a signal handler, so it only helps for threads
+     * which are spinning or blocked in an interruptible call.
+     * ACTION_ABORT aborts the process after the other actions.
+     */
+    enum Action
+    {
+        ACTION_LOG = 1 << 0,
+        ACTION_CALLBACK = 1 << 1,
+        ACTION_DUMP_STACK = 1 << 2,
+        ACTION_ABORT = 1 << 3,
+    };
+
+    struct StallInfo
+    {
+        std::string name;
+        ::pid_t tid;
+        /** Time since the last heartbeat seen. */
+        ElsUint64 stalledNs;
+        ElsUint64 periodNs;
+    };
+
+    class StallHandler
+    {
+    public:
+
+        ELS_EXPORT_SYMBOL virtual ~StallHandler(void);
+
+        virtual void onStall(const StallInfo& info) throw() = 0;
+    };
+
+    /**
+     * @brief   Handle used by a monitored thread to report progress.
+     *
+     * Copyable, a default constructed handle ignores beats.
+     */
+    class Heartbeat
+    {
+    public:
+
+        Heartbeat(void) : _M_slot(0) {}
+
+        /** A single relaxed store, safe to call in hot loops. */
+        void beat(void) const throw()
+        {
+            if (this->_M_slot != 0)
+                __atomic_store_n(&this->_M_slot->alive, 1, __ATOMIC_RELAXED);
+        }
+
+        bool valid(void) const throw() { return this->_M_slot != 0; }
+
+    private:
+
+        explicit Heartbeat(_T_Slot* slot) : _M_slot(slot) {}
+
+        _T_Slot* _M_slot;
+
+        friend class Watchdog;
+    };
+
+    ELS_EXPORT_SYMBOL static const size_t DEF_CAPACITY;
+
+    ELS_EXPORT_SYMBOL explicit Watchdog(size_t capacity = DEF_CAPACITY,
+            const misc::Timeval& interval = misc::Timeval(0, 10000000));
+    ELS_EXPORT_SYMBOL virtual ~Watchdog(void);
+
+    ELS_EXPORT_SYMBOL Heartbeat add(const std::string& name,
+            const misc::Timeval& period);
+    ELS_EXPORT_SYMBOL void remove(Heartbeat& heartbeat);
+    ELS_EXPORT_SYMBOL void setActions(unsigned actions);
+    ELS_EXPORT_SYMBOL void setStallHandler(StallHandler* handler);
+    ELS_EXPORT_SYMBOL void setLogger(log::Logger* logger);
+    ELS_EXPORT_SYMBOL void setDumpSignal(int signo);
+    ELS_EXPORT_SYMBOL size_t check(void);
+    ELS_EXPORT_SYMBOL size_t stalls(void) const;
+
+protected:
+
+    ELS_EXPORT_SYMBOL virtual int _M_run(void);
+
+private:
+
+    _T_Slot* _M_slots;
+    std::vector<std::string> _M_names;
+    size_t _M_capacity;
+    ElsUint64 _M_intervalNs;
+    unsigned _M_actions;
+    StallHandler* _M_handler;
+    log::Logger* _M_logger;
+    int _M_dumpSignal;
+    size_t _M_stalls;
+    mutable Mutex _M_mutex;
+    Mutex _M_sleepMutex;
+    Condition _M_sleepCond;
+
+    void _M_report(const StallInfo& info, unsigned actions,
+            StallHandler* handler, log::Logger* logger, int signo);
+
+    static void _S_dumpStack(int signo);
+
+    ELS_CLASS_UNCOPYABLE(Watchdog);
+};
+
+ELS_END_NAMESPACE_2
@@ -31,19 +31,40 @@ ELS_BEGIN_NAMESPACE_2(els, thread)
  * @throw   MutexError  Propagated from Mutex::lock().
  */
 AutoMutex::AutoMutex(Mutex& mutexRef)
-    : _M_mutexRef(mutexRef)
+    : _M_mutex(&mutexRef),
+      _M_fastMutex(0)
 {
-    this->_M_mutexRef.lock();
+    this->_M_mutex->lock();
+}
+
+/**
+ * @brief   The constructor. It immediately locks the mutex
+ *          at construction.
+ * @param   mutexRef    Reference to a fast mutex object.
+ * @throw   FastMutexError  Propagated from FastMutex::lock().
+ */
+AutoMutex::AutoMutex(FastMutex& mutexRef)
+    : _M_mutex(0),
+      _M_fastMutex(&mutexRef)
+{
+    this->_M_fastMutex->lock();
 }
 
 /**
  * @brief   The destructor. It releases the mutex upon destruction
- *          of the object. MutexError thrown by Mutex::unlock()
- *          will be ignored if caught.
+ *          of the object. Errors thrown by unlock() will be ignored
+ *          if caught.
  */
 AutoMutex::~AutoMutex(void) throw()
 {
-    try { this->_M_mutexRef.unlock(); } catch (...) {}
+    try
+    {
+        if (this->_M_mutex != 0)
+            this->_M_mutex->unlock();
+        else
+            this->_M_fastMutex->unlock();
+    }
+    catch (...) {}
 }
 
 ELS_END_NAMESPACE_2
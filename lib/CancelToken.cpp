@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    CancelToken.cpp
+ */
+
+#include <els/CancelToken.hpp>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Creates a new token, which is not cancelled.
+ */
+CancelToken::CancelToken(void)
+    : _M_token()
+{
+
+}
+
+/**
+ * @brief   Creates a token cancelled when a stop is requested on token.
+ * @param   token       Stop token to share the state with.
+ */
+CancelToken::CancelToken(const StopToken& token)
+    : _M_token(token)
+{
+
+}
+
+/**
+ * @brief   Cancels this token and all its copies, running the callbacks
+ *          registered on stopToken(). Cancelling a token more than once
+ *          has no effect.
+ */
+void CancelToken::cancel(void)
+{
+    this->_M_token.requestStop();
+}
+
+/**
+ * @brief   Checks if the token has been cancelled.
+ * @return  True if cancel() has been called on this token or its copies.
+ */
+bool CancelToken::cancelled(void) const throw()
+{
+    return this->_M_token.stopRequested();
+}
+
+/**
+ * @brief   Returns the stop token sharing the state of this token.
+ * @return  Token to register stop callbacks on.
+ */
+const StopToken& CancelToken::stopToken(void) const throw()
+{
+    return this->_M_token;
+}
+
+/*
+ * Only ThreadPool creates tokens without state, see StopToken.
+ */
+CancelToken::CancelToken(StopToken::_T_State* state)
+    : _M_token(state)
+{
+
+}
+
+ELS_END_NAMESPACE_2
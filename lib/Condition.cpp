@@ -122,6 +122,61 @@ void Condition::block(const misc::Timeval& tv, bool throwOnTimeout)
     this->_M_unlockMutex();
 }
 
+/**
+ * @brief   Atomically releases the mutex and blocks current thread until
+ *          it's unblocked by another. The mutex is re-acquired before
+ *          returning.
+ * @param   mutex           Mutex locked by the calling thread.
+ * @throw   ConditionError  If something goes wrong with internal
+ *                          pthread function calls.
+ *
+ * All threads waiting on a condition variable at the same time must
+ * use the same mutex - the internal one or an external one, never both.
+ */
+void Condition::block(Mutex& mutex)
+{
+    int ret = ::pthread_cond_wait(&this->_M_cond, &mutex._M_mutex);
+    if (ret != 0)
+        throw ConditionError(
+                "Error locking on condition variable: %s",
+                except::getErrnoStr(ret).c_str());
+}
+
+/**
+ * @brief   Atomically releases the mutex and blocks current thread until
+ *          it's unblocked by another or specified timeout expires.
+ *          The mutex is re-acquired before returning.
+ * @param   mutex           Mutex locked by the calling thread.
+ * @param   tv              Time after which thread will wake up.
+ * @param   throwOnTimeout  Indicates whether an exception should be thrown
+ *                          after reaching the timeout.
+ * @throw   ConditionError  If something goes wrong with internal
+ *                          pthread function calls.
+ * @throw   CondTimedout    Timeout passed and throwOnTimeout was set to true.
+ */
+void Condition::block(Mutex& mutex, const misc::Timeval& tv,
+        bool throwOnTimeout)
+{
+    int ret = 0;
+    ::timespec ts;
+
+    tv.toTimespec(ts);
+    ret = ::pthread_cond_timedwait(&this->_M_cond, &mutex._M_mutex, &ts);
+    if (ret != 0)
+    {
+        if (ret == ETIMEDOUT)
+        {
+            if (throwOnTimeout)
+                throw CondTimedOut("Conditional wait timed out");
+            else
+                return;
+        }
+        throw ConditionError(
+                "Error locking on condition variable: %s",
+                except::getErrnoStr(ret).c_str());
+    }
+}
+
 /**
  * @brief   Unblocks a single thread blocked on this condition variable.
  *          Internal pthread mechanisms decide which thread shall
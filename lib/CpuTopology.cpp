@@ -0,0 +1,651 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    CpuTopology.cpp
+ */
+
+#include <els/CpuTopology.hpp>
+#include <els/Exception.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+
+ELS_BEGIN_NAMESPACE_2(els, sys)
+
+namespace {
+
+typedef CpuTopology::Cpu Cpu;
+typedef CpuTopology::Cache Cache;
+typedef CpuTopology::CpuList CpuList;
+
+/*
+ * Sysfs attributes are tiny, a single read is enough.
+ */
+bool readFile(const std::string& path, std::string& contents)
+{
+    char buf[4096];
+    size_t len = 0;
+    std::FILE* file = ::fopen(path.c_str(), "r");
+
+    if (file == 0)
+        return false;
+
+    len = ::fread(buf, 1, sizeof(buf) - 1, file);
+    ::fclose(file);
+    buf[len] = '\0';
+    while ((len > 0) && ::isspace(static_cast<unsigned char>(buf[len - 1])))
+        buf[--len] = '\0';
+
+    contents = buf;
+    return true;
+}
+
+unsigned readUnsigned(const std::string& path, unsigned def)
+{
+    std::string str;
+    char* end = 0;
+    unsigned long val = 0;
+
+    if (!readFile(path, str) || str.empty())
+        return def;
+
+    val = ::strtoul(str.c_str(), &end, 10);
+    return *end == '\0' ? static_cast<unsigned>(val) : def;
+}
+
+/* Cache sizes look like "32K" or "8M". */
+size_t parseSize(const std::string& str)
+{
+    char* end = 0;
+    size_t size = ::strtoul(str.c_str(), &end, 10);
+
+    switch (*end)
+    {
+    case 'K': return size << 10;
+    case 'M': return size << 20;
+    case 'G': return size << 30;
+    default: return size;
+    }
+}
+
+std::string cpuDir(const std::string& root, unsigned id)
+{
+    char buf[32];
+
+    ::snprintf(buf, sizeof(buf), "/cpu%u", id);
+    return root + "/devices/system/cpu" + buf;
+}
+
+/* Siblings next to each other, then cores, packages and nodes. */
+bool compactLess(const Cpu& a, const Cpu& b)
+{
+    if (a.node != b.node)
+        return a.node < b.node;
+    if (a.package != b.package)
+        return a.package < b.package;
+    if (a.core != b.core)
+        return a.core < b.core;
+    return a.id < b.id;
+}
+
+bool sameCore(const Cpu& a, const Cpu& b)
+{
+    return (a.package == b.package) && (a.core == b.core);
+}
+
+/*
+ * The process's cgroup in the hierarchy the controller is attached to,
+ * relative to its mount point. An empty controller stands for the unified
+ * (v2) hierarchy. Returns an empty string for the root cgroup.
+ */
+std::string cgroupPath(const std::string& controller)
+{
+    char line[4096];
+    std::string str;
+    std::string path;
+    size_t first = 0;
+    size_t second = 0;
+    bool found = false;
+    std::FILE* file = ::fopen("/proc/self/cgroup", "r");
+
+    if (file == 0)
+        return path;
+
+    /* "<id>:<controller,...>:<path>" */
+    while (!found && (::fgets(line, sizeof(line), file) != 0))
+    {
+        str = line;
+        first = str.find(':');
+        second = str.find(':', first == std::string::npos ? 0 : first + 1);
+        if ((first == std::string::npos) || (second == std::string::npos))
+            continue;
+
+        str = "," + str.substr(first + 1, second - first - 1) + ",";
+        found = controller.empty() ? (str == ",,")
+                : (str.find("," + controller + ",") != std::string::npos);
+        if (found)
+            path = std::string(line).substr(second + 1);
+    }
+    ::fclose(file);
+
+    while (!path.empty() && ((path[path.size() - 1] == '/')
+            || ::isspace(static_cast<unsigned char>(path[path.size() - 1]))))
+        path.erase(path.size() - 1);
+
+    return path;
+}
+
+/* Returns 0.0 if the cgroup doesn't limit the CPU time. */
+double readQuota(const std::string& dir, bool unified)
+{
+    std::string str;
+    double quota = 0.0;
+    double period = 0.0;
+
+    if (unified)
+    {
+        /* "max 100000" or "<quota> <period>" */
+        if (!readFile(dir + "/cpu.max", str)
+                || (::sscanf(str.c_str(), "%lf %lf", &quota, &period) != 2))
+            return 0.0;
+    }
+    else
+    {
+        if (!readFile(dir + "/cpu.cfs_quota_us", str))
+            return 0.0;
+        quota = ::strtod(str.c_str(), 0);
+        if (readFile(dir + "/cpu.cfs_period_us", str))
+            period = ::strtod(str.c_str(), 0);
+    }
+
+    return (quota > 0.0) && (period > 0.0) ? quota / period : 0.0;
+}
+
+/*
+ * The limits of all the ancestors apply too, so the whole path up to
+ * the mount point is walked and the tightest limit is returned.
+ */
+double cgroupQuota(const std::string& mount, std::string path, bool unified)
+{
+    double limit = 0.0;
+    double quota = 0.0;
+    size_t pos = 0;
+
+    for (;;)
+    {
+        quota = readQuota(mount + path, unified);
+        if ((quota > 0.0) && ((limit == 0.0) || (quota < limit)))
+            limit = quota;
+        if (path.empty())
+            return limit;
+
+        pos = path.rfind('/');
+        path.erase(pos == std::string::npos ? 0 : pos);
+    }
+}
+
+struct ScatterKey
+{
+    unsigned thread;
+    unsigned core;
+    unsigned node;
+    unsigned id;
+
+    bool operator <(const ScatterKey& other) const
+    {
+        if (this->thread != other.thread)
+            return this->thread < other.thread;
+        if (this->core != other.core)
+            return this->core < other.core;
+        if (this->node != other.node)
+            return this->node < other.node;
+        return this->id < other.id;
+    }
+};
+
+}
+
+/**
+ * @brief   Reads the topology of the running system as seen by
+ *          the calling thread.
+ */
+CpuTopology::CpuTopology(void)
+    : _M_cpus(),
+      _M_caches(),
+      _M_quota(0.0)
+{
+    cpu_set_t set;
+    CpuList allowed;
+
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (unsigned i = 0; i < CPU_SETSIZE; ++i)
+        {
+            if (CPU_ISSET(i, &set))
+                allowed.push_back(i);
+        }
+    }
+
+    this->_M_load("/sys", allowed.empty() ? 0 : &allowed);
+}
+
+/**
+ * @brief   Reads the topology from a copy of the sysfs tree.
+ * @param   sysfsRoot   Directory containing devices/system/cpu and,
+ *                      optionally, devices/system/node and fs/cgroup.
+ *
+ * The affinity mask is not taken into account.
+ */
+CpuTopology::CpuTopology(const std::string& sysfsRoot)
+    : _M_cpus(),
+      _M_caches(),
+      _M_quota(0.0)
+{
+    this->_M_load(sysfsRoot, 0);
+}
+
+CpuTopology::~CpuTopology(void)
+{
+
+}
+
+/**
+ * @brief   Returns the usable CPUs ordered by their number.
+ * @return  List of CPUs.
+ */
+const std::vector<CpuTopology::Cpu>& CpuTopology::cpus(void) const
+{
+    return this->_M_cpus;
+}
+
+/**
+ * @brief   Returns the caches shared by usable CPUs.
+ * @return  List of caches, every one of them listed once.
+ */
+const std::vector<CpuTopology::Cache>& CpuTopology::caches(void) const
+{
+    return this->_M_caches;
+}
+
+size_t CpuTopology::numCpus(void) const
+{
+    return this->_M_cpus.size();
+}
+
+/**
+ * @brief   Returns the number of physical cores with at least one
+ *          usable CPU.
+ * @return  Number of cores.
+ */
+size_t CpuTopology::numCores(void) const
+{
+    std::vector<std::pair<unsigned, unsigned> > cores;
+
+    for (std::vector<Cpu>::const_iterator it = this->_M_cpus.begin();
+            it != this->_M_cpus.end(); ++it)
+        cores.push_back(std::make_pair(it->package, it->core));
+
+    std::sort(cores.begin(), cores.end());
+    return std::unique(cores.begin(), cores.end()) - cores.begin();
+}
+
+size_t CpuTopology::numPackages(void) const
+{
+    CpuList packages;
+
+    for (std::vector<Cpu>::const_iterator it = this->_M_cpus.begin();
+            it != this->_M_cpus.end(); ++it)
+        packages.push_back(it->package);
+
+    std::sort(packages.begin(), packages.end());
+    return std::unique(packages.begin(), packages.end()) - packages.begin();
+}
+
+size_t CpuTopology::numNodes(void) const
+{
+    CpuList nodes;
+
+    for (std::vector<Cpu>::const_iterator it = this->_M_cpus.begin();
+            it != this->_M_cpus.end(); ++it)
+        nodes.push_back(it->node);
+
+    std::sort(nodes.begin(), nodes.end());
+    return std::unique(nodes.begin(), nodes.end()) - nodes.begin();
+}
+
+/**
+ * @brief   Returns the usable SMT siblings of a CPU.
+ * @param   cpu     CPU number.
+ * @return  CPUs sharing the core with cpu, including cpu itself.
+ * @throw   InvalidArgument     If cpu is not usable.
+ */
+CpuTopology::CpuList CpuTopology::siblings(unsigned cpu) const
+{
+    const Cpu* self = this->_M_find(cpu);
+    CpuList siblings;
+
+    if (self == 0)
+        throw except::InvalidArgument("Unknown CPU: %u", cpu);
+
+    for (std::vector<Cpu>::const_iterator it = this->_M_cpus.begin();
+            it != this->_M_cpus.end(); ++it)
+    {
+        if (sameCore(*it, *self))
+            siblings.push_back(it->id);
+    }
+
+    return siblings;
+}
+
+/**
+ * @brief   Returns the CPU bandwidth limit of the process' cgroup.
+ * @return  Limit in CPUs (e.g. 1.5 for 150ms every 100ms), 0 if
+ *          there's no limit.
+ */
+double CpuTopology::cpuQuota(void) const
+{
+    return this->_M_quota;
+}
+
+/**
+ * @brief   Returns how many threads can run in parallel without
+ *          oversubscribing the CPUs or exceeding the cgroup quota.
+ * @return  Number of threads, at least 1.
+ */
+size_t CpuTopology::recommendedThreads(void) const
+{
+    size_t num = this->_M_cpus.size();
+    size_t quota = static_cast<size_t>(std::ceil(this->_M_quota));
+
+    if ((quota > 0) && (quota < num))
+        num = quota;
+
+    return num > 0 ? num : 1;
+}
+
+/**
+ * @brief   Orders CPUs so that threads pinned in turn fill one core,
+ *          package and node before moving on to the next one.
+ * @return  List of CPU numbers.
+ *
+ * Best for threads sharing a lot of data.
+ */
+CpuTopology::CpuList CpuTopology::compactOrder(void) const
+{
+    std::vector<Cpu> sorted(this->_M_cpus);
+    CpuList order;
+
+    std::sort(sorted.begin(), sorted.end(), compactLess);
+    for (std::vector<Cpu>::const_iterator it = sorted.begin();
+            it != sorted.end(); ++it)
+        order.push_back(it->id);
+
+    return order;
+}
+
+/**
+ * @brief   Orders CPUs so that threads pinned in turn are spread over
+ *          nodes and cores, SMT siblings of already used cores come last.
+ * @return  List of CPU numbers.
+ *
+ * Best for independent threads competing for memory bandwidth and caches.
+ */
+CpuTopology::CpuList CpuTopology::scatterOrder(void) const
+{
+    std::vector<Cpu> sorted(this->_M_cpus);
+    std::vector<ScatterKey> keys;
+    std::vector<unsigned> coresInNode;
+    ScatterKey key;
+    CpuList order;
+
+    std::sort(sorted.begin(), sorted.end(), compactLess);
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        if (sorted[i].node >= coresInNode.size())
+            coresInNode.resize(sorted[i].node + 1, 0);
+
+        if ((i > 0) && sameCore(sorted[i], sorted[i - 1])
+                && (sorted[i].node == sorted[i - 1].node))
+        {
+            key.thread++;
+        }
+        else
+        {
+            key.thread = 0;
+            key.core = coresInNode[sorted[i].node]++;
+        }
+        key.node = sorted[i].node;
+        key.id = sorted[i].id;
+        keys.push_back(key);
+    }
+
+    std::sort(keys.begin(), keys.end());
+    for (std::vector<ScatterKey>::const_iterator it = keys.begin();
+            it != keys.end(); ++it)
+        order.push_back(it->id);
+
+    return order;
+}
+
+/**
+ * @brief   Parses the kernel's CPU list format, e.g. "0-3,8,10-11".
+ * @param   list    String to parse.
+ * @return  Sorted list of CPU numbers.
+ * @throw   InvalidArgument     If the string is malformed.
+ */
+CpuTopology::CpuList CpuTopology::parseCpuList(const std::string& list)
+{
+    CpuList cpus;
+    const char* pos = list.c_str();
+    char* end = 0;
+    unsigned long first = 0;
+    unsigned long last = 0;
+
+    while (::isspace(static_cast<unsigned char>(*pos)))
+        ++pos;
+
+    while (*pos != '\0')
+    {
+        first = last = ::strtoul(pos, &end, 10);
+        if (end == pos)
+            throw except::InvalidArgument("Invalid CPU list: %s",
+                    list.c_str());
+        pos = end;
+
+        if (*pos == '-')
+        {
+            last = ::strtoul(++pos, &end, 10);
+            if ((end == pos) || (last < first))
+                throw except::InvalidArgument("Invalid CPU list: %s",
+                        list.c_str());
+            pos = end;
+        }
+
+        for (unsigned long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(static_cast<unsigned>(cpu));
+
+        if (*pos == ',')
+            ++pos;
+        else if ((*pos != '\0') && !::isspace(static_cast<unsigned char>(*pos)))
+            throw except::InvalidArgument("Invalid CPU list: %s",
+                    list.c_str());
+        else
+            break;
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+void CpuTopology::_M_load(const std::string& root, const CpuList* allowed)
+{
+    std::string str;
+    CpuList online;
+    Cpu cpu;
+    long num = 0;
+
+    if (readFile(root + "/devices/system/cpu/online", str))
+        online = parseCpuList(str);
+
+    if (online.empty())
+    {
+        num = ::sysconf(_SC_NPROCESSORS_ONLN);
+        for (long i = 0; i < num; ++i)
+            online.push_back(i);
+    }
+
+    for (CpuList::const_iterator it = online.begin();
+            it != online.end(); ++it)
+    {
+        if ((allowed != 0)
+                && !std::binary_search(allowed->begin(), allowed->end(), *it))
+            continue;
+
+        cpu.id = *it;
+        cpu.core = readUnsigned(cpuDir(root, *it) + "/topology/core_id", *it);
+        cpu.package = readUnsigned(
+                cpuDir(root, *it) + "/topology/physical_package_id", 0);
+        cpu.node = 0;
+        this->_M_cpus.push_back(cpu);
+    }
+
+    this->_M_loadNodes(root);
+    this->_M_loadCaches(root);
+    this->_M_loadQuota(root);
+}
+
+void CpuTopology::_M_loadNodes(const std::string& root)
+{
+    std::string dir = root + "/devices/system/node";
+    std::string str;
+    CpuList cpus;
+    struct dirent* entry = 0;
+    unsigned node = 0;
+    char tail = 0;
+    DIR* dp = ::opendir(dir.c_str());
+
+    if (dp == 0)
+        return;
+
+    while ((entry = ::readdir(dp)) != 0)
+    {
+        if ((::sscanf(entry->d_name, "node%u%c", &node, &tail) != 1)
+                || !readFile(dir + "/" + entry->d_name + "/cpulist", str))
+            continue;
+
+        cpus = parseCpuList(str);
+        for (std::vector<Cpu>::iterator it = this->_M_cpus.begin();
+                it != this->_M_cpus.end(); ++it)
+        {
+            if (std::binary_search(cpus.begin(), cpus.end(), it->id))
+                it->node = node;
+        }
+    }
+
+    ::closedir(dp);
+}
+
+void CpuTopology::_M_loadCaches(const std::string& root)
+{
+    std::string dir;
+    std::string str;
+    CpuList shared;
+    Cache cache;
+    bool known = false;
+    char index[32];
+
+    for (std::vector<Cpu>::const_iterator cpu = this->_M_cpus.begin();
+            cpu != this->_M_cpus.end(); ++cpu)
+    {
+        for (unsigned i = 0; ; ++i)
+        {
+            ::snprintf(index, sizeof(index), "/cache/index%u", i);
+            dir = cpuDir(root, cpu->id) + index;
+            if (!readFile(dir + "/level", str))
+                break;
+
+            cache.level = readUnsigned(dir + "/level", 0);
+            readFile(dir + "/type", cache.type);
+            cache.size = readFile(dir + "/size", str) ? parseSize(str) : 0;
+            cache.cpus.clear();
+            if (readFile(dir + "/shared_cpu_list", str))
+                shared = parseCpuList(str);
+            else
+                shared.assign(1, cpu->id);
+
+            for (CpuList::const_iterator it = shared.begin();
+                    it != shared.end(); ++it)
+            {
+                if (this->_M_find(*it) != 0)
+                    cache.cpus.push_back(*it);
+            }
+
+            known = false;
+            for (std::vector<Cache>::const_iterator it =
+                    this->_M_caches.begin();
+                    (it != this->_M_caches.end()) && !known; ++it)
+                known = (it->level == cache.level) && (it->type == cache.type)
+                        && (it->cpus == cache.cpus);
+            if (!known)
+                this->_M_caches.push_back(cache);
+        }
+    }
+}
+
+/*
+ * The process's cgroups are taken from /proc/self/cgroup and looked up
+ * under the sysfs root, both in the unified (v2) hierarchy and in the v1
+ * cpu controller's one. Directories that aren't there - e.g. when the
+ * cgroup filesystem is mounted from inside a container without its own
+ * cgroup namespace - are skipped on the way up to the mount point.
+ */
+void CpuTopology::_M_loadQuota(const std::string& root)
+{
+    double unified = cgroupQuota(root + "/fs/cgroup", cgroupPath(""), true);
+    double legacy = cgroupQuota(root + "/fs/cgroup/cpu",
+                                cgroupPath("cpu"), false);
+
+    if ((unified > 0.0) && ((legacy == 0.0) || (unified < legacy)))
+        this->_M_quota = unified;
+    else if (legacy > 0.0)
+        this->_M_quota = legacy;
+}
+
+const CpuTopology::Cpu* CpuTopology::_M_find(unsigned id) const
+{
+    for (std::vector<Cpu>::const_iterator it = this->_M_cpus.begin();
+            it != this->_M_cpus.end(); ++it)
+    {
+        if (it->id == id)
+            return &(*it);
+    }
+
+    return 0;
+}
+
+ELS_END_NAMESPACE_2
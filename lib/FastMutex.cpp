@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    FastMutex.cpp
+ */
+
+#include <els/FastMutex.hpp>
+#include "SpinHelpers.hpp"
+
+#include <cerrno>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+namespace {
+
+const unsigned maxSpins = 100;
+
+void futexWait(int* addr, int val)
+{
+    ::syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, 0, 0, 0);
+}
+
+void futexWake(int* addr, int count)
+{
+    ::syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+}
+
+}
+
+/**
+ * @brief   Constructor. Never fails, unlike Mutex there's nothing to
+ *          initialize in the kernel.
+ * @param   debug   Track the owner and check for misuse.
+ */
+FastMutex::FastMutex(bool debug) throw()
+    : _M_state(_S_unlocked),
+      _M_spins(0),
+      _M_debug(debug),
+      _M_owner()
+{
+
+}
+
+/**
+ * @brief   Destructor.
+ */
+FastMutex::~FastMutex(void) throw()
+{
+
+}
+
+/**
+ * @brief   Tells whether the mutex checks for misuse.
+ * @return  True if the mutex was created in debug mode.
+ */
+bool FastMutex::debug(void) const throw()
+{
+    return this->_M_debug;
+}
+
+/*
+ * Spin up to twice the recent average (glibc's adaptive mutex does the
+ * same), then mark the lock contended and sleep on the futex. Whoever
+ * finds the contended state when unlocking wakes a sleeper up.
+ */
+void FastMutex::_M_lockSlow(void)
+{
+    int limit = spinLimit(maxSpins);
+    int average = __atomic_load_n(&this->_M_spins, __ATOMIC_RELAXED);
+    int budget = limit > 0 ? average * 2 + 10 : 0;
+    int spins = 0;
+    int state = 0;
+
+    if (this->_M_debug && ::pthread_equal(__atomic_load_n(&this->_M_owner,
+            __ATOMIC_RELAXED), ::pthread_self()))
+        throw FastMutexError("Error locking mutex: %s",
+                except::getErrnoStr(EDEADLK).c_str());
+
+    if (budget > limit)
+        budget = limit;
+
+    for (spins = 0; spins <= budget; ++spins)
+    {
+        state = __atomic_load_n(&this->_M_state, __ATOMIC_RELAXED);
+        if (state == _S_unlocked && __atomic_compare_exchange_n(
+                &this->_M_state, &state, _S_locked, false,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+
+        ELS_CPU_RELAX();
+    }
+
+    if (spins > budget)
+    {
+        while (__atomic_exchange_n(&this->_M_state, _S_contended,
+                __ATOMIC_ACQUIRE) != _S_unlocked)
+            futexWait(&this->_M_state, _S_contended);
+    }
+
+    if (limit > 0)
+        __atomic_store_n(&this->_M_spins, average + (spins - average) / 8,
+                __ATOMIC_RELAXED);
+
+    if (this->_M_debug)
+        this->_M_setOwner();
+}
+
+void FastMutex::_M_wake(void) throw()
+{
+    futexWake(&this->_M_state, 1);
+}
+
+void FastMutex::_M_setOwner(void) throw()
+{
+    __atomic_store_n(&this->_M_owner, ::pthread_self(), __ATOMIC_RELAXED);
+}
+
+void FastMutex::_M_checkUnlock(void)
+{
+    if (__atomic_load_n(&this->_M_state, __ATOMIC_RELAXED) == _S_unlocked
+            || !::pthread_equal(__atomic_load_n(&this->_M_owner,
+                    __ATOMIC_RELAXED), ::pthread_self()))
+        throw FastMutexError("Error unlocking mutex: %s",
+                except::getErrnoStr(EPERM).c_str());
+
+    /* Cleared before the unlock, a new owner can't be overwritten. */
+    __atomic_store_n(&this->_M_owner, ::pthread_t(), __ATOMIC_RELAXED);
+}
+
+ELS_DEFINE_NESTED_EXCEPTION(FastMutexError, FastMutex, except::Exception)
+
+ELS_END_NAMESPACE_2
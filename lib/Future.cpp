@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    Future.cpp
+ */
+
+#include <els/Future.hpp>
+#include <els/ThreadPool.hpp>
+#include <els/AutoMutex.hpp>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+ELS_DEFINE_EXCEPTION(TaskFailed, except::Exception);
+
+ELS_BEGIN_NAMESPACE_1(__future_detail)
+
+ContinuationBase::ContinuationBase(ThreadPool& pool)
+    : IRunnable(),
+      _M_pool(pool),
+      _M_next(0)
+{
+
+}
+
+ContinuationBase::~ContinuationBase(void)
+{
+
+}
+
+FutureStateBase::FutureStateBase(void)
+    : _M_refs(1),
+      _M_ready(0),
+      _M_failed(false),
+      _M_error(),
+      _M_mutex(),
+      _M_cond(),
+      _M_waiters(0),
+      _M_contHead(0),
+      _M_contTail(0)
+{
+
+}
+
+/*
+ * Every state is made ready before its last reference is dropped, so
+ * there should be no continuations left here. Deleting them fails their
+ * own futures rather than leaking them.
+ */
+FutureStateBase::~FutureStateBase(void)
+{
+    ContinuationBase* cont = this->_M_contHead;
+    ContinuationBase* next = 0;
+
+    while (cont != 0)
+    {
+        next = cont->_M_next;
+        delete cont;
+        cont = next;
+    }
+}
+
+void FutureStateBase::ref(void)
+{
+    this->_M_refs.inc();
+}
+
+void FutureStateBase::unref(void)
+{
+    if (this->_M_refs.dec() == 0)
+        delete this;
+}
+
+bool FutureStateBase::ready(void) const
+{
+    return (__atomic_load_n(&this->_M_ready, __ATOMIC_ACQUIRE) != 0);
+}
+
+void FutureStateBase::wait(void)
+{
+    if (this->ready())
+        return;
+
+    AutoMutex am(this->_M_mutex);
+    this->_M_waiters++;
+    while (!this->ready())
+        this->_M_cond.block(this->_M_mutex);
+    this->_M_waiters--;
+}
+
+bool FutureStateBase::wait(const misc::Timeval& timeout)
+{
+    misc::Timeval deadline = misc::Timeval::now();
+
+    if (this->ready())
+        return true;
+
+    deadline += timeout;
+
+    AutoMutex am(this->_M_mutex);
+    this->_M_waiters++;
+    while (!this->ready() && (misc::Timeval::now() < deadline))
+        this->_M_cond.block(this->_M_mutex, deadline);
+    this->_M_waiters--;
+
+    return this->ready();
+}
+
+void FutureStateBase::setError(const std::string& error)
+{
+    this->_M_checkNotReady();
+    this->_M_failed = true;
+    this->_M_error = error;
+    this->_M_setReady();
+}
+
+/*
+ * If the state is already ready the continuation is scheduled right
+ * away, otherwise it's queued and scheduled by whoever makes the state
+ * ready. Continuations are scheduled in the order they were added.
+ */
+void FutureStateBase::addContinuation(ContinuationBase* cont)
+{
+    this->_M_mutex.lock();
+    if (!this->ready())
+    {
+        cont->_M_next = 0;
+        if (this->_M_contTail == 0)
+            this->_M_contHead = cont;
+        else
+            this->_M_contTail->_M_next = cont;
+        this->_M_contTail = cont;
+        this->_M_mutex.unlock();
+        return;
+    }
+    this->_M_mutex.unlock();
+
+    _S_scheduleContinuation(cont);
+}
+
+void FutureStateBase::_M_checkNotReady(void) const
+{
+    if (this->ready())
+        except::throwLogicError("Future already satisfied");
+}
+
+void FutureStateBase::_M_checkError(void) const
+{
+    if (this->_M_failed)
+        throw TaskFailed(this->_M_error);
+}
+
+void FutureStateBase::_M_setReady(void)
+{
+    ContinuationBase* cont = 0;
+    ContinuationBase* next = 0;
+
+    this->_M_mutex.lock();
+    __atomic_store_n(&this->_M_ready, 1, __ATOMIC_RELEASE);
+    if (this->_M_waiters > 0)
+        this->_M_cond.unblockAll();
+    cont = this->_M_contHead;
+    this->_M_contHead = this->_M_contTail = 0;
+    this->_M_mutex.unlock();
+
+    while (cont != 0)
+    {
+        next = cont->_M_next;
+        _S_scheduleContinuation(cont);
+        cont = next;
+    }
+}
+
+void FutureStateBase::_S_scheduleContinuation(ContinuationBase* cont)
+{
+    bool scheduled = false;
+
+    try
+    {
+        scheduled = cont->_M_pool.schedule(cont, true);
+    }
+    catch (const except::Exception&) {}
+
+    /* Deleting an unscheduled continuation fails its future. */
+    if (!scheduled)
+        delete cont;
+}
+
+ELS_END_NAMESPACE_1
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    HazardPointer.cpp
+ */
+
+#include <els/HazardPointer.hpp>
+
+#include <algorithm>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/**
+ * @brief   Constructor.
+ * @param   retireThreshold     Number of nodes a record may hold retired
+ *                              before they're scanned and freed.
+ */
+HazardDomain::HazardDomain(size_t retireThreshold)
+    : _M_records(0),
+      _M_threshold(retireThreshold > 0 ? retireThreshold : 1),
+      _M_pending(0)
+{
+
+}
+
+/**
+ * @brief   Destructor. Frees all retired nodes. No HazardPointer
+ *          of this domain may be alive.
+ */
+HazardDomain::~HazardDomain(void) throw()
+{
+    _T_Record* rec = this->_M_records;
+    _T_Record* next = 0;
+
+    while (rec != 0)
+    {
+        next = rec->next;
+        for (size_t i = 0; i < rec->retired.size(); ++i)
+            rec->retired[i].second(rec->retired[i].first);
+        delete rec;
+        rec = next;
+    }
+}
+
+/**
+ * @brief   Returns the number of retired nodes not freed yet.
+ * @return  Snapshot of the number of pending nodes.
+ */
+size_t HazardDomain::pending(void) const throw()
+{
+    return __atomic_load_n(&this->_M_pending, __ATOMIC_RELAXED);
+}
+
+HazardDomain::_T_Record* HazardDomain::_M_acquire(void)
+{
+    _T_Record* rec = 0;
+    int inactive = 0;
+
+    for (rec = __atomic_load_n(&this->_M_records, __ATOMIC_ACQUIRE);
+            rec != 0; rec = rec->next)
+    {
+        inactive = 0;
+        if (__atomic_load_n(&rec->active, __ATOMIC_RELAXED) == 0
+                && __atomic_compare_exchange_n(&rec->active, &inactive, 1,
+                        false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return rec;
+    }
+
+    rec = new _T_Record;
+    rec->hazard = 0;
+    rec->active = 1;
+    rec->next = __atomic_load_n(&this->_M_records, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&this->_M_records, &rec->next, rec,
+            true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return rec;
+}
+
+void HazardDomain::_M_release(_T_Record* rec) throw()
+{
+    __atomic_store_n(&rec->hazard, static_cast<void*>(0), __ATOMIC_RELAXED);
+    /* Retired nodes stay in the record for its next owner to scan. */
+    __atomic_store_n(&rec->active, 0, __ATOMIC_RELEASE);
+}
+
+void HazardDomain::_M_retire(_T_Record* rec, void* ptr, Deleter deleter)
+{
+    rec->retired.push_back(std::make_pair(ptr, deleter));
+    __atomic_add_fetch(&this->_M_pending, 1, __ATOMIC_RELAXED);
+    if (rec->retired.size() >= this->_M_threshold)
+        this->_M_scan(rec);
+}
+
+/*
+ * Frees the nodes retired in rec which no hazard pointer points to.
+ * The fence pairs with the one in HazardPointer::protect(): either the
+ * reader sees the node unlinked and retries, or we see its hazard.
+ */
+void HazardDomain::_M_scan(_T_Record* rec)
+{
+    std::vector<void*> hazards;
+    std::vector<std::pair<void*, Deleter> > kept;
+    _T_Record* cur = 0;
+    void* ptr = 0;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (cur = __atomic_load_n(&this->_M_records, __ATOMIC_ACQUIRE);
+            cur != 0; cur = cur->next)
+    {
+        ptr = __atomic_load_n(&cur->hazard, __ATOMIC_ACQUIRE);
+        if (ptr != 0)
+            hazards.push_back(ptr);
+    }
+    std::sort(hazards.begin(), hazards.end());
+
+    for (size_t i = 0; i < rec->retired.size(); ++i)
+    {
+        if (std::binary_search(hazards.begin(), hazards.end(),
+                rec->retired[i].first))
+        {
+            kept.push_back(rec->retired[i]);
+        }
+        else
+        {
+            rec->retired[i].second(rec->retired[i].first);
+            __atomic_sub_fetch(&this->_M_pending, 1, __ATOMIC_RELAXED);
+        }
+    }
+    rec->retired.swap(kept);
+}
+
+/**
+ * @brief   Constructor. Takes a free record from the domain or adds
+ *          a new one.
+ * @param   domain  Domain the protected nodes belong to.
+ */
+HazardPointer::HazardPointer(HazardDomain& domain)
+    : _M_domain(domain),
+      _M_record(domain._M_acquire())
+{
+
+}
+
+/**
+ * @brief   Destructor. Gives the record back to the domain.
+ */
+HazardPointer::~HazardPointer(void) throw()
+{
+    this->_M_domain._M_release(this->_M_record);
+}
+
+/**
+ * @brief   Hands a node, already unlinked from the container, over for
+ *          deletion once it's no longer protected.
+ * @param   ptr     Node to free.
+ * @param   deleter Function freeing the node.
+ */
+void HazardPointer::retire(void* ptr, HazardDomain::Deleter deleter)
+{
+    this->_M_domain._M_retire(this->_M_record, ptr, deleter);
+}
+
+ELS_END_NAMESPACE_2
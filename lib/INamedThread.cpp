@@ -22,6 +22,8 @@
 
 #include <els/INamedThread.hpp>
 
+#include <pthread.h>
+
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
 INamedThread::INamedThread(const std::string& name)
@@ -41,6 +43,14 @@ const std::string& INamedThread::name(void) const
     return this->_M_name;
 }
 
+void INamedThread::_M_setup(void)
+{
+    IThread::_M_setup();
+    /* Naming is cosmetic, a failure is not worth aborting the thread. */
+    ::pthread_setname_np(::pthread_self(),
+            this->_M_name.substr(0, 15).c_str());
+}
+
 ELS_END_NAMESPACE_2
 
 
@@ -23,8 +23,14 @@
 #include <els/IThread.hpp>
 #include <els/AutoMutex.hpp>
 #include <els/System.hpp>
+#include <els/ThreadRegistry.hpp>
 
 #include <cstring>
+#include <climits>
+#include <cerrno>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cxxabi.h>
 
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
@@ -32,10 +38,17 @@ IThread::IThread(void)
     : _M_id(),
       _M_tid(-1),
       _M_mutex(),
+      _M_sleepMutex(),
       _M_cond(),
       _M_state(THREAD_INITIALIZED),
-      _M_stopRequest(false),
-      _M_retval(0)
+      _M_stop(),
+      _M_retval(0),
+      _M_affinity(),
+      _M_schedPolicy(SCHED_POLICY_INHERIT),
+      _M_schedPriority(0),
+      _M_stackSize(0),
+      _M_guardSize(0),
+      _M_lockStack(false)
 {
 
 }
@@ -49,51 +62,114 @@ void* IThread::_S_initThread(void* threadPtr)
 {
     int ret = 0;
     ThreadRetval* trv = 0;
+    void* stackAddr = 0;
+    size_t stackSize = 0;
+    bool lockStack = false;
+    SchedPolicy policy = SCHED_POLICY_INHERIT;
+    ::sched_param param;
 
     _S_incThreadCount();
 
     IThread *thisThread = static_cast<IThread*>(threadPtr);
     thisThread->_M_mutex.lock();
-    thisThread->_M_tid = sys::getTid();
-    thisThread->_M_state = THREAD_RUNNING;
+    __atomic_store_n(&thisThread->_M_tid, sys::getTid(), __ATOMIC_RELEASE);
+    thisThread->_M_setState(THREAD_RUNNING);
+    lockStack = thisThread->_M_lockStack;
+    policy = thisThread->_M_schedPolicy;
     thisThread->_M_mutex.unlock();
 
+    if ((policy == SCHED_POLICY_BATCH) || (policy == SCHED_POLICY_IDLE))
+    {
+        param.sched_priority = 0;
+        ret = ::pthread_setschedparam(::pthread_self(),
+                _S_nativePolicy(policy), &param);
+        if (ret != 0)
+        {
+            trv = new IThread::ThreadRetval(-1,
+                    "Error setting scheduling policy: "
+                    + except::getErrnoStr(ret));
+            goto out;
+        }
+    }
+
+    if (lockStack)
+    {
+        ret = _S_lockStack(&stackAddr, &stackSize);
+        if (ret != 0)
+        {
+            trv = new IThread::ThreadRetval(-1,
+                    "Error locking thread stack: "
+                    + except::getErrnoStr(ret));
+            goto out;
+        }
+    }
+
+    ThreadRegistry::_S_add(thisThread);
     try
     {
+        thisThread->_M_setup();
         ret = thisThread->_M_run();
     }
     catch (const except::Exception& e)
     {
+        ThreadRegistry::_S_remove(thisThread);
         trv = new IThread::ThreadRetval(-1, e.what());
         goto out;
     }
+    catch (abi::__forced_unwind&)
+    {
+        /* pthread_cancel() unwinds the stack, it must be rethrown. */
+        ThreadRegistry::_S_remove(thisThread);
+        if (stackSize != 0)
+            ::munlock(stackAddr, stackSize);
+        _S_decThreadCount();
+        throw;
+    }
 
+    ThreadRegistry::_S_remove(thisThread);
     trv = new IThread::ThreadRetval(ret);
 
 out:
+    /* glibc caches stacks, don't hand a locked one to the next thread. */
+    if (stackSize != 0)
+        ::munlock(stackAddr, stackSize);
     thisThread->_M_setState(THREAD_FINISHED);
     _S_decThreadCount();
     return static_cast<void*>(trv);
 }
 
+/**
+ * @brief   Returns the current state without locking.
+ * @return  Thread state.
+ */
 IThread::ThreadState IThread::state(void) const
 {
-    AutoMutex am(this->_M_mutex);
-    return this->_M_state;
+    return __atomic_load_n(&this->_M_state, __ATOMIC_ACQUIRE);
 }
 
 void IThread::start(void)
 {
-    AutoMutex am(this->_M_mutex);
+    ThreadState expected = THREAD_INITIALIZED;
 
-    if (this->_M_state != THREAD_INITIALIZED)
+    if (!__atomic_compare_exchange_n(&this->_M_state, &expected,
+            THREAD_STARTING, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
         except::throwLogicError("Thread not in INITIALIZED state");
-    this->_M_state = THREAD_STARTING;
 
-    int ret = ::pthread_create(&this->_M_id, 0, IThread::_S_initThread,
-            static_cast<void*>(this));
+    AutoMutex am(this->_M_mutex);
+    ::pthread_attr_t attr;
+    int ret = ::pthread_attr_init(&attr);
+    if (ret == 0)
+    {
+        ret = this->_M_initAttr(&attr);
+        if (ret == 0)
+            ret = ::pthread_create(&this->_M_id, &attr,
+                    IThread::_S_initThread, static_cast<void*>(this));
+        ::pthread_attr_destroy(&attr);
+    }
+
     if (ret != 0)
     {
+        this->_M_setState(THREAD_INITIALIZED);
         throw ThreadError("Error creating new thread: %s",
                 except::getErrnoStr(ret).c_str());
     }
@@ -101,30 +177,24 @@ void IThread::start(void)
 
 void IThread::stop(void)
 {
-    this->_M_mutex.lock();
-    if ((this->_M_state == THREAD_INITIALIZED)
-            || (this->_M_state == THREAD_CANCELED))
-    {
-        this->_M_mutex.unlock();
+    ThreadState state = this->state();
+
+    if ((state == THREAD_INITIALIZED) || (state == THREAD_CANCELED))
         except::throwLogicError("Thread not running");
-    }
-    this->_M_stopRequest = true;
-    this->_M_mutex.unlock();
+
+    this->_M_stop.requestStop();
     this->wake();
 }
 
 
 void IThread::requestStop(void)
 {
-    AutoMutex am(this->_M_mutex);
+    ThreadState state = this->state();
 
-    if ((this->_M_state != THREAD_RUNNING)
-            && (this->_M_state != THREAD_SLEEPING))
-    {
+    if ((state != THREAD_RUNNING) && (state != THREAD_SLEEPING))
         except::throwLogicError("Thread not alive");
-    }
 
-    this->_M_stopRequest = true;
+    this->_M_stop.requestStop();
 }
 
 void IThread::cancel(void)
@@ -159,26 +229,29 @@ void IThread::join(void)
 
     this->_M_mutex.lock();
     this->_M_retval.reset(
-            this->_M_state == THREAD_CANCELED ? 0
+            this->state() == THREAD_CANCELED ? 0
             : static_cast<IThread::ThreadRetval*>(retptr));
     this->_M_mutex.unlock();
 }
 
 bool IThread::tryjoin(void)
 {
-    this->_M_mutex.lock();
-    if ((this->_M_state != THREAD_FINISHED)
-            && (this->_M_state != THREAD_CANCELED))
-    {
-        this->_M_mutex.unlock();
+    ThreadState state = this->state();
+
+    if ((state != THREAD_FINISHED) && (state != THREAD_CANCELED))
         return false;
-    }
-    this->_M_mutex.unlock();
 
     this->join();
     return true;
 }
 
+/**
+ * @brief   Brings a stopped thread back to the INITIALIZED state.
+ * @throw   LogicError  If the thread is alive.
+ *
+ * The thread gets a new stop token, copies of the old one obtained
+ * from stopToken() are no longer connected to it.
+ */
 void IThread::reset(void)
 {
     ThreadState state = this->state();
@@ -190,52 +263,324 @@ void IThread::reset(void)
         except::throwLogicError("Thread not stopped");
     }
 
+    this->_M_mutex.lock();
     ::memset(&this->_M_id, 0, sizeof(::pthread_t));
-    this->_M_tid = -1;
-    this->_M_state = THREAD_INITIALIZED;
-    this->_M_stopRequest = false;
+    __atomic_store_n(&this->_M_tid, -1, __ATOMIC_RELAXED);
+    this->_M_stop = StopToken();
     this->_M_retval.reset();
+    this->_M_mutex.unlock();
+    this->_M_setState(THREAD_INITIALIZED);
 }
 
+/*
+ * Always broadcast under the sleep mutex: checking the state first
+ * could miss a thread that has just decided to go to sleep.
+ */
 void IThread::wake(void)
 {
-    if (this->state() == THREAD_SLEEPING)
-        this->_M_cond.unblockAll();
+    this->_M_sleepMutex.lock();
+    this->_M_cond.unblockAll();
+    this->_M_sleepMutex.unlock();
 }
 
 ::pid_t IThread::tid(void) const
 {
-    AutoMutex am(this->_M_mutex);
-    return this->_M_tid;
+    return __atomic_load_n(&this->_M_tid, __ATOMIC_ACQUIRE);
 }
 
 const IThread::ThreadRetval& IThread::retval(void) const
 {
     AutoMutex am(this->_M_mutex);
 
-    if (this->_M_state != THREAD_FINISHED)
+    if (this->state() != THREAD_FINISHED)
         except::throwLogicError("Thread not stopped");
     return *(this->_M_retval);
 }
 
+/**
+ * @brief   Returns the token signalled by stop() and requestStop().
+ * @return  Copy of the token.
+ *
+ * Register callbacks with it to interrupt blocking calls made by
+ * _M_run() when the thread is asked to stop.
+ */
+StopToken IThread::stopToken(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_stop;
+}
+
+/**
+ * @brief   Restricts the thread to the given CPUs.
+ * @param   cpus    CPU numbers, empty to inherit the creator's mask.
+ * @throw   InvalidArgument     If a CPU number is out of range.
+ * @throw   ThreadError         If the mask can't be applied.
+ *
+ * Takes effect immediately if the thread is running, otherwise when
+ * it's started. The mask is kept across reset().
+ */
+void IThread::setAffinity(const std::vector<unsigned>& cpus)
+{
+    AutoMutex am(this->_M_mutex);
+    ::cpu_set_t set;
+    int ret = 0;
+
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        if (cpus[i] >= CPU_SETSIZE)
+            throw except::InvalidArgument("CPU number out of range: %u",
+                    cpus[i]);
+        CPU_SET(cpus[i], &set);
+    }
+
+    if (((this->state() == THREAD_RUNNING)
+                || (this->state() == THREAD_SLEEPING)) && !cpus.empty())
+    {
+        ret = ::pthread_setaffinity_np(this->_M_id, sizeof(set), &set);
+        if (ret != 0)
+        {
+            throw ThreadError("Error setting thread affinity: %s",
+                    except::getErrnoStr(ret).c_str());
+        }
+    }
+
+    this->_M_affinity = cpus;
+}
+
+std::vector<unsigned> IThread::affinity(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_affinity;
+}
+
+/**
+ * @brief   Sets the scheduling policy and priority.
+ * @param   policy      Scheduling policy.
+ * @param   priority    Static priority, must be within the range of
+ *                      the policy - 1 to 99 for real-time policies
+ *                      and 0 for the others.
+ * @throw   InvalidArgument     If the priority is out of range.
+ * @throw   ThreadError         If the policy can't be applied.
+ *
+ * Takes effect immediately if the thread is running, otherwise when
+ * it's started - in which case a missing privilege makes start() fail.
+ * SCHED_POLICY_BATCH and SCHED_POLICY_IDLE are applied by the new
+ * thread itself, which finishes with an error if that fails.
+ * Switching a running thread back to SCHED_POLICY_INHERIT is not
+ * possible, the current policy is kept until the next start().
+ */
+void IThread::setScheduling(SchedPolicy policy, int priority)
+{
+    AutoMutex am(this->_M_mutex);
+    ::sched_param param;
+    int native = _S_nativePolicy(policy);
+    int ret = 0;
+
+    if ((policy == SCHED_POLICY_INHERIT) ? (priority != 0)
+            : ((priority < ::sched_get_priority_min(native))
+                || (priority > ::sched_get_priority_max(native))))
+    {
+        throw except::InvalidArgument("Invalid scheduling priority: %d",
+                priority);
+    }
+
+    if (((this->state() == THREAD_RUNNING)
+                || (this->state() == THREAD_SLEEPING))
+            && (policy != SCHED_POLICY_INHERIT))
+    {
+        param.sched_priority = priority;
+        ret = ::pthread_setschedparam(this->_M_id, native, &param);
+        if (ret != 0)
+        {
+            throw ThreadError("Error setting scheduling policy: %s",
+                    except::getErrnoStr(ret).c_str());
+        }
+    }
+
+    this->_M_schedPolicy = policy;
+    this->_M_schedPriority = priority;
+}
+
+IThread::SchedPolicy IThread::schedPolicy(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_schedPolicy;
+}
+
+int IThread::schedPriority(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_schedPriority;
+}
+
+/**
+ * @brief   Sets the stack size used by the next start().
+ * @param   size    Stack size in bytes, 0 for the default (usually
+ *                  RLIMIT_STACK, 8MB on most systems).
+ * @throw   InvalidArgument     If size is below PTHREAD_STACK_MIN.
+ */
+void IThread::setStackSize(size_t size)
+{
+    AutoMutex am(this->_M_mutex);
+
+    if ((size != 0) && (size < static_cast<size_t>(PTHREAD_STACK_MIN)))
+        throw except::InvalidArgument("Stack size too small: %zu", size);
+
+    this->_M_stackSize = size;
+}
+
+size_t IThread::stackSize(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_stackSize;
+}
+
+/**
+ * @brief   Sets the size of the inaccessible area below the stack used
+ *          by the next start().
+ * @param   size    Guard size in bytes, rounded up to whole pages,
+ *                  0 for the default of one page.
+ */
+void IThread::setGuardSize(size_t size)
+{
+    AutoMutex am(this->_M_mutex);
+    this->_M_guardSize = size;
+}
+
+size_t IThread::guardSize(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_guardSize;
+}
+
+/**
+ * @brief   Makes the thread lock its whole stack in memory before
+ *          running.
+ * @param   lock    True to lock the stack.
+ *
+ * Avoids page faults on the first use of every stack page. Combine
+ * with a small stack size - the locked memory counts against
+ * RLIMIT_MEMLOCK. If locking fails the thread finishes immediately
+ * with an error instead of running.
+ */
+void IThread::setLockStack(bool lock)
+{
+    AutoMutex am(this->_M_mutex);
+    this->_M_lockStack = lock;
+}
+
+bool IThread::lockStack(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_lockStack;
+}
+
+/**
+ * @brief   Called in the new thread right before _M_run().
+ *
+ * Does nothing by default. Overriding methods should call the version
+ * of their base class.
+ */
+void IThread::_M_setup(void)
+{
+
+}
+
+/**
+ * @brief   Blocks until wake() is called, returns immediately if a stop
+ *          has been requested.
+ */
 void IThread::_M_sleep(void)
 {
+    this->_M_sleepMutex.lock();
     this->_M_setState(THREAD_SLEEPING);
-    this->_M_cond.block();
+    if (!this->_M_stopRequested())
+        this->_M_cond.block(this->_M_sleepMutex);
     this->_M_setState(THREAD_RUNNING);
+    this->_M_sleepMutex.unlock();
 }
 
+/**
+ * @brief   Checks for a stop request without locking, cheap enough to be
+ *          called on every iteration of a loop.
+ * @return  True if stop() or requestStop() has been called.
+ */
 bool IThread::_M_stopRequested(void) const
 {
-    AutoMutex am(this->_M_mutex);
-    return this->_M_stopRequest;
+    return this->_M_stop.stopRequested();
 }
 
 void IThread::_M_setState(ThreadState state)
 {
-    this->_M_mutex.lock();
-    this->_M_state = state;
-    this->_M_mutex.unlock();
+    __atomic_store_n(&this->_M_state, state, __ATOMIC_RELEASE);
+}
+
+int IThread::_M_initAttr(::pthread_attr_t* attr) const
+{
+    ::sched_param param;
+    ::cpu_set_t set;
+    int ret = 0;
+
+    if (!this->_M_affinity.empty())
+    {
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < this->_M_affinity.size(); ++i)
+            CPU_SET(this->_M_affinity[i], &set);
+        ret = ::pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+    }
+
+    /* pthread attributes only accept the POSIX policies. */
+    if ((ret == 0) && (this->_M_schedPolicy != SCHED_POLICY_INHERIT)
+            && (this->_M_schedPolicy != SCHED_POLICY_BATCH)
+            && (this->_M_schedPolicy != SCHED_POLICY_IDLE))
+    {
+        param.sched_priority = this->_M_schedPriority;
+        ret = ::pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+        if (ret == 0)
+            ret = ::pthread_attr_setschedpolicy(attr,
+                    _S_nativePolicy(this->_M_schedPolicy));
+        if (ret == 0)
+            ret = ::pthread_attr_setschedparam(attr, &param);
+    }
+
+    if ((ret == 0) && (this->_M_stackSize != 0))
+        ret = ::pthread_attr_setstacksize(attr, this->_M_stackSize);
+    if ((ret == 0) && (this->_M_guardSize != 0))
+        ret = ::pthread_attr_setguardsize(attr, this->_M_guardSize);
+
+    return ret;
+}
+
+int IThread::_S_nativePolicy(SchedPolicy policy)
+{
+    switch (policy)
+    {
+    case SCHED_POLICY_BATCH: return SCHED_BATCH;
+    case SCHED_POLICY_IDLE: return SCHED_IDLE;
+    case SCHED_POLICY_FIFO: return SCHED_FIFO;
+    case SCHED_POLICY_RR: return SCHED_RR;
+    default: return SCHED_OTHER;
+    }
+}
+
+/* The reported stack excludes the guard area. */
+int IThread::_S_lockStack(void** addr, size_t* size)
+{
+    ::pthread_attr_t attr;
+    int ret = ::pthread_getattr_np(::pthread_self(), &attr);
+
+    if (ret != 0)
+        return ret;
+
+    ret = ::pthread_attr_getstack(&attr, addr, size);
+    ::pthread_attr_destroy(&attr);
+    if ((ret == 0) && (::mlock(*addr, *size) != 0))
+        ret = errno;
+    if (ret != 0)
+        *size = 0;
+
+    return ret;
 }
 
 AtomicInt IThread::_S_threadCount(0);
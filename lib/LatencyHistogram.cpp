@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    LatencyHistogram.cpp
+ */
+
+#include <els/LatencyHistogram.hpp>
+#include <els/Exception.hpp>
+
+ELS_BEGIN_NAMESPACE_2(els, misc)
+
+/**
+ * @brief   Default constructor - creates an empty histogram.
+ */
+LatencyHistogram::LatencyHistogram(void) throw()
+    : _M_count(0),
+      _M_sum(0),
+      _M_max(0)
+{
+    for (unsigned i = 0; i < _S_NUM_BUCKETS; ++i)
+        this->_M_buckets[i] = 0;
+}
+
+/**
+ * @brief   Copy constructor.
+ * @param   other   Other instance of LatencyHistogram.
+ */
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other) throw()
+    : _M_count(0),
+      _M_sum(0),
+      _M_max(0)
+{
+    for (unsigned i = 0; i < _S_NUM_BUCKETS; ++i)
+        this->_M_buckets[i] = 0;
+    this->merge(other);
+}
+
+/**
+ * @brief   Assignment operator.
+ * @param   other   Other instance of LatencyHistogram.
+ * @return  Reference to this object.
+ */
+LatencyHistogram& LatencyHistogram::operator =(
+        const LatencyHistogram& other) throw()
+{
+    if (this != &other)
+    {
+        this->reset();
+        this->merge(other);
+    }
+
+    return *this;
+}
+
+/**
+ * @brief   Destructor.
+ */
+LatencyHistogram::~LatencyHistogram(void) throw()
+{
+
+}
+
+/**
+ * @brief   Adds a single sample.
+ * @param   ns      Duration in nanoseconds.
+ */
+void LatencyHistogram::record(ElsUint64 ns) throw()
+{
+    ElsUint64 max = __atomic_load_n(&this->_M_max, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&this->_M_buckets[_S_bucket(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&this->_M_sum, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&this->_M_count, 1, __ATOMIC_RELAXED);
+
+    while ((ns > max) && !__atomic_compare_exchange_n(&this->_M_max,
+            &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/**
+ * @brief   Adds all samples of another histogram to this one.
+ * @param   other   Histogram to merge.
+ */
+void LatencyHistogram::merge(const LatencyHistogram& other) throw()
+{
+    ElsUint64 max = __atomic_load_n(&other._M_max, __ATOMIC_RELAXED);
+    ElsUint64 cur = __atomic_load_n(&this->_M_max, __ATOMIC_RELAXED);
+
+    for (unsigned i = 0; i < _S_NUM_BUCKETS; ++i)
+        __atomic_add_fetch(&this->_M_buckets[i],
+                __atomic_load_n(&other._M_buckets[i], __ATOMIC_RELAXED),
+                __ATOMIC_RELAXED);
+    __atomic_add_fetch(&this->_M_sum,
+            __atomic_load_n(&other._M_sum, __ATOMIC_RELAXED),
+            __ATOMIC_RELAXED);
+    __atomic_add_fetch(&this->_M_count,
+            __atomic_load_n(&other._M_count, __ATOMIC_RELAXED),
+            __ATOMIC_RELAXED);
+
+    while ((max > cur) && !__atomic_compare_exchange_n(&this->_M_max,
+            &cur, max, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/**
+ * @brief   Removes all samples.
+ */
+void LatencyHistogram::reset(void) throw()
+{
+    for (unsigned i = 0; i < _S_NUM_BUCKETS; ++i)
+        __atomic_store_n(&this->_M_buckets[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->_M_sum, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->_M_count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->_M_max, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Returns the number of recorded samples.
+ * @return  Number of samples.
+ */
+ElsUint64 LatencyHistogram::count(void) const throw()
+{
+    return __atomic_load_n(&this->_M_count, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Returns the largest recorded sample.
+ * @return  Exact maximum in nanoseconds, 0 if the histogram is empty.
+ */
+ElsUint64 LatencyHistogram::max(void) const throw()
+{
+    return __atomic_load_n(&this->_M_max, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Returns the arithmetic mean of recorded samples.
+ * @return  Exact mean in nanoseconds, 0 if the histogram is empty.
+ */
+ElsUint64 LatencyHistogram::mean(void) const throw()
+{
+    ElsUint64 count = this->count();
+
+    return count != 0
+            ? __atomic_load_n(&this->_M_sum, __ATOMIC_RELAXED) / count : 0;
+}
+
+/**
+ * @brief   Estimates a percentile of recorded samples.
+ * @param   pct     Percentile in range [0, 100].
+ * @return  Upper bound of the bucket containing the percentile, capped
+ *          by the maximum. 0 if the histogram is empty.
+ * @throw   InvalidArgument     If pct is out of range.
+ */
+ElsUint64 LatencyHistogram::percentile(double pct) const
+{
+    ElsUint64 total = 0;
+    ElsUint64 rank = 0;
+    ElsUint64 seen = 0;
+    ElsUint64 max = this->max();
+
+    if ((pct < 0.0) || (pct > 100.0))
+        throw except::InvalidArgument(
+                "Percentile must be in range [0, 100]");
+
+    for (unsigned i = 0; i < _S_NUM_BUCKETS; ++i)
+        total += __atomic_load_n(&this->_M_buckets[i], __ATOMIC_RELAXED);
+    if (total == 0)
+        return 0;
+
+    rank = static_cast<ElsUint64>(pct / 100.0 * total + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    for (unsigned i = 0; i < _S_NUM_BUCKETS; ++i)
+    {
+        seen += __atomic_load_n(&this->_M_buckets[i], __ATOMIC_RELAXED);
+        if (seen >= rank)
+            return _S_upperBound(i) < max ? _S_upperBound(i) : max;
+    }
+
+    return max;
+}
+
+/*
+ * Values below 4 get a bucket each, above that every power of two
+ * is split into four buckets indexed by the two bits following the most
+ * significant one.
+ */
+unsigned LatencyHistogram::_S_bucket(ElsUint64 ns) throw()
+{
+    unsigned msb = 0;
+
+    if (ns < 4)
+        return static_cast<unsigned>(ns);
+
+    msb = 63 - __builtin_clzll(ns);
+    return 4 + (msb - 2) * 4 + static_cast<unsigned>((ns >> (msb - 2)) & 3);
+}
+
+ElsUint64 LatencyHistogram::_S_upperBound(unsigned bucket) throw()
+{
+    unsigned shift = 0;
+    ElsUint64 sub = 0;
+
+    if (bucket < 4)
+        return bucket;
+
+    shift = (bucket - 4) / 4;
+    sub = (bucket - 4) % 4;
+    return ((4 + sub + 1) << shift) - 1;
+}
+
+ELS_END_NAMESPACE_2
+
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    McsLock.cpp
+ */
+
+#include <els/McsLock.hpp>
+#include "SpinHelpers.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+__thread McsLock::_T_Node* McsLock::_S_freeList = 0;
+__thread McsLock::_T_Node* McsLock::_S_allNodes = 0;
+
+namespace {
+
+/* Polls before giving up the CPU. */
+const unsigned maxSpins = 1000;
+
+::pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+::pthread_key_t nodeKey;
+
+void backoff(unsigned& spins)
+{
+    if (spins++ < spinLimit(maxSpins))
+        ELS_CPU_RELAX();
+    else
+        ::sched_yield();
+}
+
+}
+
+/**
+ * @brief   Constructor.
+ */
+McsLock::McsLock(void) throw()
+    : _M_tail(0),
+      _M_pad(),
+      _M_holder(0)
+{
+
+}
+
+/**
+ * @brief   Destructor.
+ */
+McsLock::~McsLock(void) throw()
+{
+
+}
+
+/**
+ * @brief   Acquires the lock, waiting for the threads queued before.
+ * @throw   std::bad_alloc  If the calling thread needs another queue
+ *                          node and there's no memory for it.
+ */
+void McsLock::lock(void)
+{
+    _T_Node* node = _S_getNode();
+    _T_Node* prev = 0;
+    unsigned spins = 0;
+
+    node->next = 0;
+    node->locked = 1;
+
+    prev = __atomic_exchange_n(&this->_M_tail, node, __ATOMIC_ACQ_REL);
+    if (prev != 0)
+    {
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+            backoff(spins);
+    }
+
+    this->_M_holder = node;
+}
+
+/**
+ * @brief   Acquires the lock if nobody holds or waits for it.
+ * @return  True if the lock has been acquired.
+ * @throw   std::bad_alloc  See lock().
+ */
+bool McsLock::trylock(void)
+{
+    _T_Node* node = _S_getNode();
+    _T_Node* expected = 0;
+
+    node->next = 0;
+    node->locked = 0;
+
+    if (!__atomic_compare_exchange_n(&this->_M_tail, &expected, node,
+            false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        _S_putNode(node);
+        return false;
+    }
+
+    this->_M_holder = node;
+    return true;
+}
+
+/**
+ * @brief   Releases the lock to the next thread in line.
+ */
+void McsLock::unlock(void) throw()
+{
+    _T_Node* node = this->_M_holder;
+    _T_Node* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    _T_Node* expected = node;
+    unsigned spins = 0;
+
+    if (next == 0)
+    {
+        if (__atomic_compare_exchange_n(&this->_M_tail, &expected, 0,
+                false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            _S_putNode(node);
+            return;
+        }
+
+        /* A successor swapped the tail but hasn't linked itself yet. */
+        while ((next = __atomic_load_n(&node->next,
+                __ATOMIC_ACQUIRE)) == 0)
+            backoff(spins);
+    }
+
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+    /* The successor never touches our node after linking itself. */
+    _S_putNode(node);
+}
+
+McsLock::_T_Node* McsLock::_S_getNode(void)
+{
+    _T_Node* node = _S_freeList;
+
+    if (node != 0)
+    {
+        _S_freeList = node->next;
+        return node;
+    }
+
+    if (::posix_memalign(reinterpret_cast<void**>(&node),
+            ELS_CACHELINE_SIZE, sizeof(_T_Node)) != 0)
+        throw std::bad_alloc();
+
+    node->chain = _S_allNodes;
+    _S_allNodes = node;
+
+    /* Frees the thread's nodes when it exits. */
+    ::pthread_once(&keyOnce, _S_createKey);
+    ::pthread_setspecific(nodeKey, node);
+
+    return node;
+}
+
+void McsLock::_S_putNode(_T_Node* node) throw()
+{
+    node->next = _S_freeList;
+    _S_freeList = node;
+}
+
+void McsLock::_S_createKey(void)
+{
+    ::pthread_key_create(&nodeKey, _S_freeNodes);
+}
+
+/*
+ * A thread exiting while holding a McsLock leaves a dangling node
+ * behind, just like it would leave the lock locked forever.
+ */
+void McsLock::_S_freeNodes(void* chain)
+{
+    _T_Node* node = static_cast<_T_Node*>(chain);
+    _T_Node* next = 0;
+
+    while (node != 0)
+    {
+        next = node->chain;
+        ::free(node);
+        node = next;
+    }
+}
+
+ELS_END_NAMESPACE_2
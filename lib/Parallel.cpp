@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    Parallel.cpp
+ */
+
+#include <els/Parallel.hpp>
+#include <els/AutoMutex.hpp>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+ELS_BEGIN_NAMESPACE_1(__parallel_detail)
+
+/*
+ * Scheduled with autoDelete, so the helper is counted out and the
+ * reference dropped whether it runs or is discarded by the pool.
+ */
+class RangeHelper : public IRunnable
+{
+public:
+
+    explicit RangeHelper(RangeTaskBase* task)
+        : IRunnable(),
+          _M_task(task)
+    {
+        this->_M_task->ref();
+    }
+
+    virtual ~RangeHelper(void)
+    {
+        this->_M_task->helperDone();
+        this->_M_task->unref();
+    }
+
+    virtual void run(void) throw()
+    {
+        this->_M_task->work();
+    }
+
+private:
+
+    RangeTaskBase* _M_task;
+
+    ELS_CLASS_UNCOPYABLE(RangeHelper);
+};
+
+RangeTaskBase::RangeTaskBase(ThreadPool& pool, size_t begin, size_t end,
+        size_t grain)
+    : _M_pool(pool),
+      _M_begin(begin),
+      _M_end(end),
+      _M_grain(grain),
+      _M_numChunks(0),
+      _M_nextChunk(0),
+      _M_doneChunks(0),
+      _M_refs(1),
+      _M_mutex(),
+      _M_cond(),
+      _M_finished(false),
+      _M_helpers(0)
+{
+    size_t count = end > begin ? end - begin : 0;
+
+    /* Four chunks per participant leave some room for load balancing. */
+    if (this->_M_grain == 0)
+        this->_M_grain = count / (4 * (pool.numWorkers() + 1));
+    if (this->_M_grain == 0)
+        this->_M_grain = 1;
+
+    this->_M_numChunks = (count + this->_M_grain - 1) / this->_M_grain;
+}
+
+RangeTaskBase::~RangeTaskBase(void)
+{
+
+}
+
+size_t RangeTaskBase::chunks(void) const
+{
+    return this->_M_numChunks;
+}
+
+/*
+ * Schedules helpers for the workers, takes part in the work right away
+ * if asked to and waits until all chunks are done. Helpers which never
+ * run - not queued, or queued and then discarded by the pool - leave
+ * their chunks unclaimed, so once all helpers are gone the caller takes
+ * whatever is left regardless of callerRuns.
+ */
+void RangeTaskBase::execute(bool callerRuns)
+{
+    std::vector<IRunnable*> helpers;
+    size_t numHelpers = this->_M_numChunks - (callerRuns ? 1 : 0);
+    size_t queued = 0;
+    bool finished = false;
+
+    if (numHelpers > this->_M_pool.numWorkers())
+        numHelpers = this->_M_pool.numWorkers();
+
+    this->_M_helpers = numHelpers;
+    for (size_t i = 0; i < numHelpers; ++i)
+        helpers.push_back(new RangeHelper(this));
+
+    queued = this->_M_pool.scheduleBatch(helpers.begin(), helpers.end(), true);
+    for (size_t i = queued; i < numHelpers; ++i)
+        delete helpers[i];
+
+    if (callerRuns)
+        this->work();
+
+    if (__atomic_load_n(&this->_M_doneChunks, __ATOMIC_ACQUIRE)
+            == this->_M_numChunks)
+        return;
+
+    this->_M_mutex.lock();
+    while (!this->_M_finished && (this->_M_helpers != 0))
+        this->_M_cond.block(this->_M_mutex);
+    finished = this->_M_finished;
+    this->_M_mutex.unlock();
+
+    /* No helper is left to finish the remaining chunks. */
+    if (!finished)
+        this->work();
+}
+
+void RangeTaskBase::work(void)
+{
+    size_t chunk = 0;
+    size_t begin = 0;
+    size_t end = 0;
+
+    while ((chunk = __atomic_fetch_add(&this->_M_nextChunk, 1,
+            __ATOMIC_RELAXED)) < this->_M_numChunks)
+    {
+        begin = this->_M_begin + chunk * this->_M_grain;
+        end = begin + this->_M_grain < this->_M_end
+                ? begin + this->_M_grain : this->_M_end;
+        this->_M_runChunk(chunk, begin, end);
+
+        if (__atomic_add_fetch(&this->_M_doneChunks, 1, __ATOMIC_ACQ_REL)
+                == this->_M_numChunks)
+        {
+            this->_M_mutex.lock();
+            this->_M_finished = true;
+            this->_M_cond.unblockAll();
+            this->_M_mutex.unlock();
+        }
+    }
+}
+
+void RangeTaskBase::helperDone(void)
+{
+    AutoMutex am(this->_M_mutex);
+
+    if (--this->_M_helpers == 0)
+        this->_M_cond.unblockAll();
+}
+
+void RangeTaskBase::ref(void)
+{
+    this->_M_refs.inc();
+}
+
+void RangeTaskBase::unref(void)
+{
+    if (this->_M_refs.dec() == 0)
+        delete this;
+}
+
+ELS_END_NAMESPACE_1
+
+ELS_END_NAMESPACE_2
+
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    Rcu.cpp
+ */
+
+#include <els/Rcu.hpp>
+#include <els/Mutex.hpp>
+#include <els/AutoMutex.hpp>
+#include <els/Exception.hpp>
+
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+__thread Rcu::_T_Reader* Rcu::_S_reader = 0;
+Rcu::_T_Reader* Rcu::_S_readers = 0;
+size_t Rcu::_S_epoch = 1;
+bool Rcu::_S_membarrier = false;
+
+namespace {
+
+typedef std::vector<std::pair<Rcu::Callback, void*> > CallbackList;
+
+/* Number of callbacks queued by call() before a grace period is run. */
+const size_t callbackBatch = 64;
+const unsigned maxSpins = 128;
+
+::pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+::pthread_key_t readerKey;
+
+/*
+ * Function statics, so that static objects can use RCU from their
+ * constructors and destructors.
+ */
+Mutex& gracePeriodMutex(void)
+{
+    static Mutex mutex;
+    return mutex;
+}
+
+Mutex& callbackMutex(void)
+{
+    static Mutex mutex;
+    return mutex;
+}
+
+CallbackList& pendingCallbacks(void)
+{
+    static CallbackList callbacks;
+    return callbacks;
+}
+
+long membarrier(int cmd)
+{
+    return ::syscall(__NR_membarrier, cmd, 0);
+}
+
+void runCallbacks(const CallbackList& callbacks)
+{
+    for (size_t i = 0; i < callbacks.size(); ++i)
+        callbacks[i].first(callbacks[i].second);
+}
+
+}
+
+/**
+ * @brief   Waits until every read-side section that was running when
+ *          the call was made has ended.
+ * @throw   LogicError  If called from inside a read-side section, which
+ *                      would wait for itself.
+ *
+ * Sections started during the call aren't waited for, they can't see
+ * data unpublished before it. Concurrent calls are serialized.
+ */
+void Rcu::synchronize(void)
+{
+    _T_Reader* reader = 0;
+    size_t epoch = 0;
+    size_t seen = 0;
+    unsigned spins = 0;
+
+    if (inReadSection())
+        except::throwLogicError(
+                "Rcu::synchronize() called in a read-side section");
+
+    ::pthread_once(&initOnce, _S_init);
+
+    AutoMutex lock(gracePeriodMutex());
+
+    /*
+     * Either a reader's epoch store is visible to the scan below or
+     * the reader sees every store made before this call.
+     */
+    _S_writerFence();
+    epoch = __atomic_add_fetch(&_S_epoch, 1, __ATOMIC_RELAXED);
+
+    for (reader = __atomic_load_n(&_S_readers, __ATOMIC_ACQUIRE);
+            reader != 0; reader = reader->next)
+    {
+        for (spins = 0; ; ++spins)
+        {
+            seen = __atomic_load_n(&reader->epoch, __ATOMIC_ACQUIRE);
+            if (seen == 0 || seen >= epoch)
+                break;
+
+            if (spins < maxSpins)
+                ELS_CPU_RELAX();
+            else
+                ::sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief   Calls func(arg) after a grace period, e.g. to free an object
+ *          unpublished by the caller.
+ * @param   func    Callback.
+ * @param   arg     Argument passed to the callback.
+ *
+ * Callbacks are queued and run in batches by the thread whose call()
+ * fills the batch, outside of any read-side section. Use barrier() to
+ * run the queued ones right away.
+ */
+void Rcu::call(Callback func, void* arg)
+{
+    CallbackList batch;
+
+    {
+        AutoMutex lock(callbackMutex());
+
+        pendingCallbacks().push_back(std::make_pair(func, arg));
+        if (pendingCallbacks().size() < callbackBatch || inReadSection())
+            return;
+
+        batch.swap(pendingCallbacks());
+    }
+
+    synchronize();
+    runCallbacks(batch);
+}
+
+/**
+ * @brief   Waits for a grace period and runs all queued callbacks.
+ * @throw   LogicError  If called from inside a read-side section.
+ */
+void Rcu::barrier(void)
+{
+    CallbackList batch;
+
+    if (inReadSection())
+        except::throwLogicError(
+                "Rcu::barrier() called in a read-side section");
+
+    {
+        AutoMutex lock(callbackMutex());
+
+        batch.swap(pendingCallbacks());
+    }
+
+    synchronize();
+    runCallbacks(batch);
+}
+
+/**
+ * @brief   Tells whether readers run without memory fences.
+ * @return  True if the membarrier() system call is used.
+ */
+bool Rcu::usesMembarrier(void) throw()
+{
+    ::pthread_once(&initOnce, _S_init);
+
+    return _S_membarrier;
+}
+
+Rcu::_T_Reader* Rcu::_S_registerReader(void) throw()
+{
+    _T_Reader* reader = 0;
+    int unused = 0;
+
+    ::pthread_once(&initOnce, _S_init);
+
+    for (reader = __atomic_load_n(&_S_readers, __ATOMIC_ACQUIRE);
+            reader != 0; reader = reader->next)
+    {
+        unused = 0;
+        if (__atomic_compare_exchange_n(&reader->used, &unused, 1,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (reader == 0)
+    {
+        /* readLock() can't fail, there's no way to report it. */
+        if (::posix_memalign(reinterpret_cast<void**>(&reader),
+                ELS_CACHELINE_SIZE, sizeof(_T_Reader)) != 0)
+            ::abort();
+
+        reader->epoch = 0;
+        reader->nesting = 0;
+        reader->used = 1;
+        reader->next = __atomic_load_n(&_S_readers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&_S_readers, &reader->next,
+                reader, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    /* Hands the slot back when the thread exits. */
+    ::pthread_setspecific(readerKey, reader);
+    _S_reader = reader;
+
+    return reader;
+}
+
+void Rcu::_S_releaseReader(void* ptr)
+{
+    _T_Reader* reader = static_cast<_T_Reader*>(ptr);
+
+    reader->nesting = 0;
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&reader->used, 0, __ATOMIC_RELEASE);
+}
+
+void Rcu::_S_init(void)
+{
+    ::pthread_key_create(&readerKey, _S_releaseReader);
+
+    /* Readers registered from now on can rely on the flag. */
+    if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED) == 0)
+        _S_membarrier = true;
+}
+
+void Rcu::_S_writerFence(void) throw()
+{
+    if (_S_membarrier && membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED) == 0)
+        return;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+ELS_END_NAMESPACE_2
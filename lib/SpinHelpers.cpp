@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    SpinHelpers.cpp
+ */
+
+#include "SpinHelpers.hpp"
+
+#include <unistd.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+/*
+ * Spinning only delays the lock holder if it has to share our CPU,
+ * so lock waiters on a single CPU system give it up right away.
+ */
+unsigned spinLimit(unsigned maxSpins) throw()
+{
+    static const bool multiCpu = ::sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+    return multiCpu ? maxSpins : 0;
+}
+
+ELS_END_NAMESPACE_2
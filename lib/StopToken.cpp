@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    StopToken.cpp
+ */
+
+#include <els/StopToken.hpp>
+#include <els/Atomic.hpp>
+#include <els/Mutex.hpp>
+#include <els/Condition.hpp>
+
+#include <algorithm>
+#include <list>
+#include <pthread.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+struct StopToken::_T_State
+{
+    _T_State(void)
+        : refs(1), stopped(0), mutex(), cond(),
+          callbacks(), running(0), runner()
+    {
+
+    }
+
+    AtomicInt refs;
+    int stopped;
+    Mutex mutex;
+    Condition cond;
+    std::list<IRunnable*> callbacks;
+    /* Callback being run by requestStop() and the thread running it. */
+    IRunnable* running;
+    ::pthread_t runner;
+};
+
+/**
+ * @brief   Creates a new token, with no stop requested.
+ */
+StopToken::StopToken(void)
+    : _M_state(new _T_State)
+{
+
+}
+
+/**
+ * @brief   Creates a token sharing the state of other.
+ * @param   other       Token to copy.
+ */
+StopToken::StopToken(const StopToken& other)
+    : _M_state(_S_ref(other._M_state))
+{
+
+}
+
+StopToken& StopToken::operator =(const StopToken& other)
+{
+    _T_State* state = _S_ref(other._M_state);
+
+    _S_unref(this->_M_state);
+    this->_M_state = state;
+
+    return *this;
+}
+
+StopToken::~StopToken(void)
+{
+    _S_unref(this->_M_state);
+}
+
+/**
+ * @brief   Requests a stop and runs the registered callbacks.
+ * @return  True if this call made the request, false if a stop had
+ *          already been requested.
+ */
+bool StopToken::requestStop(void)
+{
+    _T_State* state = this->_M_state;
+    IRunnable* callback = 0;
+
+    if ((state == 0)
+            || (__atomic_exchange_n(&state->stopped, 1, __ATOMIC_ACQ_REL) != 0))
+        return false;
+
+    state->mutex.lock();
+    state->runner = ::pthread_self();
+    while (!state->callbacks.empty())
+    {
+        callback = state->callbacks.front();
+        state->callbacks.pop_front();
+        state->running = callback;
+        state->mutex.unlock();
+
+        callback->run();
+
+        state->mutex.lock();
+        state->running = 0;
+        state->cond.unblockAll();
+    }
+    state->mutex.unlock();
+
+    return true;
+}
+
+/**
+ * @brief   Checks if a stop has been requested.
+ * @return  True if requestStop() has been called on this token
+ *          or its copies.
+ */
+bool StopToken::stopRequested(void) const throw()
+{
+    return _S_stopped(this->_M_state);
+}
+
+/**
+ * @brief   Registers a callback run when a stop is requested.
+ * @param   callback    Callback, runs at most once. The caller keeps
+ *                      the ownership.
+ */
+void StopToken::addCallback(IRunnable* callback)
+{
+    _T_State* state = this->_M_state;
+
+    if (state == 0)
+        return;
+
+    state->mutex.lock();
+    if (!__atomic_load_n(&state->stopped, __ATOMIC_ACQUIRE))
+    {
+        state->callbacks.push_back(callback);
+        state->mutex.unlock();
+        return;
+    }
+    state->mutex.unlock();
+
+    callback->run();
+}
+
+/**
+ * @brief   Unregisters a callback.
+ * @param   callback    Callback passed to addCallback().
+ *
+ * If the callback is running in another thread, waits for it to return.
+ * Unregistering a callback from within itself doesn't wait.
+ */
+void StopToken::removeCallback(IRunnable* callback)
+{
+    _T_State* state = this->_M_state;
+    std::list<IRunnable*>::iterator it;
+
+    if (state == 0)
+        return;
+
+    state->mutex.lock();
+    it = std::find(state->callbacks.begin(), state->callbacks.end(),
+            callback);
+    if (it != state->callbacks.end())
+    {
+        state->callbacks.erase(it);
+    }
+    else
+    {
+        while ((state->running == callback)
+                && !::pthread_equal(state->runner, ::pthread_self()))
+            state->cond.block(state->mutex);
+    }
+    state->mutex.unlock();
+}
+
+/*
+ * Tokens without state are never stopped. Only ThreadPool creates them -
+ * it's what a TaskAttr without a cancel token holds, so that scheduling
+ * doesn't allocate.
+ */
+StopToken::StopToken(_T_State* state)
+    : _M_state(state)
+{
+
+}
+
+StopToken::_T_State* StopToken::_S_ref(_T_State* state) throw()
+{
+    if (state != 0)
+        state->refs.inc();
+
+    return state;
+}
+
+void StopToken::_S_unref(_T_State* state) throw()
+{
+    if ((state != 0) && (state->refs.dec() == 0))
+        delete state;
+}
+
+bool StopToken::_S_stopped(const _T_State* state) throw()
+{
+    return (state != 0) && __atomic_load_n(&state->stopped, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief   Adds callback to token.
+ * @param   token       Token to watch.
+ * @param   callback    Callback to run, must outlive this object.
+ */
+StopCallback::StopCallback(const StopToken& token, IRunnable& callback)
+    : _M_token(token),
+      _M_callback(callback)
+{
+    this->_M_token.addCallback(&this->_M_callback);
+}
+
+StopCallback::~StopCallback(void)
+{
+    this->_M_token.removeCallback(&this->_M_callback);
+}
+
+ELS_END_NAMESPACE_2
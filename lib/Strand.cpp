@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    Strand.cpp
+ */
+
+#include <els/Strand.hpp>
+#include <els/ThreadPool.hpp>
+#include <els/AutoMutex.hpp>
+#include <els/Exception.hpp>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+const size_t Strand::DEF_BATCH_SIZE = 32;
+
+__thread const Strand* Strand::_S_current = 0;
+
+/*
+ * Scheduled with autoDelete. If the pool doesn't run it - evicted under
+ * OVERFLOW_DROP_OLDEST or thrown away with the pool - the strand is run
+ * by whichever thread deletes it, as it would otherwise stay scheduled
+ * forever.
+ */
+class Strand::_T_Runner : public IRunnable
+{
+public:
+
+    explicit _T_Runner(Strand* strand)
+        : IRunnable(),
+          _M_strand(strand)
+    {
+
+    }
+
+    virtual ~_T_Runner(void)
+    {
+        if (this->_M_strand != 0)
+            this->_M_strand->_M_run();
+    }
+
+    virtual void run(void) throw()
+    {
+        Strand* strand = this->_M_strand;
+
+        this->_M_strand = 0;
+        strand->_M_run();
+    }
+
+    void release(void)
+    {
+        this->_M_strand = 0;
+    }
+
+private:
+
+    Strand* _M_strand;
+
+    ELS_CLASS_UNCOPYABLE(_T_Runner);
+};
+
+/**
+ * @brief   Creates an idle strand.
+ * @param   pool        Pool running the tasks. Must outlive the strand.
+ * @param   batchSize   Maximum number of tasks run before the worker
+ *                      is yielded back to the pool.
+ * @throw   InvalidArgument     If batchSize is 0.
+ */
+Strand::Strand(ThreadPool& pool, size_t batchSize)
+    : _M_pool(pool),
+      _M_batchSize(batchSize),
+      _M_head(0),
+      _M_tail(0),
+      _M_pending(0),
+      _M_scheduled(false),
+      _M_mutex(),
+      _M_idleCond()
+{
+    if (batchSize == 0)
+        throw except::InvalidArgument("Batch size must not be 0");
+}
+
+/**
+ * @brief   Destructor - waits for all pending tasks to run.
+ */
+Strand::~Strand(void)
+{
+    this->drain();
+}
+
+/**
+ * @brief   Queues a task.
+ * @param   task        Task to run.
+ * @param   autoDelete  If true, the task is deleted after it has run.
+ *
+ * Safe to call from any thread, including from tasks running in this
+ * strand. If the pool rejects the strand because its bounded queue
+ * is full, the tasks are run by the calling thread. If the pool
+ * discards the queued strand, e.g. evicts it under OVERFLOW_DROP_OLDEST,
+ * they are run by the thread which made it do so.
+ */
+void Strand::post(IRunnable* task, bool autoDelete)
+{
+    _T_Task* node = new _T_Task;
+    bool schedule = false;
+
+    node->runnable = task;
+    node->autoDelete = autoDelete;
+    node->next = 0;
+
+    this->_M_mutex.lock();
+    if (this->_M_tail == 0)
+        this->_M_head = node;
+    else
+        this->_M_tail->next = node;
+    this->_M_tail = node;
+    __atomic_add_fetch(&this->_M_pending, 1, __ATOMIC_RELAXED);
+    schedule = !this->_M_scheduled;
+    this->_M_scheduled = true;
+    this->_M_mutex.unlock();
+
+    if (schedule)
+        this->_M_schedule();
+}
+
+/**
+ * @brief   Blocks until all tasks posted so far have run.
+ * @throw   LogicError  If called from a task running in this strand.
+ */
+void Strand::drain(void)
+{
+    if (this->runningInThisThread())
+        except::throwLogicError("Strand can't drain itself");
+
+    AutoMutex am(this->_M_mutex);
+    while (this->_M_scheduled)
+        this->_M_idleCond.block(this->_M_mutex);
+}
+
+/**
+ * @brief   Returns the number of tasks waiting to run.
+ * @return  Number of pending tasks.
+ */
+size_t Strand::pending(void) const
+{
+    return __atomic_load_n(&this->_M_pending, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Checks whether the calling thread is running a task
+ *          of this strand.
+ * @return  True if called from within one of the strand's tasks.
+ */
+bool Strand::runningInThisThread(void) const
+{
+    return (_S_current == this);
+}
+
+/*
+ * Takes a batch of tasks at a time under a single lock. The strand stays
+ * marked as scheduled for as long as there are tasks left, so that
+ * post() never schedules it for the second time. If the pool rejects
+ * the strand, the next batch is run right away in this thread.
+ */
+void Strand::_M_run(void) throw()
+{
+    _T_Task* batch = 0;
+    _T_Task* node = 0;
+    const Strand* previous = _S_current;
+
+    do
+    {
+        this->_M_mutex.lock();
+        batch = this->_M_head;
+        node = batch;
+        for (size_t i = 1; (node != 0) && (i < this->_M_batchSize); ++i)
+            node = node->next;
+        if (node == 0)
+        {
+            this->_M_head = 0;
+            this->_M_tail = 0;
+        }
+        else
+        {
+            this->_M_head = node->next;
+            if (this->_M_head == 0)
+                this->_M_tail = 0;
+            node->next = 0;
+        }
+        this->_M_mutex.unlock();
+
+        _S_current = this;
+        while (batch != 0)
+        {
+            node = batch;
+            batch = batch->next;
+            node->runnable->run();
+            if (node->autoDelete)
+                delete node->runnable;
+            delete node;
+            __atomic_sub_fetch(&this->_M_pending, 1, __ATOMIC_RELAXED);
+        }
+        _S_current = previous;
+
+        this->_M_mutex.lock();
+        if (this->_M_head == 0)
+        {
+            this->_M_scheduled = false;
+            this->_M_idleCond.unblockAll();
+            this->_M_mutex.unlock();
+            return;
+        }
+        this->_M_mutex.unlock();
+    }
+    while (!this->_M_trySchedule());
+}
+
+void Strand::_M_schedule(void)
+{
+    if (!this->_M_trySchedule())
+        this->_M_run();
+}
+
+/*
+ * Returns false if the strand couldn't be queued and has to be run
+ * by the caller.
+ */
+bool Strand::_M_trySchedule(void)
+{
+    _T_Runner* runner = 0;
+
+    try
+    {
+        runner = new _T_Runner(this);
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    if (this->_M_pool.schedule(runner, true))
+        return true;
+
+    runner->release();
+    delete runner;
+    return false;
+}
+
+/**
+ * @brief   Creates a set of strands.
+ * @param   pool        Pool running the tasks. Must outlive the strands.
+ * @param   numStrands  Number of strands.
+ * @param   batchSize   See Strand::Strand().
+ * @throw   InvalidArgument     If numStrands or batchSize is 0.
+ */
+KeyedStrands::KeyedStrands(ThreadPool& pool, size_t numStrands,
+        size_t batchSize)
+    : _M_strands()
+{
+    if (numStrands == 0)
+        throw except::InvalidArgument("Number of strands must not be 0");
+
+    try
+    {
+        for (size_t i = 0; i < numStrands; ++i)
+            this->_M_strands.push_back(new Strand(pool, batchSize));
+    }
+    catch (...)
+    {
+        for (size_t i = 0; i < this->_M_strands.size(); ++i)
+            delete this->_M_strands[i];
+        throw;
+    }
+}
+
+/**
+ * @brief   Destructor - waits for all pending tasks to run.
+ */
+KeyedStrands::~KeyedStrands(void)
+{
+    for (_T_StrandList::iterator it = this->_M_strands.begin();
+            it != this->_M_strands.end(); ++it)
+        delete *it;
+}
+
+/**
+ * @brief   Queues a task in the strand assigned to key.
+ * @param   key         Key of the serialized context, e.g. a connection
+ *                      or device identifier.
+ * @param   task        Task to run.
+ * @param   autoDelete  If true, the task is deleted after it has run.
+ */
+void KeyedStrands::post(size_t key, IRunnable* task, bool autoDelete)
+{
+    this->strand(key).post(task, autoDelete);
+}
+
+/**
+ * @brief   Returns the strand assigned to a key.
+ * @param   key     Key of the serialized context.
+ * @return  Reference to the strand.
+ */
+Strand& KeyedStrands::strand(size_t key)
+{
+    /* Fibonacci hashing - spreads sequential keys evenly. */
+    ElsUint64 hash = static_cast<ElsUint64>(key) * 11400714819323198485ULL;
+
+    return *this->_M_strands[(hash >> 32) % this->_M_strands.size()];
+}
+
+size_t KeyedStrands::size(void) const
+{
+    return this->_M_strands.size();
+}
+
+/**
+ * @brief   Blocks until all tasks posted so far to any strand have run.
+ */
+void KeyedStrands::drain(void)
+{
+    for (_T_StrandList::iterator it = this->_M_strands.begin();
+            it != this->_M_strands.end(); ++it)
+        (*it)->drain();
+}
+
+ELS_END_NAMESPACE_2
+
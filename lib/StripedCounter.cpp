@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    StripedCounter.cpp
+ */
+
+#include <els/StripedCounter.hpp>
+#include <els/Exception.hpp>
+
+#include <unistd.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+__thread size_t StripedCounter::_S_threadSlot = 0;
+
+/**
+ * @brief   Creates a counter set to 0.
+ * @param   slots       Number of slots, rounded up to a power of two.
+ *                      0 means one per configured CPU.
+ * @param   policy      How updating threads are spread over slots.
+ * @param   approximate Use unlocked updates which may get lost,
+ *                      only safe with a slot per updating thread.
+ * @throw   InvalidArgument     Approximate updates with STRIPE_BY_CPU.
+ *
+ * Every slot takes a cache line. With STRIPE_BY_THREAD, use at least
+ * as many slots as there are updating threads.
+ */
+StripedCounter::StripedCounter(size_t slots, StripePolicy policy,
+        bool approximate)
+    : _M_slots(0),
+      _M_mask(0),
+      _M_policy(policy),
+      _M_approximate(approximate)
+{
+    size_t size = 1;
+    long cpus = 0;
+
+    if (approximate && (policy == STRIPE_BY_CPU))
+        throw except::InvalidArgument(
+                "Approximate updates require STRIPE_BY_THREAD");
+
+    if (slots == 0)
+    {
+        cpus = ::sysconf(_SC_NPROCESSORS_CONF);
+        slots = cpus > 0 ? cpus : 1;
+    }
+
+    while (size < slots)
+        size <<= 1;
+
+    this->_M_slots = new _T_Slot[size];
+    this->_M_mask = size - 1;
+    this->reset();
+}
+
+StripedCounter::~StripedCounter(void)
+{
+    delete[] this->_M_slots;
+}
+
+/**
+ * @brief   Sums all slots.
+ * @return  Current value.
+ */
+ElsInt64 StripedCounter::get(void) const throw()
+{
+    ElsInt64 sum = 0;
+
+    for (size_t i = 0; i <= this->_M_mask; ++i)
+        sum += __atomic_load_n(&this->_M_slots[i].value, __ATOMIC_RELAXED);
+
+    return sum;
+}
+
+/**
+ * @brief   Sets the counter to 0. Updates made at the same time may or
+ *          may not survive.
+ */
+void StripedCounter::reset(void) throw()
+{
+    for (size_t i = 0; i <= this->_M_mask; ++i)
+        __atomic_store_n(&this->_M_slots[i].value, 0, __ATOMIC_RELAXED);
+}
+
+size_t StripedCounter::slots(void) const throw()
+{
+    return this->_M_mask + 1;
+}
+
+StripedCounter::StripePolicy StripedCounter::policy(void) const throw()
+{
+    return this->_M_policy;
+}
+
+bool StripedCounter::approximate(void) const throw()
+{
+    return this->_M_approximate;
+}
+
+/* Threads get consecutive slots, never 0 which marks an unassigned one. */
+size_t StripedCounter::_S_nextThreadSlot(void) throw()
+{
+    static size_t next = 0;
+
+    return __atomic_add_fetch(&next, 1, __ATOMIC_RELAXED);
+}
+
+ELS_END_NAMESPACE_2
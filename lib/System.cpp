@@ -28,6 +28,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <cstring>
+#include <ctime>
 
 extern char** environ;
 
@@ -118,6 +119,17 @@ void libcFree(void* ptr)
     ::free(ptr);
 }
 
-ELS_END_NAMESPACE_2
+/**
+ * @brief   Reads the monotonic clock.
+ * @return  Nanoseconds since an unspecified point in the past. Only
+ *          differences between two readings are meaningful.
+ */
+ElsUint64 monotonicNs(void) throw()
+{
+    ::timespec ts;
 
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<ElsUint64>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
 
+ELS_END_NAMESPACE_2
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    TaskGraph.cpp
+ */
+
+#include <els/TaskGraph.hpp>
+#include <els/ThreadPool.hpp>
+#include <els/AutoMutex.hpp>
+#include <els/Exception.hpp>
+#include <els/System.hpp>
+
+#include <algorithm>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+namespace {
+
+/*
+ * Scheduled with autoDelete. If the pool doesn't run it - the queue was
+ * full, or it was evicted under OVERFLOW_DROP_OLDEST or thrown away
+ * with the pool - the node is run by whichever thread deletes it, as
+ * the graph would otherwise wait for it forever.
+ */
+class NodeRunner : public IRunnable
+{
+public:
+
+    explicit NodeRunner(IRunnable* node)
+        : IRunnable(),
+          _M_node(node)
+    {
+
+    }
+
+    virtual ~NodeRunner(void)
+    {
+        if (this->_M_node != 0)
+            this->_M_node->run();
+    }
+
+    virtual void run(void) throw()
+    {
+        IRunnable* node = this->_M_node;
+
+        this->_M_node = 0;
+        node->run();
+    }
+
+private:
+
+    IRunnable* _M_node;
+
+    ELS_CLASS_UNCOPYABLE(NodeRunner);
+};
+
+}
+
+/**
+ * @brief   Creates an empty graph.
+ * @param   pool    Pool running the nodes. Must outlive the graph.
+ */
+TaskGraph::TaskGraph(ThreadPool& pool)
+    : _M_pool(pool),
+      _M_nodes(),
+      _M_order(),
+      _M_roots(),
+      _M_prepared(false),
+      _M_running(false),
+      _M_remaining(0),
+      _M_finished(false),
+      _M_mutex(),
+      _M_cond(),
+      _M_lastRunTime(0),
+      _M_criticalEnd(0)
+{
+
+}
+
+TaskGraph::~TaskGraph(void)
+{
+    for (_T_NodeList::iterator it = this->_M_nodes.begin();
+            it != this->_M_nodes.end(); ++it)
+        delete *it;
+}
+
+/**
+ * @brief   Adds a node to the graph.
+ * @param   task        Task run by the node, on every run of the graph.
+ * @param   name        Name of the node, for diagnostics.
+ * @param   autoDelete  If true, task is deleted together with the graph.
+ * @return  Identifier of the new node.
+ * @throw   LogicError  If the graph is running.
+ */
+TaskGraph::NodeId TaskGraph::addNode(IRunnable* task, const std::string& name,
+        bool autoDelete)
+{
+    if (this->_M_running)
+        except::throwLogicError("TaskGraph is running");
+
+    this->_M_nodes.push_back(new _T_Node(this, this->_M_nodes.size(),
+            task, name, autoDelete));
+    this->_M_prepared = false;
+
+    return this->_M_nodes.size() - 1;
+}
+
+/**
+ * @brief   Makes one node depend on another.
+ * @param   from    Node which must finish first.
+ * @param   to      Node which runs after from has finished.
+ * @throw   InvalidArgument     If any of the nodes doesn't exist.
+ * @throw   LogicError  If the graph is running.
+ *
+ * Cycles are only detected by the next call to run().
+ */
+void TaskGraph::addEdge(NodeId from, NodeId to)
+{
+    _T_Node* fromNode = this->_M_node(from);
+    _T_Node* toNode = this->_M_node(to);
+
+    if (this->_M_running)
+        except::throwLogicError("TaskGraph is running");
+
+    fromNode->_M_successors.push_back(toNode);
+    ++toNode->_M_numPredecessors;
+    this->_M_prepared = false;
+}
+
+size_t TaskGraph::size(void) const
+{
+    return this->_M_nodes.size();
+}
+
+const std::string& TaskGraph::name(NodeId node) const
+{
+    return this->_M_node(node)->_M_name;
+}
+
+/**
+ * @brief   Runs all nodes of the graph and waits until they're done.
+ * @throw   LogicError  If the graph contains a cycle or is already
+ *                      running.
+ *
+ * The calling thread runs the first root node (and whichever nodes it
+ * unblocks) itself. If the pool isn't running, all nodes are run by
+ * the calling thread in dependency order.
+ */
+void TaskGraph::run(void)
+{
+    ElsUint64 start = 0;
+
+    if (this->_M_running)
+        except::throwLogicError("TaskGraph is running");
+    if (!this->_M_prepared)
+        this->_M_prepare();
+    if (this->_M_nodes.empty())
+        return;
+
+    for (_T_NodeList::iterator it = this->_M_nodes.begin();
+            it != this->_M_nodes.end(); ++it)
+        (*it)->_M_pending = (*it)->_M_numPredecessors;
+    this->_M_remaining = this->_M_nodes.size();
+    this->_M_finished = false;
+    this->_M_running = true;
+
+    start = sys::monotonicNs();
+    if (this->_M_pool.numWorkers() == 0)
+    {
+        this->_M_runSerial();
+    }
+    else
+    {
+        for (size_t i = 1; i < this->_M_roots.size(); ++i)
+            this->_M_schedule(this->_M_roots[i]);
+        this->_M_roots[0]->run();
+
+        AutoMutex am(this->_M_mutex);
+        while (!this->_M_finished)
+            this->_M_cond.block(this->_M_mutex);
+    }
+    this->_M_lastRunTime = sys::monotonicNs() - start;
+
+    this->_M_computeCriticalPath();
+    this->_M_running = false;
+}
+
+/**
+ * @brief   Returns the wall-clock duration of the last run.
+ * @return  Time in nanoseconds.
+ */
+ElsUint64 TaskGraph::lastRunTime(void) const
+{
+    return this->_M_lastRunTime;
+}
+
+/**
+ * @brief   Returns how long a node's task took in the last run.
+ * @param   node    Node identifier.
+ * @return  Time in nanoseconds.
+ */
+ElsUint64 TaskGraph::nodeTime(NodeId node) const
+{
+    return this->_M_node(node)->_M_duration;
+}
+
+/**
+ * @brief   Returns the total duration of the nodes on the critical path
+ *          measured in the last run.
+ * @return  Time in nanoseconds. The difference between this and
+ *          lastRunTime() is the scheduling overhead and the time nodes
+ *          spent waiting for a worker.
+ */
+ElsUint64 TaskGraph::criticalPathTime(void) const
+{
+    return this->_M_criticalEnd != 0 ? this->_M_criticalEnd->_M_pathTime : 0;
+}
+
+/**
+ * @brief   Returns the longest chain of dependent nodes measured
+ *          in the last run.
+ * @return  Node identifiers in execution order.
+ */
+std::vector<TaskGraph::NodeId> TaskGraph::criticalPath(void) const
+{
+    std::vector<NodeId> path;
+
+    for (_T_Node* node = this->_M_criticalEnd; node != 0;
+            node = node->_M_pathPrev)
+        path.push_back(node->_M_id);
+    std::reverse(path.begin(), path.end());
+
+    return path;
+}
+
+TaskGraph::_T_Node* TaskGraph::_M_node(NodeId node) const
+{
+    if (node >= this->_M_nodes.size())
+        throw except::InvalidArgument("No such node: %zu", node);
+
+    return this->_M_nodes[node];
+}
+
+/*
+ * Topological sort (Kahn's algorithm) - gives the root nodes, detects
+ * cycles and yields the order used for the critical path computation.
+ */
+void TaskGraph::_M_prepare(void)
+{
+    _T_Node* node = 0;
+
+    this->_M_order.clear();
+    this->_M_roots.clear();
+    for (_T_NodeList::iterator it = this->_M_nodes.begin();
+            it != this->_M_nodes.end(); ++it)
+    {
+        (*it)->_M_pending = (*it)->_M_numPredecessors;
+        if ((*it)->_M_numPredecessors == 0)
+        {
+            this->_M_roots.push_back(*it);
+            this->_M_order.push_back(*it);
+        }
+    }
+
+    for (size_t i = 0; i < this->_M_order.size(); ++i)
+    {
+        node = this->_M_order[i];
+        for (_T_NodeList::iterator it = node->_M_successors.begin();
+                it != node->_M_successors.end(); ++it)
+        {
+            if (--(*it)->_M_pending == 0)
+                this->_M_order.push_back(*it);
+        }
+    }
+
+    if (this->_M_order.size() != this->_M_nodes.size())
+        except::throwLogicError("TaskGraph contains a cycle");
+
+    this->_M_prepared = true;
+}
+
+void TaskGraph::_M_runSerial(void)
+{
+    ElsUint64 start = 0;
+
+    for (_T_NodeList::iterator it = this->_M_order.begin();
+            it != this->_M_order.end(); ++it)
+    {
+        start = sys::monotonicNs();
+        (*it)->_M_task->run();
+        (*it)->_M_duration = sys::monotonicNs() - start;
+    }
+}
+
+void TaskGraph::_M_schedule(_T_Node* node)
+{
+    NodeRunner* runner = 0;
+
+    try
+    {
+        runner = new NodeRunner(node);
+    }
+    catch (...)
+    {
+        node->run();
+        return;
+    }
+
+    /* Rejected by a full bounded queue - the runner runs it here. */
+    if (!this->_M_pool.schedule(runner, true))
+        delete runner;
+}
+
+void TaskGraph::_M_finishNode(void)
+{
+    if (__atomic_sub_fetch(&this->_M_remaining, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    this->_M_mutex.lock();
+    this->_M_finished = true;
+    this->_M_cond.unblockAll();
+    this->_M_mutex.unlock();
+}
+
+void TaskGraph::_M_computeCriticalPath(void)
+{
+    _T_Node* node = 0;
+
+    this->_M_criticalEnd = 0;
+    for (_T_NodeList::iterator it = this->_M_order.begin();
+            it != this->_M_order.end(); ++it)
+    {
+        (*it)->_M_pathTime = 0;
+        (*it)->_M_pathPrev = 0;
+    }
+
+    /* Before a node is visited, _M_pathTime holds the longest incoming path. */
+    for (_T_NodeList::iterator it = this->_M_order.begin();
+            it != this->_M_order.end(); ++it)
+    {
+        node = *it;
+        node->_M_pathTime += node->_M_duration;
+        if ((this->_M_criticalEnd == 0)
+                || (node->_M_pathTime > this->_M_criticalEnd->_M_pathTime))
+            this->_M_criticalEnd = node;
+
+        for (_T_NodeList::iterator st = node->_M_successors.begin();
+                st != node->_M_successors.end(); ++st)
+        {
+            if ((*st)->_M_pathPrev == 0
+                    || (node->_M_pathTime > (*st)->_M_pathTime))
+            {
+                (*st)->_M_pathTime = node->_M_pathTime;
+                (*st)->_M_pathPrev = node;
+            }
+        }
+    }
+}
+
+TaskGraph::_T_Node::_T_Node(TaskGraph* graph, NodeId id, IRunnable* task,
+        const std::string& name, bool autoDelete)
+    : IRunnable(),
+      _M_graph(graph),
+      _M_id(id),
+      _M_task(task),
+      _M_name(name),
+      _M_autoDelete(autoDelete),
+      _M_successors(),
+      _M_numPredecessors(0),
+      _M_pending(0),
+      _M_duration(0),
+      _M_pathTime(0),
+      _M_pathPrev(0)
+{
+
+}
+
+TaskGraph::_T_Node::~_T_Node(void)
+{
+    if (this->_M_autoDelete)
+        delete this->_M_task;
+}
+
+/*
+ * Runs the node and releases its successors. The first successor which
+ * becomes ready is run right away by the same thread instead of going
+ * through the pool's queue.
+ */
+void TaskGraph::_T_Node::run(void) throw()
+{
+    _T_Node* node = this;
+    _T_Node* next = 0;
+    ElsUint64 start = 0;
+
+    while (node != 0)
+    {
+        start = sys::monotonicNs();
+        node->_M_task->run();
+        node->_M_duration = sys::monotonicNs() - start;
+
+        next = 0;
+        for (_T_NodeList::iterator it = node->_M_successors.begin();
+                it != node->_M_successors.end(); ++it)
+        {
+            if (__atomic_sub_fetch(&(*it)->_M_pending, 1,
+                    __ATOMIC_ACQ_REL) != 0)
+                continue;
+
+            if (next == 0)
+                next = *it;
+            else
+                this->_M_graph->_M_schedule(*it);
+        }
+
+        this->_M_graph->_M_finishNode();
+        node = next;
+    }
+}
+
+ELS_END_NAMESPACE_2
+
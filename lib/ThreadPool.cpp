@@ -23,113 +23,2122 @@
 #include <els/ThreadPool.hpp>
 #include <els/Exception.hpp>
 #include <els/AutoMutex.hpp>
+#include <els/CpuTopology.hpp>
+#include <els/System.hpp>
+#include <els/Timeval.hpp>
+
+#include <sched.h>
 
 ELS_BEGIN_NAMESPACE_2(els, thread)
 
 const size_t ThreadPool::DEF_NUM_THREADS = 16;
+const size_t ThreadPool::AUTO_NUM_THREADS = 0;
+const size_t ThreadPool::MAX_RESIZE_EVENTS = 64;
+const size_t ThreadPool::_S_LOCAL_QUEUE_SIZE = 256;
+const size_t ThreadPool::_S_SLAB_SIZE = 64;
+const size_t ThreadPool::_S_TASK_CACHE_SIZE = 256;
+const ElsUint64 ThreadPool::_S_DEF_AGING_NS = 1000000000ULL;
+const ElsUint64 ThreadPool::_S_DEF_GROW_THRESHOLD_NS = 10000000ULL;
+const ElsUint64 ThreadPool::_S_DEF_IDLE_TIMEOUT_NS = 5000000000ULL;
+const ElsUint64 ThreadPool::_T_PriorityQueue::_S_STRIDE_ONE = 1 << 20;
+const unsigned ThreadPool::TaskAttr::PRIORITY_LOWEST = ~0U;
+
+__thread ThreadPool::_T_Job* ThreadPool::_S_currentJob = 0;
+__thread const ThreadPool::_T_Task* ThreadPool::_S_currentTask = 0;
+
+/*
+ * Per-worker counters have a single writer, so a plain load and store
+ * is enough. Being atomic only keeps readers from seeing torn values.
+ */
+static inline void addCounter(ElsUint64& counter, ElsUint64 value)
+{
+    __atomic_store_n(&counter,
+            __atomic_load_n(&counter, __ATOMIC_RELAXED) + value,
+            __ATOMIC_RELAXED);
+}
+
+/*
+ * Bounded Chase-Lev deque. Only the owning worker calls push() and pop()
+ * which operate on the bottom end, any other worker may steal() from
+ * the top end.
+ */
+class ThreadPool::_T_LocalQueue
+{
+public:
+
+    explicit _T_LocalQueue(size_t size)
+        : _M_top(0),
+          _M_bottom(0),
+          _M_buffer(new _T_Task*[size]),
+          _M_mask(size - 1)
+    {
+
+    }
+
+    ~_T_LocalQueue(void)
+    {
+        delete[] this->_M_buffer;
+    }
+
+    bool push(_T_Task* task)
+    {
+        ElsInt64 bottom = __atomic_load_n(&this->_M_bottom, __ATOMIC_RELAXED);
+        ElsInt64 top = __atomic_load_n(&this->_M_top, __ATOMIC_ACQUIRE);
+
+        if (bottom - top > this->_M_mask)
+            return false;
+
+        __atomic_store_n(&this->_M_buffer[bottom & this->_M_mask],
+                task, __ATOMIC_RELAXED);
+        __atomic_store_n(&this->_M_bottom, bottom + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    _T_Task* pop(void)
+    {
+        ElsInt64 bottom = 0;
+        ElsInt64 top = 0;
+        _T_Task* task = 0;
+
+        bottom = __atomic_load_n(&this->_M_bottom, __ATOMIC_RELAXED) - 1;
+        __atomic_store_n(&this->_M_bottom, bottom, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        top = __atomic_load_n(&this->_M_top, __ATOMIC_RELAXED);
+
+        if (top > bottom)
+        {
+            __atomic_store_n(&this->_M_bottom, bottom + 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+
+        task = __atomic_load_n(&this->_M_buffer[bottom & this->_M_mask],
+                __ATOMIC_RELAXED);
+        if (top == bottom)
+        {
+            /* Last element - race against thieves. */
+            if (!__atomic_compare_exchange_n(&this->_M_top, &top, top + 1,
+                    false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                task = 0;
+            __atomic_store_n(&this->_M_bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
 
-ThreadPool::ThreadPool(void)
-    : _M_tasks(),
+        return task;
+    }
+
+    _T_Task* steal(void)
+    {
+        ElsInt64 top = __atomic_load_n(&this->_M_top, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        ElsInt64 bottom = __atomic_load_n(&this->_M_bottom, __ATOMIC_ACQUIRE);
+        _T_Task* task = 0;
+
+        if (top >= bottom)
+            return 0;
+
+        task = __atomic_load_n(&this->_M_buffer[top & this->_M_mask],
+                __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&this->_M_top, &top, top + 1,
+                false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            return 0;
+
+        return task;
+    }
+
+    size_t size(void) const
+    {
+        ElsInt64 top = __atomic_load_n(&this->_M_top, __ATOMIC_ACQUIRE);
+        ElsInt64 bottom = __atomic_load_n(&this->_M_bottom, __ATOMIC_ACQUIRE);
+
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+private:
+
+    ElsInt64 _M_top;
+    char _M_pad[ELS_CACHELINE_SIZE];
+    ElsInt64 _M_bottom;
+    _T_Task** _M_buffer;
+    ElsInt64 _M_mask;
+
+    ELS_CLASS_UNCOPYABLE(_T_LocalQueue);
+};
+
+ThreadPool::ThreadPool(SchedulingMode mode)
+    : _M_mode(mode),
+      _M_tasks(),
+      _M_groupNames(1, "default"),
+      _M_agingNs(_S_DEF_AGING_NS),
+      _M_ring(0),
+      _M_overflowPolicy(OVERFLOW_BLOCK),
+      _M_dropped(0),
+      _M_cancelled(0),
+      _M_expired(0),
+      _M_highWater(0),
+      _M_counters(),
       _M_taskMutex(),
       _M_jobs(),
       _M_jobMutex(),
-      _M_cond()
+      _M_listMutex(),
+      _M_cond(),
+      _M_sleepers(0),
+      _M_wakeEpoch(0),
+      _M_spaceCond(),
+      _M_blockedProducers(0),
+      _M_spaceEpoch(0),
+      _M_stopping(false),
+      _M_minJobs(0),
+      _M_activeJobs(0),
+      _M_growThresholdNs(_S_DEF_GROW_THRESHOLD_NS),
+      _M_idleTimeoutNs(_S_DEF_IDLE_TIMEOUT_NS),
+      _M_idleStrategy(IDLE_BLOCK),
+      _M_maxSpinNs(0),
+      _M_affinityPolicy(AFFINITY_NONE),
+      _M_affinityCpus(),
+      _M_lastGrowth(0),
+      _M_events(),
+      _M_eventCount(0),
+      _M_eventMutex(),
+      _M_freeTasks(0),
+      _M_slabs(),
+      _M_freeMutex()
 {
 
 }
 
 ThreadPool::~ThreadPool(void)
 {
-    this->_M_clearJobs();
+    if (!this->_M_jobs.empty())
+        this->stop();
+    this->_M_clearTasks();
+    delete this->_M_ring;
+
+    for (_T_SlabList::iterator it = this->_M_slabs.begin();
+            it != this->_M_slabs.end(); ++it)
+        delete[] *it;
+
+    for (_T_CounterList::iterator it = this->_M_counters.begin();
+            it != this->_M_counters.end(); ++it)
+        delete *it;
+}
+
+ThreadPool::SchedulingMode ThreadPool::schedulingMode(void) const
+{
+    return this->_M_mode;
+}
+
+/**
+ * @brief   Replaces the unbounded shared queue with a lock-free ring
+ *          buffer of limited capacity.
+ * @param   capacity    Maximum number of queued tasks, rounded up to
+ *                      the nearest power of two. Zero restores
+ *                      the unbounded queue.
+ * @param   policy      What to do when the queue is full.
+ * @throw   LogicError  If the pool is running or has pending tasks.
+ *
+ * In work-stealing mode the limit applies to the shared queue, worker
+ * deques have a fixed size and overflow to the shared queue. A worker
+ * thread never blocks on a full queue as that could deadlock the pool,
+ * under OVERFLOW_BLOCK it runs the task itself instead. Other threads
+ * blocked on a full queue are only released by workers, so they wait
+ * indefinitely if the pool is not running.
+ */
+void ThreadPool::setQueueLimit(size_t capacity, OverflowPolicy policy)
+{
+    AutoMutex am(this->_M_jobMutex);
+
+    this->_M_checkIdle();
+    if ((capacity > 0) && ((this->_M_tasks.levels() > 1)
+            || (this->_M_tasks.groups() > 1)))
+        except::throwLogicError(
+                "Bounded queue can't be used with priorities or task groups");
+
+    this->_M_listMutex.lock();
+    delete this->_M_ring;
+    this->_M_ring = capacity > 0 ? new _T_RingQueue(capacity) : 0;
+    this->_M_listMutex.unlock();
+    this->_M_overflowPolicy = policy;
 }
 
-void ThreadPool::schedule(IRunnable* task, bool autoDelete)
+size_t ThreadPool::queueLimit(void) const
 {
+    return this->_M_ring != 0 ? this->_M_ring->capacity() : 0;
+}
+
+ThreadPool::OverflowPolicy ThreadPool::overflowPolicy(void) const
+{
+    return this->_M_overflowPolicy;
+}
+
+/**
+ * @brief   Returns the number of tasks waiting for a worker, including
+ *          those in the workers' local deques.
+ * @return  Approximate number of pending tasks.
+ *
+ * Only takes the lock guarding the worker list, which is held briefly
+ * when the pool starts or stops, so it's cheap enough to be polled by
+ * producers wanting to shed load before the queue fills up, including
+ * tasks running in the pool.
+ */
+size_t ThreadPool::queueDepth(void) const
+{
+    AutoMutex am(this->_M_listMutex);
+
+    return this->_M_queueDepth();
+}
+
+/**
+ * @brief   Returns the number of tasks discarded under
+ *          OVERFLOW_DROP_OLDEST.
+ * @return  Number of dropped tasks.
+ */
+size_t ThreadPool::droppedTasks(void) const
+{
+    return this->_M_dropped.get();
+}
+
+/**
+ * @brief   Returns the number of tasks discarded because their
+ *          cancellation token had been cancelled before they were run.
+ * @return  Number of cancelled tasks.
+ */
+size_t ThreadPool::cancelledTasks(void) const
+{
+    return this->_M_cancelled.get();
+}
+
+/**
+ * @brief   Returns the number of tasks discarded because their deadline
+ *          had passed before they were run.
+ * @return  Number of expired tasks.
+ */
+size_t ThreadPool::expiredTasks(void) const
+{
+    return this->_M_expired.get();
+}
+
+/**
+ * @brief   Checks if the task run by the calling thread should give up.
+ * @return  True if the pool task being run by the calling thread has been
+ *          cancelled or has passed its deadline, false otherwise and when
+ *          not called from a task.
+ *
+ * Meant to be polled by long running tasks, which the pool can't
+ * interrupt by itself.
+ */
+bool ThreadPool::cancellationRequested(void)
+{
+    const _T_Task* task = _S_currentTask;
+
+    if (task == 0)
+        return false;
+
+    return StopToken::_S_stopped(task->token) || ((task->deadline != 0)
+            && (sys::monotonicNs() >= task->deadline));
+}
+
+/**
+ * @brief   Sets the number of priority levels.
+ * @param   levels      Number of levels, tasks with priority 0 are always
+ *                      served before those with priority 1 and so on.
+ * @throw   InvalidArgument     If levels is 0.
+ * @throw   LogicError  If the pool is running or has pending tasks
+ *                      or a bounded queue is in use.
+ *
+ * Resets the wait latency statistics.
+ */
+void ThreadPool::setPriorityLevels(unsigned levels)
+{
+    AutoMutex am(this->_M_jobMutex);
+
+    if (levels == 0)
+        throw except::InvalidArgument("Number of levels must not be 0");
+
+    this->_M_checkIdle();
+    if ((levels > 1) && (this->_M_ring != 0))
+        except::throwLogicError(
+                "Bounded queue can't be used with priorities or task groups");
+
     this->_M_taskMutex.lock();
-    this->_M_tasks.push_back(std::make_pair(task, autoDelete));
+    this->_M_tasks.setLevels(levels);
     this->_M_taskMutex.unlock();
-    this->_M_cond.unblockOne();
+
+    AutoMutex lm(this->_M_listMutex);
+    for (_T_CounterList::iterator it = this->_M_counters.begin();
+            it != this->_M_counters.end(); ++it)
+        (*it)->priorityWait.assign(levels, misc::LatencyHistogram());
 }
 
-void ThreadPool::start(size_t numJobs)
+unsigned ThreadPool::priorityLevels(void) const
+{
+    return this->_M_tasks.levels();
+}
+
+/**
+ * @brief   Sets the time after which a task waiting in a lower priority
+ *          level is served before the higher priority ones.
+ * @param   threshold   Maximum wait time, zero disables aging.
+ *
+ * Without aging a steady stream of urgent tasks starves all others.
+ * Defaults to one second.
+ */
+void ThreadPool::setAgingThreshold(const misc::Timeval& threshold)
+{
+    AutoMutex am(this->_M_taskMutex);
+
+    this->_M_agingNs = static_cast<ElsUint64>(threshold.getSec())
+            * 1000000000ULL + threshold.getNsec();
+}
+
+misc::Timeval ThreadPool::agingThreshold(void) const
 {
-    _T_Job* newJob = 0;
+    AutoMutex am(this->_M_taskMutex);
+
+    return misc::Timeval(
+            static_cast<ElsInt32>(this->_M_agingNs / 1000000000ULL),
+            static_cast<ElsInt32>(this->_M_agingNs % 1000000000ULL));
+}
 
+/**
+ * @brief   Creates a new task group.
+ * @param   name    Unique name of the group.
+ * @param   weight  Relative share of workers' time the group gets when
+ *                  competing with other groups at the same priority.
+ * @return  Identifier of the new group to be used in TaskAttr.
+ * @throw   InvalidArgument     If the name is taken or weight is 0.
+ * @throw   LogicError  If the pool is running or a bounded queue
+ *                      is in use.
+ *
+ * The default group 0 is named "default" and has the weight of 1.
+ */
+unsigned ThreadPool::addTaskGroup(const std::string& name, unsigned weight)
+{
     AutoMutex am(this->_M_jobMutex);
 
     if (!this->_M_jobs.empty())
-        except::throwLogicError("ThreadPool already active");
+        except::throwLogicError("ThreadPool active");
+    if (this->_M_ring != 0)
+        except::throwLogicError(
+                "Bounded queue can't be used with priorities or task groups");
+    if ((weight == 0) || (weight > (1U << 20)))
+        throw except::InvalidArgument("Invalid weight: %u", weight);
 
-    this->_M_jobs.resize(numJobs, 0);
-    for (unsigned i = 0; i < numJobs; ++i)
+    for (size_t i = 0; i < this->_M_groupNames.size(); ++i)
     {
-        newJob = new _T_Job(this);
-        newJob->start();
-        this->_M_jobs.at(i) = newJob;
+        if (this->_M_groupNames[i] == name)
+            throw except::InvalidArgument("Task group already exists: %s",
+                    name.c_str());
     }
+
+    this->_M_taskMutex.lock();
+    this->_M_tasks.addGroup(weight);
+    this->_M_taskMutex.unlock();
+    this->_M_groupNames.push_back(name);
+
+    return this->_M_groupNames.size() - 1;
 }
 
-void ThreadPool::stop(void)
+/**
+ * @brief   Looks up a task group.
+ * @param   name    Name of the group.
+ * @return  Identifier of the group.
+ * @throw   KeyNotFound     If there's no such group.
+ */
+unsigned ThreadPool::taskGroup(const std::string& name) const
 {
     AutoMutex am(this->_M_jobMutex);
 
-    for (_T_JobList::iterator it = this->_M_jobs.begin();
-            it != this->_M_jobs.end(); ++it)
-        (*it)->stop();
-    this->_M_cond.unblockAll();
+    for (size_t i = 0; i < this->_M_groupNames.size(); ++i)
+    {
+        if (this->_M_groupNames[i] == name)
+            return i;
+    }
 
-    for (_T_JobList::iterator it = this->_M_jobs.begin();
-            it != this->_M_jobs.end(); ++it)
-        (*it)->join();
+    throw except::KeyNotFound("Task group not found: %s", name.c_str());
+}
 
-    this->_M_clearJobs();
+/**
+ * @brief   Returns the distribution of time tasks spent in the queue
+ *          before a worker picked them up.
+ * @param   priority    Priority level.
+ * @return  Snapshot of the histogram.
+ * @throw   InvalidArgument     If there's no such level.
+ *
+ * Each worker records into its own histograms, which are merged here.
+ */
+misc::LatencyHistogram ThreadPool::waitLatency(unsigned priority) const
+{
+    misc::LatencyHistogram ret;
+
+    AutoMutex am(this->_M_listMutex);
+    if (priority >= this->_M_tasks.levels())
+        throw except::InvalidArgument("Invalid priority: %u", priority);
+
+    for (_T_CounterList::const_iterator it = this->_M_counters.begin();
+            it != this->_M_counters.end(); ++it)
+        ret.merge((*it)->priorityWait[priority]);
+
+    return ret;
 }
 
-void ThreadPool::_M_clearJobs(void)
+/**
+ * @brief   Takes a snapshot of the pool's counters and histograms.
+ * @return  Current statistics.
+ *
+ * Never takes the task mutex, so it can be polled while the pool is
+ * under load. The counters are read one by one, so the snapshot is only
+ * approximately consistent. Counters of stopped workers are preserved
+ * until resetStats().
+ */
+ThreadPool::Stats ThreadPool::stats(void) const
 {
-    for (_T_JobList::iterator it = this->_M_jobs.begin();
-            it != this->_M_jobs.end(); ++it)
-        delete *it;
-    this->_M_jobs.clear();
+    Stats stats;
+    WorkerStats worker;
+
+    AutoMutex am(this->_M_listMutex);
+    stats.queueDepth = this->_M_queueDepth();
+    stats.queueHighWater = __atomic_load_n(&this->_M_highWater,
+            __ATOMIC_RELAXED);
+
+    for (_T_CounterList::const_iterator it = this->_M_counters.begin();
+            it != this->_M_counters.end(); ++it)
+    {
+        (*it)->snapshot(worker);
+        stats.total.tasksRun += worker.tasksRun;
+        stats.total.steals += worker.steals;
+        stats.total.busyNs += worker.busyNs;
+        stats.total.idleNs += worker.idleNs;
+        if (worker.localHighWater > stats.total.localHighWater)
+            stats.total.localHighWater = worker.localHighWater;
+        stats.total.waitLatency.merge(worker.waitLatency);
+        stats.total.runTime.merge(worker.runTime);
+        stats.workers.push_back(worker);
+    }
+
+    return stats;
 }
 
-ThreadPool::_T_Job::_T_Job(ThreadPool* owner)
-    : IThread(),
-      _M_owner(owner)
+/**
+ * @brief   Zeroes all counters, histograms and high-water marks,
+ *          including the per-priority wait latencies.
+ *
+ * Updates made concurrently by the workers may be lost.
+ */
+void ThreadPool::resetStats(void)
 {
+    AutoMutex am(this->_M_listMutex);
 
+    __atomic_store_n(&this->_M_highWater, 0, __ATOMIC_RELAXED);
+    for (_T_CounterList::iterator it = this->_M_counters.begin();
+            it != this->_M_counters.end(); ++it)
+        (*it)->reset();
 }
 
-ThreadPool::_T_Job::~_T_Job(void)
+/**
+ * @brief   Queues a task for execution.
+ * @param   task        Task to run.
+ * @param   autoDelete  If true, the task is deleted after it has run
+ *                      or has been discarded.
+ * @return  False if the task was rejected because the queue was full
+ *          and the overflow policy is OVERFLOW_FAIL, true otherwise.
+ */
+bool ThreadPool::schedule(IRunnable* task, bool autoDelete)
 {
+    _T_Task* newTask = this->_M_newTask(task, autoDelete, 0, 0);
+
+    if (!this->_M_submit(newTask, true))
+    {
+        this->_M_rejectTask(newTask);
+        return false;
+    }
 
+    return true;
 }
 
-int ThreadPool::_T_Job::_M_run(void)
+/**
+ * @brief   Queues a task for execution with given priority and group.
+ * @param   task        Task to run.
+ * @param   attr        Scheduling attributes.
+ * @param   autoDelete  If true, the task is deleted after it has run
+ *                      or has been discarded.
+ * @return  False if the task was rejected because the queue was full
+ *          and the overflow policy is OVERFLOW_FAIL, true otherwise.
+ * @throw   InvalidArgument     If the task group doesn't exist.
+ *
+ * Such tasks always go to the shared queue, even in work-stealing mode,
+ * as the worker deques are not ordered by priority.
+ */
+bool ThreadPool::schedule(IRunnable* task, const TaskAttr& attr,
+        bool autoDelete)
 {
-    while (!this->_M_stopRequested())
+    _T_Task* newTask = this->_M_newTask(task, autoDelete, &attr, 0);
+
+    if (!this->_M_submit(newTask, false))
+    {
+        this->_M_rejectTask(newTask);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief   Queues multiple tasks at once.
+ * @param   tasks       Array of tasks to run.
+ * @param   count       Number of tasks in the array.
+ * @param   autoDelete  If true, the tasks are deleted after they have run
+ *                      or have been discarded.
+ * @return  Number of tasks queued. It's only less than count if the queue
+ *          is full and the overflow policy is OVERFLOW_FAIL, in which
+ *          case the tasks past the returned number were not queued.
+ *
+ * With the unbounded queue all tasks are queued under a single lock
+ * and exactly as many idle workers as there are new tasks are woken up.
+ */
+size_t ThreadPool::scheduleBatch(IRunnable* const* tasks, size_t count,
+        bool autoDelete)
+{
+    _T_Job* job = _S_currentJob;
+    _T_Task* node = 0;
+    _T_TaskQueue batch;
+    size_t done = 0;
+    ElsUint64 now = sys::monotonicNs();
+
+    if ((this->_M_mode == SCHEDULE_WORK_STEALING)
+            && (job != 0) && (job->_M_owner == this))
     {
-        this->_M_owner->_M_taskMutex.lock();
-        if (this->_M_owner->_M_tasks.empty())
+        for (; done < count; ++done)
         {
-            this->_M_owner->_M_taskMutex.unlock();
-            this->_M_owner->_M_cond.block();
+            node = this->_M_newTask(tasks[done], autoDelete, 0, now);
+            if (!job->_M_localQueue->push(node))
+            {
+                this->_M_freeTask(node);
+                break;
+            }
         }
-        else
+        this->_M_noteLocalDepth(job);
+        this->_M_notify(done);
+    }
+
+    if (this->_M_ring != 0)
+    {
+        /*
+         * Notify after every task - a producer blocked on a full queue
+         * would wait forever for workers that were never woken up.
+         */
+        for (; done < count; ++done)
+        {
+            node = this->_M_newTask(tasks[done], autoDelete, 0, now);
+            if (!this->_M_pushRing(node))
+            {
+                this->_M_freeTask(node);
+                break;
+            }
+            this->_M_noteDepth(this->_M_ring->size());
+            this->_M_notify();
+        }
+
+        return done;
+    }
+
+    if (done == count)
+        return done;
+
+    for (size_t i = done; i < count; ++i)
+        batch.push(this->_M_newTask(tasks[i], autoDelete, 0, now));
+
+    this->_M_taskMutex.lock();
+    while ((node = batch.pop()) != 0)
+        this->_M_tasks.push(node);
+    this->_M_noteDepth(this->_M_tasks.size());
+    this->_M_taskMutex.unlock();
+
+    this->_M_notify(count - done);
+    this->_M_checkLoad(now);
+    return count;
+}
+
+/**
+ * @brief   Starts a pool with a fixed number of workers.
+ * @param   numJobs     Number of workers. AUTO_NUM_THREADS picks one
+ *                      worker per CPU in the explicit affinity set or,
+ *                      without one, per CPU the process may use,
+ *                      capped by the cgroup CPU quota.
+ * @throw   LogicError  If the pool is already running.
+ */
+void ThreadPool::start(size_t numJobs)
+{
+    if (numJobs == AUTO_NUM_THREADS)
+    {
+        this->_M_jobMutex.lock();
+        numJobs = this->_M_affinityPolicy == AFFINITY_EXPLICIT
+                ? this->_M_affinityCpus.size() : 0;
+        this->_M_jobMutex.unlock();
+
+        if (numJobs == 0)
+            numJobs = sys::CpuTopology().recommendedThreads();
+    }
+
+    this->start(numJobs, numJobs);
+}
+
+/**
+ * @brief   Starts an elastic pool.
+ * @param   minJobs     Number of workers started immediately and never
+ *                      retired.
+ * @param   maxJobs     Maximum number of workers.
+ * @throw   InvalidArgument     If minJobs is 0 or greater than maxJobs.
+ * @throw   LogicError  If the pool is already running.
+ *
+ * Another worker is spawned when a task waits in the queue for longer
+ * than the grow threshold, workers above minJobs retire after having
+ * been idle for the idle timeout. The pool never grows more often than
+ * once per grow threshold.
+ */
+void ThreadPool::start(size_t minJobs, size_t maxJobs)
+{
+    AutoMutex am(this->_M_jobMutex);
+    std::vector<unsigned> cpus;
+
+    if (!this->_M_jobs.empty())
+        except::throwLogicError("ThreadPool already active");
+    if ((minJobs == 0) || (minJobs > maxJobs))
+        throw except::InvalidArgument("Invalid number of workers: %zu-%zu",
+                minJobs, maxJobs);
+
+    this->_M_taskMutex.lock();
+    this->_M_stopping = false;
+    this->_M_taskMutex.unlock();
+
+    this->_M_minJobs = minJobs;
+    __atomic_store_n(&this->_M_activeJobs, minJobs, __ATOMIC_RELEASE);
+
+    /*
+     * Workers iterate over the job list when looking for work to steal,
+     * so it must be complete before any of them starts. Jobs of an elastic
+     * pool are created upfront and only their threads come and go.
+     */
+    if (this->_M_affinityPolicy == AFFINITY_COMPACT)
+        cpus = sys::CpuTopology().compactOrder();
+    else if (this->_M_affinityPolicy == AFFINITY_SCATTER)
+        cpus = sys::CpuTopology().scatterOrder();
+    else if (this->_M_affinityPolicy == AFFINITY_EXPLICIT)
+        cpus = this->_M_affinityCpus;
+
+    {
+        AutoMutex lm(this->_M_listMutex);
+
+        this->_M_jobs.resize(maxJobs, 0);
+        for (unsigned i = 0; i < maxJobs; ++i)
         {
-            IRunnable* task = this->_M_owner->_M_tasks.front().first;
-            bool autoDelete = this->_M_owner->_M_tasks.front().second;
-            this->_M_owner->_M_tasks.pop_front();
-            this->_M_owner->_M_taskMutex.unlock();
-            task->run();
-            if (autoDelete)
-                delete task;
+            if (i >= this->_M_counters.size())
+                this->_M_counters.push_back(
+                        new _T_WorkerCounters(this->_M_tasks.levels()));
+            this->_M_jobs.at(i) = new _T_Job(this, i);
+            if (!cpus.empty())
+                this->_M_jobs.at(i)->setAffinity(
+                        std::vector<unsigned>(1, cpus[i % cpus.size()]));
         }
     }
 
-    return 0;
+    for (unsigned i = 0; i < minJobs; ++i)
+        this->_M_jobs.at(i)->start();
 }
 
-ELS_END_NAMESPACE_2
+void ThreadPool::stop(void)
+{
+    AutoMutex am(this->_M_jobMutex);
+
+    for (_T_JobList::iterator it = this->_M_jobs.begin();
+            it != this->_M_jobs.end(); ++it)
+    {
+        if ((*it)->state() != IThread::THREAD_INITIALIZED)
+            (*it)->stop();
+    }
+
+    this->_M_taskMutex.lock();
+    this->_M_stopping = true;
+    __atomic_add_fetch(&this->_M_wakeEpoch, 1, __ATOMIC_RELEASE);
+    this->_M_cond.unblockAll();
+    this->_M_taskMutex.unlock();
+
+    for (_T_JobList::iterator it = this->_M_jobs.begin();
+            it != this->_M_jobs.end(); ++it)
+    {
+        if ((*it)->state() != IThread::THREAD_INITIALIZED)
+            (*it)->join();
+    }
 
+    this->_M_clearJobs();
+    __atomic_store_n(&this->_M_activeJobs, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief   Sets what workers do when they run out of tasks.
+ * @param   strategy    Idle strategy, IDLE_BLOCK by default.
+ * @param   maxSpin     Maximum time a worker polls for new tasks before
+ *                      going to sleep. Ignored by IDLE_BLOCK
+ *                      and IDLE_BUSY_POLL.
+ *
+ * Spinning workers don't count as sleeping, so producers skip waking
+ * them up altogether. Takes effect the next time a worker runs out
+ * of tasks.
+ */
+void ThreadPool::setIdleStrategy(IdleStrategy strategy,
+        const misc::Timeval& maxSpin)
+{
+    __atomic_store_n(&this->_M_maxSpinNs,
+            static_cast<ElsUint64>(maxSpin.getSec()) * 1000000000ULL
+            + maxSpin.getNsec(), __ATOMIC_RELAXED);
+    __atomic_store_n(&this->_M_idleStrategy, strategy, __ATOMIC_RELAXED);
+}
 
+ThreadPool::IdleStrategy ThreadPool::idleStrategy(void) const
+{
+    return __atomic_load_n(&this->_M_idleStrategy, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Sets how workers are pinned to CPUs.
+ * @param   policy  Affinity policy, AFFINITY_NONE by default.
+ * @param   cpus    CPUs used by AFFINITY_EXPLICIT, ignored otherwise.
+ * @throw   LogicError      If the pool is running.
+ * @throw   InvalidArgument If AFFINITY_EXPLICIT is used without CPUs.
+ */
+void ThreadPool::setAffinity(AffinityPolicy policy,
+        const std::vector<unsigned>& cpus)
+{
+    AutoMutex am(this->_M_jobMutex);
+
+    if (!this->_M_jobs.empty())
+        except::throwLogicError("ThreadPool already active");
+    if ((policy == AFFINITY_EXPLICIT) && cpus.empty())
+        throw except::InvalidArgument("No CPUs given for explicit affinity");
+
+    this->_M_affinityPolicy = policy;
+    this->_M_affinityCpus = policy == AFFINITY_EXPLICIT
+            ? cpus : std::vector<unsigned>();
+}
+
+ThreadPool::AffinityPolicy ThreadPool::affinityPolicy(void) const
+{
+    AutoMutex am(this->_M_jobMutex);
+    return this->_M_affinityPolicy;
+}
+
+/**
+ * @brief   Sets how long a task may wait in the queue of an elastic pool
+ *          before another worker is spawned.
+ * @param   wait    Maximum queue wait, defaults to 10 milliseconds.
+ */
+void ThreadPool::setGrowThreshold(const misc::Timeval& wait)
+{
+    __atomic_store_n(&this->_M_growThresholdNs,
+            static_cast<ElsUint64>(wait.getSec()) * 1000000000ULL
+            + wait.getNsec(), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Sets how long a worker of an elastic pool may stay idle before
+ *          it retires.
+ * @param   timeout     Idle timeout, defaults to 5 seconds.
+ *
+ * Workers already waiting for tasks use the previous value.
+ */
+void ThreadPool::setIdleTimeout(const misc::Timeval& timeout)
+{
+    __atomic_store_n(&this->_M_idleTimeoutNs,
+            static_cast<ElsUint64>(timeout.getSec()) * 1000000000ULL
+            + timeout.getNsec(), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Returns the number of running workers.
+ * @return  Number of workers.
+ */
+size_t ThreadPool::numWorkers(void) const
+{
+    return __atomic_load_n(&this->_M_activeJobs, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief   Returns the most recent changes in the number of workers.
+ * @return  Up to MAX_RESIZE_EVENTS events, oldest first.
+ */
+std::vector<ThreadPool::ResizeEvent> ThreadPool::resizeEvents(void) const
+{
+    AutoMutex am(this->_M_eventMutex);
+    _T_EventList events;
+
+    if (this->_M_eventCount <= MAX_RESIZE_EVENTS)
+        return this->_M_events;
+
+    for (size_t i = 0; i < MAX_RESIZE_EVENTS; ++i)
+        events.push_back(this->_M_events[
+                (this->_M_eventCount + i) % MAX_RESIZE_EVENTS]);
+
+    return events;
+}
+
+/*
+ * The caller must either submit the task or hand it back with
+ * _M_rejectTask(). If now is 0, the current time is used.
+ */
+ThreadPool::_T_Task* ThreadPool::_M_newTask(IRunnable* runnable,
+        bool autoDelete, const TaskAttr* attr, ElsUint64 now)
+{
+    unsigned levels = this->_M_tasks.levels();
+    unsigned priority = TaskAttr::PRIORITY_LOWEST;
+    _T_Task* task = 0;
+
+    if (attr != 0)
+    {
+        if (attr->group() >= this->_M_tasks.groups())
+            throw except::InvalidArgument("Invalid task group: %u",
+                    attr->group());
+        priority = attr->priority();
+    }
+
+    task = this->_M_allocTask();
+    task->runnable = runnable;
+    task->autoDelete = autoDelete;
+    task->inlined = false;
+    task->priority = priority < levels ? priority : levels - 1;
+    task->group = attr != 0 ? attr->group() : 0;
+    task->enqueued = now != 0 ? now : sys::monotonicNs();
+    task->deadline = attr != 0 ? attr->deadline() : 0;
+    task->token = attr != 0
+            ? StopToken::_S_ref(attr->cancelToken()._M_token._M_state) : 0;
+    task->next = 0;
+
+    return task;
+}
+
+/*
+ * Task nodes come from slabs which are only freed together with
+ * the pool. Every worker keeps a private cache of free nodes, so a worker
+ * scheduling tasks for itself or recycling the tasks it has run doesn't
+ * take any lock most of the time. Other threads use the shared free list.
+ */
+ThreadPool::_T_Task* ThreadPool::_M_allocTask(void)
+{
+    _T_Job* job = _S_currentJob;
+    _T_Task* task = 0;
+
+    if ((job != 0) && (job->_M_owner == this))
+    {
+        if (job->_M_freeTasks == 0)
+            this->_M_refillCache(job);
+        task = job->_M_freeTasks;
+        job->_M_freeTasks = task->next;
+        --job->_M_numFree;
+        return task;
+    }
+
+    AutoMutex am(this->_M_freeMutex);
+    if (this->_M_freeTasks == 0)
+        this->_M_addSlab();
+    task = this->_M_freeTasks;
+    this->_M_freeTasks = task->next;
+
+    return task;
+}
+
+void ThreadPool::_M_freeTask(_T_Task* task)
+{
+    _T_Job* job = _S_currentJob;
+
+    if ((job != 0) && (job->_M_owner == this))
+    {
+        task->next = job->_M_freeTasks;
+        job->_M_freeTasks = task;
+        if (++job->_M_numFree > _S_TASK_CACHE_SIZE)
+            this->_M_spillCache(job, _S_TASK_CACHE_SIZE / 2);
+        return;
+    }
+
+    AutoMutex am(this->_M_freeMutex);
+    task->next = this->_M_freeTasks;
+    this->_M_freeTasks = task;
+}
+
+void ThreadPool::_M_refillCache(_T_Job* job)
+{
+    _T_Task* task = 0;
+
+    AutoMutex am(this->_M_freeMutex);
+    if (this->_M_freeTasks == 0)
+        this->_M_addSlab();
+
+    while ((this->_M_freeTasks != 0)
+            && (job->_M_numFree < _S_TASK_CACHE_SIZE / 2))
+    {
+        task = this->_M_freeTasks;
+        this->_M_freeTasks = task->next;
+        task->next = job->_M_freeTasks;
+        job->_M_freeTasks = task;
+        ++job->_M_numFree;
+    }
+}
+
+/*
+ * Moves all but the first keep nodes of the cache to the shared list.
+ */
+void ThreadPool::_M_spillCache(_T_Job* job, size_t keep)
+{
+    _T_Task* last = 0;
+    _T_Task* first = 0;
+
+    if (job->_M_numFree <= keep)
+        return;
+
+    if (keep == 0)
+    {
+        first = job->_M_freeTasks;
+        job->_M_freeTasks = 0;
+    }
+    else
+    {
+        last = job->_M_freeTasks;
+        for (size_t i = 1; i < keep; ++i)
+            last = last->next;
+        first = last->next;
+        last->next = 0;
+    }
+    job->_M_numFree = keep;
+
+    for (last = first; last->next != 0; last = last->next)
+        ;
+
+    AutoMutex am(this->_M_freeMutex);
+    last->next = this->_M_freeTasks;
+    this->_M_freeTasks = first;
+}
+
+/*
+ * Must be called with the free list mutex held.
+ */
+void ThreadPool::_M_addSlab(void)
+{
+    _T_Task* slab = new _T_Task[_S_SLAB_SIZE];
+
+    this->_M_slabs.push_back(slab);
+    for (size_t i = 0; i < _S_SLAB_SIZE; ++i)
+    {
+        slab[i].next = this->_M_freeTasks;
+        this->_M_freeTasks = &slab[i];
+    }
+}
+
+void ThreadPool::_M_checkIdle(void) const
+{
+    if (!this->_M_jobs.empty() || (this->_M_queueDepth() != 0))
+        except::throwLogicError("ThreadPool active or not empty");
+}
+
+/*
+ * The caller must hold _M_jobMutex or _M_listMutex so that stop() can't
+ * delete the jobs and their deques while they are walked.
+ */
+size_t ThreadPool::_M_queueDepth(void) const
+{
+    size_t depth = 0;
+
+    depth = this->_M_ring != 0 ? this->_M_ring->size() : this->_M_tasks.size();
+    for (_T_JobList::const_iterator it = this->_M_jobs.begin();
+            it != this->_M_jobs.end(); ++it)
+        depth += (*it)->_M_localQueue->size();
+
+    return depth;
+}
+
+/*
+ * Returns false without touching the task if the queue is full and
+ * the overflow policy is OVERFLOW_FAIL, otherwise the pool owns the task.
+ */
+bool ThreadPool::_M_submit(_T_Task* task, bool local)
+{
+    _T_Job* job = _S_currentJob;
+    ElsUint64 enqueued = task->enqueued;
+
+    if (local && (this->_M_mode == SCHEDULE_WORK_STEALING)
+            && (job != 0) && (job->_M_owner == this)
+            && job->_M_localQueue->push(task))
+    {
+        this->_M_noteLocalDepth(job);
+        this->_M_notify();
+        return true;
+    }
+
+    if (!this->_M_pushShared(task))
+        return false;
+
+    this->_M_notify();
+    this->_M_checkLoad(enqueued);
+    return true;
+}
+
+bool ThreadPool::_M_pushShared(_T_Task* task)
+{
+    if (this->_M_ring != 0)
+        return this->_M_pushRing(task);
+
+    this->_M_taskMutex.lock();
+    this->_M_tasks.push(task);
+    this->_M_noteDepth(this->_M_tasks.size());
+    this->_M_taskMutex.unlock();
+
+    return true;
+}
+
+bool ThreadPool::_M_pushRing(_T_Task* task)
+{
+    _T_Task* oldest = 0;
+    _T_Job* job = _S_currentJob;
+
+    while (!this->_M_ring->push(task))
+    {
+        switch (this->_M_overflowPolicy)
+        {
+        case OVERFLOW_FAIL:
+            return false;
+        case OVERFLOW_DROP_OLDEST:
+            if (this->_M_ring->pop(oldest))
+            {
+                this->_M_releaseTask(oldest);
+                this->_M_dropped.inc();
+            }
+            break;
+        case OVERFLOW_BLOCK:
+            if ((job == 0) || (job->_M_owner != this))
+            {
+                this->_M_waitForSpace();
+                break;
+            }
+            /* Fall through - a worker must not wait for itself. */
+        case OVERFLOW_CALLER_RUNS:
+            this->_M_runTask(task);
+            return true;
+        }
+    }
+
+    this->_M_noteDepth(this->_M_ring->size());
+    return true;
+}
+
+/*
+ * Blocked producers use the same protocol as idle workers (see _M_park())
+ * with _M_blockedProducers and _M_spaceEpoch, so a slot freed between
+ * the failed push and blocking wakes them up.
+ */
+void ThreadPool::_M_waitForSpace(void)
+{
+    ElsUint32 epoch = 0;
+
+    this->_M_blockedProducers.inc();
+    epoch = __atomic_load_n(&this->_M_spaceEpoch, __ATOMIC_ACQUIRE);
+    if (this->_M_ring->size() >= this->_M_ring->capacity())
+    {
+        AutoMutex am(this->_M_taskMutex);
+
+        while (epoch == this->_M_spaceEpoch)
+            this->_M_spaceCond.block(this->_M_taskMutex);
+    }
+    this->_M_blockedProducers.dec();
+}
+
+void ThreadPool::_M_notifySpace(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (this->_M_blockedProducers.get() == 0)
+        return;
+
+    this->_M_taskMutex.lock();
+    __atomic_add_fetch(&this->_M_spaceEpoch, 1, __ATOMIC_RELEASE);
+    this->_M_taskMutex.unlock();
+    this->_M_spaceCond.unblockOne();
+}
+
+bool ThreadPool::_M_nextTask(_T_Job* job, _T_Task*& task)
+{
+    /* The local deque is only ever filled in work-stealing mode. */
+    task = job->_M_localQueue->pop();
+    if (task != 0)
+        return true;
+
+    if (this->_M_popShared(job, task))
+        return true;
+
+    if (this->_M_mode == SCHEDULE_WORK_STEALING)
+        return this->_M_steal(job, task);
+
+    return false;
+}
+
+/*
+ * Takes up to _S_DEQUEUE_CHUNK tasks from the unbounded queue under
+ * a single lock, but no more than a fair share of what's queued so that
+ * other workers aren't starved. The extra tasks are pushed to the local
+ * deque in reverse, so that the owner pops them in the original order.
+ * They always fit as the deque was found empty just before.
+ *
+ * Chunks are only taken in work-stealing mode, where idle workers steal
+ * them back, and only with a single level and group, as tasks in a local
+ * deque bypass priorities, groups and aging.
+ */
+bool ThreadPool::_M_popShared(_T_Job* job, _T_Task*& task)
+{
+    _T_Task* sharedTask = 0;
+    _T_Task* chunk[_S_DEQUEUE_CHUNK];
+    size_t chunkSize = 0;
+    size_t limit = 0;
+
+    if (this->_M_ring != 0)
+    {
+        if (!this->_M_ring->pop(task))
+            return false;
+
+        this->_M_notifySpace();
+        return true;
+    }
+
+    if (this->_M_tasks.empty())
+        return false;
+
+    this->_M_taskMutex.lock();
+    if ((this->_M_mode == SCHEDULE_WORK_STEALING)
+            && (this->_M_tasks.levels() == 1)
+            && (this->_M_tasks.groups() == 1))
+    {
+        limit = this->_M_tasks.size() / (this->numWorkers() + 1);
+        if (limit > _S_DEQUEUE_CHUNK)
+            limit = _S_DEQUEUE_CHUNK;
+    }
+
+    sharedTask = this->_M_tasks.pop(this->_M_agingNs);
+    while ((chunkSize + 1 < limit)
+            && ((chunk[chunkSize] = this->_M_tasks.pop(this->_M_agingNs)) != 0))
+        ++chunkSize;
+    this->_M_taskMutex.unlock();
+
+    if (sharedTask == 0)
+        return false;
+
+    if (chunkSize > 0)
+    {
+        while (chunkSize > 0)
+            job->_M_localQueue->push(chunk[--chunkSize]);
+        this->_M_noteLocalDepth(job);
+        this->_M_notify();
+    }
+
+    task = sharedTask;
+    return true;
+}
+
+bool ThreadPool::_M_steal(_T_Job* job, _T_Task*& task)
+{
+    size_t numJobs = this->_M_jobs.size();
+    size_t first = job->_M_random() % numJobs;
+    _T_Job* victim = 0;
+    _T_Task* stolen = 0;
+
+    for (size_t i = 0; i < numJobs; ++i)
+    {
+        victim = this->_M_jobs[(first + i) % numJobs];
+        if (victim == job)
+            continue;
+
+        stolen = victim->_M_localQueue->steal();
+        if (stolen != 0)
+        {
+            addCounter(job->_M_counters->steals, 1);
+            task = stolen;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::_M_hasWork(void) const
+{
+    if (this->_M_ring != 0 ? this->_M_ring->size() != 0
+            : !this->_M_tasks.empty())
+        return true;
+
+    if (this->_M_mode == SCHEDULE_WORK_STEALING)
+    {
+        for (_T_JobList::const_iterator it = this->_M_jobs.begin();
+                it != this->_M_jobs.end(); ++it)
+        {
+            if ((*it)->_M_localQueue->size() != 0)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+ElsUint64 ThreadPool::_M_recordWait(_T_Job* job, const _T_Task& task,
+        ElsUint64 now)
+{
+    ElsUint64 wait = now - task.enqueued;
+
+    job->_M_counters->waitLatency.record(wait);
+    job->_M_counters->priorityWait[task.priority].record(wait);
+    return wait;
+}
+
+/*
+ * Producers only write the high-water mark when they beat it, so
+ * the cache line stays shared most of the time.
+ */
+void ThreadPool::_M_noteDepth(size_t depth)
+{
+    size_t highWater = __atomic_load_n(&this->_M_highWater, __ATOMIC_RELAXED);
+
+    while ((depth > highWater) && !__atomic_compare_exchange_n(
+            &this->_M_highWater, &highWater, depth, true,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void ThreadPool::_M_noteLocalDepth(_T_Job* job)
+{
+    size_t depth = job->_M_localQueue->size();
+
+    if (depth > job->_M_counters->localHighWater)
+        __atomic_store_n(&job->_M_counters->localHighWater, depth,
+                __ATOMIC_RELAXED);
+}
+
+bool ThreadPool::_M_elastic(void) const
+{
+    return (this->_M_jobs.size() > this->_M_minJobs);
+}
+
+/*
+ * Called by producers. Workers notice long queue waits only once they
+ * get to a task, which doesn't happen if all of them are stuck in long
+ * running tasks, so if nobody is idle, check the oldest queued task.
+ */
+void ThreadPool::_M_checkLoad(ElsUint64 now)
+{
+    ElsUint64 oldest = 0;
+
+    if (!this->_M_elastic() || (this->_M_ring != 0)
+            || (this->_M_sleepers.get() != 0)
+            || (this->numWorkers() >= this->_M_jobs.size()))
+        return;
+
+    this->_M_taskMutex.lock();
+    oldest = this->_M_tasks.oldest();
+    this->_M_taskMutex.unlock();
+
+    if ((oldest != 0) && (now > oldest) && (now - oldest
+            > __atomic_load_n(&this->_M_growThresholdNs, __ATOMIC_RELAXED)))
+        this->_M_grow(now - oldest);
+}
+
+/*
+ * Never blocks on the job mutex - if it's taken, the pool is either being
+ * stopped or another thread is growing it already.
+ */
+void ThreadPool::_M_grow(ElsUint64 queueWait)
+{
+    ElsUint64 now = sys::monotonicNs();
+    ElsUint64 threshold = __atomic_load_n(&this->_M_growThresholdNs,
+            __ATOMIC_RELAXED);
+    size_t workers = 0;
+    _T_Job* job = 0;
+
+    if (!this->_M_jobMutex.trylock())
+        return;
+
+    workers = this->numWorkers();
+    if (this->_M_jobs.empty() || (workers >= this->_M_jobs.size())
+            || (now - this->_M_lastGrowth < threshold))
+    {
+        this->_M_jobMutex.unlock();
+        return;
+    }
+
+    /* Retired workers may still be exiting, pick one that's done. */
+    for (_T_JobList::iterator it = this->_M_jobs.begin();
+            it != this->_M_jobs.end(); ++it)
+    {
+        if ((*it)->state() == IThread::THREAD_INITIALIZED)
+        {
+            job = *it;
+            break;
+        }
+
+        if ((*it)->tryjoin())
+        {
+            job = *it;
+            job->reset();
+            break;
+        }
+    }
+
+    if (job != 0)
+    {
+        workers = __atomic_add_fetch(&this->_M_activeJobs, 1,
+                __ATOMIC_ACQ_REL);
+        this->_M_lastGrowth = now;
+        job->start();
+        this->_M_addEvent(true, workers, queueWait);
+    }
+
+    this->_M_jobMutex.unlock();
+}
+
+bool ThreadPool::_M_retire(void)
+{
+    size_t workers = __atomic_load_n(&this->_M_activeJobs, __ATOMIC_ACQUIRE);
+
+    do
+    {
+        if (workers <= this->_M_minJobs)
+            return false;
+    }
+    while (!__atomic_compare_exchange_n(&this->_M_activeJobs, &workers,
+            workers - 1, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    this->_M_addEvent(false, workers - 1, 0);
+    return true;
+}
+
+void ThreadPool::_M_addEvent(bool grown, size_t workers, ElsUint64 queueWait)
+{
+    AutoMutex am(this->_M_eventMutex);
+    ResizeEvent event;
+
+    event.timestamp = sys::monotonicNs();
+    event.workers = workers;
+    event.grown = grown;
+    event.queueWait = queueWait;
+
+    if (this->_M_events.size() < MAX_RESIZE_EVENTS)
+        this->_M_events.push_back(event);
+    else
+        this->_M_events[this->_M_eventCount % MAX_RESIZE_EVENTS] = event;
+    ++this->_M_eventCount;
+}
+
+/*
+ * Returns false if the task was discarded instead.
+ */
+bool ThreadPool::_M_runTask(_T_Task* task)
+{
+    const _T_Task* previous = _S_currentTask;
+
+    if (this->_M_dropStale(task))
+        return false;
+
+    _S_currentTask = task;
+    task->runnable->run();
+    _S_currentTask = previous;
+
+    this->_M_releaseTask(task);
+    return true;
+}
+
+/*
+ * Disposes of a task which has run or has been discarded.
+ */
+void ThreadPool::_M_releaseTask(_T_Task* task)
+{
+    if (task->inlined)
+        task->runnable->~IRunnable();
+    else if (task->autoDelete)
+        delete task->runnable;
+
+    this->_M_rejectTask(task);
+}
+
+/*
+ * Recycles a task which never made it to the queue, the runnable
+ * still belongs to the caller.
+ */
+void ThreadPool::_M_rejectTask(_T_Task* task)
+{
+    StopToken::_S_unref(task->token);
+    this->_M_freeTask(task);
+}
+
+/*
+ * Tasks are only checked once dequeued - scanning the queues on every
+ * cancel() would cost far more than the occasional stale task occupying
+ * its slot a little longer.
+ */
+bool ThreadPool::_M_dropStale(_T_Task* task)
+{
+    if (StopToken::_S_stopped(task->token))
+        this->_M_cancelled.inc();
+    else if ((task->deadline != 0) && (sys::monotonicNs() >= task->deadline))
+        this->_M_expired.inc();
+    else
+        return false;
+
+    this->_M_releaseTask(task);
+    return true;
+}
+
+/*
+ * Returns false if the worker should retire. The idle gap measured
+ * by IDLE_ADAPTIVE includes the wakeup latency if the worker had to
+ * park, which makes it spin a bit longer next time.
+ */
+bool ThreadPool::_M_idle(_T_Job* job)
+{
+    IdleStrategy strategy = this->idleStrategy();
+    ElsUint64 maxSpin = __atomic_load_n(&this->_M_maxSpinNs, __ATOMIC_RELAXED);
+    ElsUint64 budget = 0;
+    ElsUint64 start = 0;
+    bool ret = true;
+
+    switch (strategy)
+    {
+    case IDLE_BLOCK:
+        return this->_M_park();
+    case IDLE_BUSY_POLL:
+        return this->_M_spin(job, ~0ULL) || this->_M_park();
+    case IDLE_SPIN_THEN_PARK:
+        return this->_M_spin(job, maxSpin) || this->_M_park();
+    case IDLE_ADAPTIVE:
+        break;
+    }
+
+    budget = job->_M_avgIdleGap * 2;
+    if (job->_M_avgIdleGap > maxSpin)
+        budget = 0;
+    else if (budget > maxSpin)
+        budget = maxSpin;
+
+    start = sys::monotonicNs();
+    if ((budget == 0) || !this->_M_spin(job, budget))
+        ret = this->_M_park();
+
+    job->_M_avgIdleGap = (job->_M_avgIdleGap * 7
+            + (sys::monotonicNs() - start)) / 8;
+    return ret;
+}
+
+/*
+ * Polls the queues until there's work, the pool is being stopped or
+ * the budget runs out. The clock is only read every few iterations and
+ * the CPU is yielded to other threads during the second half.
+ */
+bool ThreadPool::_M_spin(_T_Job* job, ElsUint64 budget)
+{
+    ElsUint64 start = sys::monotonicNs();
+    ElsUint64 elapsed = 0;
+
+    for (unsigned i = 1; ; ++i)
+    {
+        if (this->_M_hasWork() || __atomic_load_n(&this->_M_stopping,
+                __ATOMIC_ACQUIRE))
+            return true;
+
+        if ((i % 64) == 0)
+        {
+            if (job->_M_stopRequested())
+                return true;
+
+            elapsed = sys::monotonicNs() - start;
+            if (elapsed >= budget)
+                return false;
+            if ((budget != ~0ULL) && (elapsed >= budget / 2))
+                ::sched_yield();
+        }
+
+        ELS_CPU_RELAX();
+    }
+}
+
+/*
+ * Idle workers announce themselves in _M_sleepers before checking
+ * for work for the last time. Producers publish a task and then check
+ * _M_sleepers - if any worker is about to sleep, the wake epoch is bumped
+ * under the task mutex, so that a worker can't miss a wakeup between its
+ * last check and blocking on the condition variable.
+ */
+bool ThreadPool::_M_park(void)
+{
+    ElsUint32 epoch = 0;
+    bool timed = false;
+    bool timedOut = false;
+    misc::Timeval deadline;
+    ElsUint64 timeout = 0;
+
+    this->_M_sleepers.inc();
+    epoch = __atomic_load_n(&this->_M_wakeEpoch, __ATOMIC_ACQUIRE);
+    if (!this->_M_hasWork())
+    {
+        AutoMutex am(this->_M_taskMutex);
+
+        /* Workers which can retire wait at most for the idle timeout. */
+        timed = this->numWorkers() > this->_M_minJobs;
+        if (timed)
+        {
+            timeout = __atomic_load_n(&this->_M_idleTimeoutNs,
+                    __ATOMIC_RELAXED);
+            deadline = misc::Timeval::now();
+            deadline += misc::Timeval(
+                    static_cast<ElsInt32>(timeout / 1000000000ULL),
+                    static_cast<ElsInt32>(timeout % 1000000000ULL));
+        }
+
+        while (!this->_M_stopping && (epoch == this->_M_wakeEpoch)
+                && !timedOut)
+        {
+            if (!timed)
+            {
+                this->_M_cond.block(this->_M_taskMutex);
+                continue;
+            }
+
+            this->_M_cond.block(this->_M_taskMutex, deadline);
+            timedOut = !(misc::Timeval::now() < deadline);
+        }
+
+        timedOut = timedOut && !this->_M_stopping
+                && (epoch == this->_M_wakeEpoch);
+    }
+    this->_M_sleepers.dec();
+
+    return !(timedOut && this->_M_retire());
+}
+
+void ThreadPool::_M_notify(size_t count)
+{
+    size_t sleepers = 0;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    sleepers = this->_M_sleepers.get();
+    if ((sleepers == 0) || (count == 0))
+        return;
+
+    this->_M_taskMutex.lock();
+    __atomic_add_fetch(&this->_M_wakeEpoch, 1, __ATOMIC_RELEASE);
+    this->_M_taskMutex.unlock();
+
+    if (count >= sleepers)
+    {
+        this->_M_cond.unblockAll();
+        return;
+    }
+
+    while (count-- > 0)
+        this->_M_cond.unblockOne();
+}
+
+/*
+ * Called by a stopping worker - whatever is left in its deque goes
+ * to the shared queue so that it isn't lost.
+ */
+void ThreadPool::_M_flushLocal(_T_Job* job)
+{
+    _T_Task* task = 0;
+
+    while ((task = job->_M_localQueue->pop()) != 0)
+    {
+        if (!this->_M_pushShared(task))
+            this->_M_releaseTask(task);
+    }
+}
+
+/*
+ * Only called once the workers have been joined. Readers of the job
+ * list take _M_listMutex alone, as _M_jobMutex is held across the joins
+ * and tasks may poll queueDepth() or stats() until they exit.
+ */
+void ThreadPool::_M_clearJobs(void)
+{
+    AutoMutex am(this->_M_listMutex);
+
+    for (_T_JobList::iterator it = this->_M_jobs.begin();
+            it != this->_M_jobs.end(); ++it)
+        delete *it;
+    this->_M_jobs.clear();
+}
+
+/*
+ * Destroying a discarded task may run code which schedules new tasks,
+ * so they're released without holding the task mutex, until none is
+ * left.
+ */
+void ThreadPool::_M_clearTasks(void)
+{
+    _T_TaskQueue discarded;
+    _T_Task* task = 0;
+
+    for (;;)
+    {
+        this->_M_taskMutex.lock();
+        while ((task = this->_M_tasks.pop(0)) != 0)
+            discarded.push(task);
+        this->_M_taskMutex.unlock();
+
+        if (this->_M_ring != 0)
+        {
+            while (this->_M_ring->pop(task))
+                discarded.push(task);
+        }
+
+        if (discarded.empty())
+            break;
+        while ((task = discarded.pop()) != 0)
+            this->_M_releaseTask(task);
+    }
+}
+
+ThreadPool::_T_TaskQueue::_T_TaskQueue(void)
+    : _M_head(0),
+      _M_tail(0),
+      _M_size(0)
+{
+
+}
+
+void ThreadPool::_T_TaskQueue::push(_T_Task* task)
+{
+    task->next = 0;
+    if (this->_M_tail == 0)
+        this->_M_head = task;
+    else
+        this->_M_tail->next = task;
+    this->_M_tail = task;
+    __atomic_store_n(&this->_M_size, this->_M_size + 1, __ATOMIC_RELEASE);
+}
+
+ThreadPool::_T_Task* ThreadPool::_T_TaskQueue::front(void) const
+{
+    return this->_M_head;
+}
+
+ThreadPool::_T_Task* ThreadPool::_T_TaskQueue::pop(void)
+{
+    _T_Task* task = this->_M_head;
+
+    if (task == 0)
+        return 0;
+
+    this->_M_head = task->next;
+    if (this->_M_head == 0)
+        this->_M_tail = 0;
+    __atomic_store_n(&this->_M_size, this->_M_size - 1, __ATOMIC_RELEASE);
+
+    return task;
+}
+
+/*
+ * May be called without holding the task mutex as a hint whether
+ * it's worth taking the lock at all.
+ */
+size_t ThreadPool::_T_TaskQueue::size(void) const
+{
+    return __atomic_load_n(&this->_M_size, __ATOMIC_ACQUIRE);
+}
+
+bool ThreadPool::_T_TaskQueue::empty(void) const
+{
+    return (this->size() == 0);
+}
+
+ThreadPool::_T_PriorityQueue::_T_PriorityQueue(void)
+    : _M_levels(),
+      _M_strides(1, _S_STRIDE_ONE),
+      _M_size(0)
+{
+    this->setLevels(1);
+}
+
+ThreadPool::_T_PriorityQueue::~_T_PriorityQueue(void)
+{
+    this->_M_clear();
+}
+
+/*
+ * Must only be called when the queue is empty, tasks already queued
+ * would be leaked.
+ */
+void ThreadPool::_T_PriorityQueue::setLevels(unsigned levels)
+{
+    this->_M_clear();
+    this->_M_levels.resize(levels);
+    for (_T_LevelList::iterator it = this->_M_levels.begin();
+            it != this->_M_levels.end(); ++it)
+    {
+        it->vtime = 0;
+        it->size = 0;
+        for (size_t i = 0; i < this->_M_strides.size(); ++i)
+        {
+            it->lanes.push_back(new _T_Lane);
+            it->lanes.back()->pass = 0;
+        }
+    }
+}
+
+unsigned ThreadPool::_T_PriorityQueue::levels(void) const
+{
+    return this->_M_levels.size();
+}
+
+void ThreadPool::_T_PriorityQueue::addGroup(unsigned weight)
+{
+    this->_M_strides.push_back(_S_STRIDE_ONE / weight);
+    for (_T_LevelList::iterator it = this->_M_levels.begin();
+            it != this->_M_levels.end(); ++it)
+    {
+        it->lanes.push_back(new _T_Lane);
+        it->lanes.back()->pass = it->vtime;
+    }
+}
+
+unsigned ThreadPool::_T_PriorityQueue::groups(void) const
+{
+    return this->_M_strides.size();
+}
+
+/*
+ * A group that has been idle doesn't get credit for the time it didn't
+ * use - its pass is moved forward to the level's virtual time.
+ */
+void ThreadPool::_T_PriorityQueue::push(_T_Task* task)
+{
+    _T_Level& level = this->_M_levels[task->priority];
+    _T_Lane* lane = level.lanes[task->group];
+
+    if (lane->tasks.empty() && (lane->pass < level.vtime))
+        lane->pass = level.vtime;
+
+    lane->tasks.push(task);
+    ++level.size;
+    __atomic_store_n(&this->_M_size, this->_M_size + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Normally takes a task from the most urgent non-empty level. If aging
+ * is enabled, the oldest task of the less urgent levels which has waited
+ * longer than agingNs goes first.
+ */
+ThreadPool::_T_Task* ThreadPool::_T_PriorityQueue::pop(ElsUint64 agingNs)
+{
+    unsigned first = 0;
+    unsigned best = 0;
+    unsigned bestGroup = 0;
+    ElsUint64 now = 0;
+    ElsUint64 oldest = 0;
+    _T_Task* head = 0;
+    const _T_LaneList* lanes = 0;
+
+    if (this->_M_size == 0)
+        return 0;
+
+    while (this->_M_levels[first].size == 0)
+        ++first;
+
+    if ((agingNs != 0) && (first + 1 < this->_M_levels.size()))
+    {
+        now = sys::monotonicNs();
+        oldest = now > agingNs ? now - agingNs : 0;
+        best = first;
+        for (unsigned i = first + 1; i < this->_M_levels.size(); ++i)
+        {
+            if (this->_M_levels[i].size == 0)
+                continue;
+
+            for (unsigned j = 0; j < this->_M_strides.size(); ++j)
+            {
+                head = this->_M_levels[i].lanes[j]->tasks.front();
+                if ((head != 0) && (head->enqueued <= oldest))
+                {
+                    oldest = head->enqueued;
+                    best = i;
+                    bestGroup = j;
+                }
+            }
+        }
+
+        if (best != first)
+            return this->_M_take(best, bestGroup);
+    }
+
+    lanes = &this->_M_levels[first].lanes;
+    bestGroup = this->_M_strides.size();
+    for (unsigned j = 0; j < this->_M_strides.size(); ++j)
+    {
+        if (!(*lanes)[j]->tasks.empty()
+                && ((bestGroup == this->_M_strides.size())
+                    || ((*lanes)[j]->pass < (*lanes)[bestGroup]->pass)))
+            bestGroup = j;
+    }
+
+    return this->_M_take(first, bestGroup);
+}
+
+/*
+ * Returns the enqueue time of the task which has waited the longest,
+ * 0 if the queue is empty.
+ */
+ElsUint64 ThreadPool::_T_PriorityQueue::oldest(void) const
+{
+    ElsUint64 oldest = 0;
+    _T_Task* head = 0;
+
+    for (_T_LevelList::const_iterator it = this->_M_levels.begin();
+            it != this->_M_levels.end(); ++it)
+    {
+        if (it->size == 0)
+            continue;
+
+        for (_T_LaneList::const_iterator lt = it->lanes.begin();
+                lt != it->lanes.end(); ++lt)
+        {
+            head = (*lt)->tasks.front();
+            if ((head != 0) && ((oldest == 0) || (head->enqueued < oldest)))
+                oldest = head->enqueued;
+        }
+    }
+
+    return oldest;
+}
+
+size_t ThreadPool::_T_PriorityQueue::size(void) const
+{
+    return __atomic_load_n(&this->_M_size, __ATOMIC_ACQUIRE);
+}
+
+bool ThreadPool::_T_PriorityQueue::empty(void) const
+{
+    return (this->size() == 0);
+}
+
+ThreadPool::_T_Task* ThreadPool::_T_PriorityQueue::_M_take(unsigned level,
+        unsigned group)
+{
+    _T_Level& lvl = this->_M_levels[level];
+    _T_Lane* lane = lvl.lanes[group];
+
+    lvl.vtime = lane->pass;
+    lane->pass += this->_M_strides[group];
+    --lvl.size;
+    __atomic_store_n(&this->_M_size, this->_M_size - 1, __ATOMIC_RELEASE);
+
+    return lane->tasks.pop();
+}
+
+void ThreadPool::_T_PriorityQueue::_M_clear(void)
+{
+    for (_T_LevelList::iterator it = this->_M_levels.begin();
+            it != this->_M_levels.end(); ++it)
+    {
+        for (_T_LaneList::iterator lt = it->lanes.begin();
+                lt != it->lanes.end(); ++lt)
+            delete *lt;
+        it->lanes.clear();
+    }
+    this->_M_levels.clear();
+}
+
+ThreadPool::TaskAttr::TaskAttr(void)
+    : _M_priority(PRIORITY_LOWEST),
+      _M_group(0),
+      _M_deadline(0),
+      _M_token(0)
+{
+
+}
+
+ThreadPool::TaskAttr& ThreadPool::TaskAttr::setPriority(unsigned priority)
+{
+    this->_M_priority = priority;
+    return *this;
+}
+
+ThreadPool::TaskAttr& ThreadPool::TaskAttr::setGroup(unsigned group)
+{
+    this->_M_group = group;
+    return *this;
+}
+
+/*
+ * Deadline is an absolute sys::monotonicNs() timestamp, 0 meaning none.
+ */
+ThreadPool::TaskAttr& ThreadPool::TaskAttr::setDeadline(ElsUint64 deadline)
+{
+    this->_M_deadline = deadline;
+    return *this;
+}
+
+/*
+ * Relative to now, not to the moment the task is scheduled.
+ */
+ThreadPool::TaskAttr& ThreadPool::TaskAttr::setTimeout(
+        const misc::Timeval& timeout)
+{
+    this->_M_deadline = sys::monotonicNs()
+            + static_cast<ElsUint64>(timeout.getSec()) * 1000000000ULL
+            + timeout.getNsec();
+    return *this;
+}
+
+ThreadPool::TaskAttr& ThreadPool::TaskAttr::setCancelToken(
+        const CancelToken& token)
+{
+    this->_M_token = token;
+    return *this;
+}
+
+unsigned ThreadPool::TaskAttr::priority(void) const
+{
+    return this->_M_priority;
+}
+
+unsigned ThreadPool::TaskAttr::group(void) const
+{
+    return this->_M_group;
+}
+
+ElsUint64 ThreadPool::TaskAttr::deadline(void) const
+{
+    return this->_M_deadline;
+}
+
+const CancelToken& ThreadPool::TaskAttr::cancelToken(void) const
+{
+    return this->_M_token;
+}
+
+ThreadPool::WorkerStats::WorkerStats(void)
+    : tasksRun(0),
+      steals(0),
+      busyNs(0),
+      idleNs(0),
+      localHighWater(0),
+      waitLatency(),
+      runTime()
+{
+
+}
+
+/**
+ * @brief   Returns the fraction of time the worker spent running tasks.
+ * @return  Value between 0 and 1, 0 if the worker has never run.
+ */
+double ThreadPool::WorkerStats::busyRatio(void) const
+{
+    ElsUint64 total = this->busyNs + this->idleNs;
+
+    return total != 0 ? static_cast<double>(this->busyNs) / total : 0.0;
+}
+
+ThreadPool::_T_WorkerCounters::_T_WorkerCounters(unsigned levels)
+    : tasksRun(0),
+      steals(0),
+      busyNs(0),
+      idleNs(0),
+      localHighWater(0),
+      waitLatency(),
+      runTime(),
+      priorityWait(levels)
+{
+
+}
+
+void ThreadPool::_T_WorkerCounters::reset(void)
+{
+    __atomic_store_n(&this->tasksRun, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->steals, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->busyNs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->idleNs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->localHighWater, 0, __ATOMIC_RELAXED);
+    this->waitLatency.reset();
+    this->runTime.reset();
+    for (_T_HistogramList::iterator it = this->priorityWait.begin();
+            it != this->priorityWait.end(); ++it)
+        it->reset();
+}
+
+void ThreadPool::_T_WorkerCounters::snapshot(WorkerStats& stats) const
+{
+    stats.tasksRun = __atomic_load_n(&this->tasksRun, __ATOMIC_RELAXED);
+    stats.steals = __atomic_load_n(&this->steals, __ATOMIC_RELAXED);
+    stats.busyNs = __atomic_load_n(&this->busyNs, __ATOMIC_RELAXED);
+    stats.idleNs = __atomic_load_n(&this->idleNs, __ATOMIC_RELAXED);
+    stats.localHighWater = __atomic_load_n(&this->localHighWater,
+            __ATOMIC_RELAXED);
+    stats.waitLatency = this->waitLatency;
+    stats.runTime = this->runTime;
+}
+
+ThreadPool::_T_Job::_T_Job(ThreadPool* owner, size_t index)
+    : IThread(),
+      _M_owner(owner),
+      _M_localQueue(new _T_LocalQueue(_S_LOCAL_QUEUE_SIZE)),
+      _M_counters(owner->_M_counters.at(index)),
+      _M_seed(static_cast<ElsUint32>(index + 1) * 2654435761U),
+      _M_avgIdleGap(0),
+      _M_freeTasks(0),
+      _M_numFree(0)
+{
+
+}
+
+ThreadPool::_T_Job::~_T_Job(void)
+{
+    this->_M_owner->_M_spillCache(this, 0);
+    delete this->_M_localQueue;
+}
+
+int ThreadPool::_T_Job::_M_run(void)
+{
+    _T_Task* task = 0;
+    ElsUint64 start = 0;
+    ElsUint64 elapsed = 0;
+    ElsUint64 wait = 0;
+    bool active = true;
+
+    _S_currentJob = this;
+    while (active && !this->_M_stopRequested())
+    {
+        if (this->_M_owner->_M_nextTask(this, task))
+        {
+            start = sys::monotonicNs();
+            wait = this->_M_owner->_M_recordWait(this, *task, start);
+            if (this->_M_owner->_M_elastic() && (wait > __atomic_load_n(
+                    &this->_M_owner->_M_growThresholdNs, __ATOMIC_RELAXED)))
+                this->_M_owner->_M_grow(wait);
+            if (this->_M_owner->_M_runTask(task))
+            {
+                elapsed = sys::monotonicNs() - start;
+                this->_M_counters->runTime.record(elapsed);
+                addCounter(this->_M_counters->tasksRun, 1);
+                addCounter(this->_M_counters->busyNs, elapsed);
+            }
+        }
+        else
+        {
+            start = sys::monotonicNs();
+            active = this->_M_owner->_M_idle(this);
+            addCounter(this->_M_counters->idleNs, sys::monotonicNs() - start);
+        }
+    }
+    this->_M_owner->_M_flushLocal(this);
+    _S_currentJob = 0;
+
+    return 0;
+}
+
+ElsUint32 ThreadPool::_T_Job::_M_random(void)
+{
+    /* xorshift32 - only used for picking steal victims. */
+    this->_M_seed ^= this->_M_seed << 13;
+    this->_M_seed ^= this->_M_seed >> 17;
+    this->_M_seed ^= this->_M_seed << 5;
+    return this->_M_seed;
+}
+
+ELS_END_NAMESPACE_2
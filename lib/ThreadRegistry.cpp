@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    ThreadRegistry.cpp
+ */
+
+#include <els/ThreadRegistry.hpp>
+#include <els/AutoMutex.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+namespace {
+
+/*
+ * Function statics, so that threads started by constructors of other
+ * static objects find the registry initialized.
+ */
+Mutex& registryMutex(void)
+{
+    static Mutex mutex;
+    return mutex;
+}
+
+std::vector<IThread*>& registryThreads(void)
+{
+    static std::vector<IThread*> threads;
+    return threads;
+}
+
+bool readProcFile(::pid_t tid, const char* file, char* buf, size_t size)
+{
+    char path[64];
+    std::FILE* fp = 0;
+    size_t len = 0;
+
+    ::snprintf(path, sizeof(path), "/proc/self/task/%d/%s",
+            static_cast<int>(tid), file);
+    fp = ::fopen(path, "r");
+    if (fp == 0)
+        return false;
+
+    len = ::fread(buf, 1, size - 1, fp);
+    ::fclose(fp);
+    buf[len] = '\0';
+    return true;
+}
+
+bool cpuTimeGreater(const ThreadRegistry::ThreadInfo& a,
+        const ThreadRegistry::ThreadInfo& b)
+{
+    return a.cpuNs > b.cpuNs;
+}
+
+}
+
+ThreadRegistry::ThreadInfo::ThreadInfo(void)
+    : tid(-1),
+      name(),
+      state(IThread::THREAD_INITIALIZED),
+      userNs(0),
+      systemNs(0),
+      cpuNs(0),
+      voluntarySwitches(0),
+      involuntarySwitches(0)
+{
+
+}
+
+/**
+ * @brief   Collects the state and CPU usage of all registered threads.
+ * @return  Thread info, the biggest CPU consumers first.
+ *
+ * Threads which exit while the snapshot is being taken are left out.
+ * CPU times are cumulative since the thread started - compare two
+ * snapshots to get the current usage.
+ */
+std::vector<ThreadRegistry::ThreadInfo> ThreadRegistry::snapshot(void)
+{
+    std::vector<ThreadInfo> infos;
+    std::vector<ThreadInfo> result;
+    ThreadInfo info;
+
+    registryMutex().lock();
+    for (std::vector<IThread*>::const_iterator it = registryThreads().begin();
+            it != registryThreads().end(); ++it)
+    {
+        info.tid = (*it)->tid();
+        info.state = (*it)->state();
+        infos.push_back(info);
+    }
+    registryMutex().unlock();
+
+    for (std::vector<ThreadInfo>::iterator it = infos.begin();
+            it != infos.end(); ++it)
+    {
+        if (_S_readStats(*it))
+            result.push_back(*it);
+    }
+
+    std::stable_sort(result.begin(), result.end(), cpuTimeGreater);
+    return result;
+}
+
+/**
+ * @brief   Returns the number of registered threads.
+ * @return  Number of running IThread threads.
+ */
+size_t ThreadRegistry::size(void)
+{
+    AutoMutex am(registryMutex());
+    return registryThreads().size();
+}
+
+/**
+ * @brief   Returns the CPU time consumed by the calling thread.
+ * @return  CPU time in nanoseconds.
+ *
+ * Unlike snapshot() a single vDSO call, cheap enough to measure
+ * individual operations.
+ */
+ElsUint64 ThreadRegistry::currentCpuNs(void)
+{
+    struct timespec ts;
+
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+
+    return static_cast<ElsUint64>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void ThreadRegistry::_S_add(IThread* thread)
+{
+    AutoMutex am(registryMutex());
+    registryThreads().push_back(thread);
+}
+
+void ThreadRegistry::_S_remove(IThread* thread)
+{
+    AutoMutex am(registryMutex());
+    std::vector<IThread*>& threads = registryThreads();
+
+    threads.erase(std::remove(threads.begin(), threads.end(), thread),
+            threads.end());
+}
+
+bool ThreadRegistry::_S_readStats(ThreadInfo& info)
+{
+    static const ElsUint64 tickNs = 1000000000ULL / ::sysconf(_SC_CLK_TCK);
+    char buf[4096];
+    const char* pos = 0;
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+    unsigned long long runNs = 0;
+
+    if (!readProcFile(info.tid, "stat", buf, sizeof(buf)))
+        return false;
+
+    /*
+     * "tid (comm) state ppid ..." - the name may contain spaces and
+     * parentheses, so skip to the last ')'. utime and stime are fields
+     * 14 and 15, the state is field 3.
+     */
+    pos = ::strrchr(buf, ')');
+    if ((pos == 0) || (::sscanf(pos + 2,
+            "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+            &utime, &stime) != 2))
+        return false;
+
+    info.name.assign(static_cast<const char*>(::strchr(buf, '(')) + 1, pos);
+    info.userNs = utime * tickNs;
+    info.systemNs = stime * tickNs;
+    info.cpuNs = info.userNs + info.systemNs;
+
+    if (readProcFile(info.tid, "schedstat", buf, sizeof(buf))
+            && (::sscanf(buf, "%llu", &runNs) == 1))
+        info.cpuNs = runNs;
+
+    if (readProcFile(info.tid, "status", buf, sizeof(buf)))
+    {
+        if ((pos = ::strstr(buf, "\nvoluntary_ctxt_switches:")) != 0)
+            info.voluntarySwitches = ::strtoull(::strchr(pos, ':') + 1, 0, 10);
+        if ((pos = ::strstr(buf, "\nnonvoluntary_ctxt_switches:")) != 0)
+            info.involuntarySwitches =
+                    ::strtoull(::strchr(pos, ':') + 1, 0, 10);
+    }
+
+    return true;
+}
+
+ELS_END_NAMESPACE_2
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    TicketLock.cpp
+ */
+
+#include <els/TicketLock.hpp>
+#include "SpinHelpers.hpp"
+
+#include <sched.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+namespace {
+
+/* Pause iterations per thread queued ahead of us. */
+const unsigned spinsPerWaiter = 20;
+/* Further waiters don't lengthen the backoff. */
+const unsigned maxAhead = 16;
+/* Pause iterations before giving up the CPU. */
+const unsigned maxSpins = 2000;
+
+}
+
+/**
+ * @brief   Constructor.
+ */
+TicketLock::TicketLock(void) throw()
+    : _M_next(0),
+      _M_serving(0)
+{
+
+}
+
+/**
+ * @brief   Destructor.
+ */
+TicketLock::~TicketLock(void) throw()
+{
+
+}
+
+void TicketLock::_M_wait(unsigned ticket) throw()
+{
+    unsigned limit = spinLimit(maxSpins);
+    unsigned serving = 0;
+    unsigned spins = 0;
+    unsigned ahead = 0;
+
+    while ((serving = __atomic_load_n(&this->_M_serving,
+            __ATOMIC_ACQUIRE)) != ticket)
+    {
+        if (spins >= limit)
+        {
+            ::sched_yield();
+            continue;
+        }
+
+        /* Proportional backoff - fewer polls of the contended line. */
+        ahead = ticket - serving;
+        if (ahead > maxAhead)
+            ahead = maxAhead;
+        for (unsigned i = 0; i < ahead * spinsPerWaiter; ++i)
+            ELS_CPU_RELAX();
+        spins += ahead * spinsPerWaiter;
+    }
+}
+
+ELS_END_NAMESPACE_2
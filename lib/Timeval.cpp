@@ -142,6 +142,51 @@ void Timeval::toTimespec(::timespec& ts) const throw()
     ts.tv_nsec = this->_M_nsec;
 }
 
+/**
+ * @brief   Adds another time value to this one.
+ * @param   other   Time value to add.
+ * @return  Reference to this object.
+ */
+Timeval& Timeval::operator +=(const Timeval& other) throw()
+{
+    this->_M_sec += other._M_sec;
+    this->_M_nsec += other._M_nsec;
+    if (this->_M_nsec >= 1000000000)
+    {
+        this->_M_sec++;
+        this->_M_nsec -= 1000000000;
+    }
+
+    return *this;
+}
+
+/**
+ * @brief   Compares two time values.
+ * @param   other   Time value to compare with.
+ * @return  True if this time value is earlier than the other one.
+ */
+bool Timeval::operator <(const Timeval& other) const throw()
+{
+    if (this->_M_sec != other._M_sec)
+        return this->_M_sec < other._M_sec;
+    return this->_M_nsec < other._M_nsec;
+}
+
+/**
+ * @brief   Returns current wall-clock time.
+ * @return  Time passed since the Epoch.
+ *
+ * The result can be passed directly to Condition::block() after adding
+ * a relative timeout.
+ */
+Timeval Timeval::now(void) throw()
+{
+    ::timespec ts;
+
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return Timeval(ts.tv_sec, ts.tv_nsec);
+}
+
 ElsInt32& Timeval::_S_checkNsec(ElsInt32& nsec)
 {
     if (nsec >= 1000000000)
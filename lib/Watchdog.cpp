@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    Watchdog.cpp
+ */
+
+#include <els/Watchdog.hpp>
+#include <els/AutoMutex.hpp>
+#include <els/Exception.hpp>
+#include <els/StopToken.hpp>
+#include <els/System.hpp>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <execinfo.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+ELS_BEGIN_NAMESPACE_2(els, thread)
+
+namespace {
+
+class Wakeup : public IRunnable
+{
+public:
+
+    Wakeup(Mutex& mutex, Condition& cond)
+        : IRunnable(), _M_mutex(mutex), _M_cond(cond) {}
+
+    virtual void run(void) throw()
+    {
+        this->_M_mutex.lock();
+        this->_M_cond.unblockAll();
+        this->_M_mutex.unlock();
+    }
+
+private:
+
+    Mutex& _M_mutex;
+    Condition& _M_cond;
+};
+
+misc::Timeval nsToTimeval(ElsUint64 ns)
+{
+    return misc::Timeval(static_cast<ElsInt32>(ns / 1000000000ULL),
+            static_cast<ElsInt32>(ns % 1000000000ULL));
+}
+
+ElsUint64 timevalToNs(const misc::Timeval& tv)
+{
+    return static_cast<ElsUint64>(tv.getSec()) * 1000000000ULL
+            + tv.getNsec();
+}
+
+}
+
+const size_t Watchdog::DEF_CAPACITY = 64;
+
+Watchdog::StallHandler::~StallHandler(void)
+{
+
+}
+
+/**
+ * @brief   Creates a watchdog, start() it to begin monitoring.
+ * @param   capacity    Maximum number of monitored threads.
+ * @param   interval    Time between checks, 10 milliseconds by default.
+ * @throw   InvalidArgument     If capacity or interval is 0.
+ *
+ * Stalls are logged to stderr by default.
+ */
+Watchdog::Watchdog(size_t capacity, const misc::Timeval& interval)
+    : INamedThread("watchdog"),
+      _M_slots(0),
+      _M_names(capacity),
+      _M_capacity(capacity),
+      _M_intervalNs(timevalToNs(interval)),
+      _M_actions(ACTION_LOG),
+      _M_handler(0),
+      _M_logger(0),
+      _M_dumpSignal(SIGRTMIN),
+      _M_stalls(0),
+      _M_mutex(),
+      _M_sleepMutex(),
+      _M_sleepCond()
+{
+    if ((capacity == 0) || (this->_M_intervalNs == 0))
+        throw except::InvalidArgument("Invalid watchdog configuration");
+
+    this->_M_slots = new _T_Slot[capacity];
+    ::memset(this->_M_slots, 0, capacity * sizeof(_T_Slot));
+}
+
+Watchdog::~Watchdog(void)
+{
+    ThreadState state = this->state();
+
+    if ((state == THREAD_STARTING) || (state == THREAD_RUNNING)
+            || (state == THREAD_SLEEPING))
+    {
+        this->stop();
+        this->join();
+    }
+
+    delete[] this->_M_slots;
+}
+
+/**
+ * @brief   Starts monitoring a thread.
+ * @param   name    Name used in reports.
+ * @param   period  Maximum time between two beats.
+ * @return  Heartbeat handle.
+ * @throw   InvalidArgument     If period is 0.
+ * @throw   OutOfRange          If all slots are taken.
+ *
+ * Meant to be called by the monitored thread - its id is recorded for
+ * reports and stack dumps. The period starts counting immediately.
+ */
+Watchdog::Heartbeat Watchdog::add(const std::string& name,
+        const misc::Timeval& period)
+{
+    AutoMutex am(this->_M_mutex);
+    ElsUint64 periodNs = timevalToNs(period);
+    _T_Slot* slot = 0;
+
+    if (periodNs == 0)
+        throw except::InvalidArgument("Heartbeat period must not be 0");
+
+    for (size_t i = 0; i < this->_M_capacity; ++i)
+    {
+        slot = &this->_M_slots[i];
+        if (slot->used)
+            continue;
+
+        slot->periodNs = periodNs;
+        slot->lastSeen = sys::monotonicNs();
+        slot->stalled = 0;
+        slot->tid = sys::getTid();
+        __atomic_store_n(&slot->alive, 0, __ATOMIC_RELAXED);
+        slot->used = 1;
+        this->_M_names[i] = name;
+
+        return Heartbeat(slot);
+    }
+
+    throw except::OutOfRange("Watchdog full: %zu slots", this->_M_capacity);
+}
+
+/**
+ * @brief   Stops monitoring a thread.
+ * @param   heartbeat   Handle returned by add(), invalidated.
+ * @throw   InvalidArgument     If the handle doesn't belong to this
+ *                              watchdog.
+ *
+ * Copies of the handle must not be used afterwards, the slot may be
+ * given to another thread.
+ */
+void Watchdog::remove(Heartbeat& heartbeat)
+{
+    AutoMutex am(this->_M_mutex);
+    _T_Slot* slot = heartbeat._M_slot;
+    std::less<const _T_Slot*> before;
+    size_t index = 0;
+
+    /*
+     * Pointers into other arrays can't be subtracted or compared with
+     * the built-in operators, std::less gives a total order for them.
+     */
+    if ((slot == 0) || before(slot, this->_M_slots)
+            || !before(slot, this->_M_slots + this->_M_capacity))
+        throw except::InvalidArgument("Unknown heartbeat");
+
+    index = slot - this->_M_slots;
+    if (!slot->used)
+        throw except::InvalidArgument("Unknown heartbeat");
+
+    slot->used = 0;
+    this->_M_names[index].clear();
+    heartbeat._M_slot = 0;
+}
+
+/**
+ * @brief   Sets what happens on a stall.
+ * @param   actions     Bitwise or of Action values, ACTION_LOG
+ *                      by default.
+ */
+void Watchdog::setActions(unsigned actions)
+{
+    AutoMutex am(this->_M_mutex);
+    this->_M_actions = actions;
+}
+
+/**
+ * @brief   Sets the handler called for ACTION_CALLBACK.
+ * @param   handler     Handler, called from the watchdog thread. It must
+ *                      outlive the watchdog or be replaced.
+ */
+void Watchdog::setStallHandler(StallHandler* handler)
+{
+    AutoMutex am(this->_M_mutex);
+    this->_M_handler = handler;
+}
+
+/**
+ * @brief   Sets the logger used by ACTION_LOG.
+ * @param   logger  Logger, 0 to log to stderr.
+ */
+void Watchdog::setLogger(log::Logger* logger)
+{
+    AutoMutex am(this->_M_mutex);
+    this->_M_logger = logger;
+}
+
+/**
+ * @brief   Sets the signal used by ACTION_DUMP_STACK.
+ * @param   signo   Signal number, SIGRTMIN by default. The watchdog
+ *                  installs its own handler for it on the first dump.
+ */
+void Watchdog::setDumpSignal(int signo)
+{
+    AutoMutex am(this->_M_mutex);
+    this->_M_dumpSignal = signo;
+}
+
+/**
+ * @brief   Checks all heartbeats once and reports new stalls.
+ * @return  Number of new stalls.
+ *
+ * Called periodically by the watchdog thread. Can also be called
+ * directly instead of starting the thread.
+ */
+size_t Watchdog::check(void)
+{
+    std::vector<StallInfo> stalled;
+    StallInfo info;
+    ElsUint64 now = sys::monotonicNs();
+    _T_Slot* slot = 0;
+    unsigned actions = 0;
+    StallHandler* handler = 0;
+    log::Logger* logger = 0;
+    int signo = 0;
+
+    this->_M_mutex.lock();
+    for (size_t i = 0; i < this->_M_capacity; ++i)
+    {
+        slot = &this->_M_slots[i];
+        if (!slot->used)
+            continue;
+
+        if (__atomic_exchange_n(&slot->alive, 0, __ATOMIC_RELAXED))
+        {
+            slot->lastSeen = now;
+            slot->stalled = 0;
+            continue;
+        }
+
+        if (slot->stalled || (now - slot->lastSeen <= slot->periodNs))
+            continue;
+
+        slot->stalled = 1;
+        info.name = this->_M_names[i];
+        info.tid = slot->tid;
+        info.stalledNs = now - slot->lastSeen;
+        info.periodNs = slot->periodNs;
+        stalled.push_back(info);
+    }
+
+    this->_M_stalls += stalled.size();
+    actions = this->_M_actions;
+    handler = this->_M_handler;
+    logger = this->_M_logger;
+    signo = this->_M_dumpSignal;
+    this->_M_mutex.unlock();
+
+    /* Outside the lock, handlers may add or remove heartbeats. */
+    for (std::vector<StallInfo>::const_iterator it = stalled.begin();
+            it != stalled.end(); ++it)
+        this->_M_report(*it, actions, handler, logger, signo);
+
+    return stalled.size();
+}
+
+/**
+ * @brief   Returns the number of stalls detected so far.
+ * @return  Number of stalls.
+ */
+size_t Watchdog::stalls(void) const
+{
+    AutoMutex am(this->_M_mutex);
+    return this->_M_stalls;
+}
+
+int Watchdog::_M_run(void)
+{
+    Wakeup wakeup(this->_M_sleepMutex, this->_M_sleepCond);
+    StopCallback callback(this->stopToken(), wakeup);
+    misc::Timeval deadline;
+
+    while (!this->_M_stopRequested())
+    {
+        this->check();
+
+        deadline = misc::Timeval::now();
+        deadline += nsToTimeval(this->_M_intervalNs);
+        this->_M_sleepMutex.lock();
+        while (!this->_M_stopRequested()
+                && (misc::Timeval::now() < deadline))
+            this->_M_sleepCond.block(this->_M_sleepMutex, deadline);
+        this->_M_sleepMutex.unlock();
+    }
+
+    return 0;
+}
+
+void Watchdog::_M_report(const StallInfo& info, unsigned actions,
+        StallHandler* handler, log::Logger* logger, int signo)
+{
+    struct sigaction sa;
+    void* frame = 0;
+
+    if (actions & ACTION_LOG)
+    {
+        if (logger != 0)
+            logger->crit("Watchdog: thread %s (%d) stalled for %llu ms, "
+                    "period %llu ms", info.name.c_str(), info.tid,
+                    info.stalledNs / 1000000ULL, info.periodNs / 1000000ULL);
+        else
+            ::fprintf(stderr, "Watchdog: thread %s (%d) stalled for %llu ms, "
+                    "period %llu ms\n", info.name.c_str(), info.tid,
+                    info.stalledNs / 1000000ULL, info.periodNs / 1000000ULL);
+    }
+
+    if ((actions & ACTION_CALLBACK) && (handler != 0))
+        handler->onStall(info);
+
+    if (actions & ACTION_DUMP_STACK)
+    {
+        /* The first backtrace() loads libgcc, not in a signal handler. */
+        ::backtrace(&frame, 1);
+        ::memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = _S_dumpStack;
+        sa.sa_flags = SA_RESTART;
+        ::sigemptyset(&sa.sa_mask);
+        ::sigaction(signo, &sa, 0);
+        ::syscall(SYS_tgkill, ::getpid(), info.tid, signo);
+    }
+
+    if (actions & ACTION_ABORT)
+    {
+        /* Give the stalled thread a chance to print its stack. */
+        if (actions & ACTION_DUMP_STACK)
+            ::usleep(100000);
+        ::abort();
+    }
+}
+
+/* Runs in the stalled thread, sticks to async-signal-safe calls. */
+void Watchdog::_S_dumpStack(int signo)
+{
+    static const char header[] = "Watchdog: backtrace of stalled thread ";
+    void* frames[64];
+    char tid[16];
+    size_t len = sizeof(tid);
+    long id = ::syscall(SYS_gettid);
+    int num = 0;
+
+    (void)signo;
+    tid[--len] = '\n';
+    do
+    {
+        tid[--len] = '0' + id % 10;
+        id /= 10;
+    }
+    while ((id > 0) && (len > 0));
+
+    if ((::write(STDERR_FILENO, header, sizeof(header) - 1) < 0)
+            || (::write(STDERR_FILENO, tid + len, sizeof(tid) - len) < 0))
+        return;
+    num = ::backtrace(frames, sizeof(frames) / sizeof(frames[0]));
+    ::backtrace_symbols_fd(frames, num, STDERR_FILENO);
+}
+
+ELS_END_NAMESPACE_2
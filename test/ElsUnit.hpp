@@ -33,6 +33,19 @@ inline int runElsUnitTests(int argc, char** argv)
 #define ELSUNIT_SIMPLE_TESTCASE(TESTNAME, CASENAME)                         \
     TEST(TESTNAME, CASENAME)
 
+/*
+ * Typed test cases run once for every type of a list, which is
+ * declared with ELSUNIT_TYPES. The type is TypeParam in the test body.
+ */
+#define ELSUNIT_TYPES ::testing::Types
+
+#define ELSUNIT_TYPED_TESTCASE(TESTNAME, TYPES)                             \
+    template <typename T> class TESTNAME : public ::testing::Test {};       \
+    TYPED_TEST_SUITE(TESTNAME, TYPES)
+
+#define ELSUNIT_TYPED_TEST(TESTNAME, CASENAME)                              \
+    TYPED_TEST(TESTNAME, CASENAME)
+
 #define ELSUNIT_EXPECT_TRUE(CONDITION) EXPECT_TRUE(CONDITION)
 #define ELSUNIT_EXPECT_FALSE(CONDITION) EXPECT_FALSE(CONDITION)
 #define ELSUNIT_ASSERT_TRUE(CONDITION) ASSERT_TRUE(CONDITION)
@@ -24,6 +24,8 @@
 
 #include <els/Atomic.hpp>
 
+#include <stdint.h>
+
 ELSUNIT_SIMPLE_TESTCASE(AtomicInt, get)
 {
     els::thread::AtomicInt i(-100);
@@ -80,3 +82,75 @@ ELSUNIT_SIMPLE_TESTCASE(AtomicUint, dec)
 
 
 
+
+ELSUNIT_SIMPLE_TESTCASE(AtomicInt, loadStore)
+{
+    els::thread::AtomicInt i;
+
+    ELSUNIT_EXPECT_EQ(0, i.load());
+    i.store(5);
+    ELSUNIT_EXPECT_EQ(5, i.load(els::thread::MEMORY_ORDER_RELAXED));
+    i.store(6, els::thread::MEMORY_ORDER_SEQ_CST);
+    ELSUNIT_EXPECT_EQ(6, i.get());
+    ELSUNIT_EXPECT_EQ(6, i.exchange(7));
+    ELSUNIT_EXPECT_EQ(7, i.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(AtomicInt, compareExchange)
+{
+    els::thread::AtomicInt i(10);
+    els::ElsInt32 expected = 11;
+
+    ELSUNIT_EXPECT_FALSE(i.compareExchange(expected, 20));
+    ELSUNIT_EXPECT_EQ(10, expected);
+    ELSUNIT_EXPECT_TRUE(i.compareExchange(expected, 20,
+            els::thread::MEMORY_ORDER_ACQ_REL,
+            els::thread::MEMORY_ORDER_ACQUIRE));
+    ELSUNIT_EXPECT_EQ(20, i.get());
+
+    expected = 20;
+    while (!i.compareExchangeWeak(expected, 30))
+        ;
+    ELSUNIT_EXPECT_EQ(30, i.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(AtomicInt, fetchOps)
+{
+    els::thread::AtomicUint i(0x0f);
+
+    ELSUNIT_EXPECT_EQ(0x0fU, i.fetchAdd(1));
+    ELSUNIT_EXPECT_EQ(0x10U,
+            i.fetchSub(1, els::thread::MEMORY_ORDER_RELAXED));
+    ELSUNIT_EXPECT_EQ(0x0fU, i.fetchAnd(0x3c));
+    ELSUNIT_EXPECT_EQ(0x0cU, i.fetchOr(0x30));
+    ELSUNIT_EXPECT_EQ(0x3cU, i.fetchXor(0xff));
+    ELSUNIT_EXPECT_EQ(0xc3U, i.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(AtomicInt, wide)
+{
+    els::thread::AtomicUint64 i(0xffffffffULL);
+    els::thread::AtomicInt64 j(-1);
+
+    ELSUNIT_EXPECT_EQ(0x100000000ULL, i.inc());
+    ELSUNIT_EXPECT_EQ(0x100000000ULL, i.fetchAdd(0x100000000ULL));
+    ELSUNIT_EXPECT_EQ(0x200000000ULL, i.load());
+    ELSUNIT_EXPECT_EQ(-2, j.dec());
+    ELSUNIT_EXPECT_EQ(0U,
+            reinterpret_cast<uintptr_t>(&i) % sizeof(els::ElsUint64));
+}
+
+ELSUNIT_SIMPLE_TESTCASE(AtomicInt, pointer)
+{
+    int array[4] = { 0, 1, 2, 3 };
+    els::thread::Atomic<int*> p(array);
+    int* expected = array + 1;
+
+    ELSUNIT_EXPECT_EQ(array, p.fetchAdd(2));
+    ELSUNIT_EXPECT_EQ(2, *p.load());
+    ELSUNIT_EXPECT_EQ(array + 2, p.fetchSub(1));
+    ELSUNIT_EXPECT_TRUE(p.compareExchange(expected, array + 3));
+    ELSUNIT_EXPECT_EQ(3, *p.get());
+    ELSUNIT_EXPECT_EQ(array + 3, p.exchange(0));
+    ELSUNIT_EXPECT_TRUE(p.load() == 0);
+}
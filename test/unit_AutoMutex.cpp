@@ -23,6 +23,7 @@
 #include "ElsUnit.hpp"
 
 #include <els/Mutex.hpp>
+#include <els/FastMutex.hpp>
 #include <els/AutoMutex.hpp>
 #include <els/IThread.hpp>
 
@@ -63,3 +64,15 @@ ELSUNIT_SIMPLE_TESTCASE(AutoMutex, autoLock)
     ELSUNIT_EXPECT_EQ(0, els::thread::IThread::threadCount());
 }
 
+ELSUNIT_SIMPLE_TESTCASE(AutoMutex, fastMutex)
+{
+    els::thread::FastMutex fast(true);
+
+    {
+        els::thread::AutoMutex am(fast);
+        ELSUNIT_EXPECT_FALSE(fast.trylock());
+    }
+    ELSUNIT_EXPECT_TRUE(fast.trylock());
+    fast.unlock();
+}
+
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_CancelToken.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/CancelToken.hpp>
+
+ELSUNIT_SIMPLE_TESTCASE(CancelToken, sharedState)
+{
+    els::thread::CancelToken token;
+    els::thread::CancelToken copy(token);
+    els::thread::CancelToken other;
+
+    ELSUNIT_EXPECT_FALSE(token.cancelled());
+    ELSUNIT_EXPECT_FALSE(copy.cancelled());
+
+    copy.cancel();
+    ELSUNIT_EXPECT_TRUE(token.cancelled());
+    ELSUNIT_EXPECT_TRUE(copy.cancelled());
+    ELSUNIT_EXPECT_FALSE(other.cancelled());
+
+    copy = other;
+    ELSUNIT_EXPECT_FALSE(copy.cancelled());
+    copy.cancel();
+    copy.cancel();
+    ELSUNIT_EXPECT_TRUE(other.cancelled());
+    ELSUNIT_EXPECT_TRUE(token.cancelled());
+}
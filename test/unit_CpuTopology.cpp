@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_CpuTopology.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/CpuTopology.hpp>
+#include <els/Exception.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using els::sys::CpuTopology;
+
+namespace {
+
+void writeFile(const std::string& root, const std::string& path,
+        const std::string& contents)
+{
+    std::string full = root + "/" + path;
+    std::string cmd = "mkdir -p " + full.substr(0, full.rfind('/'));
+    std::FILE* file = 0;
+
+    ELSUNIT_ASSERT_EQ(0, std::system(cmd.c_str()));
+    file = std::fopen(full.c_str(), "w");
+    ELSUNIT_ASSERT_TRUE(file != 0);
+    std::fprintf(file, "%s\n", contents.c_str());
+    std::fclose(file);
+}
+
+std::string cpuFile(unsigned cpu, const char* file)
+{
+    char buf[128];
+
+    std::snprintf(buf, sizeof(buf), "devices/system/cpu/cpu%u/%s", cpu, file);
+    return buf;
+}
+
+/* The unified hierarchy's entry of /proc/self/cgroup, "/" if missing. */
+std::string ownCgroup(void)
+{
+    char line[4096];
+    std::string path = "/";
+    std::FILE* file = std::fopen("/proc/self/cgroup", "r");
+
+    while ((file != 0) && (std::fgets(line, sizeof(line), file) != 0))
+    {
+        if (std::string(line).compare(0, 3, "0::") == 0)
+        {
+            path = std::string(line).substr(3);
+            path.erase(path.find_last_not_of("\n") + 1);
+        }
+    }
+    if (file != 0)
+        std::fclose(file);
+
+    return path;
+}
+
+/*
+ * Two packages, each with two cores with two SMT threads. Siblings are
+ * numbered like on x86: 0/4, 1/5, 2/6 and 3/7.
+ */
+std::string makeSysfs(void)
+{
+    char tmpl[] = "/tmp/els_sysfs_XXXXXX";
+    std::string root = ::mkdtemp(tmpl);
+    char siblings[16];
+
+    writeFile(root, "devices/system/cpu/online", "0-7");
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        std::snprintf(siblings, sizeof(siblings), "%u,%u", i % 4, i % 4 + 4);
+        writeFile(root, cpuFile(i, "topology/core_id"), i % 2 ? "1" : "0");
+        writeFile(root, cpuFile(i, "topology/physical_package_id"),
+                (i / 2) % 2 ? "1" : "0");
+        writeFile(root, cpuFile(i, "cache/index0/level"), "1");
+        writeFile(root, cpuFile(i, "cache/index0/type"), "Data");
+        writeFile(root, cpuFile(i, "cache/index0/size"), "32K");
+        writeFile(root, cpuFile(i, "cache/index0/shared_cpu_list"), siblings);
+        writeFile(root, cpuFile(i, "cache/index1/level"), "3");
+        writeFile(root, cpuFile(i, "cache/index1/type"), "Unified");
+        writeFile(root, cpuFile(i, "cache/index1/size"), "8192K");
+        writeFile(root, cpuFile(i, "cache/index1/shared_cpu_list"),
+                (i / 2) % 2 ? "2-3,6-7" : "0-1,4-5");
+    }
+    writeFile(root, "devices/system/node/node0/cpulist", "0-1,4-5");
+    writeFile(root, "devices/system/node/node1/cpulist", "2-3,6-7");
+    writeFile(root, "fs/cgroup/cpu.max", "300000 100000");
+
+    return root;
+}
+
+void removeTree(const std::string& root)
+{
+    std::string cmd = "rm -rf " + root;
+
+    ELSUNIT_ASSERT_EQ(0, std::system(cmd.c_str()));
+}
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(CpuTopology, parseCpuList)
+{
+    CpuTopology::CpuList cpus;
+
+    cpus = CpuTopology::parseCpuList("0-2,5,7-8\n");
+    ELSUNIT_ASSERT_EQ(6U, cpus.size());
+    ELSUNIT_EXPECT_EQ(0U, cpus[0]);
+    ELSUNIT_EXPECT_EQ(2U, cpus[2]);
+    ELSUNIT_EXPECT_EQ(5U, cpus[3]);
+    ELSUNIT_EXPECT_EQ(8U, cpus[5]);
+    ELSUNIT_EXPECT_TRUE(CpuTopology::parseCpuList("").empty());
+    ELSUNIT_EXPECT_EXCEPTION(CpuTopology::parseCpuList("1-x"),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EXCEPTION(CpuTopology::parseCpuList("3-1"),
+            els::except::InvalidArgument);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(CpuTopology, fakeSysfs)
+{
+    std::string root = makeSysfs();
+    CpuTopology topo(root);
+    CpuTopology::CpuList order;
+    const unsigned compact[] = { 0, 4, 1, 5, 2, 6, 3, 7 };
+    const unsigned scatter[] = { 0, 2, 1, 3, 4, 6, 5, 7 };
+
+    removeTree(root);
+
+    ELSUNIT_EXPECT_EQ(8U, topo.numCpus());
+    ELSUNIT_EXPECT_EQ(4U, topo.numCores());
+    ELSUNIT_EXPECT_EQ(2U, topo.numPackages());
+    ELSUNIT_EXPECT_EQ(2U, topo.numNodes());
+    ELSUNIT_EXPECT_EQ(1U, topo.cpus()[6].node);
+    ELSUNIT_EXPECT_EQ(3.0, topo.cpuQuota());
+    ELSUNIT_EXPECT_EQ(3U, topo.recommendedThreads());
+
+    order = topo.siblings(5);
+    ELSUNIT_ASSERT_EQ(2U, order.size());
+    ELSUNIT_EXPECT_EQ(1U, order[0]);
+    ELSUNIT_EXPECT_EQ(5U, order[1]);
+    ELSUNIT_EXPECT_EXCEPTION(topo.siblings(8), els::except::InvalidArgument);
+
+    ELSUNIT_ASSERT_EQ(6U, topo.caches().size());
+    ELSUNIT_EXPECT_EQ(1U, topo.caches()[0].level);
+    ELSUNIT_EXPECT_STRING_EQ("Data", topo.caches()[0].type);
+    ELSUNIT_EXPECT_EQ(32768U, topo.caches()[0].size);
+    ELSUNIT_EXPECT_EQ(3U, topo.caches()[1].level);
+    ELSUNIT_EXPECT_EQ(8U << 20, topo.caches()[1].size);
+    ELSUNIT_EXPECT_EQ(4U, topo.caches()[1].cpus.size());
+
+    order = topo.compactOrder();
+    ELSUNIT_ASSERT_EQ(8U, order.size());
+    for (unsigned i = 0; i < 8; ++i)
+        ELSUNIT_EXPECT_EQ(compact[i], order[i]);
+
+    order = topo.scatterOrder();
+    ELSUNIT_ASSERT_EQ(8U, order.size());
+    for (unsigned i = 0; i < 8; ++i)
+        ELSUNIT_EXPECT_EQ(scatter[i], order[i]);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(CpuTopology, minimalSysfs)
+{
+    char tmpl[] = "/tmp/els_sysfs_XXXXXX";
+    std::string root = ::mkdtemp(tmpl);
+
+    writeFile(root, "devices/system/cpu/online", "0-3");
+    writeFile(root, "fs/cgroup/cpu/cpu.cfs_quota_us", "150000");
+    writeFile(root, "fs/cgroup/cpu/cpu.cfs_period_us", "100000");
+
+    CpuTopology topo(root);
+    removeTree(root);
+
+    ELSUNIT_EXPECT_EQ(4U, topo.numCpus());
+    ELSUNIT_EXPECT_EQ(4U, topo.numCores());
+    ELSUNIT_EXPECT_EQ(1U, topo.numNodes());
+    ELSUNIT_EXPECT_TRUE(topo.caches().empty());
+    ELSUNIT_EXPECT_EQ(1.5, topo.cpuQuota());
+    ELSUNIT_EXPECT_EQ(2U, topo.recommendedThreads());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(CpuTopology, processCgroup)
+{
+    char tmpl[] = "/tmp/els_sysfs_XXXXXX";
+    std::string root = ::mkdtemp(tmpl);
+    std::string path = ownCgroup();
+
+    /* The limit of the process's own cgroup is tighter than the root's. */
+    writeFile(root, "devices/system/cpu/online", "0-7");
+    writeFile(root, "fs/cgroup/cpu.max", "400000 100000");
+    writeFile(root, "fs/cgroup" + path + "/cpu.max", "200000 100000");
+
+    CpuTopology topo(root);
+    removeTree(root);
+
+    ELSUNIT_EXPECT_EQ(2.0, topo.cpuQuota());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(CpuTopology, runningSystem)
+{
+    CpuTopology topo;
+
+    ELSUNIT_EXPECT_TRUE(topo.numCpus() > 0);
+    ELSUNIT_EXPECT_TRUE(topo.numCores() <= topo.numCpus());
+    ELSUNIT_EXPECT_TRUE(topo.recommendedThreads() > 0);
+    ELSUNIT_EXPECT_TRUE(topo.recommendedThreads() <= topo.numCpus());
+    ELSUNIT_EXPECT_EQ(topo.numCpus(), topo.compactOrder().size());
+    ELSUNIT_EXPECT_EQ(topo.numCpus(), topo.scatterOrder().size());
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_FastMutex.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/FastMutex.hpp>
+#include <els/IThread.hpp>
+
+namespace {
+
+/* Takes the mutex and exits without releasing it. */
+class TryLocker : public els::thread::IThread
+{
+public:
+    explicit TryLocker(els::thread::FastMutex& mutex)
+        : els::thread::IThread(), locked(true), _M_mutex(mutex) {}
+
+    bool locked;
+
+protected:
+    virtual int _M_run(void)
+    {
+        this->locked = this->_M_mutex.trylock();
+        return 0;
+    }
+private:
+    els::thread::FastMutex& _M_mutex;
+};
+
+}
+
+/* Locking itself is tested for all lock types in unit_Locks.cpp. */
+
+ELSUNIT_SIMPLE_TESTCASE(FastMutex, debugChecks)
+{
+    els::thread::FastMutex mutex(true);
+    TryLocker other(mutex);
+
+    ELSUNIT_EXPECT_FALSE(els::thread::FastMutex().debug());
+    ELSUNIT_EXPECT_TRUE(mutex.debug());
+    ELSUNIT_EXPECT_EXCEPTION(mutex.unlock(),
+            els::thread::FastMutex::FastMutexError);
+
+    mutex.lock();
+    ELSUNIT_EXPECT_EXCEPTION(mutex.lock(),
+            els::thread::FastMutex::FastMutexError);
+    ELSUNIT_EXPECT_FALSE(mutex.trylock());
+    ELSUNIT_EXPECT_NO_THROW(mutex.unlock());
+    ELSUNIT_EXPECT_EXCEPTION(mutex.unlock(),
+            els::thread::FastMutex::FastMutexError);
+
+    /* Locked by another thread, which has exited since. */
+    ELSUNIT_ASSERT_NO_THROW(other.start());
+    ELSUNIT_EXPECT_NO_THROW(other.join());
+    ELSUNIT_EXPECT_TRUE(other.locked);
+    ELSUNIT_EXPECT_EXCEPTION(mutex.unlock(),
+            els::thread::FastMutex::FastMutexError);
+}
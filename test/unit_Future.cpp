@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    unit_Future.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/Future.hpp>
+#include <els/ThreadPool.hpp>
+#include <els/Timeval.hpp>
+#include <els/Exception.hpp>
+
+#include <string>
+
+namespace {
+
+class Square : public els::thread::ICallable<int>
+{
+public:
+    explicit Square(int val) : _M_val(val) {}
+    virtual int call(void) { return this->_M_val * this->_M_val; }
+private:
+    int _M_val;
+};
+
+class Failing : public els::thread::ICallable<int>
+{
+public:
+    virtual int call(void)
+    {
+        throw els::except::InvalidArgument("bad input");
+    }
+};
+
+class AddOne : public els::thread::IContinuation<int, int>
+{
+public:
+    virtual int call(const els::thread::Future<int>& previous)
+    {
+        return previous.get() + 1;
+    }
+};
+
+class Tracked : public els::thread::ICallable<int>,
+        public els::thread::IContinuation<int, int>
+{
+public:
+    explicit Tracked(int& deleted) : _M_deleted(deleted) {}
+    virtual ~Tracked(void) { ++this->_M_deleted; }
+    virtual int call(void) { return 0; }
+    virtual int call(const els::thread::Future<int>&) { return 0; }
+private:
+    int& _M_deleted;
+};
+
+class ToString : public els::thread::IContinuation<int, std::string>
+{
+public:
+    virtual std::string call(const els::thread::Future<int>& previous)
+    {
+        try
+        {
+            return previous.get() > 0 ? "positive" : "other";
+        }
+        catch (const els::thread::TaskFailed& e)
+        {
+            return std::string("failed: ") + e.what();
+        }
+    }
+};
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Future, promise)
+{
+    els::thread::Promise<int> promise;
+    els::thread::Future<int> future = promise.future();
+    els::thread::Future<int> empty;
+
+    ELSUNIT_EXPECT_FALSE(empty.valid());
+    ELSUNIT_EXPECT_EXCEPTION(empty.ready(), els::except::LogicError);
+    ELSUNIT_EXPECT_TRUE(future.valid());
+    ELSUNIT_EXPECT_FALSE(future.ready());
+    ELSUNIT_EXPECT_FALSE(future.wait(els::misc::Timeval(0, 1000000)));
+    promise.setValue(42);
+    ELSUNIT_EXPECT_TRUE(future.ready());
+    ELSUNIT_EXPECT_TRUE(future.wait(els::misc::Timeval(0, 1000000)));
+    ELSUNIT_EXPECT_EQ(42, future.get());
+    ELSUNIT_EXPECT_EXCEPTION(promise.setValue(1), els::except::LogicError);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Future, brokenPromise)
+{
+    els::thread::Future<int> future;
+
+    {
+        els::thread::Promise<int> promise;
+        future = promise.future();
+    }
+
+    ELSUNIT_EXPECT_TRUE(future.ready());
+    ELSUNIT_EXPECT_EXCEPTION(future.get(), els::thread::TaskFailed);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Future, submit)
+{
+    els::thread::ThreadPool pool;
+    els::thread::Future<int> futures[16];
+
+    ELSUNIT_ASSERT_NO_THROW(pool.start(4));
+    for (int i = 0; i < 16; ++i)
+        futures[i] = pool.submit(new Square(i), true);
+    for (int i = 0; i < 16; ++i)
+        ELSUNIT_EXPECT_EQ(i * i, futures[i].get());
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Future, submitException)
+{
+    els::thread::ThreadPool pool;
+    Failing failing;
+    els::thread::Future<int> future;
+
+    ELSUNIT_ASSERT_NO_THROW(pool.start(1));
+    future = pool.submit(&failing);
+    future.wait();
+    ELSUNIT_EXPECT_TRUE(future.ready());
+    try
+    {
+        future.get();
+        ELSUNIT_EXPECT_TRUE(false);
+    }
+    catch (const els::thread::TaskFailed& e)
+    {
+        ELSUNIT_EXPECT_STRING_EQ("bad input", std::string(e.what()));
+    }
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Future, then)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+    els::thread::Future<int> sq;
+    els::thread::Future<int> plusTwo;
+    els::thread::Future<std::string> str;
+    els::thread::Future<std::string> failed;
+
+    ELSUNIT_ASSERT_NO_THROW(pool.start(2));
+    sq = pool.submit(new Square(5), true);
+    plusTwo = sq.then(pool, new AddOne, true).then(pool, new AddOne, true);
+    str = plusTwo.then(pool, new ToString, true);
+    ELSUNIT_EXPECT_EQ(27, plusTwo.get());
+    ELSUNIT_EXPECT_STRING_EQ("positive", str.get());
+    /* Continuation added to a future which is already ready. */
+    ELSUNIT_EXPECT_EQ(26, sq.then(pool, new AddOne, true).get());
+
+    failed = pool.submit(new Failing, true).then(pool, new ToString, true);
+    ELSUNIT_EXPECT_STRING_EQ("failed: bad input", failed.get());
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Future, rejected)
+{
+    els::thread::ThreadPool pool;
+    els::thread::Future<int> accepted;
+    els::thread::Future<int> rejected;
+
+    ELSUNIT_ASSERT_NO_THROW(pool.setQueueLimit(1,
+            els::thread::ThreadPool::OVERFLOW_FAIL));
+    accepted = pool.submit(new Square(3), true);
+    accepted = pool.submit(new Square(3), true);
+    rejected = pool.submit(new Square(3), true);
+    ELSUNIT_EXPECT_TRUE(rejected.ready());
+    ELSUNIT_EXPECT_EXCEPTION(rejected.get(), els::thread::TaskFailed);
+    ELSUNIT_ASSERT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_EQ(9, accepted.get());
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Future, invalidArguments)
+{
+    els::thread::ThreadPool pool;
+    els::thread::ThreadPool::TaskAttr attr;
+    els::thread::Future<int> empty;
+    int deleted = 0;
+
+    attr.setGroup(1);
+    ELSUNIT_EXPECT_EXCEPTION(pool.submit<int>(new Tracked(deleted), attr,
+            true), els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EQ(1, deleted);
+    ELSUNIT_EXPECT_EXCEPTION(empty.then<int>(pool, new Tracked(deleted),
+            true), els::except::LogicError);
+    ELSUNIT_EXPECT_EQ(2, deleted);
+    ELSUNIT_EXPECT_EQ(0U, pool.queueDepth());
+}
@@ -25,8 +25,10 @@
 #include <els/INamedThread.hpp>
 
 #include <string>
+#include <pthread.h>
 
 static std::string threadName;
+static std::string kernelName;
 
 class NamedThread : public els::thread::INamedThread
 {
@@ -35,7 +37,11 @@ public:
 protected:
     virtual int _M_run(void)
     {
+        char buf[16];
+
         threadName = this->name();
+        if (::pthread_getname_np(::pthread_self(), buf, sizeof(buf)) == 0)
+            kernelName = buf;
         return 0;
     }
 };
@@ -53,3 +59,14 @@ ELSUNIT_SIMPLE_TESTCASE(INamedThread, name)
 }
 
 
+
+ELSUNIT_SIMPLE_TESTCASE(INamedThread, kernelName)
+{
+    NamedThread thread("a-very-long-thread-name");
+
+    kernelName.clear();
+    ELSUNIT_EXPECT_NO_THROW(thread.start());
+    ELSUNIT_EXPECT_NO_THROW(thread.join());
+    ELSUNIT_EXPECT_STRING_EQ("a-very-long-thread-name", threadName);
+    ELSUNIT_EXPECT_STRING_EQ("a-very-long-thr", kernelName);
+}
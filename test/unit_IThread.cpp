@@ -26,6 +26,7 @@
 #include <els/Exception.hpp>
 
 #include <unistd.h>
+#include <sched.h>
 #include <cerrno>
 
 static int valueToChange = 0;
@@ -56,6 +57,19 @@ protected:
     }
 };
 
+class SleepThread : public els::thread::IThread
+{
+public:
+    SleepThread(void) : els::thread::IThread() {}
+protected:
+    virtual int _M_run(void)
+    {
+        while (!this->_M_stopRequested())
+            this->_M_sleep();
+        return 0;
+    }
+};
+
 class ExceptionThread : public els::thread::IThread
 {
 public:
@@ -68,6 +82,42 @@ protected:
     }
 };
 
+class AffinityThread : public els::thread::IThread
+{
+public:
+    AffinityThread(void) : els::thread::IThread(), mask() {}
+    cpu_set_t mask;
+protected:
+    virtual int _M_run(void)
+    {
+        return ::sched_getaffinity(0, sizeof(this->mask), &this->mask);
+    }
+};
+
+class AttrThread : public els::thread::IThread
+{
+public:
+    AttrThread(void)
+        : els::thread::IThread(), stackSize(0), guardSize(0), policy(-1) {}
+    size_t stackSize;
+    size_t guardSize;
+    int policy;
+protected:
+    virtual int _M_run(void)
+    {
+        pthread_attr_t attr;
+        void* addr = 0;
+
+        if (::pthread_getattr_np(::pthread_self(), &attr) != 0)
+            return -1;
+        ::pthread_attr_getstack(&attr, &addr, &this->stackSize);
+        ::pthread_attr_getguardsize(&attr, &this->guardSize);
+        ::pthread_attr_destroy(&attr);
+        this->policy = ::sched_getscheduler(0);
+        return 0;
+    }
+};
+
 ELSUNIT_SIMPLE_TESTCASE(IThread, basicThread)
 {
     BasicThread thread;
@@ -108,3 +158,69 @@ ELSUNIT_SIMPLE_TESTCASE(IThread, exceptionThread)
     ELSUNIT_EXPECT_EQ(-1, thread.retval().retval());
 }
 
+
+ELSUNIT_SIMPLE_TESTCASE(IThread, affinity)
+{
+    AffinityThread thread;
+    cpu_set_t set;
+    unsigned cpu = 0;
+
+    ELSUNIT_ASSERT_EQ(0, ::sched_getaffinity(0, sizeof(set), &set));
+    while (!CPU_ISSET(cpu, &set))
+        ++cpu;
+
+    ELSUNIT_EXPECT_EXCEPTION(thread.setAffinity(
+            std::vector<unsigned>(1, CPU_SETSIZE)),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_NO_THROW(thread.setAffinity(
+            std::vector<unsigned>(1, cpu)));
+    ELSUNIT_ASSERT_EQ(1U, thread.affinity().size());
+    ELSUNIT_EXPECT_NO_THROW(thread.start());
+    ELSUNIT_EXPECT_NO_THROW(thread.join());
+    ELSUNIT_EXPECT_EQ(0, thread.retval().retval());
+    ELSUNIT_EXPECT_EQ(1, CPU_COUNT(&thread.mask));
+    ELSUNIT_EXPECT_TRUE(CPU_ISSET(cpu, &thread.mask));
+}
+
+ELSUNIT_SIMPLE_TESTCASE(IThread, attributes)
+{
+    AttrThread thread;
+    size_t page = ::sysconf(_SC_PAGESIZE);
+
+    ELSUNIT_EXPECT_EQ(els::thread::IThread::SCHED_POLICY_INHERIT,
+            thread.schedPolicy());
+    ELSUNIT_EXPECT_EXCEPTION(thread.setStackSize(1024),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EXCEPTION(thread.setScheduling(
+            els::thread::IThread::SCHED_POLICY_FIFO, 0),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EXCEPTION(thread.setScheduling(
+            els::thread::IThread::SCHED_POLICY_OTHER, 10),
+            els::except::InvalidArgument);
+
+    thread.setStackSize(256 * 1024);
+    thread.setGuardSize(2 * page);
+    thread.setLockStack(true);
+    thread.setScheduling(els::thread::IThread::SCHED_POLICY_BATCH);
+    ELSUNIT_EXPECT_NO_THROW(thread.start());
+    ELSUNIT_EXPECT_NO_THROW(thread.join());
+    ELSUNIT_EXPECT_EQ(0, thread.retval().retval());
+    ELSUNIT_EXPECT_EQ(256U * 1024, thread.stackSize);
+    ELSUNIT_EXPECT_EQ(2 * page, thread.guardSize);
+    ELSUNIT_EXPECT_EQ(SCHED_BATCH, thread.policy);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(IThread, stopSleeping)
+{
+    for (int i = 0; i < 100; ++i)
+    {
+        SleepThread thread;
+
+        ELSUNIT_ASSERT_NO_THROW(thread.start());
+        if (i % 2)
+            ::usleep(1000);
+        ELSUNIT_EXPECT_NO_THROW(thread.stop());
+        ELSUNIT_EXPECT_NO_THROW(thread.join());
+        ELSUNIT_EXPECT_EQ(0, thread.retval().retval());
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    unit_LatencyHistogram.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/LatencyHistogram.hpp>
+#include <els/Exception.hpp>
+
+ELSUNIT_SIMPLE_TESTCASE(LatencyHistogram, empty)
+{
+    els::misc::LatencyHistogram hist;
+
+    ELSUNIT_EXPECT_EQ(0U, hist.count());
+    ELSUNIT_EXPECT_EQ(0U, hist.max());
+    ELSUNIT_EXPECT_EQ(0U, hist.mean());
+    ELSUNIT_EXPECT_EQ(0U, hist.percentile(99.0));
+}
+
+ELSUNIT_SIMPLE_TESTCASE(LatencyHistogram, percentile)
+{
+    els::misc::LatencyHistogram hist;
+
+    for (els::ElsUint64 i = 1; i <= 1000; ++i)
+        hist.record(i * 1000);
+
+    ELSUNIT_EXPECT_EQ(1000U, hist.count());
+    ELSUNIT_EXPECT_EQ(1000000U, hist.max());
+    ELSUNIT_EXPECT_EQ(500500U, hist.mean());
+    ELSUNIT_EXPECT_TRUE(hist.percentile(50.0) >= 500000);
+    ELSUNIT_EXPECT_TRUE(hist.percentile(50.0) <= 500000 * 5 / 4);
+    ELSUNIT_EXPECT_TRUE(hist.percentile(99.0) >= 990000);
+    ELSUNIT_EXPECT_EQ(1000000U, hist.percentile(100.0));
+    ELSUNIT_EXPECT_EXCEPTION(hist.percentile(101.0),
+            els::except::InvalidArgument);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(LatencyHistogram, smallValues)
+{
+    els::misc::LatencyHistogram hist;
+
+    hist.record(0);
+    hist.record(3);
+    ELSUNIT_EXPECT_EQ(0U, hist.percentile(50.0));
+    ELSUNIT_EXPECT_EQ(3U, hist.percentile(100.0));
+}
+
+ELSUNIT_SIMPLE_TESTCASE(LatencyHistogram, mergeAndCopy)
+{
+    els::misc::LatencyHistogram first;
+    els::misc::LatencyHistogram second;
+
+    first.record(100);
+    second.record(200);
+    second.record(300);
+    first.merge(second);
+
+    els::misc::LatencyHistogram copy(first);
+    ELSUNIT_EXPECT_EQ(3U, copy.count());
+    ELSUNIT_EXPECT_EQ(300U, copy.max());
+    ELSUNIT_EXPECT_EQ(200U, copy.mean());
+
+    copy.reset();
+    ELSUNIT_EXPECT_EQ(0U, copy.count());
+    ELSUNIT_EXPECT_EQ(3U, first.count());
+}
+
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    unit_Locks.cpp
+ *
+ * Tests shared by all the spinning and queueing locks.
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/FastMutex.hpp>
+#include <els/TicketLock.hpp>
+#include <els/McsLock.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+const int numThreads = 4;
+const int itemsPerThread = 50000;
+
+class DebugFastMutex : public els::thread::FastMutex
+{
+public:
+    DebugFastMutex(void) : els::thread::FastMutex(true) {}
+};
+
+template <typename Lock> class Incrementer : public els::thread::IThread
+{
+public:
+    Incrementer(Lock& lock, long& counter)
+        : els::thread::IThread(), _M_lock(lock), _M_counter(counter) {}
+protected:
+    virtual int _M_run(void)
+    {
+        for (int i = 0; i < itemsPerThread; ++i)
+        {
+            this->_M_lock.lock();
+            /* Not atomic, a broken lock loses increments. */
+            this->_M_counter = this->_M_counter + 1;
+            this->_M_lock.unlock();
+        }
+        return 0;
+    }
+private:
+    Lock& _M_lock;
+    long& _M_counter;
+};
+
+template <typename Lock> class TryLocker : public els::thread::IThread
+{
+public:
+    explicit TryLocker(Lock& lock)
+        : els::thread::IThread(), locked(true), _M_lock(lock) {}
+
+    bool locked;
+
+protected:
+    virtual int _M_run(void)
+    {
+        this->locked = this->_M_lock.trylock();
+        if (this->locked)
+            this->_M_lock.unlock();
+        return 0;
+    }
+private:
+    Lock& _M_lock;
+};
+
+template <typename Lock> class Waiter : public els::thread::IThread
+{
+public:
+    Waiter(Lock& lock, std::vector<int>& order, int id)
+        : els::thread::IThread(), started(0), _M_lock(lock),
+          _M_order(order), _M_id(id) {}
+
+    els::thread::AtomicInt started;
+
+protected:
+    virtual int _M_run(void)
+    {
+        this->started.set(1);
+        this->_M_lock.lock();
+        this->_M_order.push_back(this->_M_id);
+        this->_M_lock.unlock();
+        return 0;
+    }
+private:
+    Lock& _M_lock;
+    std::vector<int>& _M_order;
+    int _M_id;
+};
+
+typedef ELSUNIT_TYPES<els::thread::FastMutex, DebugFastMutex,
+        els::thread::TicketLock, els::thread::McsLock> LockTypes;
+typedef ELSUNIT_TYPES<els::thread::TicketLock,
+        els::thread::McsLock> FairLockTypes;
+
+}
+
+ELSUNIT_TYPED_TESTCASE(Locks, LockTypes);
+
+ELSUNIT_TYPED_TEST(Locks, lockUnlock)
+{
+    TypeParam lock;
+    TryLocker<TypeParam> other(lock);
+
+    lock.lock();
+    ELSUNIT_ASSERT_NO_THROW(other.start());
+    ELSUNIT_EXPECT_NO_THROW(other.join());
+    ELSUNIT_EXPECT_FALSE(other.locked);
+    lock.unlock();
+
+    ELSUNIT_EXPECT_TRUE(lock.trylock());
+    ELSUNIT_EXPECT_FALSE(lock.trylock());
+    lock.unlock();
+    ELSUNIT_EXPECT_TRUE(lock.trylock());
+    lock.unlock();
+}
+
+ELSUNIT_TYPED_TEST(Locks, contended)
+{
+    TypeParam lock;
+    std::vector<Incrementer<TypeParam>*> threads;
+    long counter = 0;
+
+    for (int i = 0; i < numThreads; ++i)
+        threads.push_back(new Incrementer<TypeParam>(lock, counter));
+    for (int i = 0; i < numThreads; ++i)
+        ELSUNIT_ASSERT_NO_THROW(threads[i]->start());
+    for (int i = 0; i < numThreads; ++i)
+    {
+        ELSUNIT_EXPECT_NO_THROW(threads[i]->join());
+        delete threads[i];
+    }
+    ELSUNIT_EXPECT_EQ(numThreads * itemsPerThread, counter);
+}
+
+ELSUNIT_TYPED_TESTCASE(FairLocks, FairLockTypes);
+
+/*
+ * Waiters are started one at a time while the lock is held, each one
+ * given time to queue up before the next one starts. They must get
+ * the lock in the order in which they queued.
+ */
+ELSUNIT_TYPED_TEST(FairLocks, fifo)
+{
+    TypeParam lock;
+    std::vector<Waiter<TypeParam>*> threads;
+    std::vector<int> order;
+    bool ordered = true;
+
+    lock.lock();
+    for (int i = 0; i < numThreads; ++i)
+    {
+        threads.push_back(new Waiter<TypeParam>(lock, order, i));
+        ELSUNIT_ASSERT_NO_THROW(threads[i]->start());
+        while (threads[i]->started.get() == 0)
+            ::usleep(1000);
+        ::usleep(20000);
+    }
+    lock.unlock();
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        ELSUNIT_EXPECT_NO_THROW(threads[i]->join());
+        delete threads[i];
+    }
+    ELSUNIT_ASSERT_EQ(static_cast<size_t>(numThreads), order.size());
+    for (int i = 0; i < numThreads; ++i)
+        ordered = ordered && (order[i] == i);
+    ELSUNIT_EXPECT_TRUE(ordered);
+}
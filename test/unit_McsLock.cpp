@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_McsLock.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/McsLock.hpp>
+
+/* Locking itself is tested for all lock types in unit_Locks.cpp. */
+
+ELSUNIT_SIMPLE_TESTCASE(McsLock, severalHeld)
+{
+    els::thread::McsLock first;
+    els::thread::McsLock second;
+    els::thread::McsLock third;
+
+    /* Every held lock needs its own queue node. */
+    first.lock();
+    second.lock();
+    ELSUNIT_EXPECT_TRUE(third.trylock());
+    first.unlock();
+    third.unlock();
+    ELSUNIT_EXPECT_TRUE(first.trylock());
+    ELSUNIT_EXPECT_FALSE(second.trylock());
+    second.unlock();
+    first.unlock();
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    unit_MpmcQueue.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/MpmcQueue.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+#include <els/Exception.hpp>
+
+#include <sched.h>
+
+namespace {
+
+const int itemsPerThread = 20000;
+
+els::thread::AtomicInt consumedCount(0);
+
+class Producer : public els::thread::IThread
+{
+public:
+    explicit Producer(els::thread::MpmcQueue<int>& queue)
+        : els::thread::IThread(), _M_queue(queue) {}
+protected:
+    virtual int _M_run(void)
+    {
+        for (int i = 1; i <= itemsPerThread; ++i)
+        {
+            while (!this->_M_queue.push(i))
+                ::sched_yield();
+        }
+        return 0;
+    }
+private:
+    els::thread::MpmcQueue<int>& _M_queue;
+};
+
+class Consumer : public els::thread::IThread
+{
+public:
+    explicit Consumer(els::thread::MpmcQueue<int>& queue, int total)
+        : els::thread::IThread(), _M_queue(queue), _M_total(total),
+          _M_sum(0) {}
+    long long sum(void) const { return this->_M_sum; }
+protected:
+    virtual int _M_run(void)
+    {
+        int val = 0;
+
+        while (consumedCount.get() < this->_M_total)
+        {
+            if (this->_M_queue.pop(val))
+            {
+                this->_M_sum += val;
+                consumedCount.inc();
+            }
+            else
+            {
+                ::sched_yield();
+            }
+        }
+        return 0;
+    }
+private:
+    els::thread::MpmcQueue<int>& _M_queue;
+    int _M_total;
+    long long _M_sum;
+};
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(MpmcQueue, capacity)
+{
+    els::thread::MpmcQueue<int> queue(5);
+
+    ELSUNIT_EXPECT_EQ(8U, queue.capacity());
+    ELSUNIT_EXPECT_EQ(0U, queue.size());
+    ELSUNIT_EXPECT_EXCEPTION(els::thread::MpmcQueue<int> bad(0),
+            els::except::InvalidArgument);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(MpmcQueue, pushPop)
+{
+    els::thread::MpmcQueue<int> queue(4);
+    int val = 0;
+
+    ELSUNIT_EXPECT_FALSE(queue.pop(val));
+    for (int i = 0; i < 4; ++i)
+        ELSUNIT_EXPECT_TRUE(queue.push(i));
+    ELSUNIT_EXPECT_FALSE(queue.push(4));
+    ELSUNIT_EXPECT_EQ(4U, queue.size());
+    for (int i = 0; i < 4; ++i)
+    {
+        ELSUNIT_EXPECT_TRUE(queue.pop(val));
+        ELSUNIT_EXPECT_EQ(i, val);
+    }
+    ELSUNIT_EXPECT_FALSE(queue.pop(val));
+    ELSUNIT_EXPECT_TRUE(queue.push(5));
+    ELSUNIT_EXPECT_TRUE(queue.pop(val));
+    ELSUNIT_EXPECT_EQ(5, val);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(MpmcQueue, concurrent)
+{
+    els::thread::MpmcQueue<int> queue(64);
+    Producer p1(queue);
+    Producer p2(queue);
+    Consumer c1(queue, 2 * itemsPerThread);
+    Consumer c2(queue, 2 * itemsPerThread);
+
+    consumedCount.set(0);
+    ELSUNIT_ASSERT_NO_THROW(c1.start());
+    ELSUNIT_ASSERT_NO_THROW(c2.start());
+    ELSUNIT_ASSERT_NO_THROW(p1.start());
+    ELSUNIT_ASSERT_NO_THROW(p2.start());
+    ELSUNIT_EXPECT_NO_THROW(p1.join());
+    ELSUNIT_EXPECT_NO_THROW(p2.join());
+    ELSUNIT_EXPECT_NO_THROW(c1.join());
+    ELSUNIT_EXPECT_NO_THROW(c2.join());
+    ELSUNIT_EXPECT_EQ(2 * itemsPerThread, consumedCount.get());
+    /* Every producer pushes 1..itemsPerThread. */
+    ELSUNIT_EXPECT_EQ(static_cast<long long>(itemsPerThread)
+            * (itemsPerThread + 1), c1.sum() + c2.sum());
+    ELSUNIT_EXPECT_EQ(0U, queue.size());
+}
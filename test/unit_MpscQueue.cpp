@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_MpscQueue.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/MpscQueue.hpp>
+#include <els/IThread.hpp>
+
+#include <sched.h>
+#include <vector>
+
+namespace {
+
+const int numProducers = 4;
+const int itemsPerThread = 20000;
+
+struct Item : public els::thread::MpscNode
+{
+    Item(int prod = 0, int val = 0) : producer(prod), value(val) {}
+
+    int producer;
+    int value;
+};
+
+class Producer : public els::thread::IThread
+{
+public:
+    Producer(els::thread::MpscQueue<Item>& queue, int id)
+        : els::thread::IThread(), _M_queue(queue), _M_id(id) {}
+protected:
+    virtual int _M_run(void)
+    {
+        for (int i = 0; i < itemsPerThread; ++i)
+            this->_M_queue.push(new Item(this->_M_id, i));
+        return 0;
+    }
+private:
+    els::thread::MpscQueue<Item>& _M_queue;
+    int _M_id;
+};
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(MpscQueue, pushPop)
+{
+    els::thread::MpscQueue<Item> queue;
+    Item items[3];
+
+    ELSUNIT_EXPECT_TRUE(queue.empty());
+    ELSUNIT_EXPECT_TRUE(queue.pop() == 0);
+    for (int i = 0; i < 3; ++i)
+    {
+        items[i].value = i;
+        queue.push(&items[i]);
+    }
+    ELSUNIT_EXPECT_FALSE(queue.empty());
+    for (int i = 0; i < 3; ++i)
+        ELSUNIT_EXPECT_EQ(&items[i], queue.pop());
+    ELSUNIT_EXPECT_TRUE(queue.pop() == 0);
+    ELSUNIT_EXPECT_TRUE(queue.empty());
+
+    /* Popped nodes can be pushed again right away. */
+    queue.push(&items[1]);
+    ELSUNIT_EXPECT_EQ(&items[1], queue.pop());
+    ELSUNIT_EXPECT_TRUE(queue.empty());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(MpscQueue, concurrent)
+{
+    els::thread::MpscQueue<Item> queue;
+    std::vector<Producer*> producers;
+    std::vector<int> next(numProducers, 0);
+    int received = 0;
+    bool ordered = true;
+    Item* item = 0;
+
+    for (int i = 0; i < numProducers; ++i)
+        producers.push_back(new Producer(queue, i));
+    for (int i = 0; i < numProducers; ++i)
+        ELSUNIT_ASSERT_NO_THROW(producers[i]->start());
+
+    while (received < numProducers * itemsPerThread)
+    {
+        item = queue.pop();
+        if (item == 0)
+        {
+            ::sched_yield();
+            continue;
+        }
+
+        /* FIFO per producer. */
+        if (item->value != next[item->producer]++)
+            ordered = false;
+        delete item;
+        ++received;
+    }
+
+    for (int i = 0; i < numProducers; ++i)
+    {
+        ELSUNIT_EXPECT_NO_THROW(producers[i]->join());
+        delete producers[i];
+    }
+    ELSUNIT_EXPECT_TRUE(ordered);
+    ELSUNIT_EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    unit_Parallel.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+
+#include <els/Parallel.hpp>
+#include <els/ThreadPool.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+
+#include <unistd.h>
+
+class Fill
+{
+public:
+
+    explicit Fill(std::vector<int>& data) : _M_data(data) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+            this->_M_data[i] += static_cast<int>(i);
+    }
+
+private:
+
+    std::vector<int>& _M_data;
+};
+
+class Sum
+{
+public:
+
+    explicit Sum(const std::vector<int>& data) : _M_data(data) {}
+
+    long long operator()(size_t begin, size_t end) const
+    {
+        long long sum = 0;
+
+        for (size_t i = begin; i < end; ++i)
+            sum += this->_M_data[i];
+        return sum;
+    }
+
+private:
+
+    const std::vector<int>& _M_data;
+};
+
+class Square
+{
+public:
+
+    int operator()(int val) const { return val * val; }
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Parallel, parallelFor)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> data(100000, 0);
+    bool ok = true;
+
+    pool.start(4);
+    els::thread::parallelFor(pool, 0, data.size(), Fill(data));
+    els::thread::parallelFor(pool, 0, data.size(), Fill(data), 7, false);
+    for (size_t i = 0; i < data.size(); ++i)
+        ok = ok && (data[i] == static_cast<int>(2 * i));
+    ELSUNIT_EXPECT_TRUE(ok);
+    pool.stop();
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Parallel, notStarted)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> data(1000, 0);
+
+    els::thread::parallelFor(pool, 0, data.size(), Fill(data), 10, false);
+    ELSUNIT_EXPECT_EQ(999, data[999]);
+    ELSUNIT_EXPECT_EQ(0U, pool.queueDepth());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Parallel, parallelReduce)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> data(100000);
+    long long sum = 0;
+
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<int>(i);
+
+    pool.start(4);
+    sum = els::thread::parallelReduce(pool, 0, data.size(), 0LL,
+            Sum(data), std::plus<long long>());
+    ELSUNIT_EXPECT_EQ(4999950000LL, sum);
+    sum = els::thread::parallelReduce(pool, 5, 5, 42LL,
+            Sum(data), std::plus<long long>());
+    ELSUNIT_EXPECT_EQ(42LL, sum);
+    pool.stop();
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Parallel, parallelTransform)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> in(10000);
+    std::vector<int> out(10000);
+    bool ok = true;
+
+    for (size_t i = 0; i < in.size(); ++i)
+        in[i] = static_cast<int>(i % 1000);
+
+    pool.start(4);
+    els::thread::parallelTransform(pool, in.begin(), in.end(),
+            out.begin(), Square());
+    for (size_t i = 0; i < in.size(); ++i)
+        ok = ok && (out[i] == in[i] * in[i]);
+    ELSUNIT_EXPECT_TRUE(ok);
+    pool.stop();
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Parallel, parallelSort)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> data(100000);
+    std::vector<int> expected;
+
+    ::srand(1234);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = ::rand();
+    expected = data;
+    std::sort(expected.begin(), expected.end());
+
+    pool.start(4);
+    els::thread::parallelSort(pool, data.begin(), data.end());
+    ELSUNIT_EXPECT_TRUE(data == expected);
+
+    /* Odd number of runs, descending order. */
+    els::thread::parallelSort(pool, data.begin(), data.end(),
+            std::greater<int>(), 3000);
+    std::reverse(expected.begin(), expected.end());
+    ELSUNIT_EXPECT_TRUE(data == expected);
+    pool.stop();
+}
+
+static std::vector<int> nestedData(64 * 1000, 0);
+
+class Nested
+{
+public:
+
+    explicit Nested(els::thread::ThreadPool& pool) : _M_pool(pool) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+        std::vector<int> row(1000, 0);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            els::thread::parallelFor(this->_M_pool, 0, 1000, Fill(row), 100);
+            std::copy(row.begin(), row.end(), nestedData.begin() + i * 1000);
+            std::fill(row.begin(), row.end(), 0);
+        }
+    }
+
+private:
+
+    els::thread::ThreadPool& _M_pool;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Parallel, nested)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+
+    pool.start(2);
+    els::thread::parallelFor(pool, 0, 64, Nested(pool), 1);
+    ELSUNIT_EXPECT_EQ(999, nestedData[63 * 1000 + 999]);
+    ELSUNIT_EXPECT_EQ(0, nestedData[5 * 1000]);
+    pool.stop();
+}
+
+namespace {
+
+els::thread::AtomicInt blockersReleased(0);
+
+class Blocker : public els::thread::IRunnable
+{
+public:
+
+    virtual void run(void) throw()
+    {
+        while (blockersReleased.get() == 0)
+            ::usleep(1000);
+    }
+};
+
+class Noop : public els::thread::IRunnable
+{
+public:
+
+    virtual void run(void) throw() {}
+};
+
+class ForCaller : public els::thread::IThread
+{
+public:
+
+    ForCaller(els::thread::ThreadPool& pool, std::vector<int>& data)
+        : els::thread::IThread(), _M_pool(pool), _M_data(data) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        els::thread::parallelFor(this->_M_pool, 0, this->_M_data.size(),
+                Fill(this->_M_data), 10, false);
+        return 0;
+    }
+
+private:
+
+    els::thread::ThreadPool& _M_pool;
+    std::vector<int>& _M_data;
+};
+
+}
+
+/*
+ * Both workers are busy while the helpers get evicted from the queue,
+ * so the caller must process the whole range itself.
+ */
+ELSUNIT_SIMPLE_TESTCASE(Parallel, helpersDropped)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> data(1000, 0);
+    ForCaller caller(pool, data);
+    Blocker blocker;
+    Noop noop;
+
+    blockersReleased.set(0);
+    pool.setQueueLimit(4, els::thread::ThreadPool::OVERFLOW_DROP_OLDEST);
+    pool.start(2);
+    pool.schedule(&blocker);
+    pool.schedule(&blocker);
+    while (pool.queueDepth() != 0)
+        ::usleep(1000);
+
+    ELSUNIT_ASSERT_NO_THROW(caller.start());
+    while (pool.queueDepth() != 2)
+        ::usleep(1000);
+    for (size_t i = 0; i < pool.queueLimit(); ++i)
+        pool.schedule(&noop);
+    ELSUNIT_EXPECT_EQ(2U, pool.droppedTasks());
+
+    ELSUNIT_EXPECT_NO_THROW(caller.join());
+    ELSUNIT_EXPECT_EQ(999, data[999]);
+    blockersReleased.set(1);
+    pool.stop();
+}
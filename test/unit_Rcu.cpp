@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_Rcu.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/Rcu.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+#include <els/Exception.hpp>
+
+#include <vector>
+#include <unistd.h>
+
+using els::thread::Rcu;
+using els::thread::RcuPtr;
+using els::thread::RcuReadGuard;
+
+namespace {
+
+const long configMagic = 0x5ca1ab1e;
+
+els::thread::AtomicInt callbacksRun(0);
+els::thread::AtomicInt readerEntered(0);
+els::thread::AtomicInt readerLeaving(0);
+els::thread::AtomicInt stopReaders(0);
+
+/* Stands for a routing table or a configuration map. */
+struct Config
+{
+    explicit Config(long ver) : magic(configMagic), version(ver),
+            doubled(ver * 2) {}
+    ~Config(void) { this->magic = 0; }
+
+    long magic;
+    long version;
+    long doubled;
+};
+
+void countCallback(void* arg)
+{
+    callbacksRun.fetchAdd(*static_cast<int*>(arg));
+}
+
+class SlowReader : public els::thread::IThread
+{
+public:
+    SlowReader(void) : els::thread::IThread() {}
+protected:
+    virtual int _M_run(void)
+    {
+        RcuReadGuard guard;
+
+        readerEntered.set(1);
+        ::usleep(50000);
+        readerLeaving.set(1);
+        return 0;
+    }
+};
+
+class ConfigReader : public els::thread::IThread
+{
+public:
+    explicit ConfigReader(RcuPtr<Config>& config)
+        : els::thread::IThread(), errors(0), _M_config(config) {}
+
+    int errors;
+
+protected:
+    virtual int _M_run(void)
+    {
+        Config* config = 0;
+        long last = 0;
+
+        while (stopReaders.get() == 0)
+        {
+            RcuReadGuard guard;
+
+            config = this->_M_config.get();
+            if (config->magic != configMagic
+                    || config->doubled != config->version * 2
+                    || config->version < last)
+                ++this->errors;
+            last = config->version;
+        }
+        return 0;
+    }
+private:
+    RcuPtr<Config>& _M_config;
+};
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Rcu, nesting)
+{
+    ELSUNIT_EXPECT_FALSE(Rcu::inReadSection());
+    Rcu::readLock();
+    Rcu::readLock();
+    ELSUNIT_EXPECT_TRUE(Rcu::inReadSection());
+    Rcu::readUnlock();
+    ELSUNIT_EXPECT_TRUE(Rcu::inReadSection());
+    ELSUNIT_EXPECT_EXCEPTION(Rcu::synchronize(), els::except::LogicError);
+    ELSUNIT_EXPECT_EXCEPTION(Rcu::barrier(), els::except::LogicError);
+    Rcu::readUnlock();
+    ELSUNIT_EXPECT_FALSE(Rcu::inReadSection());
+    ELSUNIT_EXPECT_NO_THROW(Rcu::synchronize());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Rcu, synchronizeWaitsForReaders)
+{
+    SlowReader reader;
+
+    readerEntered.set(0);
+    readerLeaving.set(0);
+    ELSUNIT_ASSERT_NO_THROW(reader.start());
+    while (readerEntered.get() == 0)
+        ::usleep(1000);
+
+    Rcu::synchronize();
+    ELSUNIT_EXPECT_EQ(1, readerLeaving.get());
+    ELSUNIT_EXPECT_NO_THROW(reader.join());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Rcu, callbacks)
+{
+    int one = 1;
+
+    callbacksRun.set(0);
+    for (int i = 0; i < 10; ++i)
+        Rcu::call(&countCallback, &one);
+    Rcu::barrier();
+    ELSUNIT_EXPECT_EQ(10, callbacksRun.get());
+
+    /* Queued from a read-side section, run by the barrier. */
+    callbacksRun.set(0);
+    Rcu::readLock();
+    for (int i = 0; i < 100; ++i)
+        Rcu::call(&countCallback, &one);
+    Rcu::readUnlock();
+    Rcu::barrier();
+    ELSUNIT_EXPECT_EQ(100, callbacksRun.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Rcu, ptrPublish)
+{
+    RcuPtr<Config> config(new Config(1));
+    Config* old = 0;
+
+    {
+        RcuReadGuard guard;
+
+        ELSUNIT_EXPECT_EQ(1, config.get()->version);
+    }
+
+    old = config.exchange(new Config(2));
+    ELSUNIT_EXPECT_EQ(1, old->version);
+    Rcu::synchronize();
+    delete old;
+
+    config.replaceSync(new Config(3));
+    ELSUNIT_EXPECT_EQ(3, config.get()->version);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Rcu, concurrentReplace)
+{
+    RcuPtr<Config> config(new Config(0));
+    std::vector<ConfigReader*> readers;
+
+    stopReaders.set(0);
+    for (int i = 0; i < 4; ++i)
+        readers.push_back(new ConfigReader(config));
+    for (int i = 0; i < 4; ++i)
+        ELSUNIT_ASSERT_NO_THROW(readers[i]->start());
+
+    for (long ver = 1; ver <= 2000; ++ver)
+    {
+        if ((ver % 10) == 0)
+            config.replaceSync(new Config(ver));
+        else
+            config.replace(new Config(ver));
+    }
+
+    stopReaders.set(1);
+    for (int i = 0; i < 4; ++i)
+    {
+        ELSUNIT_EXPECT_NO_THROW(readers[i]->join());
+        ELSUNIT_EXPECT_EQ(0, readers[i]->errors);
+        delete readers[i];
+    }
+    Rcu::barrier();
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_SeqLock.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/SeqLock.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+
+#include <vector>
+
+namespace {
+
+struct Sample
+{
+    long first;
+    long second;
+    long third;
+    long sum;
+};
+
+const long numWrites = 20000;
+
+els::thread::AtomicInt writerDone(0);
+
+class Writer : public els::thread::IThread
+{
+public:
+    explicit Writer(els::thread::SeqLock<Sample>& lock)
+        : els::thread::IThread(), _M_lock(lock) {}
+protected:
+    virtual int _M_run(void)
+    {
+        Sample sample;
+
+        for (long i = 1; i <= numWrites; ++i)
+        {
+            sample.first = i;
+            sample.second = i * 2;
+            sample.third = i * 3;
+            sample.sum = i * 6;
+            this->_M_lock.store(sample);
+        }
+        writerDone.set(1);
+        return 0;
+    }
+private:
+    els::thread::SeqLock<Sample>& _M_lock;
+};
+
+class Reader : public els::thread::IThread
+{
+public:
+    explicit Reader(els::thread::SeqLock<Sample>& lock)
+        : els::thread::IThread(), torn(0), backwards(0), reads(0),
+          _M_lock(lock) {}
+
+    int torn;
+    int backwards;
+    long reads;
+
+protected:
+    virtual int _M_run(void)
+    {
+        Sample sample;
+        long last = 0;
+
+        while (writerDone.get() == 0)
+        {
+            sample = this->_M_lock.load();
+            if (sample.second != sample.first * 2
+                    || sample.third != sample.first * 3
+                    || sample.sum != sample.first * 6)
+                ++this->torn;
+            if (sample.first < last)
+                ++this->backwards;
+            last = sample.first;
+            ++this->reads;
+        }
+        return 0;
+    }
+private:
+    els::thread::SeqLock<Sample>& _M_lock;
+};
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(SeqLock, loadStore)
+{
+    Sample init = { 1, 2, 3, 6 };
+    Sample next = { 4, 5, 6, 15 };
+    els::thread::SeqLock<Sample> lock(init);
+    Sample val;
+    size_t seq = lock.sequence();
+
+    val = lock.load();
+    ELSUNIT_EXPECT_EQ(1, val.first);
+    ELSUNIT_EXPECT_EQ(6, val.sum);
+
+    lock.store(next);
+    ELSUNIT_EXPECT_EQ(seq + 2, lock.sequence());
+    ELSUNIT_EXPECT_TRUE(lock.tryLoad(val));
+    ELSUNIT_EXPECT_EQ(4, val.first);
+    ELSUNIT_EXPECT_EQ(15, val.sum);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(SeqLock, sections)
+{
+    els::thread::SeqLock<int> lock(5);
+    size_t seq = 0;
+    int val = 0;
+
+    seq = lock.readBegin();
+    val = lock.get();
+    ELSUNIT_EXPECT_FALSE(lock.readRetry(seq));
+    ELSUNIT_EXPECT_EQ(5, val);
+
+    /* A write in between invalidates the read. */
+    seq = lock.readBegin();
+    lock.writeLock();
+    ELSUNIT_EXPECT_FALSE(lock.tryLoad(val));
+    lock.get() += 10;
+    lock.writeUnlock();
+    ELSUNIT_EXPECT_TRUE(lock.readRetry(seq));
+    ELSUNIT_EXPECT_EQ(15, lock.load());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(SeqLock, concurrent)
+{
+    Sample init = { 0, 0, 0, 0 };
+    els::thread::SeqLock<Sample> lock(init);
+    Writer writer(lock);
+    std::vector<Reader*> readers;
+
+    writerDone.set(0);
+    for (int i = 0; i < 4; ++i)
+        readers.push_back(new Reader(lock));
+    for (int i = 0; i < 4; ++i)
+        ELSUNIT_ASSERT_NO_THROW(readers[i]->start());
+    ELSUNIT_ASSERT_NO_THROW(writer.start());
+    ELSUNIT_EXPECT_NO_THROW(writer.join());
+    for (int i = 0; i < 4; ++i)
+    {
+        ELSUNIT_EXPECT_NO_THROW(readers[i]->join());
+        ELSUNIT_EXPECT_EQ(0, readers[i]->torn);
+        ELSUNIT_EXPECT_EQ(0, readers[i]->backwards);
+        delete readers[i];
+    }
+    ELSUNIT_EXPECT_EQ(numWrites, lock.load().first);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_SpscQueue.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/SpscQueue.hpp>
+#include <els/IThread.hpp>
+#include <els/Exception.hpp>
+
+#include <sched.h>
+
+namespace {
+
+const int numItems = 200000;
+
+class Producer : public els::thread::IThread
+{
+public:
+    explicit Producer(els::thread::SpscQueue<int>& queue)
+        : els::thread::IThread(), _M_queue(queue) {}
+protected:
+    virtual int _M_run(void)
+    {
+        for (int i = 0; i < numItems; ++i)
+        {
+            while (!this->_M_queue.push(i))
+                ::sched_yield();
+        }
+        return 0;
+    }
+private:
+    els::thread::SpscQueue<int>& _M_queue;
+};
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(SpscQueue, capacity)
+{
+    els::thread::SpscQueue<int> queue(5);
+
+    ELSUNIT_EXPECT_EQ(8U, queue.capacity());
+    ELSUNIT_EXPECT_EQ(0U, queue.size());
+    ELSUNIT_EXPECT_EXCEPTION(els::thread::SpscQueue<int> bad(0),
+            els::except::InvalidArgument);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(SpscQueue, pushPop)
+{
+    els::thread::SpscQueue<int> queue(4);
+    int val = 0;
+
+    ELSUNIT_EXPECT_FALSE(queue.pop(val));
+    for (int lap = 0; lap < 3; ++lap)
+    {
+        for (int i = 0; i < 4; ++i)
+            ELSUNIT_EXPECT_TRUE(queue.push(i));
+        ELSUNIT_EXPECT_FALSE(queue.push(4));
+        ELSUNIT_EXPECT_EQ(4U, queue.size());
+        for (int i = 0; i < 4; ++i)
+        {
+            ELSUNIT_EXPECT_TRUE(queue.pop(val));
+            ELSUNIT_EXPECT_EQ(i, val);
+        }
+        ELSUNIT_EXPECT_FALSE(queue.pop(val));
+    }
+}
+
+ELSUNIT_SIMPLE_TESTCASE(SpscQueue, concurrent)
+{
+    els::thread::SpscQueue<int> queue(64);
+    Producer producer(queue);
+    int expected = 0;
+    int val = 0;
+    bool ordered = true;
+
+    ELSUNIT_ASSERT_NO_THROW(producer.start());
+    while (expected < numItems)
+    {
+        if (!queue.pop(val))
+        {
+            ::sched_yield();
+            continue;
+        }
+
+        if (val != expected)
+            ordered = false;
+        ++expected;
+    }
+    ELSUNIT_EXPECT_NO_THROW(producer.join());
+    ELSUNIT_EXPECT_TRUE(ordered);
+    ELSUNIT_EXPECT_FALSE(queue.pop(val));
+}
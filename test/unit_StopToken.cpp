@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_StopToken.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/StopToken.hpp>
+#include <els/IThread.hpp>
+#include <els/Mutex.hpp>
+#include <els/Condition.hpp>
+
+#include <unistd.h>
+
+class CountCallback : public els::thread::IRunnable
+{
+public:
+    CountCallback(void) : els::thread::IRunnable(), count(0) {}
+    virtual void run(void) throw() { ++this->count; }
+    int count;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(StopToken, requestStop)
+{
+    els::thread::StopToken token;
+    els::thread::StopToken copy(token);
+    els::thread::StopToken other;
+
+    ELSUNIT_EXPECT_FALSE(token.stopRequested());
+    ELSUNIT_EXPECT_TRUE(copy.requestStop());
+    ELSUNIT_EXPECT_FALSE(token.requestStop());
+    ELSUNIT_EXPECT_TRUE(token.stopRequested());
+    ELSUNIT_EXPECT_FALSE(other.stopRequested());
+
+    copy = other;
+    ELSUNIT_EXPECT_FALSE(copy.stopRequested());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(StopToken, callbacks)
+{
+    els::thread::StopToken token;
+    CountCallback first;
+    CountCallback removed;
+    CountCallback late;
+
+    token.addCallback(&first);
+    token.addCallback(&removed);
+    token.removeCallback(&removed);
+    {
+        els::thread::StopCallback scoped(token, removed);
+    }
+
+    token.requestStop();
+    token.requestStop();
+    ELSUNIT_EXPECT_EQ(1, first.count);
+    ELSUNIT_EXPECT_EQ(0, removed.count);
+
+    /* Added after the request - runs right away. */
+    {
+        els::thread::StopCallback scoped(token, late);
+        ELSUNIT_EXPECT_EQ(1, late.count);
+    }
+    ELSUNIT_EXPECT_EQ(1, late.count);
+}
+
+class WaitThread : public els::thread::IThread
+{
+public:
+
+    WaitThread(void)
+        : els::thread::IThread(), mutex(), cond(), woken(false)
+    {
+
+    }
+
+    els::thread::Mutex mutex;
+    els::thread::Condition cond;
+    bool woken;
+
+protected:
+
+    class Wakeup : public els::thread::IRunnable
+    {
+    public:
+        explicit Wakeup(WaitThread& thread)
+            : els::thread::IRunnable(), _M_thread(thread) {}
+        virtual void run(void) throw()
+        {
+            this->_M_thread.mutex.lock();
+            this->_M_thread.woken = true;
+            this->_M_thread.cond.unblockAll();
+            this->_M_thread.mutex.unlock();
+        }
+    private:
+        WaitThread& _M_thread;
+    };
+
+    virtual int _M_run(void)
+    {
+        Wakeup wakeup(*this);
+        els::thread::StopCallback callback(this->stopToken(), wakeup);
+
+        this->mutex.lock();
+        while (!this->woken)
+            this->cond.block(this->mutex);
+        this->mutex.unlock();
+
+        return this->_M_stopRequested() ? 0 : -1;
+    }
+};
+
+ELSUNIT_SIMPLE_TESTCASE(StopToken, interruptWait)
+{
+    WaitThread thread;
+
+    ELSUNIT_ASSERT_NO_THROW(thread.start());
+    ::usleep(10000);
+    ELSUNIT_EXPECT_NO_THROW(thread.stop());
+    ELSUNIT_EXPECT_NO_THROW(thread.join());
+    ELSUNIT_EXPECT_EQ(0, thread.retval().retval());
+
+    /* A reset thread gets a fresh token. */
+    ELSUNIT_EXPECT_NO_THROW(thread.reset());
+    ELSUNIT_EXPECT_FALSE(thread.stopToken().stopRequested());
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    unit_Strand.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <vector>
+
+#include <unistd.h>
+
+#include <els/Strand.hpp>
+#include <els/ThreadPool.hpp>
+#include <els/Atomic.hpp>
+#include <els/Exception.hpp>
+
+static els::thread::AtomicInt active(0);
+static els::thread::AtomicInt overlaps(0);
+
+class Step : public els::thread::IRunnable
+{
+public:
+
+    Step(std::vector<int>& log, int value)
+        : els::thread::IRunnable(), _M_log(log), _M_value(value) {}
+
+    virtual void run(void) throw()
+    {
+        if (active.inc() != 1)
+            overlaps.inc();
+        this->_M_log.push_back(this->_M_value);
+        active.dec();
+    }
+
+private:
+
+    std::vector<int>& _M_log;
+    int _M_value;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Strand, fifo)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> log;
+    bool ordered = true;
+
+    pool.start(4);
+    {
+        els::thread::Strand strand(pool, 8);
+
+        overlaps.set(0);
+        for (int i = 0; i < 1000; ++i)
+            strand.post(new Step(log, i), true);
+        strand.drain();
+        ELSUNIT_EXPECT_EQ(0U, strand.pending());
+    }
+    pool.stop();
+
+    ELSUNIT_ASSERT_EQ(1000U, log.size());
+    for (int i = 0; i < 1000; ++i)
+        ordered = ordered && (log[i] == i);
+    ELSUNIT_EXPECT_TRUE(ordered);
+    ELSUNIT_EXPECT_EQ(0, overlaps.get());
+}
+
+class KeyedStep : public els::thread::IRunnable
+{
+public:
+
+    KeyedStep(std::vector<int>& last, size_t key, int index)
+        : els::thread::IRunnable(), _M_last(last), _M_key(key),
+          _M_index(index) {}
+
+    virtual void run(void) throw()
+    {
+        if (this->_M_last[this->_M_key] != this->_M_index - 1)
+            overlaps.inc();
+        this->_M_last[this->_M_key] = this->_M_index;
+    }
+
+private:
+
+    std::vector<int>& _M_last;
+    size_t _M_key;
+    int _M_index;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Strand, keyed)
+{
+    els::thread::ThreadPool pool;
+    std::vector<int> last(200, -1);
+
+    ELSUNIT_EXPECT_EXCEPTION(els::thread::KeyedStrands(pool, 0),
+            els::except::InvalidArgument);
+
+    pool.start(4);
+    {
+        els::thread::KeyedStrands strands(pool, 16);
+
+        ELSUNIT_EXPECT_EQ(16U, strands.size());
+        ELSUNIT_EXPECT_EQ(&strands.strand(5), &strands.strand(5));
+
+        overlaps.set(0);
+        for (int i = 0; i < 20; ++i)
+        {
+            for (size_t key = 0; key < last.size(); ++key)
+                strands.post(key, new KeyedStep(last, key, i), true);
+        }
+        strands.drain();
+    }
+    pool.stop();
+
+    ELSUNIT_EXPECT_EQ(0, overlaps.get());
+    for (size_t key = 0; key < last.size(); ++key)
+        ELSUNIT_EXPECT_EQ(19, last[key]);
+}
+
+class SelfCheck : public els::thread::IRunnable
+{
+public:
+
+    explicit SelfCheck(els::thread::Strand& strand)
+        : els::thread::IRunnable(), inStrand(false), drainFailed(false),
+          _M_strand(strand) {}
+
+    virtual void run(void) throw()
+    {
+        this->inStrand = this->_M_strand.runningInThisThread();
+        try
+        {
+            this->_M_strand.drain();
+        }
+        catch (const els::except::LogicError&)
+        {
+            this->drainFailed = true;
+        }
+    }
+
+    bool inStrand;
+    bool drainFailed;
+
+private:
+
+    els::thread::Strand& _M_strand;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Strand, runningInThisThread)
+{
+    els::thread::ThreadPool pool;
+    els::thread::Strand strand(pool);
+    SelfCheck check(strand);
+
+    pool.start(2);
+    ELSUNIT_EXPECT_FALSE(strand.runningInThisThread());
+    strand.post(&check);
+    strand.drain();
+    ELSUNIT_EXPECT_TRUE(check.inStrand);
+    ELSUNIT_EXPECT_TRUE(check.drainFailed);
+    pool.stop();
+}
+
+
+class Poster : public els::thread::IRunnable
+{
+public:
+
+    Poster(els::thread::Strand& strand, std::vector<int>& log, int count)
+        : els::thread::IRunnable(), _M_strand(strand), _M_log(log),
+          _M_count(count) {}
+
+    virtual void run(void) throw()
+    {
+        for (int i = 0; i < this->_M_count; ++i)
+            this->_M_strand.post(new Step(this->_M_log, i), true);
+    }
+
+private:
+
+    els::thread::Strand& _M_strand;
+    std::vector<int>& _M_log;
+    int _M_count;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Strand, poolFull)
+{
+    static const int count = 200000;
+    els::thread::ThreadPool pool;
+    std::vector<int> ignored;
+    std::vector<int> log;
+    Step filler(ignored, 0);
+    bool ordered = true;
+
+    /*
+     * The pool never runs and its queue is full, so every batch is run
+     * inline by the thread which posted the first task.
+     */
+    pool.setQueueLimit(1, els::thread::ThreadPool::OVERFLOW_FAIL);
+    while (pool.schedule(&filler))
+        ;
+    {
+        els::thread::Strand strand(pool, 1);
+        Poster poster(strand, log, count);
+
+        overlaps.set(0);
+        strand.post(&poster);
+        ELSUNIT_EXPECT_EQ(0U, strand.pending());
+    }
+
+    ELSUNIT_ASSERT_EQ(static_cast<size_t>(count), log.size());
+    for (int i = 0; i < count; ++i)
+        ordered = ordered && (log[i] == i);
+    ELSUNIT_EXPECT_TRUE(ordered);
+    ELSUNIT_EXPECT_EQ(0, overlaps.get());
+}
+
+namespace {
+
+els::thread::AtomicInt workerReleased(0);
+
+class Blocker : public els::thread::IRunnable
+{
+public:
+
+    virtual void run(void) throw()
+    {
+        while (workerReleased.get() == 0)
+            ::usleep(1000);
+    }
+};
+
+class Noop : public els::thread::IRunnable
+{
+public:
+
+    virtual void run(void) throw() {}
+};
+
+} /* namespace */
+
+ELSUNIT_SIMPLE_TESTCASE(Strand, strandDropped)
+{
+    els::thread::ThreadPool pool;
+    Blocker blocker;
+    Noop noop;
+    std::vector<int> log;
+    Step step(log, 1);
+
+    workerReleased.set(0);
+    pool.setQueueLimit(4, els::thread::ThreadPool::OVERFLOW_DROP_OLDEST);
+    pool.start(1);
+    pool.schedule(&blocker);
+    while (pool.queueDepth() != 0)
+        ::usleep(1000);
+
+    {
+        els::thread::Strand strand(pool);
+
+        /*
+         * The only worker is busy, so filling the queue evicts the
+         * strand, which is then run by this thread.
+         */
+        strand.post(&step);
+        ELSUNIT_EXPECT_EQ(1U, pool.queueDepth());
+        for (size_t i = 0; i < pool.queueLimit(); ++i)
+            pool.schedule(&noop);
+        ELSUNIT_EXPECT_EQ(1U, pool.droppedTasks());
+        ELSUNIT_EXPECT_EQ(1U, log.size());
+        ELSUNIT_EXPECT_EQ(0U, strand.pending());
+        strand.drain();
+    }
+
+    workerReleased.set(1);
+    pool.stop();
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_StripedCounter.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/StripedCounter.hpp>
+#include <els/IThread.hpp>
+#include <els/Exception.hpp>
+
+#include <vector>
+
+using els::thread::StripedCounter;
+
+namespace {
+
+class Incrementer : public els::thread::IThread
+{
+public:
+
+    Incrementer(StripedCounter& counter, int count)
+        : els::thread::IThread(), _M_counter(counter), _M_count(count) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        for (int i = 0; i < this->_M_count; ++i)
+            this->_M_counter.inc();
+
+        return 0;
+    }
+
+private:
+
+    StripedCounter& _M_counter;
+    int _M_count;
+};
+
+void runIncrementers(StripedCounter& counter, size_t threads, int count)
+{
+    std::vector<Incrementer*> workers;
+
+    for (size_t i = 0; i < threads; ++i)
+        workers.push_back(new Incrementer(counter, count));
+    for (size_t i = 0; i < threads; ++i)
+        workers[i]->start();
+    for (size_t i = 0; i < threads; ++i)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+}
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(StripedCounter, slots)
+{
+    StripedCounter automatic;
+    StripedCounter three(3);
+    StripedCounter eight(8);
+
+    ELSUNIT_EXPECT_TRUE(automatic.slots() > 0);
+    ELSUNIT_EXPECT_EQ(0U, automatic.slots() & (automatic.slots() - 1));
+    ELSUNIT_EXPECT_EQ(4U, three.slots());
+    ELSUNIT_EXPECT_EQ(8U, eight.slots());
+    ELSUNIT_EXPECT_EQ(StripedCounter::STRIPE_BY_CPU, automatic.policy());
+    ELSUNIT_EXPECT_FALSE(automatic.approximate());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(StripedCounter, addAndReset)
+{
+    StripedCounter counter(4, StripedCounter::STRIPE_BY_THREAD);
+
+    ELSUNIT_EXPECT_EQ(0, counter.get());
+    counter.inc();
+    counter.inc();
+    counter.add(40);
+    ELSUNIT_EXPECT_EQ(42, counter.get());
+    counter.dec();
+    counter.add(-41);
+    ELSUNIT_EXPECT_EQ(0, counter.get());
+    counter.add(7);
+    counter.reset();
+    ELSUNIT_EXPECT_EQ(0, counter.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(StripedCounter, exactByCpu)
+{
+    StripedCounter counter;
+
+    runIncrementers(counter, 8, 20000);
+    ELSUNIT_EXPECT_EQ(8 * 20000, counter.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(StripedCounter, exactByThread)
+{
+    /* Fewer slots than threads - some have to share. */
+    StripedCounter counter(2, StripedCounter::STRIPE_BY_THREAD);
+
+    runIncrementers(counter, 8, 20000);
+    ELSUNIT_EXPECT_EQ(8 * 20000, counter.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(StripedCounter, approximate)
+{
+    StripedCounter counter(16, StripedCounter::STRIPE_BY_THREAD, true);
+
+    ELSUNIT_EXPECT_EXCEPTION(
+            StripedCounter(16, StripedCounter::STRIPE_BY_CPU, true),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_TRUE(counter.approximate());
+    counter.add(5);
+    counter.dec();
+    ELSUNIT_EXPECT_EQ(4, counter.get());
+
+    counter.reset();
+    runIncrementers(counter, 4, 20000);
+    ELSUNIT_EXPECT_TRUE(counter.get() > 0);
+    ELSUNIT_EXPECT_TRUE(counter.get() <= 4 * 20000);
+}
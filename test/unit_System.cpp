@@ -37,4 +37,9 @@ ELSUNIT_SIMPLE_TESTCASE(System, gettid)
     ELSUNIT_EXPECT_EQ(::syscall(SYS_gettid), els::sys::getTid());
 }
 
-
+ELSUNIT_SIMPLE_TESTCASE(System, monotonicNs)
+{
+    els::ElsUint64 first = els::sys::monotonicNs();
+    ::usleep(1000);
+    ELSUNIT_EXPECT_TRUE(els::sys::monotonicNs() - first >= 1000000);
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * @file    unit_TaskGraph.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <unistd.h>
+
+#include <els/TaskGraph.hpp>
+#include <els/ThreadPool.hpp>
+#include <els/Atomic.hpp>
+#include <els/Exception.hpp>
+
+static els::thread::AtomicInt sequence(0);
+
+class Stage : public els::thread::IRunnable
+{
+public:
+
+    explicit Stage(unsigned sleepUs = 0)
+        : els::thread::IRunnable(), order(-1), runs(0), _M_sleepUs(sleepUs) {}
+
+    virtual void run(void) throw()
+    {
+        if (this->_M_sleepUs > 0)
+            ::usleep(this->_M_sleepUs);
+        this->order = sequence.inc();
+        ++this->runs;
+    }
+
+    int order;
+    int runs;
+
+private:
+
+    unsigned _M_sleepUs;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(TaskGraph, diamond)
+{
+    els::thread::ThreadPool pool;
+    els::thread::TaskGraph graph(pool);
+    Stage a;
+    Stage b(5000);
+    Stage c;
+    Stage d;
+    els::thread::TaskGraph::NodeId ids[4];
+    std::vector<els::thread::TaskGraph::NodeId> path;
+
+    ids[0] = graph.addNode(&a, "a");
+    ids[1] = graph.addNode(&b, "b");
+    ids[2] = graph.addNode(&c, "c");
+    ids[3] = graph.addNode(&d, "d");
+    graph.addEdge(ids[0], ids[1]);
+    graph.addEdge(ids[0], ids[2]);
+    graph.addEdge(ids[1], ids[3]);
+    graph.addEdge(ids[2], ids[3]);
+    ELSUNIT_EXPECT_EQ(4U, graph.size());
+    ELSUNIT_EXPECT_EQ("c", graph.name(ids[2]));
+
+    pool.start(3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        sequence.set(0);
+        ELSUNIT_EXPECT_NO_THROW(graph.run());
+        ELSUNIT_EXPECT_EQ(1, a.order);
+        ELSUNIT_EXPECT_EQ(4, d.order);
+        ELSUNIT_EXPECT_EQ(i, d.runs);
+    }
+    pool.stop();
+
+    path = graph.criticalPath();
+    ELSUNIT_ASSERT_EQ(3U, path.size());
+    ELSUNIT_EXPECT_EQ(ids[0], path[0]);
+    ELSUNIT_EXPECT_EQ(ids[1], path[1]);
+    ELSUNIT_EXPECT_EQ(ids[3], path[2]);
+    ELSUNIT_EXPECT_TRUE(graph.nodeTime(ids[1]) >= 5000000);
+    ELSUNIT_EXPECT_TRUE(graph.criticalPathTime() >= graph.nodeTime(ids[1]));
+    ELSUNIT_EXPECT_TRUE(graph.lastRunTime() >= graph.criticalPathTime());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(TaskGraph, wideGraph)
+{
+    els::thread::ThreadPool pool;
+    els::thread::TaskGraph graph(pool);
+    els::thread::TaskGraph::NodeId root = 0;
+    els::thread::TaskGraph::NodeId sink = 0;
+    Stage* last = new Stage;
+
+    root = graph.addNode(new Stage, "root", true);
+    sink = graph.addNode(last, "sink", true);
+    for (int i = 0; i < 100; ++i)
+    {
+        els::thread::TaskGraph::NodeId mid = graph.addNode(new Stage,
+                "mid", true);
+        graph.addEdge(root, mid);
+        graph.addEdge(mid, sink);
+    }
+
+    pool.start(4);
+    sequence.set(0);
+    ELSUNIT_EXPECT_NO_THROW(graph.run());
+    ELSUNIT_EXPECT_EQ(102, last->order);
+    pool.stop();
+}
+
+ELSUNIT_SIMPLE_TESTCASE(TaskGraph, serial)
+{
+    els::thread::ThreadPool pool;
+    els::thread::TaskGraph graph(pool);
+    Stage a;
+    Stage b;
+    els::thread::TaskGraph::NodeId first = graph.addNode(&a);
+    els::thread::TaskGraph::NodeId second = graph.addNode(&b);
+
+    graph.addEdge(second, first);
+    sequence.set(0);
+    ELSUNIT_EXPECT_NO_THROW(graph.run());
+    ELSUNIT_EXPECT_EQ(1, b.order);
+    ELSUNIT_EXPECT_EQ(2, a.order);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(TaskGraph, invalid)
+{
+    els::thread::ThreadPool pool;
+    els::thread::TaskGraph graph(pool);
+    Stage a;
+    Stage b;
+    els::thread::TaskGraph::NodeId first = graph.addNode(&a);
+    els::thread::TaskGraph::NodeId second = graph.addNode(&b);
+
+    ELSUNIT_EXPECT_EXCEPTION(graph.addEdge(first, 2),
+            els::except::InvalidArgument);
+    graph.addEdge(first, second);
+    graph.addEdge(second, first);
+    ELSUNIT_EXPECT_EXCEPTION(graph.run(), els::except::LogicError);
+    ELSUNIT_EXPECT_EQ(-1, a.order);
+}
+
+
+namespace {
+
+els::thread::AtomicInt workerReleased(0);
+
+class Blocker : public els::thread::IRunnable
+{
+public:
+
+    virtual void run(void) throw()
+    {
+        while (workerReleased.get() == 0)
+            ::usleep(1000);
+    }
+};
+
+class Noop : public els::thread::IRunnable
+{
+public:
+
+    virtual void run(void) throw() {}
+};
+
+/* Fills the queue, evicting the nodes queued before it. */
+class Evictor : public els::thread::IRunnable
+{
+public:
+
+    explicit Evictor(els::thread::ThreadPool& pool)
+        : els::thread::IRunnable(), _M_pool(pool) {}
+
+    virtual void run(void) throw()
+    {
+        for (size_t i = 0; i < this->_M_pool.queueLimit(); ++i)
+            this->_M_pool.schedule(&this->_M_noop);
+    }
+
+private:
+
+    els::thread::ThreadPool& _M_pool;
+    Noop _M_noop;
+};
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(TaskGraph, nodesDropped)
+{
+    els::thread::ThreadPool pool;
+    els::thread::TaskGraph graph(pool);
+    Blocker blocker;
+    Evictor evictor(pool);
+    Stage first;
+    Stage second;
+
+    /*
+     * The only worker is busy, so the root run by the caller evicts
+     * the two other roots from the queue.
+     */
+    workerReleased.set(0);
+    pool.setQueueLimit(4, els::thread::ThreadPool::OVERFLOW_DROP_OLDEST);
+    pool.start(1);
+    pool.schedule(&blocker);
+    while (pool.queueDepth() != 0)
+        ::usleep(1000);
+
+    graph.addNode(&evictor, "evictor");
+    graph.addNode(&first, "first");
+    graph.addNode(&second, "second");
+    ELSUNIT_EXPECT_NO_THROW(graph.run());
+    ELSUNIT_EXPECT_EQ(2U, pool.droppedTasks());
+    ELSUNIT_EXPECT_EQ(1, first.runs);
+    ELSUNIT_EXPECT_EQ(1, second.runs);
+
+    workerReleased.set(1);
+    pool.stop();
+}
@@ -22,13 +22,18 @@
 
 #include "ElsUnit.hpp"
 
+#include <vector>
 #include <unistd.h>
+#include <sched.h>
 
 #include <els/ThreadPool.hpp>
 #include <els/IRunnable.hpp>
 #include <els/Macros.hpp>
 #include <els/Mutex.hpp>
 #include <els/Condition.hpp>
+#include <els/Atomic.hpp>
+#include <els/Exception.hpp>
+#include <els/CpuTopology.hpp>
 
 static els::thread::Mutex counterMutex;
 static int counter = 0;
@@ -70,3 +75,811 @@ ELSUNIT_SIMPLE_TESTCASE(ThreadPool, basicPool)
 }
 
 
+static els::thread::AtomicInt fanOutCounter(0);
+
+class FanOut : public els::thread::IRunnable
+{
+public:
+
+    FanOut(els::thread::ThreadPool& pool, unsigned depth)
+        : els::thread::IRunnable(), _M_pool(pool), _M_depth(depth) {}
+
+    virtual void run(void) throw()
+    {
+        if (this->_M_depth > 0)
+        {
+            this->_M_pool.schedule(
+                    new FanOut(this->_M_pool, this->_M_depth - 1), true);
+            this->_M_pool.schedule(
+                    new FanOut(this->_M_pool, this->_M_depth - 1), true);
+        }
+        fanOutCounter.inc();
+    }
+
+private:
+
+    els::thread::ThreadPool& _M_pool;
+    unsigned _M_depth;
+};
+
+static bool waitForCounter(els::thread::AtomicInt& cnt, int expected)
+{
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        if (cnt.get() == expected)
+            return true;
+        ::usleep(10000);
+    }
+
+    return false;
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, workStealingPool)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+
+    fanOutCounter.set(0);
+    ELSUNIT_EXPECT_EQ(els::thread::ThreadPool::SCHEDULE_WORK_STEALING,
+            pool.schedulingMode());
+    ELSUNIT_EXPECT_NO_THROW(pool.start(4));
+    for (unsigned i = 0; i < 100; ++i)
+        pool.schedule(new FanOut(pool, 0), true);
+    ELSUNIT_EXPECT_TRUE(waitForCounter(fanOutCounter, 100));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, workStealingFanOut)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+
+    fanOutCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(4));
+    pool.schedule(new FanOut(pool, 10), true);
+    /* A binary tree of depth 10 has 2047 nodes. */
+    ELSUNIT_EXPECT_TRUE(waitForCounter(fanOutCounter, 2047));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+static els::thread::AtomicInt runCounter(0);
+
+class CountRun : public els::thread::IRunnable
+{
+public:
+
+    explicit CountRun(int id = 0) : els::thread::IRunnable(), _M_id(id) {}
+
+    virtual void run(void) throw()
+    {
+        runCounter.inc();
+        lastRunId = this->_M_id;
+    }
+
+    static int lastRunId;
+
+private:
+
+    int _M_id;
+};
+
+int CountRun::lastRunId = -1;
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, boundedFail)
+{
+    els::thread::ThreadPool pool;
+    CountRun task;
+
+    ELSUNIT_EXPECT_NO_THROW(pool.setQueueLimit(4,
+            els::thread::ThreadPool::OVERFLOW_FAIL));
+    ELSUNIT_EXPECT_EQ(4U, pool.queueLimit());
+    for (unsigned i = 0; i < 4; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(&task));
+    ELSUNIT_EXPECT_EQ(4U, pool.queueDepth());
+    ELSUNIT_EXPECT_FALSE(pool.schedule(&task));
+    ELSUNIT_EXPECT_EXCEPTION(pool.setQueueLimit(8),
+            els::except::LogicError);
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(2));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 4));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(0U, pool.queueDepth());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, boundedDropOldest)
+{
+    els::thread::ThreadPool pool;
+
+    ELSUNIT_EXPECT_NO_THROW(pool.setQueueLimit(4,
+            els::thread::ThreadPool::OVERFLOW_DROP_OLDEST));
+    for (int i = 0; i < 6; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(new CountRun(i), true));
+    ELSUNIT_EXPECT_EQ(4U, pool.queueDepth());
+    ELSUNIT_EXPECT_EQ(2U, pool.droppedTasks());
+
+    runCounter.set(0);
+    CountRun::lastRunId = -1;
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 4));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(5, CountRun::lastRunId);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, boundedCallerRuns)
+{
+    els::thread::ThreadPool pool;
+    CountRun task;
+
+    ELSUNIT_EXPECT_NO_THROW(pool.setQueueLimit(2,
+            els::thread::ThreadPool::OVERFLOW_CALLER_RUNS));
+    runCounter.set(0);
+    for (unsigned i = 0; i < 5; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(&task));
+    ELSUNIT_EXPECT_EQ(3, runCounter.get());
+    ELSUNIT_EXPECT_EQ(2U, pool.queueDepth());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, boundedBlock)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+    CountRun task;
+
+    ELSUNIT_EXPECT_NO_THROW(pool.setQueueLimit(4,
+            els::thread::ThreadPool::OVERFLOW_BLOCK));
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(2));
+    for (unsigned i = 0; i < 1000; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(&task));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 1000));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+static int runOrder[32];
+
+class RecordRun : public els::thread::IRunnable
+{
+public:
+
+    explicit RecordRun(int id) : els::thread::IRunnable(), _M_id(id) {}
+
+    virtual void run(void) throw()
+    {
+        runOrder[runCounter.inc() - 1] = this->_M_id;
+    }
+
+private:
+
+    int _M_id;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, priorities)
+{
+    els::thread::ThreadPool pool;
+    els::thread::ThreadPool::TaskAttr attr;
+    const int expected[] = { 2, 5, 1, 4, 0, 3 };
+
+    ELSUNIT_EXPECT_EXCEPTION(pool.setPriorityLevels(0),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_NO_THROW(pool.setPriorityLevels(3));
+    ELSUNIT_EXPECT_EQ(3U, pool.priorityLevels());
+    ELSUNIT_EXPECT_EXCEPTION(pool.setQueueLimit(8),
+            els::except::LogicError);
+
+    for (int i = 0; i < 6; ++i)
+        pool.schedule(new RecordRun(i), attr.setPriority(2 - i % 3), true);
+    ELSUNIT_EXPECT_EXCEPTION(pool.setPriorityLevels(2),
+            els::except::LogicError);
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 6));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    for (int i = 0; i < 6; ++i)
+        ELSUNIT_EXPECT_EQ(expected[i], runOrder[i]);
+
+    ELSUNIT_EXPECT_EQ(2U, pool.waitLatency(0).count());
+    ELSUNIT_EXPECT_EQ(2U, pool.waitLatency(2).count());
+    ELSUNIT_EXPECT_EXCEPTION(pool.waitLatency(3),
+            els::except::InvalidArgument);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, taskGroups)
+{
+    els::thread::ThreadPool pool;
+    els::thread::ThreadPool::TaskAttr attr;
+    unsigned heavy = 0;
+    int heavyFirst = 0;
+
+    ELSUNIT_EXPECT_NO_THROW(heavy = pool.addTaskGroup("heavy", 3));
+    ELSUNIT_EXPECT_EQ(1U, heavy);
+    ELSUNIT_EXPECT_EQ(heavy, pool.taskGroup("heavy"));
+    ELSUNIT_EXPECT_EQ(0U, pool.taskGroup("default"));
+    ELSUNIT_EXPECT_EXCEPTION(pool.taskGroup("light"),
+            els::except::KeyNotFound);
+    ELSUNIT_EXPECT_EXCEPTION(pool.addTaskGroup("heavy", 1),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EXCEPTION(pool.schedule(new RecordRun(0),
+            attr.setGroup(2), true), els::except::InvalidArgument);
+
+    for (int i = 0; i < 8; ++i)
+        pool.schedule(new RecordRun(0), attr.setGroup(0), true);
+    for (int i = 0; i < 8; ++i)
+        pool.schedule(new RecordRun(1), attr.setGroup(heavy), true);
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 16));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    for (int i = 0; i < 8; ++i)
+        heavyFirst += runOrder[i];
+    ELSUNIT_EXPECT_EQ(6, heavyFirst);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, priorityAging)
+{
+    els::thread::ThreadPool pool;
+    els::thread::ThreadPool::TaskAttr attr;
+
+    ELSUNIT_EXPECT_NO_THROW(pool.setPriorityLevels(2));
+    ELSUNIT_EXPECT_NO_THROW(pool.setAgingThreshold(
+            els::misc::Timeval(0, 1000000)));
+    pool.schedule(new RecordRun(1), attr.setPriority(1), true);
+    ::usleep(2000);
+    for (int i = 0; i < 4; ++i)
+        pool.schedule(new RecordRun(0), attr.setPriority(0), true);
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 5));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(1, runOrder[0]);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, scheduleBatch)
+{
+    els::thread::ThreadPool pool;
+    CountRun task;
+    std::vector<els::thread::IRunnable*> tasks(1000, &task);
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(4));
+    ELSUNIT_EXPECT_EQ(1000U, pool.scheduleBatch(tasks.begin(), tasks.end()));
+    ELSUNIT_EXPECT_EQ(10U, pool.scheduleBatch(&tasks[0], 10));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 1010));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, scheduleBatchOrder)
+{
+    els::thread::ThreadPool pool;
+    els::thread::IRunnable* tasks[20];
+
+    for (int i = 0; i < 20; ++i)
+        tasks[i] = new RecordRun(i);
+    ELSUNIT_EXPECT_EQ(20U, pool.scheduleBatch(tasks, 20, true));
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 20));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    for (int i = 0; i < 20; ++i)
+        ELSUNIT_EXPECT_EQ(i, runOrder[i]);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, scheduleBatchBounded)
+{
+    els::thread::ThreadPool pool;
+    CountRun task;
+    std::vector<els::thread::IRunnable*> tasks(6, &task);
+
+    ELSUNIT_EXPECT_NO_THROW(pool.setQueueLimit(4,
+            els::thread::ThreadPool::OVERFLOW_FAIL));
+    ELSUNIT_EXPECT_EQ(4U, pool.scheduleBatch(tasks.begin(), tasks.end()));
+    ELSUNIT_EXPECT_EQ(4U, pool.queueDepth());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, scheduleBatchStealing)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+    CountRun task;
+    std::vector<els::thread::IRunnable*> tasks(500, &task);
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(4));
+    for (int i = 0; i < 4; ++i)
+        ELSUNIT_EXPECT_EQ(500U,
+                pool.scheduleBatch(tasks.begin(), tasks.end()));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 2000));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, staleTasks)
+{
+    els::thread::ThreadPool pool;
+    els::thread::ThreadPool::TaskAttr cancelAttr;
+    els::thread::ThreadPool::TaskAttr expireAttr;
+    els::thread::CancelToken token;
+    CountRun task;
+
+    cancelAttr.setCancelToken(token);
+    expireAttr.setTimeout(els::misc::Timeval(0, 1000000));
+    for (unsigned i = 0; i < 4; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(&task, cancelAttr));
+    for (unsigned i = 0; i < 2; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(&task, expireAttr));
+    for (unsigned i = 0; i < 3; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(&task));
+    ELSUNIT_EXPECT_TRUE(pool.schedule(new CountRun, cancelAttr, true));
+
+    token.cancel();
+    ::usleep(5000);
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 3));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(3, runCounter.get());
+    ELSUNIT_EXPECT_EQ(5U, pool.cancelledTasks());
+    ELSUNIT_EXPECT_EQ(2U, pool.expiredTasks());
+}
+
+static els::thread::AtomicInt pollStarted(0);
+
+class PollRun : public els::thread::IRunnable
+{
+public:
+
+    PollRun(void) : els::thread::IRunnable() {}
+
+    virtual void run(void) throw()
+    {
+        pollStarted.inc();
+        while (!els::thread::ThreadPool::cancellationRequested())
+            ::usleep(1000);
+        runCounter.inc();
+    }
+};
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, cooperativeCancellation)
+{
+    els::thread::ThreadPool pool;
+    els::thread::CancelToken token;
+    PollRun task;
+
+    ELSUNIT_EXPECT_FALSE(els::thread::ThreadPool::cancellationRequested());
+
+    pollStarted.set(0);
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(2));
+    pool.schedule(&task,
+            els::thread::ThreadPool::TaskAttr().setCancelToken(token));
+    pool.schedule(&task, els::thread::ThreadPool::TaskAttr().setTimeout(
+            els::misc::Timeval(0, 20000000)));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(pollStarted, 2));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 1));
+    token.cancel();
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 2));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(0U, pool.cancelledTasks());
+    ELSUNIT_EXPECT_EQ(0U, pool.expiredTasks());
+}
+
+class WakeRun : public els::thread::IRunnable
+{
+public:
+
+    WakeRun(els::thread::Mutex& mutex, els::thread::Condition& cond)
+        : els::thread::IRunnable(), _M_mutex(mutex), _M_cond(cond) {}
+
+    virtual void run(void) throw()
+    {
+        this->_M_mutex.lock();
+        this->_M_cond.unblockAll();
+        this->_M_mutex.unlock();
+    }
+
+private:
+
+    els::thread::Mutex& _M_mutex;
+    els::thread::Condition& _M_cond;
+};
+
+/* Blocks on a condition variable which only the cancellation signals. */
+class BlockRun : public els::thread::IRunnable
+{
+public:
+
+    explicit BlockRun(const els::thread::CancelToken& token)
+        : els::thread::IRunnable(), _M_token(token) {}
+
+    virtual void run(void) throw()
+    {
+        els::thread::Mutex mutex;
+        els::thread::Condition cond;
+        WakeRun wake(mutex, cond);
+        els::thread::StopCallback callback(this->_M_token.stopToken(), wake);
+
+        mutex.lock();
+        pollStarted.inc();
+        while (!this->_M_token.cancelled())
+            cond.block(mutex);
+        mutex.unlock();
+        runCounter.inc();
+    }
+
+private:
+
+    els::thread::CancelToken _M_token;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, stopTokenCancellation)
+{
+    els::thread::ThreadPool pool;
+    els::thread::StopToken stop;
+    els::thread::CancelToken token(stop);
+    els::thread::ThreadPool::TaskAttr attr;
+    BlockRun blocked(token);
+    CountRun task;
+
+    /* Requesting the stop wakes the running task and drops the rest. */
+    attr.setCancelToken(token);
+    pollStarted.set(0);
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    ELSUNIT_EXPECT_TRUE(pool.schedule(&blocked, attr));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(pollStarted, 1));
+    for (unsigned i = 0; i < 3; ++i)
+        ELSUNIT_EXPECT_TRUE(pool.schedule(&task, attr));
+
+    ELSUNIT_EXPECT_TRUE(stop.requestStop());
+    ELSUNIT_EXPECT_TRUE(token.cancelled());
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 1));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(1, runCounter.get());
+    ELSUNIT_EXPECT_EQ(3U, pool.cancelledTasks());
+}
+
+static els::thread::AtomicInt liveFunctors(0);
+
+template <size_t Size> class CountFunctor
+{
+public:
+
+    CountFunctor(void) { liveFunctors.inc(); }
+    CountFunctor(const CountFunctor&) { liveFunctors.inc(); }
+    ~CountFunctor(void) { liveFunctors.dec(); }
+
+    void operator ()(void) const
+    {
+        runCounter.inc();
+    }
+
+private:
+
+    char _M_payload[Size];
+};
+
+static void countFunction(void)
+{
+    runCounter.inc();
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, executeFunctors)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+    els::thread::ThreadPool::TaskAttr attr;
+    els::thread::CancelToken token;
+
+    runCounter.set(0);
+    liveFunctors.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(2));
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        ELSUNIT_EXPECT_TRUE(pool.execute(CountFunctor<8>()));
+        ELSUNIT_EXPECT_TRUE(pool.execute(CountFunctor<256>()));
+        ELSUNIT_EXPECT_TRUE(pool.execute(countFunction));
+    }
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 3000));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(0, liveFunctors.get());
+
+    /* Discarded functors are destroyed too. */
+    attr.setCancelToken(token);
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        ELSUNIT_EXPECT_TRUE(pool.execute(CountFunctor<8>(), attr));
+        ELSUNIT_EXPECT_TRUE(pool.execute(CountFunctor<256>(), attr));
+    }
+    ELSUNIT_EXPECT_EQ(20, liveFunctors.get());
+    token.cancel();
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1));
+    for (unsigned i = 0; (i < 100) && (pool.cancelledTasks() < 20); ++i)
+        ::usleep(10000);
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(20U, pool.cancelledTasks());
+    ELSUNIT_EXPECT_EQ(0, liveFunctors.get());
+    ELSUNIT_EXPECT_EQ(3000, runCounter.get());
+
+    ELSUNIT_EXPECT_TRUE(pool.execute(CountFunctor<8>()));
+    ELSUNIT_EXPECT_EXCEPTION(pool.execute(CountFunctor<8>(),
+            els::thread::ThreadPool::TaskAttr().setGroup(5)),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EQ(1, liveFunctors.get());
+}
+
+class SleepRun : public els::thread::IRunnable
+{
+public:
+
+    SleepRun(void) : els::thread::IRunnable() {}
+
+    virtual void run(void) throw()
+    {
+        ::usleep(20000);
+        runCounter.inc();
+    }
+};
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, elasticPool)
+{
+    els::thread::ThreadPool pool;
+    SleepRun task;
+    std::vector<els::thread::ThreadPool::ResizeEvent> events;
+    bool shrunk = false;
+
+    ELSUNIT_EXPECT_EXCEPTION(pool.start(0, 4),
+            els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EXCEPTION(pool.start(3, 2),
+            els::except::InvalidArgument);
+
+    pool.setGrowThreshold(els::misc::Timeval(0, 1000000));
+    pool.setIdleTimeout(els::misc::Timeval(0, 50000000));
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(1, 4));
+    ELSUNIT_EXPECT_EQ(1U, pool.numWorkers());
+    for (int i = 0; i < 16; ++i)
+    {
+        pool.schedule(&task);
+        ::usleep(2000);
+    }
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 16));
+    ELSUNIT_EXPECT_TRUE(pool.numWorkers() > 1);
+    ELSUNIT_EXPECT_TRUE(pool.numWorkers() <= 4);
+
+    for (unsigned i = 0; (i < 200) && !shrunk; ++i)
+    {
+        shrunk = (pool.numWorkers() == 1);
+        ::usleep(10000);
+    }
+    ELSUNIT_EXPECT_TRUE(shrunk);
+
+    events = pool.resizeEvents();
+    ELSUNIT_ASSERT_FALSE(events.empty());
+    ELSUNIT_EXPECT_TRUE(events.front().grown);
+    ELSUNIT_EXPECT_EQ(2U, events.front().workers);
+    ELSUNIT_EXPECT_TRUE(events.front().queueWait >= 1000000);
+    ELSUNIT_EXPECT_FALSE(events.back().grown);
+    ELSUNIT_EXPECT_EQ(1U, events.back().workers);
+
+    /* Retired workers can be spawned again. */
+    for (int i = 0; i < 8; ++i)
+    {
+        pool.schedule(&task);
+        ::usleep(2000);
+    }
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 24));
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(0U, pool.numWorkers());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, stats)
+{
+    els::thread::ThreadPool pool(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+    els::thread::ThreadPool::Stats stats;
+    els::thread::ThreadPool::TaskAttr attr;
+    els::thread::CancelToken token;
+    SleepRun task;
+
+    stats = pool.stats();
+    ELSUNIT_EXPECT_EQ(0U, stats.queueHighWater);
+    ELSUNIT_EXPECT_TRUE(stats.workers.empty());
+
+    attr.setCancelToken(token);
+    pool.schedule(&task, attr);
+    for (unsigned i = 0; i < 10; ++i)
+        pool.schedule(&task);
+    token.cancel();
+
+    runCounter.set(0);
+    ELSUNIT_EXPECT_NO_THROW(pool.start(3));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 10));
+    pool.schedule(new FanOut(pool, 4), true);
+    ::usleep(50000);
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+
+    /* Counters survive stopping the pool. */
+    stats = pool.stats();
+    ELSUNIT_EXPECT_EQ(0U, stats.queueDepth);
+    ELSUNIT_EXPECT_EQ(11U, stats.queueHighWater);
+    ELSUNIT_ASSERT_EQ(3U, stats.workers.size());
+    ELSUNIT_EXPECT_EQ(41U, stats.total.tasksRun);
+    ELSUNIT_EXPECT_EQ(42U, stats.total.waitLatency.count());
+    ELSUNIT_EXPECT_EQ(41U, stats.total.runTime.count());
+    ELSUNIT_EXPECT_TRUE(stats.total.runTime.max() >= 20000000);
+    ELSUNIT_EXPECT_TRUE(stats.total.localHighWater >= 1);
+    ELSUNIT_EXPECT_TRUE(stats.total.busyNs >= 200000000);
+    ELSUNIT_EXPECT_TRUE(stats.total.busyRatio() > 0.0);
+    ELSUNIT_EXPECT_TRUE(stats.total.busyRatio() < 1.0);
+    ELSUNIT_EXPECT_EQ(stats.total.tasksRun, stats.workers[0].tasksRun
+            + stats.workers[1].tasksRun + stats.workers[2].tasksRun);
+    ELSUNIT_EXPECT_EQ(stats.total.steals, stats.workers[0].steals
+            + stats.workers[1].steals + stats.workers[2].steals);
+
+    pool.resetStats();
+    stats = pool.stats();
+    ELSUNIT_EXPECT_EQ(0U, stats.queueHighWater);
+    ELSUNIT_EXPECT_EQ(0U, stats.total.tasksRun);
+    ELSUNIT_EXPECT_EQ(0U, stats.total.runTime.count());
+    ELSUNIT_EXPECT_EQ(0U, pool.waitLatency(0).count());
+}
+
+/*
+ * Tasks queued before the workers start are taken from the shared queue.
+ * They must never be moved to a local deque where nobody steals them
+ * or where they would skip their priority.
+ */
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, noDequeueChunks)
+{
+    els::thread::ThreadPool shared;
+    els::thread::ThreadPool prioritized(
+            els::thread::ThreadPool::SCHEDULE_WORK_STEALING);
+    CountRun task;
+
+    prioritized.setPriorityLevels(2);
+    runCounter.set(0);
+    for (int i = 0; i < 100; ++i)
+    {
+        shared.schedule(&task);
+        prioritized.schedule(&task);
+    }
+
+    ELSUNIT_ASSERT_NO_THROW(shared.start(2));
+    ELSUNIT_ASSERT_NO_THROW(prioritized.start(2));
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 200));
+    shared.stop();
+    prioritized.stop();
+    ELSUNIT_EXPECT_EQ(0U, shared.stats().total.localHighWater);
+    ELSUNIT_EXPECT_EQ(0U, prioritized.stats().total.localHighWater);
+}
+
+static els::thread::AtomicInt pollerStarted(0);
+
+class StatsPoller : public els::thread::IRunnable
+{
+public:
+
+    explicit StatsPoller(els::thread::ThreadPool& pool)
+        : els::thread::IRunnable(), _M_pool(pool) {}
+
+    virtual void run(void) throw()
+    {
+        pollerStarted.set(1);
+        for (int i = 0; i < 100; ++i)
+        {
+            this->_M_pool.queueDepth();
+            this->_M_pool.stats();
+            this->_M_pool.waitLatency(0);
+            ::usleep(1000);
+        }
+    }
+
+private:
+
+    els::thread::ThreadPool& _M_pool;
+};
+
+/* Tasks may keep polling the pool while stop() waits for them. */
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, statsDuringStop)
+{
+    els::thread::ThreadPool pool;
+    StatsPoller poller(pool);
+
+    pollerStarted.set(0);
+    ELSUNIT_ASSERT_NO_THROW(pool.start(1));
+    pool.schedule(&poller);
+    while (pollerStarted.get() == 0)
+        ::usleep(1000);
+    ELSUNIT_EXPECT_NO_THROW(pool.stop());
+    ELSUNIT_EXPECT_EQ(1U, pool.stats().total.tasksRun);
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, idleStrategies)
+{
+    const els::thread::ThreadPool::IdleStrategy strategies[] = {
+        els::thread::ThreadPool::IDLE_BLOCK,
+        els::thread::ThreadPool::IDLE_SPIN_THEN_PARK,
+        els::thread::ThreadPool::IDLE_ADAPTIVE,
+        els::thread::ThreadPool::IDLE_BUSY_POLL,
+    };
+    Incr incr;
+
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); ++i)
+    {
+        els::thread::ThreadPool pool;
+
+        ELSUNIT_EXPECT_EQ(els::thread::ThreadPool::IDLE_BLOCK,
+                pool.idleStrategy());
+        pool.setIdleStrategy(strategies[i], els::misc::Timeval(0, 200000));
+        ELSUNIT_EXPECT_EQ(strategies[i], pool.idleStrategy());
+
+        counter = 0;
+        ELSUNIT_EXPECT_NO_THROW(pool.start(2));
+        for (unsigned j = 0; j < 100; ++j)
+        {
+            pool.schedule(&incr);
+            if ((j % 10) == 0)
+                ::usleep(1000);
+        }
+        for (unsigned j = 0; (j < 1000) && (counter < 100); ++j)
+            ::usleep(10000);
+        ELSUNIT_EXPECT_NO_THROW(pool.stop());
+        ELSUNIT_EXPECT_EQ(100, counter);
+    }
+}
+
+class AffinityRun : public els::thread::IRunnable
+{
+public:
+
+    AffinityRun(void) : els::thread::IRunnable(), numCpus(0) {}
+
+    virtual void run(void) throw()
+    {
+        cpu_set_t set;
+
+        if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+            this->numCpus = CPU_COUNT(&set);
+        runCounter.inc();
+    }
+
+    int numCpus;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadPool, affinity)
+{
+    els::thread::ThreadPool pool;
+    els::sys::CpuTopology topology;
+    AffinityRun task;
+    std::vector<unsigned> cpus(1, topology.cpus().back().id);
+
+    ELSUNIT_EXPECT_EQ(els::thread::ThreadPool::AFFINITY_NONE,
+            pool.affinityPolicy());
+    ELSUNIT_EXPECT_EXCEPTION(pool.setAffinity(
+            els::thread::ThreadPool::AFFINITY_EXPLICIT),
+            els::except::InvalidArgument);
+
+    /* Auto-sizing follows the explicit CPU set. */
+    pool.setAffinity(els::thread::ThreadPool::AFFINITY_EXPLICIT, cpus);
+    runCounter.set(0);
+    ELSUNIT_ASSERT_NO_THROW(pool.start());
+    ELSUNIT_EXPECT_EQ(1U, pool.numWorkers());
+    ELSUNIT_EXPECT_EXCEPTION(pool.setAffinity(
+            els::thread::ThreadPool::AFFINITY_NONE),
+            els::except::LogicError);
+    pool.schedule(&task);
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 1));
+    ELSUNIT_EXPECT_EQ(1, task.numCpus);
+    pool.stop();
+
+    pool.setAffinity(els::thread::ThreadPool::AFFINITY_SCATTER);
+    ELSUNIT_ASSERT_NO_THROW(pool.start());
+    ELSUNIT_EXPECT_EQ(topology.recommendedThreads(), pool.numWorkers());
+    pool.schedule(&task);
+    ELSUNIT_EXPECT_TRUE(waitForCounter(runCounter, 2));
+    ELSUNIT_EXPECT_EQ(1, task.numCpus);
+    pool.stop();
+}
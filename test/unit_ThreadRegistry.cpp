@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_ThreadRegistry.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/ThreadRegistry.hpp>
+#include <els/INamedThread.hpp>
+
+#include <unistd.h>
+
+using els::thread::ThreadRegistry;
+
+class BusyThread : public els::thread::INamedThread
+{
+public:
+
+    BusyThread(void) : els::thread::INamedThread("busy-worker"), busyNs(0) {}
+
+    els::ElsUint64 busyNs;
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        els::ElsUint64 start = ThreadRegistry::currentCpuNs();
+
+        while (ThreadRegistry::currentCpuNs() - start < 30000000ULL)
+            ;
+        this->busyNs = ThreadRegistry::currentCpuNs() - start;
+
+        while (!this->_M_stopRequested())
+            ::usleep(1000);
+        return 0;
+    }
+};
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadRegistry, snapshot)
+{
+    BusyThread thread;
+    std::vector<ThreadRegistry::ThreadInfo> infos;
+    const ThreadRegistry::ThreadInfo* info = 0;
+    size_t before = ThreadRegistry::size();
+
+    ELSUNIT_ASSERT_NO_THROW(thread.start());
+    while (__atomic_load_n(&thread.busyNs, __ATOMIC_RELAXED) == 0)
+        ::usleep(1000);
+    ELSUNIT_EXPECT_EQ(before + 1, ThreadRegistry::size());
+
+    /* Let it go through a few sleeps. */
+    ::usleep(20000);
+    infos = ThreadRegistry::snapshot();
+    for (size_t i = 0; i < infos.size(); ++i)
+    {
+        if (infos[i].tid == thread.tid())
+            info = &infos[i];
+    }
+    ELSUNIT_ASSERT_TRUE(info != 0);
+    ELSUNIT_EXPECT_STRING_EQ("busy-worker", info->name);
+    ELSUNIT_EXPECT_EQ(els::thread::IThread::THREAD_RUNNING, info->state);
+    ELSUNIT_EXPECT_TRUE(info->cpuNs >= 20000000ULL);
+    ELSUNIT_EXPECT_TRUE(info->voluntarySwitches > 0);
+
+    ELSUNIT_EXPECT_NO_THROW(thread.stop());
+    ELSUNIT_EXPECT_NO_THROW(thread.join());
+    ELSUNIT_EXPECT_EQ(before, ThreadRegistry::size());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(ThreadRegistry, currentCpuNs)
+{
+    els::ElsUint64 start = ThreadRegistry::currentCpuNs();
+    volatile unsigned sum = 0;
+
+    for (unsigned i = 0; i < 1000000; ++i)
+        sum += i;
+    ELSUNIT_EXPECT_TRUE(ThreadRegistry::currentCpuNs() > start);
+}
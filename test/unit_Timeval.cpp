@@ -59,3 +59,26 @@ ELSUNIT_SIMPLE_TESTCASE(Timeval, toTimespec)
 }
 
 
+
+ELSUNIT_SIMPLE_TESTCASE(Timeval, add)
+{
+    els::misc::Timeval t(1, 600000000);
+    t += els::misc::Timeval(2, 500000000);
+    ELSUNIT_EXPECT_EQ(4, t.getSec());
+    ELSUNIT_EXPECT_EQ(100000000, t.getNsec());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Timeval, compare)
+{
+    ELSUNIT_EXPECT_TRUE(els::misc::Timeval(1, 5) < els::misc::Timeval(2, 0));
+    ELSUNIT_EXPECT_TRUE(els::misc::Timeval(1, 5) < els::misc::Timeval(1, 6));
+    ELSUNIT_EXPECT_FALSE(els::misc::Timeval(1, 5) < els::misc::Timeval(1, 5));
+}
+
+ELSUNIT_SIMPLE_TESTCASE(Timeval, now)
+{
+    els::misc::Timeval before(::time(0), 0);
+    els::misc::Timeval now = els::misc::Timeval::now();
+
+    ELSUNIT_EXPECT_FALSE(now < before);
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_TreiberStack.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/TreiberStack.hpp>
+#include <els/HazardPointer.hpp>
+#include <els/IThread.hpp>
+#include <els/Atomic.hpp>
+
+#include <vector>
+
+namespace {
+
+const int numThreads = 4;
+const int itemsPerThread = 20000;
+
+els::thread::AtomicInt liveItems(0);
+els::thread::AtomicInt deletedNodes(0);
+
+/* Counts its instances, to check that every node gets freed. */
+struct Item
+{
+    Item(int val = 0) : value(val) { liveItems.inc(); }
+    Item(const Item& other) : value(other.value) { liveItems.inc(); }
+    ~Item(void) { liveItems.dec(); }
+
+    Item& operator=(const Item& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+
+    int value;
+};
+
+class Worker : public els::thread::IThread
+{
+public:
+    explicit Worker(els::thread::TreiberStack<int>& stack)
+        : els::thread::IThread(), sum(0), popped(0), _M_stack(stack) {}
+
+    long long sum;
+    int popped;
+
+protected:
+    virtual int _M_run(void)
+    {
+        int val = 0;
+
+        /* Mixed pushes and pops keep the top node changing hands. */
+        for (int i = 1; i <= itemsPerThread; ++i)
+        {
+            this->_M_stack.push(i);
+            if ((i % 2) == 0)
+                this->_M_pop(val);
+        }
+        while (this->_M_pop(val));
+
+        return 0;
+    }
+
+private:
+    bool _M_pop(int& val)
+    {
+        if (!this->_M_stack.pop(val))
+            return false;
+
+        this->sum += val;
+        ++this->popped;
+        return true;
+    }
+
+    els::thread::TreiberStack<int>& _M_stack;
+};
+
+void countingDeleter(void* ptr)
+{
+    deletedNodes.inc();
+    delete static_cast<int*>(ptr);
+}
+
+}
+
+ELSUNIT_SIMPLE_TESTCASE(TreiberStack, pushPop)
+{
+    els::thread::TreiberStack<int> stack;
+    int val = 0;
+
+    ELSUNIT_EXPECT_TRUE(stack.empty());
+    ELSUNIT_EXPECT_FALSE(stack.pop(val));
+    for (int i = 0; i < 5; ++i)
+        stack.push(i);
+    ELSUNIT_EXPECT_FALSE(stack.empty());
+    for (int i = 4; i >= 0; --i)
+    {
+        ELSUNIT_EXPECT_TRUE(stack.pop(val));
+        ELSUNIT_EXPECT_EQ(i, val);
+    }
+    ELSUNIT_EXPECT_FALSE(stack.pop(val));
+    ELSUNIT_EXPECT_TRUE(stack.empty());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(TreiberStack, reclaimsNodes)
+{
+    Item item;
+
+    liveItems.set(0);
+    {
+        els::thread::TreiberStack<Item> stack;
+
+        for (int i = 0; i < 1000; ++i)
+            stack.push(Item(i));
+        for (int i = 0; i < 500; ++i)
+            stack.pop(item);
+        /* Popped nodes are freed in batches. */
+        ELSUNIT_EXPECT_TRUE(stack.pendingReclaim() < 500);
+    }
+    ELSUNIT_EXPECT_EQ(0, liveItems.get());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(TreiberStack, concurrent)
+{
+    els::thread::TreiberStack<int> stack;
+    std::vector<Worker*> workers;
+    long long sum = 0;
+    int popped = 0;
+
+    for (int i = 0; i < numThreads; ++i)
+        workers.push_back(new Worker(stack));
+    for (int i = 0; i < numThreads; ++i)
+        ELSUNIT_ASSERT_NO_THROW(workers[i]->start());
+    for (int i = 0; i < numThreads; ++i)
+    {
+        ELSUNIT_EXPECT_NO_THROW(workers[i]->join());
+        sum += workers[i]->sum;
+        popped += workers[i]->popped;
+        delete workers[i];
+    }
+
+    ELSUNIT_EXPECT_EQ(numThreads * itemsPerThread, popped);
+    ELSUNIT_EXPECT_EQ(static_cast<long long>(numThreads) * itemsPerThread
+            * (itemsPerThread + 1) / 2, sum);
+    ELSUNIT_EXPECT_TRUE(stack.empty());
+}
+
+ELSUNIT_SIMPLE_TESTCASE(HazardPointer, protectedNodeSurvivesScan)
+{
+    els::thread::HazardDomain domain(1);
+    int* shared = new int(42);
+    int* other = new int(7);
+
+    deletedNodes.set(0);
+    {
+        els::thread::HazardPointer reader(domain);
+        els::thread::HazardPointer writer(domain);
+
+        ELSUNIT_EXPECT_EQ(shared, reader.protect(&shared));
+        /* Threshold 1 - every retire scans. */
+        writer.retire(shared, &countingDeleter);
+        ELSUNIT_EXPECT_EQ(0, deletedNodes.get());
+        ELSUNIT_EXPECT_EQ(1U, domain.pending());
+        ELSUNIT_EXPECT_EQ(42, *shared);
+
+        reader.reset();
+        writer.retire(other, &countingDeleter);
+        ELSUNIT_EXPECT_EQ(2, deletedNodes.get());
+        ELSUNIT_EXPECT_EQ(0U, domain.pending());
+    }
+}
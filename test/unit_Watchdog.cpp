@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2013 Bartosz Golaszewski
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * @file    unit_Watchdog.cpp
+ */
+
+#include "ElsUnit.hpp"
+
+#include <els/Watchdog.hpp>
+#include <els/Exception.hpp>
+#include <els/System.hpp>
+
+#include <unistd.h>
+
+using els::thread::Watchdog;
+
+class CountStalls : public Watchdog::StallHandler
+{
+public:
+
+    CountStalls(void) : Watchdog::StallHandler(), count(0), last() {}
+
+    virtual void onStall(const Watchdog::StallInfo& info) throw()
+    {
+        this->last = info;
+        __atomic_add_fetch(&this->count, 1, __ATOMIC_RELEASE);
+    }
+
+    int count;
+    Watchdog::StallInfo last;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Watchdog, manualCheck)
+{
+    Watchdog watchdog(2);
+    CountStalls handler;
+    Watchdog::Heartbeat heartbeat;
+    Watchdog::Heartbeat other;
+
+    ELSUNIT_EXPECT_EXCEPTION(Watchdog(0), els::except::InvalidArgument);
+    ELSUNIT_EXPECT_EXCEPTION(watchdog.add("zero", els::misc::Timeval(0, 0)),
+            els::except::InvalidArgument);
+
+    watchdog.setActions(Watchdog::ACTION_CALLBACK);
+    watchdog.setStallHandler(&handler);
+    heartbeat = watchdog.add("worker", els::misc::Timeval(0, 20000000));
+    other = watchdog.add("other", els::misc::Timeval(10, 0));
+    ELSUNIT_EXPECT_TRUE(heartbeat.valid());
+    ELSUNIT_EXPECT_EXCEPTION(watchdog.add("full", els::misc::Timeval(1, 0)),
+            els::except::OutOfRange);
+
+    heartbeat.beat();
+    ELSUNIT_EXPECT_EQ(0U, watchdog.check());
+    ::usleep(40000);
+    ELSUNIT_EXPECT_EQ(1U, watchdog.check());
+    ELSUNIT_EXPECT_EQ(1, handler.count);
+    ELSUNIT_EXPECT_STRING_EQ("worker", handler.last.name);
+    ELSUNIT_EXPECT_EQ(els::sys::getTid(), handler.last.tid);
+    ELSUNIT_EXPECT_TRUE(handler.last.stalledNs > 20000000ULL);
+
+    /* Reported once per stall. */
+    ELSUNIT_EXPECT_EQ(0U, watchdog.check());
+
+    heartbeat.beat();
+    ELSUNIT_EXPECT_EQ(0U, watchdog.check());
+    ::usleep(40000);
+    ELSUNIT_EXPECT_EQ(1U, watchdog.check());
+    ELSUNIT_EXPECT_EQ(2U, watchdog.stalls());
+
+    watchdog.remove(heartbeat);
+    ELSUNIT_EXPECT_FALSE(heartbeat.valid());
+    ELSUNIT_EXPECT_EXCEPTION(watchdog.remove(heartbeat),
+            els::except::InvalidArgument);
+    ::usleep(40000);
+    ELSUNIT_EXPECT_EQ(0U, watchdog.check());
+    {
+        Watchdog foreign(1);
+        Watchdog::Heartbeat stranger = foreign.add("stranger",
+                els::misc::Timeval(10, 0));
+
+        ELSUNIT_EXPECT_EXCEPTION(watchdog.remove(stranger),
+                els::except::InvalidArgument);
+        ELSUNIT_EXPECT_EXCEPTION(foreign.remove(other),
+                els::except::InvalidArgument);
+        ELSUNIT_EXPECT_TRUE(stranger.valid());
+        foreign.remove(stranger);
+    }
+    watchdog.remove(other);
+}
+
+class MonitoredThread : public els::thread::IThread
+{
+public:
+
+    explicit MonitoredThread(Watchdog& watchdog)
+        : els::thread::IThread(), _M_watchdog(watchdog) {}
+
+protected:
+
+    virtual int _M_run(void)
+    {
+        Watchdog::Heartbeat heartbeat = this->_M_watchdog.add("monitored",
+                els::misc::Timeval(0, 30000000));
+        volatile bool spin = true;
+
+        /* Healthy for a while, then spin without beating. */
+        for (int i = 0; i < 10; ++i)
+        {
+            heartbeat.beat();
+            ::usleep(5000);
+        }
+        while (spin && !this->_M_stopRequested())
+            ;
+
+        this->_M_watchdog.remove(heartbeat);
+        return 0;
+    }
+
+private:
+
+    Watchdog& _M_watchdog;
+};
+
+ELSUNIT_SIMPLE_TESTCASE(Watchdog, monitorThread)
+{
+    Watchdog watchdog(4, els::misc::Timeval(0, 5000000));
+    MonitoredThread thread(watchdog);
+    CountStalls handler;
+
+    watchdog.setActions(Watchdog::ACTION_CALLBACK
+            | Watchdog::ACTION_DUMP_STACK);
+    watchdog.setStallHandler(&handler);
+    ELSUNIT_ASSERT_NO_THROW(watchdog.start());
+    ELSUNIT_ASSERT_NO_THROW(thread.start());
+
+    for (int i = 0; (i < 500)
+            && (__atomic_load_n(&handler.count, __ATOMIC_ACQUIRE) == 0); ++i)
+        ::usleep(10000);
+
+    ELSUNIT_EXPECT_TRUE(
+            __atomic_load_n(&handler.count, __ATOMIC_ACQUIRE) > 0);
+    ELSUNIT_EXPECT_STRING_EQ("monitored", handler.last.name);
+    ELSUNIT_EXPECT_EQ(thread.tid(), handler.last.tid);
+
+    ELSUNIT_EXPECT_NO_THROW(thread.stop());
+    ELSUNIT_EXPECT_NO_THROW(thread.join());
+    ELSUNIT_EXPECT_NO_THROW(watchdog.stop());
+    ELSUNIT_EXPECT_NO_THROW(watchdog.join());
+}